@@ -0,0 +1,87 @@
+//! Measures PosixProcessRunner launch latency for the fork() and posix_spawn() strategies.
+//!
+//! Each round starts `/bin/true` N times through the runner (including the exec-status handshake) and reaps every
+//! child, so the numbers reflect what `up` pays per forward before kubectl itself starts doing work.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+
+#include "kubeforward/runtime/process_runner.h"
+
+namespace {
+
+using kubeforward::runtime::LaunchStrategy;
+using kubeforward::runtime::PosixProcessRunner;
+using kubeforward::runtime::StartProcessRequest;
+
+struct BenchResult {
+  double total_ms = 0;
+  double per_launch_us = 0;
+  int failures = 0;
+};
+
+BenchResult RunLaunches(LaunchStrategy strategy, int launches, const std::string& binary) {
+  PosixProcessRunner runner(strategy);
+  StartProcessRequest request;
+  request.argv = {binary};
+
+  BenchResult result;
+  std::vector<int> pids;
+  pids.reserve(static_cast<size_t>(launches));
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < launches; ++i) {
+    std::string error;
+    const auto started = runner.Start(request, error);
+    if (!started.has_value()) {
+      ++result.failures;
+      continue;
+    }
+    pids.push_back(started->pid);
+  }
+  const auto launched = std::chrono::steady_clock::now();
+  for (const int pid : pids) {
+    (void)::waitpid(pid, nullptr, 0);
+  }
+
+  result.total_ms = std::chrono::duration<double, std::milli>(launched - start).count();
+  result.per_launch_us = launches > 0 ? result.total_ms * 1000.0 / launches : 0;
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const std::string binary = argc > 1 ? argv[1] : "/bin/true";
+  std::vector<std::pair<std::string, LaunchStrategy>> strategies = {{"fork", LaunchStrategy::kFork}};
+  if (PosixProcessRunner::SupportsSpawn()) {
+    strategies.emplace_back("posix_spawn", LaunchStrategy::kSpawn);
+  } else {
+    std::cerr << "posix_spawn launch path not available; benchmarking fork only\n";
+  }
+
+  std::cout << std::left << std::setw(14) << "strategy" << std::setw(10) << "launches" << std::setw(14) << "total ms"
+            << "us/launch\n";
+  int failures = 0;
+  for (const int launches : {10, 100, 1000}) {
+    for (const auto& [name, strategy] : strategies) {
+      // Warm-up round so page cache and dynamic loader state do not favour whichever strategy runs second.
+      (void)RunLaunches(strategy, std::min(launches, 10), binary);
+      const auto result = RunLaunches(strategy, launches, binary);
+      failures += result.failures;
+      std::cout << std::left << std::setw(14) << name << std::setw(10) << launches << std::setw(14) << std::fixed
+                << std::setprecision(2) << result.total_ms << result.per_launch_us << "\n";
+    }
+  }
+  if (failures > 0) {
+    std::cerr << failures << " launches failed\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -27,6 +27,12 @@ enum class RestartPolicy {
   kReplace,
 };
 
+/// Engine that carries a forward's traffic to the cluster.
+enum class PortForwardEngine {
+  kKubectl,
+  kNative,
+};
+
 /// File-level metadata for ownership and project labeling.
 struct Metadata {
   std::string project;
@@ -43,6 +49,9 @@ struct TargetDefaults {
   std::optional<std::string> context;
   std::optional<std::string> namespace_name;
   std::optional<std::string> bind_address;
+  std::optional<PortForwardEngine> port_forward_engine;
+  /// Plain-HTTP API server (typically `kubectl proxy`) used by the native engine.
+  std::optional<std::string> api_server;
   std::map<std::string, std::string> labels;
 };
 
@@ -73,6 +82,32 @@ struct HealthCheck {
   std::optional<int> timeout_ms;
 };
 
+/// Upstream connections the local proxy keeps open ahead of clients, so a new client skips the tunnel's
+/// stream setup round-trip.
+struct WarmPool {
+  int size = 0;
+  /// Connections opened per second while the pool is below `size`.
+  int refill_per_second = 10;
+
+  bool operator==(const WarmPool&) const = default;
+};
+
+/// How connections to a load-balanced forward are spread over its pods.
+enum class LoadBalanceStrategy {
+  kRoundRobin,
+  kLeastConnections,
+};
+
+/// Spreads a service forward over several ready endpoints, one port-forward tunnel per pod, instead of the single pod
+/// kubectl picks.
+struct LoadBalance {
+  /// Endpoints to open tunnels to; fewer are used when the service has fewer ready endpoints.
+  int replicas = 0;
+  LoadBalanceStrategy strategy = LoadBalanceStrategy::kRoundRobin;
+
+  bool operator==(const LoadBalance&) const = default;
+};
+
 /// Full runtime definition for one named forward entry.
 struct ForwardDefinition {
   std::string name;
@@ -81,6 +116,8 @@ struct ForwardDefinition {
   bool detach = false;
   RestartPolicy restart_policy = RestartPolicy::kFailFast;
   std::optional<HealthCheck> health_check;
+  std::optional<WarmPool> warm_pool;
+  std::optional<LoadBalance> load_balance;
   std::map<std::string, std::string> env;
   std::map<std::string, std::string> annotations;
 };
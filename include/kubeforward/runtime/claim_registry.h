@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "kubeforward/runtime/state_store.h"
+
+namespace kubeforward::runtime {
+
+//! Registry every state file registers in, wherever it lives (default state files and `KUBEFORWARD_STATE_FILE` alike):
+//! one per user under the kubeforward temp directory, so it is never written by someone else.
+std::filesystem::path ClaimRegistryPath();
+
+//! Records that the state file at `state_path` now claims exactly `keys`, replacing what it registered before, and
+//! drops the claims of state files that no longer exist. Nothing is written when the registry already agrees. Creates
+//! the registry's directory when it is missing.
+bool RegisterStateClaims(const std::filesystem::path& registry_path, const std::filesystem::path& state_path,
+                         const std::vector<PortClaimKey>& keys, std::string& error);
+
+//! Registry lookup result: the state files that registered a claim on one of the keys (hash matches; the state file
+//! itself decides).
+struct ClaimRegistryLookup {
+  std::vector<std::filesystem::path> state_paths;
+  std::vector<std::string> errors;
+
+  bool ok() const { return errors.empty(); }
+};
+
+//! Looks `keys` up in the mapped registry without decoding the rest of it. Missing registry is treated as empty.
+ClaimRegistryLookup LookupClaimRegistry(const std::filesystem::path& registry_path,
+                                        const std::vector<PortClaimKey>& keys);
+
+//! Claims on `keys` from the state file at `state_path` and from every other state file its registry points at.
+//! The registry only widens the search: when it or another state file cannot be read, that part is skipped. Errors
+//! reading `state_path` itself are reported.
+PortClaimLookup LookupRegisteredPortClaims(const std::filesystem::path& state_path,
+                                           const std::vector<PortClaimKey>& keys);
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kubeforward::runtime {
+
+//! Extra NAME=VALUE pairs for a child's environment, on top of (and overriding) kubeforward's own.
+using CommandEnvironment = std::vector<std::pair<std::string, std::string>>;
+
+//! Runs `argv` (looked up on PATH) to completion and returns its stdout in `output`; on failure `error` carries its
+//! stderr. The child runs in its own process group, which is killed once `timeout` passes.
+bool RunCommandCapturingOutput(const std::vector<std::string>& argv, const CommandEnvironment& environment,
+                               std::chrono::milliseconds timeout, std::string& output, std::string& error);
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace kubeforward::runtime {
+
+//! Readiness notification mechanism behind an EventLoop.
+enum class EventLoopBackend {
+  //! poll(2); portable, O(watched fds) per wait.
+  kPoll,
+  //! epoll(7); Linux only.
+  kEpoll,
+  //! io_uring poll requests batched into one io_uring_enter per wait; Linux 5.11+ only.
+  kIoUring,
+};
+
+//! Interest and readiness bits for EventLoop::Watch and ReadyEvent::events.
+inline constexpr unsigned kEventReadable = 1u << 0;
+inline constexpr unsigned kEventWritable = 1u << 1;
+//! Reported only: the peer hung up or the socket has a pending error; the next read/write surfaces the cause.
+inline constexpr unsigned kEventHangup = 1u << 2;
+
+struct ReadyEvent {
+  int fd = -1;
+  unsigned events = 0;
+};
+
+//! Level-triggered readiness loop over a changing set of file descriptors, used by one thread.
+//!
+//! Callers declare what they want per descriptor with Watch() and must Forget() a descriptor before closing it
+//! (io_uring keeps a reference to the file while a poll request is armed, so a closed socket would not be released).
+class EventLoop {
+ public:
+  virtual ~EventLoop() = default;
+
+  //! Sets the interest mask for `fd`; 0 stops watching it. Unchanged masks cost nothing.
+  virtual bool Watch(int fd, unsigned events, std::string& error) = 0;
+  //! Drops `fd` from the loop; call before closing it.
+  virtual void Forget(int fd) = 0;
+  //! Waits up to `timeout_ms` (-1 forever) and replaces `ready` with the descriptors that became ready.
+  //! An interrupted wait returns true with no events.
+  virtual bool Wait(int timeout_ms, std::vector<ReadyEvent>& ready, std::string& error) = 0;
+
+  virtual EventLoopBackend backend() const = 0;
+};
+
+const char* EventLoopBackendName(EventLoopBackend backend);
+//! Parses "poll", "epoll" or "io_uring".
+std::optional<EventLoopBackend> ParseEventLoopBackend(const std::string& value);
+//! epoll on Linux, poll elsewhere.
+EventLoopBackend PlatformEventLoopBackend();
+
+//! Creates the `preferred` backend, falling back io_uring -> epoll -> poll when the platform or kernel (e.g. a
+//! seccomp profile or kernel.io_uring_disabled) does not provide it. Never returns null.
+std::unique_ptr<EventLoop> CreateEventLoop(EventLoopBackend preferred);
+
+}  // namespace kubeforward::runtime
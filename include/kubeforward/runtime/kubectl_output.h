@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kubeforward::runtime {
+
+//! Classification of one `kubectl port-forward` output line.
+enum class KubectlOutputEventKind {
+  //! "Forwarding from ADDR:LOCAL -> REMOTE": the local listener is bound.
+  kForwarding,
+  //! "lost connection to pod": the tunnel is gone even if kubectl has not exited yet.
+  kConnectionLost,
+  //! "Unable to listen on port ..." or a kubectl/API error line.
+  kError,
+};
+
+//! One recognized kubectl output line.
+struct KubectlOutputEvent {
+  KubectlOutputEventKind kind = KubectlOutputEventKind::kForwarding;
+  int local_port = 0;
+  std::string line;
+};
+
+//! Incremental line parser for kubectl port-forward stdout/stderr.
+class KubectlOutputParser {
+ public:
+  //! Consumes a chunk of output and returns events for every line completed by it.
+  std::vector<KubectlOutputEvent> Feed(std::string_view chunk);
+
+ private:
+  std::string partial_line_;
+};
+
+//! kubectl output event attributed to the process that produced it.
+struct ForwardOutputEvent {
+  int pid = 0;
+  KubectlOutputEvent event;
+};
+
+//! Follows the output of started forwards and turns it into readiness/failure events.
+//!
+//! Captured pipes are polled and echoed to std::cout/std::cerr so foreground sessions keep showing kubectl output.
+//! Daemon log files are read from the offset recorded before launch and are not echoed.
+class ForwardOutputMonitor {
+ public:
+  ForwardOutputMonitor() = default;
+  ForwardOutputMonitor(const ForwardOutputMonitor&) = delete;
+  ForwardOutputMonitor& operator=(const ForwardOutputMonitor&) = delete;
+  ~ForwardOutputMonitor();
+
+  //! Takes ownership of the captured pipe read ends of `pid` (either may be -1).
+  void TrackPipes(int pid, int stdout_fd, int stderr_fd);
+  //! Follows bytes appended to `log_path` after `offset` on behalf of `pid`.
+  void TrackLogFile(int pid, const std::filesystem::path& log_path, std::uintmax_t offset);
+  //! Stops following `pid` and closes its pipes.
+  void Untrack(int pid);
+
+  //! Captured pipe descriptors still open, for callers that multiplex them with other wake-up sources.
+  std::vector<int> PipeDescriptors() const;
+
+  //! Waits up to `timeout` for captured output and returns the events parsed from whatever arrived.
+  std::vector<ForwardOutputEvent> Wait(std::chrono::milliseconds timeout);
+
+ private:
+  struct Source {
+    int pid = 0;
+    int fd = -1;
+    bool to_stderr = false;
+    std::filesystem::path log_path;
+    std::uintmax_t log_offset = 0;
+    KubectlOutputParser parser;
+  };
+
+  void Drain(Source& source, std::vector<ForwardOutputEvent>& events);
+
+  std::vector<Source> sources_;
+};
+
+//! Returns the current size of `path`, or 0 when it does not exist yet.
+std::uintmax_t CurrentFileSize(const std::filesystem::path& path);
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kubeforward/runtime/event_loop.h"
+#include "kubeforward/runtime/stream_relay.h"
+
+namespace kubeforward::runtime {
+
+//! How a route served by several upstreams picks one for a new connection.
+enum class UpstreamBalancing {
+  kRoundRobin,
+  //! The upstream with the fewest open relayed connections; ties go round-robin.
+  kLeastConnections,
+};
+
+//! One local listener owned by kubeforward and the loopback port of the kubectl child it relays to.
+struct LocalProxyRoute {
+  std::string bind_address = "127.0.0.1";
+  int local_port = 0;
+  int upstream_port = 0;
+  //! Forward the route belongs to; only used to label Stats().
+  std::string forward_name;
+  //! Upstream connections kept open ahead of clients; 0 disables the warm pool.
+  int warm_pool_size = 0;
+  //! Warm connections opened per second while the pool is below its size.
+  int warm_pool_refill_per_second = 0;
+  //! Further kubectl children serving the route, e.g. one per pod of a load-balanced forward. New connections are
+  //! spread over `upstream_port` and these according to `balancing`.
+  std::vector<int> balanced_upstream_ports;
+  UpstreamBalancing balancing = UpstreamBalancing::kRoundRobin;
+};
+
+//! Traffic relayed through one route since the proxy started.
+struct LocalProxyRouteStats {
+  LocalProxyRoute route;
+  uint64_t connections = 0;
+  uint64_t bytes_to_upstream = 0;
+  uint64_t bytes_to_client = 0;
+  //! Connections paired with an already open upstream from the warm pool.
+  uint64_t warm_hits = 0;
+  //! Connections established per upstream, `upstream_port` first, then `balanced_upstream_ports`.
+  std::vector<uint64_t> upstream_connections;
+  //! Times an upstream refused a connection and was taken out of rotation.
+  uint64_t ejections = 0;
+};
+
+//! TCP relay that keeps the user-facing local ports open across kubectl restarts.
+//!
+//! kubeforward binds the local ports itself and forwards each accepted connection to kubectl listening on
+//! 127.0.0.1:<upstream_port>. While the upstream is down (kubectl restarting), new connections are held and the
+//! upstream connect is retried for `upstream_retry_window` instead of being refused; only connections that were in
+//! flight through the old tunnel are lost. Relaying runs on one background thread with non-blocking sockets and
+//! StreamRelay, so on Linux payload bytes are spliced between the sockets without being copied into user space.
+//! Readiness comes from an EventLoop, so each iteration only touches the connections that have work to do.
+//!
+//! Routes with a warm pool keep upstream connections open before any client arrives. Connecting to kubectl is what
+//! makes it open a stream to the pod, so a client paired with a warm connection skips that API server round-trip.
+//! Warm connections the remote side closes are dropped and replaced at the refill rate.
+//!
+//! Routes with several upstreams spread new connections over them. An upstream that refuses a connection (its kubectl
+//! exited or was stopped) is ejected for a few seconds and the connection moves on to the next one right away; only
+//! when every upstream is ejected does the connection fall back to the retry window.
+//!
+//! Drain() retires the proxy gracefully: the listeners close, so new connections to the local ports are refused, while
+//! the connections already relayed carry on until they finish or the deadline passes.
+class LocalForwardProxy {
+ public:
+  explicit LocalForwardProxy(std::chrono::milliseconds upstream_retry_window = std::chrono::milliseconds(10000),
+                             StreamRelayMode relay_mode = StreamRelayMode::kAuto,
+                             EventLoopBackend event_backend = PlatformEventLoopBackend());
+  LocalForwardProxy(const LocalForwardProxy&) = delete;
+  LocalForwardProxy& operator=(const LocalForwardProxy&) = delete;
+  ~LocalForwardProxy();
+
+  //! Binds every route and starts relaying. Nothing is left listening when any route fails to bind.
+  bool Start(const std::vector<LocalProxyRoute>& routes, std::string& error);
+  //! Closes the listeners and every relayed connection; safe to call more than once. Stats() stays readable.
+  void Stop();
+  //! Per-route connection and byte counters; safe to call while the proxy is running.
+  std::vector<LocalProxyRouteStats> Stats() const;
+  //! Closes the listeners and the warm pools, then waits up to `timeout` for the relayed connections to finish.
+  //! True when none is left; the remaining ones are cut by Stop().
+  bool Drain(std::chrono::milliseconds timeout);
+  //! Relayed connections currently open, including those still waiting for their upstream.
+  size_t active_connections() const { return active_connections_.load(); }
+
+  bool running() const { return thread_.joinable(); }
+
+ private:
+  struct Upstream {
+    int port = 0;
+    std::atomic<uint64_t> connections{0};
+    //! Relayed connections currently assigned to it; relay thread only.
+    size_t active = 0;
+    //! Out of rotation until then; relay thread only.
+    std::chrono::steady_clock::time_point ejected_until;
+  };
+
+  struct Listener {
+    int fd = -1;
+    LocalProxyRoute route;
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> bytes_to_upstream{0};
+    std::atomic<uint64_t> bytes_to_client{0};
+    std::atomic<uint64_t> warm_hits{0};
+    std::atomic<uint64_t> ejections{0};
+    //! `route.upstream_port` first, then `route.balanced_upstream_ports`.
+    std::vector<Upstream> upstreams;
+    //! Round-robin cursor into `upstreams`; relay thread only.
+    size_t next_upstream = 0;
+  };
+
+  void Run();
+
+  std::chrono::milliseconds upstream_retry_window_;
+  StreamRelayMode relay_mode_;
+  EventLoopBackend event_backend_;
+  std::vector<std::unique_ptr<Listener>> listeners_;
+  int wake_pipe_[2] = {-1, -1};
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> draining_{false};
+  std::atomic<size_t> active_connections_{0};
+  //! Signalled by the relay thread whenever a draining proxy closed its listeners or a connection finished.
+  std::mutex drain_mutex_;
+  std::condition_variable drain_progress_;
+  bool listeners_closed_ = false;
+  std::thread thread_;
+};
+
+//! Picks a currently free loopback TCP port for a kubectl child to listen on behind the proxy; 0 on failure.
+int ReserveLoopbackPort(std::string& error);
+
+//! Loopback TCP port held for a kubectl child behind the proxy while the reservation lives. On Linux the port stays
+//! bound with SO_REUSEADDR but never listens: neither bind(0) nor an outgoing connection is handed it in the meantime,
+//! while the child, which binds with SO_REUSEADDR like kubectl and the native engine do, can listen on it, also again
+//! after a restart. Elsewhere the port is only picked, as by ReserveLoopbackPort().
+class LoopbackPortReservation {
+ public:
+  //! nullptr with `error` set when no port could be bound.
+  static std::unique_ptr<LoopbackPortReservation> Create(std::string& error);
+  ~LoopbackPortReservation();
+  LoopbackPortReservation(const LoopbackPortReservation&) = delete;
+  LoopbackPortReservation& operator=(const LoopbackPortReservation&) = delete;
+
+  int port() const { return port_; }
+
+ private:
+  LoopbackPortReservation(int fd, int port) : fd_(fd), port_(port) {}
+
+  int fd_;
+  int port_;
+};
+
+}  // namespace kubeforward::runtime
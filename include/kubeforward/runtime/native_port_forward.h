@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace kubeforward::runtime {
+
+//! Plain-HTTP API server endpoint parsed from `apiServer` (e.g. `http://127.0.0.1:8001` served by `kubectl proxy`).
+struct ApiServerEndpoint {
+  std::string host;
+  int port = 80;
+  //! Path prefix prepended to API paths; empty or starting with '/' without a trailing slash.
+  std::string path_prefix;
+};
+
+//! Parses `http://host[:port][/prefix]`. https endpoints are rejected: the native engine carries no TLS stack.
+bool ParseApiServerEndpoint(const std::string& url, ApiServerEndpoint& endpoint, std::string& error);
+
+//! RFC 6455 `Sec-WebSocket-Accept` value for a client `Sec-WebSocket-Key`.
+std::string WebSocketAcceptKey(const std::string& client_key);
+
+//! One local listener and the pod port its connections are tunnelled to.
+struct NativePortForwardPort {
+  int local_port = 0;
+  int remote_port = 0;
+};
+
+//! Everything the native engine needs to serve one pod's ports.
+struct NativePortForwardOptions {
+  std::string api_server;
+  std::string namespace_name;
+  std::string pod;
+  std::string bind_address = "127.0.0.1";
+  std::vector<NativePortForwardPort> ports;
+};
+
+//! In-process replacement for `kubectl port-forward pod/NAME`.
+//!
+//! Every accepted local connection opens its own WebSocket to the pod's `portforward` subresource and speaks the
+//! `v4.channel.k8s.io` framing: channel 0 carries data, channel 1 errors, and each channel starts with the remote port
+//! as a little-endian uint16; that is the only protocol the endpoint negotiates, so a client EOF cannot be forwarded
+//! as a half-close.
+//! All listeners and tunnels share one background thread with non-blocking sockets.
+class NativePortForwarder {
+ public:
+  NativePortForwarder() = default;
+  NativePortForwarder(const NativePortForwarder&) = delete;
+  NativePortForwarder& operator=(const NativePortForwarder&) = delete;
+  ~NativePortForwarder();
+
+  //! Resolves the API server and binds every local port. Nothing is left listening on failure.
+  bool Start(const NativePortForwardOptions& options, std::string& error);
+  //! Closes the listeners and every tunnel; safe to call more than once.
+  void Stop();
+
+  bool running() const { return thread_.joinable(); }
+  //! True once the API server refused an upgrade (pod gone, RBAC, ...); mirrors kubectl's "lost connection to pod".
+  bool lost() const { return lost_; }
+  //! Human-readable reason for lost(); only meaningful after lost() turned true.
+  std::string lost_reason() const;
+
+ private:
+  struct Listener {
+    int fd = -1;
+    NativePortForwardPort port;
+  };
+
+  void Run();
+
+  NativePortForwardOptions options_;
+  ApiServerEndpoint endpoint_;
+  sockaddr_storage api_address_{};
+  socklen_t api_address_length_ = 0;
+  std::vector<Listener> listeners_;
+  int wake_pipe_[2] = {-1, -1};
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> lost_{false};
+  std::string lost_reason_;
+  std::thread thread_;
+};
+
+}  // namespace kubeforward::runtime
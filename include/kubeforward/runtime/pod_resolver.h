@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "kubeforward/config/types.h"
+
+namespace kubeforward::runtime {
+
+//! A deployment, service or statefulset target to be resolved to one of its pods.
+struct PodLookupKey {
+  config::ResourceKind kind = config::ResourceKind::kDeployment;
+  std::string name;
+  std::string namespace_name;
+  std::optional<std::string> context;
+  std::optional<std::string> kubeconfig;
+
+  bool operator<(const PodLookupKey& other) const;
+};
+
+//! A pod a target resolved to.
+struct ResolvedPod {
+  std::string name;
+  //! For services, the port the pod serves each service port on, by service port: `pod/NAME` is forwarded by pod
+  //! port, so a launch pinned to the pod has to use the service's targetPort instead. Named targetPorts are resolved
+  //! per pod through the endpoints. Empty for the other kinds, whose ports already are pod ports.
+  std::map<int, int> target_ports;
+
+  bool operator==(const ResolvedPod& other) const = default;
+};
+
+//! Resolves `key` to a pod; std::nullopt with `error` set when no pod is available.
+using PodLookup = std::function<std::optional<ResolvedPod>(const PodLookupKey& key, std::string& error)>;
+
+//! Pod names resolved per target, reused for `ttl` so restarts can name `pod/NAME` directly instead of making
+//! kubectl resolve the target again. Invalidate() forgets a pin after the pod failed. Not thread-safe.
+class PodResolutionCache {
+ public:
+  PodResolutionCache(std::chrono::milliseconds ttl, PodLookup lookup);
+
+  //! The cached pod for `key`, or a fresh lookup when there is none or it expired.
+  std::optional<ResolvedPod> Resolve(const PodLookupKey& key, std::string& error);
+  void Invalidate(const PodLookupKey& key);
+
+  //! Lookups actually performed (cache misses).
+  size_t lookups() const { return lookups_; }
+
+ private:
+  struct Entry {
+    ResolvedPod pod;
+    std::chrono::steady_clock::time_point resolved_at;
+  };
+
+  std::chrono::milliseconds ttl_;
+  PodLookup lookup_;
+  std::map<PodLookupKey, Entry> entries_;
+  size_t lookups_ = 0;
+};
+
+//! Picks the pod a target resolves to with `kubectl get`:
+//! - services: the first ready endpoint, by name, with the target ports of the service's ports on it;
+//! - deployments and statefulsets: the first running and ready pod, by name, matching the workload's
+//!   `spec.selector` (its matchLabels and matchExpressions).
+//! Choosing by name keeps the pick stable, so forwards to one target land on the same pod. Each kubectl call is
+//! killed after `timeout`.
+std::optional<ResolvedPod> LookupPodWithKubectl(const std::string& kubectl, const PodLookupKey& key,
+                                                std::chrono::milliseconds timeout, std::string& error);
+
+//! Every pod behind the ready endpoints of service `key`, sorted by name and without duplicates, each with the target
+//! ports the service's ports have on it; never empty on success.
+std::optional<std::vector<ResolvedPod>> LookupServicePodsWithKubectl(const std::string& kubectl,
+                                                                    const PodLookupKey& key,
+                                                                    std::chrono::milliseconds timeout,
+                                                                    std::string& error);
+
+//! Parses the flat string map kubectl prints for `{.spec.selector.matchLabels}`, e.g. {"app":"api"}.
+std::optional<std::map<std::string, std::string>> ParseLabelSelectorJson(const std::string& json);
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+namespace kubeforward::runtime {
+
+//! Outcome of an in-process TCP listener lookup.
+enum class TcpListenerProbe {
+  kListening,
+  kNotListening,
+  //! The platform offers no in-process way to inspect listening sockets.
+  kUnavailable,
+};
+
+//! Reports whether any process has a TCP socket listening on `bind_address:port`.
+//!
+//! Wildcard listeners (0.0.0.0 / ::) and IPv4-mapped IPv6 listeners count as matches. The probe never connects to
+//! the port; on Linux it queries sock_diag over netlink and falls back to parsing /proc/net/tcp{,6}.
+TcpListenerProbe ProbeTcpListener(const std::string& bind_address, int port);
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace kubeforward::runtime {
+
+//! Identity of one running process, recorded right after start and compared before signalling it later.
+//!
+//! `start_time` alone defeats pid reuse; the executable inode and command-line hash additionally catch a pid that
+//! was recycled within the same clock tick or a process that exec()ed into something else.
+struct ProcessFingerprint {
+  //! Start time in platform units (clock ticks since boot on Linux, microseconds since the epoch on macOS).
+  std::uint64_t start_time = 0;
+  std::uint64_t exe_inode = 0;
+  //! FNV-1a hash of the NUL-separated argv, stable across builds so it can be persisted.
+  std::uint64_t cmdline_hash = 0;
+
+  bool empty() const { return start_time == 0 && exe_inode == 0 && cmdline_hash == 0; }
+};
+
+enum class FingerprintMatch {
+  kMatch,
+  //! The pid is alive but belongs to a different process than the one recorded.
+  kMismatch,
+  //! The platform cannot read fingerprints or the process is gone.
+  kUnavailable,
+};
+
+//! Reads the fingerprint of a live process straight from the kernel (no subprocess). Nullopt when unsupported.
+std::optional<ProcessFingerprint> ReadProcessFingerprint(int pid);
+
+//! Compares the live process behind `pid` against a previously recorded fingerprint.
+FingerprintMatch CompareProcessFingerprint(int pid, const ProcessFingerprint& expected);
+
+//! Whether `pid` exited but was not reaped by its parent yet. Its fingerprint still matches, yet it holds nothing.
+bool IsZombieProcess(int pid);
+
+//! Reads the argv of a live process from /proc (Linux) or sysctl (macOS). Nullopt when unavailable.
+std::optional<std::vector<std::string>> ReadProcessArgv(int pid);
+
+}  // namespace kubeforward::runtime
@@ -13,11 +13,23 @@ struct StartProcessRequest {
   std::filesystem::path cwd;
   bool daemon = false;
   std::filesystem::path log_path;
+  //! When set, stdout/stderr go to pipes returned in StartedProcess instead of the terminal or log file.
+  bool capture_output = false;
 };
 
 //! Process handle metadata returned after successful process start.
 struct StartedProcess {
   int pid = 0;
+  //! Non-blocking read ends of the captured stdout/stderr pipes (-1 when output is not captured); caller owns them.
+  int stdout_fd = -1;
+  int stderr_fd = -1;
+};
+
+//! Outcome of stopping one process as part of StopAll().
+struct StopProcessResult {
+  int pid = 0;
+  bool stopped = false;
+  std::string error;
 };
 
 //! Runtime process control interface.
@@ -27,13 +39,35 @@ class ProcessRunner {
 
   virtual std::optional<StartedProcess> Start(const StartProcessRequest& request, std::string& error) = 0;
   virtual bool Stop(int pid, std::string& error) = 0;
+  //! Stops several processes; results are returned in `pids` order. The default stops them one at a time.
+  virtual std::vector<StopProcessResult> StopAll(const std::vector<int>& pids);
+};
+
+//! How PosixProcessRunner creates child processes.
+enum class LaunchStrategy {
+  //! posix_spawn() where the platform supports it, fork() otherwise.
+  kAuto,
+  kFork,
+  //! posix_spawn() only; Start() fails when the platform lacks posix_spawn_file_actions_addchdir_np().
+  kSpawn,
 };
 
 //! POSIX-backed runner that launches and terminates real child process groups.
 class PosixProcessRunner final : public ProcessRunner {
  public:
+  explicit PosixProcessRunner(LaunchStrategy strategy = LaunchStrategy::kAuto) : strategy_(strategy) {}
+
+  //! True when the posix_spawn() launch path is compiled in.
+  static bool SupportsSpawn();
+
   std::optional<StartedProcess> Start(const StartProcessRequest& request, std::string& error) override;
   bool Stop(int pid, std::string& error) override;
+  //! Sends SIGTERM to every process group first, then waits on all of them against one shared grace deadline before
+  //! escalating the stragglers to SIGKILL together, so the batch takes one grace period instead of one per pid.
+  std::vector<StopProcessResult> StopAll(const std::vector<int>& pids) override;
+
+ private:
+  LaunchStrategy strategy_;
 };
 
 //! No-op runner used while kubectl invocation is not yet wired.
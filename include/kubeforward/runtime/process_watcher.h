@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace kubeforward::runtime {
+
+//! Event-driven wait on child process exits, readable descriptors and asynchronous wake-ups.
+//!
+//! Linux watches processes through pidfd_open(2) + epoll, macOS through kqueue EVFILT_PROC. Processes that cannot be
+//! watched that way (old kernels, other platforms) fall back to a 100ms re-check so callers never miss an exit.
+class ProcessWatcher {
+ public:
+  ProcessWatcher();
+  ProcessWatcher(const ProcessWatcher&) = delete;
+  ProcessWatcher& operator=(const ProcessWatcher&) = delete;
+  ~ProcessWatcher();
+
+  //! Wakes Wait() when `pid` exits. The process is not reaped; callers still waitpid() it.
+  void WatchProcess(int pid);
+  //! Replaces the set of readable descriptors that wake Wait(); descriptors are not owned. A descriptor closed by its
+  //! owner may be passed again once its number was reused for another file, which is then registered afresh.
+  void SetDescriptors(const std::vector<int>& fds);
+
+  //! Write end of the self-pipe; writing one byte to it (async-signal-safe) makes Wait() return.
+  int wake_fd() const { return wake_pipe_[1]; }
+
+  //! Blocks until a watched process exits, a watched descriptor becomes readable, wake_fd() is written or `timeout`
+  //! elapses (negative waits indefinitely). Returns pids that may have exited since the previous call.
+  std::vector<int> Wait(std::chrono::milliseconds timeout);
+
+ private:
+  //! The open file behind a descriptor number, so a closed and reused number is not mistaken for the old file.
+  struct DescriptorIdentity {
+    dev_t device = 0;
+    ino_t inode = 0;
+
+    bool operator==(const DescriptorIdentity&) const = default;
+  };
+
+  void AddDescriptor(int fd);
+  void RemoveDescriptor(int fd);
+
+  int event_fd_ = -1;
+  int wake_pipe_[2] = {-1, -1};
+  //! pidfd -> pid on Linux; unused on kqueue where the pid is the event identifier.
+  std::map<int, int> pidfds_;
+  //! Processes without an exit notification; reported after every wake-up and re-checked at least every 100ms.
+  std::set<int> polled_pids_;
+  std::map<int, DescriptorIdentity> descriptors_;
+};
+
+}  // namespace kubeforward::runtime
@@ -20,6 +20,8 @@ struct ResolvedForward {
   bool detach = false;
   config::RestartPolicy restart_policy = config::RestartPolicy::kFailFast;
   std::optional<config::HealthCheck> health_check;
+  std::optional<config::WarmPool> warm_pool;
+  std::optional<config::LoadBalance> load_balance;
   std::map<std::string, std::string> env;
   std::map<std::string, std::string> annotations;
 };
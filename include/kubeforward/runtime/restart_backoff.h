@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+namespace kubeforward::runtime {
+
+//! Tuning for RestartBackoff.
+struct RestartBackoffPolicy {
+  std::chrono::milliseconds initial_delay{500};
+  std::chrono::milliseconds max_delay{30000};
+  double multiplier = 2.0;
+  //! Fraction of each delay that is randomized away (0 = fixed delays, 1 = anywhere between 0 and the full delay).
+  double jitter = 0.5;
+  //! A process that stayed up this long is considered healthy again and the next delay starts from scratch.
+  std::chrono::milliseconds stable_after{60000};
+};
+
+//! Jittered exponential backoff for respawning one supervised process.
+//!
+//! The n-th consecutive delay is drawn uniformly from [base * (1 - jitter), base] where
+//! base = min(max_delay, initial_delay * multiplier^n), so forwards that die together (e.g. during one rollout) do
+//! not hammer the API server in lockstep.
+class RestartBackoff {
+ public:
+  explicit RestartBackoff(RestartBackoffPolicy policy = {}, std::uint64_t seed = std::random_device{}());
+
+  //! Returns the delay before the next restart attempt and advances the backoff.
+  std::chrono::milliseconds NextDelay();
+  //! Forgets previous failures, e.g. after the process stayed up for `stable_after`.
+  void Reset() { attempts_ = 0; }
+  //! Resets the backoff when a process that ran for `uptime` counts as stable.
+  void RecordUptime(std::chrono::milliseconds uptime);
+
+  int attempts() const { return attempts_; }
+
+ private:
+  RestartBackoffPolicy policy_;
+  int attempts_ = 0;
+  std::mt19937_64 rng_;
+};
+
+}  // namespace kubeforward::runtime
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "kubeforward/runtime/resolved_plan.h"
 #include "kubeforward/runtime/state_store.h"
@@ -11,4 +12,11 @@ namespace kubeforward::runtime {
 bool CheckRuntimeSessionPortConflicts(const RuntimeState& state, const std::string& normalized_config_path,
                                       const ResolvedEnvironment& target_env, std::string& error);
 
+//! Returns the local sockets `env` listens on, once each.
+std::vector<PortClaimKey> PortClaimKeys(const ResolvedEnvironment& env);
+
+//! Same check against claims already narrowed to the target's sockets, e.g. by LookupPortClaims.
+bool CheckPortClaimConflicts(const std::vector<PortClaim>& claims, const std::string& normalized_config_path,
+                             const ResolvedEnvironment& target_env, std::string& error);
+
 }  // namespace kubeforward::runtime
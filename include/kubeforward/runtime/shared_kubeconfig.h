@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "kubeforward/runtime/command_capture.h"
+
+namespace kubeforward::runtime {
+
+//! Credential printed by a kubeconfig `exec` plugin (the `status` of a client.authentication.k8s.io ExecCredential).
+struct ExecCredential {
+  std::string token;
+  //! PEM client certificate and key, for plugins that hand out certificates instead of tokens.
+  std::string client_certificate_data;
+  std::string client_key_data;
+  //! Unset when the plugin gave no expiry; the credential is then kept for as long as kubeforward runs.
+  std::optional<std::chrono::system_clock::time_point> expires_at;
+};
+
+//! Parses the ExecCredential JSON a plugin prints to stdout; std::nullopt with `error` set when it carries no usable
+//! credential.
+std::optional<ExecCredential> ParseExecCredential(const std::string& json, std::string& error);
+
+//! Runs an exec plugin (`argv`, with `environment` added) and returns its stdout.
+using ExecPluginRunner = std::function<bool(const std::vector<std::string>& argv, const CommandEnvironment& environment,
+                                            std::string& output, std::string& error)>;
+
+//! Kubeconfig files kubectl would read: `explicit_path` when set, otherwise $KUBECONFIG (a ':'-separated list) or
+//! ~/.kube/config.
+std::vector<std::filesystem::path> ResolveKubeconfigFiles(const std::optional<std::string>& explicit_path);
+
+//! A minimal kubeconfig shared by every kubectl of a session, so exec credential plugins (aws-iam-authenticator,
+//! gke-gcloud-auth-plugin, ...) run once per user instead of once per kubectl process.
+//!
+//! The source kubeconfig is parsed once. Update() writes `output_path` with just the clusters, users and contexts of
+//! `contexts` ("" stands for the current context). Users with an `exec` plugin are replaced by the credential the
+//! plugin returned, which is reused until shortly before it expires. Other users are copied as they are. Relative
+//! file references are made absolute, so the file works from anywhere. The file is only readable by its owner.
+class SharedKubeconfig {
+ public:
+  SharedKubeconfig(std::optional<std::string> kubeconfig, std::set<std::string> contexts,
+                   std::filesystem::path output_path, ExecPluginRunner runner);
+  ~SharedKubeconfig();
+  SharedKubeconfig(const SharedKubeconfig&) = delete;
+  SharedKubeconfig& operator=(const SharedKubeconfig&) = delete;
+
+  //! Writes the shared kubeconfig, re-running the plugins whose credentials are about to expire, and returns its
+  //! path. std::nullopt with an empty `error` when there is no kubeconfig or none of the contexts uses an exec plugin,
+  //! so kubectl gains nothing from it; with `error` set when the kubeconfig or a plugin failed.
+  std::optional<std::filesystem::path> Update(std::string& error);
+
+  //! Exec plugin invocations so far.
+  size_t plugin_runs() const { return plugin_runs_; }
+
+ private:
+  struct Source;
+
+  std::optional<std::string> kubeconfig_;
+  std::set<std::string> contexts_;
+  std::filesystem::path output_path_;
+  ExecPluginRunner runner_;
+  std::unique_ptr<Source> source_;
+  //! Credentials by kubeconfig user name.
+  std::map<std::string, ExecCredential> credentials_;
+  size_t plugin_runs_ = 0;
+};
+
+}  // namespace kubeforward::runtime
@@ -1,14 +1,26 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <string>
 #include <vector>
 
 #include "kubeforward/config/types.h"
+#include "kubeforward/runtime/process_identity.h"
 
 namespace kubeforward::runtime {
 
-//! Runtime process metadata for one forwarded local port.
+//! Extra LOCAL:REMOTE pair served by a kubectl process that owns several ports of one forward.
+struct ManagedPortMapping {
+  int local_port = 0;
+  int remote_port = 0;
+  //! Loopback port kubectl listens on when kubeforward's local proxy owns `local_port`; 0 when kubectl binds it.
+  int upstream_port = 0;
+};
+
+//! Runtime process metadata for one kubectl process. `local_port`/`remote_port` hold its first port mapping and
+//! `additional_ports` any further TCP mappings on the same bind address that the process forwards as well.
 struct ManagedForwardProcess {
   std::string environment;
   std::string forward_name;
@@ -20,8 +32,18 @@ struct ManagedForwardProcess {
   int remote_port = 0;
   config::PortProtocol protocol = config::PortProtocol::kTcp;
   int pid = 0;
+  std::vector<ManagedPortMapping> additional_ports;
+  //! Recorded right after start; empty for state written by older versions or when it could not be read.
+  ProcessFingerprint fingerprint;
+  //! Number of times a `restartPolicy: replace` supervisor respawned this process.
+  int restart_count = 0;
+  //! Upstream loopback port of the primary mapping when it is served through the local proxy (see ManagedPortMapping).
+  int upstream_port = 0;
 };
 
+//! Returns every port mapping owned by `process`, primary mapping first.
+std::vector<ManagedPortMapping> ManagedPortMappings(const ManagedForwardProcess& process);
+
 //! Runtime session persisted by `up` and consumed by `down`.
 struct ManagedSession {
   std::string id;
@@ -30,6 +52,12 @@ struct ManagedSession {
   bool daemon = false;
   std::string started_at_utc;
   std::vector<ManagedForwardProcess> forwards;
+  //! Foreground `up` process supervising the forwards and owning their local proxy; 0 for daemon sessions.
+  int supervisor_pid = 0;
+  ProcessFingerprint supervisor_fingerprint;
+  //! Written by `down` or a replacing `up` right before it sends SIGTERM to the supervisor: how long the supervisor
+  //! lets relayed connections finish before it stops the forwards. 0 stops them right away.
+  int drain_timeout_ms = 0;
 };
 
 //! Persisted state file model.
@@ -45,13 +73,72 @@ struct StateLoadResult {
   bool ok() const { return errors.empty(); }
 };
 
-//! Returns the default state file path associated with a config path.
+//! Local socket a forward listens on.
+struct PortClaimKey {
+  std::string bind_address = "127.0.0.1";
+  int local_port = 0;
+  config::PortProtocol protocol = config::PortProtocol::kTcp;
+
+  bool operator==(const PortClaimKey&) const = default;
+};
+
+//! A local socket claimed by a forward of a stored session, with the process holding it.
+struct PortClaim {
+  PortClaimKey key;
+  std::string session_id;
+  std::string config_path;
+  std::string environment;
+  std::string forward_name;
+  int pid = 0;
+  ProcessFingerprint fingerprint;
+};
+
+//! Claim lookup result.
+struct PortClaimLookup {
+  std::vector<PortClaim> claims;
+  std::vector<std::string> errors;
+
+  bool ok() const { return errors.empty(); }
+};
+
+//! Stable 64-bit hash of `key`, used by the on-disk claim indexes.
+std::uint64_t PortClaimHash(const PortClaimKey& key);
+
+//! Returns the claims of `state` on any of `keys`, in session order.
+std::vector<PortClaim> PortClaimsOf(const RuntimeState& state, const std::vector<PortClaimKey>& keys);
+
+//! Returns the default state file path associated with a config path. A state file still named `state-<hash>.yaml`
+//! by older versions is moved to the current name first.
 std::filesystem::path DefaultStatePathForConfig(const std::string& config_path);
 
+//! Selects sessions by id, config path and environment; empty fields match every session.
+struct SessionQuery {
+  std::string id;
+  std::string config_path;
+  std::string environment;
+};
+
 //! Reads runtime state from disk. Missing file is treated as empty state.
 StateLoadResult LoadState(const std::filesystem::path& path);
 
-//! Writes runtime state to disk atomically (parent directory created when missing).
+//! Reads only the sessions matching `query`. The state file indexes its sessions, so the others are not decoded.
+StateLoadResult LoadSessions(const std::filesystem::path& path, const SessionQuery& query);
+
+//! Same as LoadSessions without waiting on the state lock: the read is repeated when a writer published in the
+//! meantime. When that keeps happening for half a millisecond, or the state has no sequence file yet (it is created by
+//! the first write of this version), the lock is taken only if it is free; otherwise an error says to try again.
+StateLoadResult LoadSessionsWithoutLock(const std::filesystem::path& path, const SessionQuery& query);
+
+//! Reads the claims on any of `keys` from the port-claim index the state file keeps next to its sessions, decoding
+//! only the sessions holding one of them. Missing file is treated as empty state.
+PortClaimLookup LookupPortClaims(const std::filesystem::path& path, const std::vector<PortClaimKey>& keys);
+
+//! Writes runtime state to disk atomically (parent directory created when missing), in the binary state format.
 bool SaveState(const std::filesystem::path& path, const RuntimeState& state, std::string& error);
 
+//! Loads, mutates and writes runtime state under one exclusive lock, so concurrent writers cannot drop each other's
+//! sessions. Fails without writing when the current state cannot be parsed.
+bool UpdateState(const std::filesystem::path& path, const std::function<void(RuntimeState&)>& mutate,
+                 std::string& error);
+
 }  // namespace kubeforward::runtime
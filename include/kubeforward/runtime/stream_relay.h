@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace kubeforward::runtime {
+
+//! Free list of fixed-size relay buffers for the read/write fallback. Connections borrow a buffer only while they
+//! hold unsent bytes, so idle connections cost no buffer memory. Not thread-safe: one pool per relay thread.
+class RelayBufferPool {
+ public:
+  static constexpr size_t kBufferSize = 64 * 1024;
+
+  explicit RelayBufferPool(size_t max_idle_buffers = 64) : max_idle_buffers_(max_idle_buffers) {}
+
+  std::unique_ptr<char[]> Acquire();
+  //! Keeps the buffer for reuse unless `max_idle_buffers` are already idle.
+  void Release(std::unique_ptr<char[]> buffer);
+
+  size_t idle() const { return idle_.size(); }
+
+ private:
+  size_t max_idle_buffers_;
+  std::vector<std::unique_ptr<char[]>> idle_;
+};
+
+//! How a StreamRelay moves bytes.
+enum class StreamRelayMode {
+  //! splice() through a pipe pair where the platform supports it, otherwise the pooled read/write path.
+  kAuto,
+  //! Always the pooled read/write path.
+  kCopy,
+};
+
+//! Non-blocking pump for one direction of a relayed TCP connection (`from` -> `to`).
+//!
+//! On Linux the bytes travel socket -> pipe -> socket with splice(), so they never enter user space; the pipe's fill
+//! level is the backpressure window. Where splice() is unavailable or refused for the descriptors (EINVAL), the
+//! relay falls back to a pooled buffer. When the source reaches EOF and everything is delivered, the destination's
+//! write side is shut down so half-closed connections keep working in the other direction.
+class StreamRelay {
+ public:
+  enum class Result {
+    kOk,
+    kFailed,
+  };
+
+  StreamRelay(RelayBufferPool& pool, StreamRelayMode mode = StreamRelayMode::kAuto);
+  StreamRelay(const StreamRelay&) = delete;
+  StreamRelay& operator=(const StreamRelay&) = delete;
+  ~StreamRelay();
+
+  //! Moves as many bytes as both sockets accept right now without blocking.
+  Result Pump(int from, int to);
+
+  //! The source should be polled for POLLIN: it is not at EOF and there is room to take more bytes.
+  bool wants_read() const;
+  //! Bytes are waiting for the destination (poll it for POLLOUT).
+  bool pending() const;
+  //! The destination's write side was shut down after the source's EOF was delivered.
+  bool shut() const { return shut_; }
+  //! Marks the direction finished without touching the sockets, e.g. after the peer direction failed.
+  void Abort() { shut_ = true; }
+
+  //! Total bytes delivered to the destination.
+  uint64_t bytes_moved() const { return bytes_moved_; }
+  //! Whether this direction is currently using splice().
+  bool spliced() const { return pipe_[0] >= 0; }
+
+  //! Whether splice() relaying is compiled in for this platform.
+  static bool SupportsSplice();
+
+ private:
+  Result PumpSplice(int from, int to);
+  Result PumpCopy(int from, int to);
+  void ClosePipe();
+
+  RelayBufferPool& pool_;
+  int pipe_[2] = {-1, -1};
+  size_t pipe_capacity_ = 0;
+  size_t in_pipe_ = 0;
+  std::unique_ptr<char[]> buffer_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  bool eof_ = false;
+  bool shut_ = false;
+  uint64_t bytes_moved_ = 0;
+};
+
+}  // namespace kubeforward::runtime
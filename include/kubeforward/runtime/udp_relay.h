@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kubeforward/runtime/event_loop.h"
+#include "kubeforward/runtime/local_proxy.h"
+
+namespace kubeforward::runtime {
+
+//! Appends `payload` to `stream` as one frame: a 2-byte big-endian length followed by the datagram (the DNS over TCP
+//! framing of RFC 1035 section 4.2.2). Returns false for payloads longer than 65535 bytes.
+bool AppendDatagramFrame(std::string& stream, const char* data, size_t size);
+//! Removes every complete frame from the front of `stream` and appends its payload to `datagrams`.
+void ExtractDatagramFrames(std::string& stream, std::vector<std::string>& datagrams);
+
+//! Forwards UDP over the TCP-only port-forward tunnel.
+//!
+//! kubeforward binds the local UDP port and opens one tunnel connection (127.0.0.1:<upstream_port>, where kubectl
+//! listens) per client address. Each datagram travels as a length-prefixed frame, and frames coming back are sent to
+//! the client as datagrams, so the pod-side port must speak that framing: DNS servers do natively, other services
+//! need a decapsulating sidecar. Flows idle for `flow_idle_timeout` are closed. Datagrams are read and written in
+//! batches with recvmmsg/sendmmsg on Linux. As with UDP itself, datagrams that arrive while the tunnel is down or
+//! backed up are dropped.
+class UdpForwardRelay {
+ public:
+  explicit UdpForwardRelay(std::chrono::milliseconds flow_idle_timeout = std::chrono::milliseconds(60000),
+                           EventLoopBackend event_backend = PlatformEventLoopBackend());
+  UdpForwardRelay(const UdpForwardRelay&) = delete;
+  UdpForwardRelay& operator=(const UdpForwardRelay&) = delete;
+  ~UdpForwardRelay();
+
+  //! Binds every route's UDP port and starts relaying. Nothing is left bound when any route fails.
+  bool Start(const std::vector<LocalProxyRoute>& routes, std::string& error);
+  //! Closes the sockets and every flow; safe to call more than once. Stats() stays readable.
+  void Stop();
+  //! Per-route counters; `connections` counts client flows and the byte counters count datagram payloads.
+  std::vector<LocalProxyRouteStats> Stats() const;
+
+  bool running() const { return thread_.joinable(); }
+
+ private:
+  struct Socket {
+    int fd = -1;
+    LocalProxyRoute route;
+    std::atomic<uint64_t> flows{0};
+    std::atomic<uint64_t> bytes_to_upstream{0};
+    std::atomic<uint64_t> bytes_to_client{0};
+  };
+
+  void Run();
+
+  std::chrono::milliseconds flow_idle_timeout_;
+  EventLoopBackend event_backend_;
+  std::vector<std::unique_ptr<Socket>> sockets_;
+  int wake_pipe_[2] = {-1, -1};
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+}  // namespace kubeforward::runtime
@@ -18,6 +18,8 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -27,14 +29,28 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
-#include <thread>
 #include <unistd.h>
 
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+
 #include "kubeforward/config/loader.h"
+#include "kubeforward/runtime/claim_registry.h"
+#include "kubeforward/runtime/kubectl_output.h"
+#include "kubeforward/runtime/local_proxy.h"
+#include "kubeforward/runtime/native_port_forward.h"
+#include "kubeforward/runtime/pod_resolver.h"
+#include "kubeforward/runtime/port_probe.h"
+#include "kubeforward/runtime/process_identity.h"
 #include "kubeforward/runtime/process_runner.h"
+#include "kubeforward/runtime/process_watcher.h"
 #include "kubeforward/runtime/resolved_plan.h"
+#include "kubeforward/runtime/restart_backoff.h"
 #include "kubeforward/runtime/session_conflicts.h"
+#include "kubeforward/runtime/shared_kubeconfig.h"
 #include "kubeforward/runtime/state_store.h"
+#include "kubeforward/runtime/udp_relay.h"
 
 namespace {
 
@@ -62,8 +78,17 @@ std::vector<std::string> BuildSubcommandArgs(const std::vector<std::string>& arg
 const char* AppVersion() { return KF_APP_VERSION; }
 
 volatile sig_atomic_t g_foreground_signal = 0;
+//! Self-pipe of the foreground ProcessWatcher, so a signal interrupts its wait immediately (-1 when unset).
+volatile sig_atomic_t g_foreground_wake_fd = -1;
 
-void HandleForegroundSignal(int signal_number) { g_foreground_signal = signal_number; }
+void HandleForegroundSignal(int signal_number) {
+  g_foreground_signal = signal_number;
+  const int wake_fd = g_foreground_wake_fd;
+  if (wake_fd >= 0) {
+    const char byte = 0;
+    (void)::write(wake_fd, &byte, 1);
+  }
+}
 
 std::string DescribeWaitStatus(int status);
 
@@ -78,6 +103,7 @@ void PrintGeneralHelp() {
             << "  plan    Render the normalized port-forward plan.\n"
             << "  up      Start port-forwards for one environment.\n"
             << "  down    Stop port-forwards for one or all environments.\n"
+            << "  status  Show the port-forwards running for one or all environments.\n"
             << "  help    Show this message.\n"
             << "\n"
             << "Global options:\n"
@@ -88,6 +114,13 @@ std::string OptionalValueOr(const std::optional<std::string>& value, const std::
   return value.has_value() ? *value : fallback;
 }
 
+std::string PortForwardEngineToString(const std::optional<kubeforward::config::PortForwardEngine>& engine) {
+  if (!engine.has_value()) {
+    return "<unset>";
+  }
+  return *engine == kubeforward::config::PortForwardEngine::kNative ? "native" : "kubectl";
+}
+
 const char* ResourceKindToString(kubeforward::config::ResourceKind kind) {
   switch (kind) {
     case kubeforward::config::ResourceKind::kPod:
@@ -122,6 +155,16 @@ const char* RestartPolicyToString(kubeforward::config::RestartPolicy policy) {
   return "unknown";
 }
 
+const char* LoadBalanceStrategyToString(kubeforward::config::LoadBalanceStrategy strategy) {
+  switch (strategy) {
+    case kubeforward::config::LoadBalanceStrategy::kRoundRobin:
+      return "roundRobin";
+    case kubeforward::config::LoadBalanceStrategy::kLeastConnections:
+      return "leastConnections";
+  }
+  return "unknown";
+}
+
 void PrintStringMap(const std::map<std::string, std::string>& values, const std::string& indent) {
   if (values.empty()) {
     std::cout << indent << "<none>\n";
@@ -168,6 +211,8 @@ void PrintVerboseHeader(const kubeforward::config::Config& config, const std::st
   std::cout << "  context: " << OptionalValueOr(config.defaults.context) << "\n";
   std::cout << "  namespace: " << OptionalValueOr(config.defaults.namespace_name) << "\n";
   std::cout << "  bindAddress: " << OptionalValueOr(config.defaults.bind_address) << "\n";
+  std::cout << "  portForwardEngine: " << PortForwardEngineToString(config.defaults.port_forward_engine) << "\n";
+  std::cout << "  apiServer: " << OptionalValueOr(config.defaults.api_server) << "\n";
   std::cout << "  labels:\n";
   PrintStringMap(config.defaults.labels, "    ");
   std::cout << "\n";
@@ -182,6 +227,8 @@ void PrintPlanVerbose(const std::string& name, const kubeforward::config::Enviro
   std::cout << "    context: " << OptionalValueOr(env.settings.context) << "\n";
   std::cout << "    namespace: " << OptionalValueOr(env.settings.namespace_name) << "\n";
   std::cout << "    bindAddress: " << OptionalValueOr(env.settings.bind_address) << "\n";
+  std::cout << "    portForwardEngine: " << PortForwardEngineToString(env.settings.port_forward_engine) << "\n";
+  std::cout << "    apiServer: " << OptionalValueOr(env.settings.api_server) << "\n";
   std::cout << "    labels:\n";
   PrintStringMap(env.settings.labels, "      ");
   std::cout << "  guards:\n";
@@ -201,6 +248,14 @@ void PrintPlanVerbose(const std::string& name, const kubeforward::config::Enviro
     std::cout << "      annotations:\n";
     std::cout << "        detach: " << (forward.detach ? "true" : "false") << "\n";
     std::cout << "        restartPolicy: " << RestartPolicyToString(forward.restart_policy) << "\n";
+    if (forward.warm_pool.has_value()) {
+      std::cout << "        warmPool: size " << forward.warm_pool->size << ", refill "
+                << forward.warm_pool->refill_per_second << "/s\n";
+    }
+    if (forward.load_balance.has_value()) {
+      std::cout << "        loadBalance: " << forward.load_balance->replicas << " replicas, "
+                << LoadBalanceStrategyToString(forward.load_balance->strategy) << "\n";
+    }
     std::cout << "        passthrough:\n";
     PrintStringMap(forward.annotations, "          ");
     std::cout << "      healthCheck:\n";
@@ -246,6 +301,8 @@ void PrintPlanVerbose(const kubeforward::config::EnvironmentDefinition& source_e
   std::cout << "    context: " << OptionalValueOr(env.settings.context) << "\n";
   std::cout << "    namespace: " << OptionalValueOr(env.settings.namespace_name) << "\n";
   std::cout << "    bindAddress: " << OptionalValueOr(env.settings.bind_address) << "\n";
+  std::cout << "    portForwardEngine: " << PortForwardEngineToString(env.settings.port_forward_engine) << "\n";
+  std::cout << "    apiServer: " << OptionalValueOr(env.settings.api_server) << "\n";
   std::cout << "    labels:\n";
   PrintStringMap(env.settings.labels, "      ");
   std::cout << "  guards:\n";
@@ -265,6 +322,14 @@ void PrintPlanVerbose(const kubeforward::config::EnvironmentDefinition& source_e
     std::cout << "      annotations:\n";
     std::cout << "        detach: " << (forward.detach ? "true" : "false") << "\n";
     std::cout << "        restartPolicy: " << RestartPolicyToString(forward.restart_policy) << "\n";
+    if (forward.warm_pool.has_value()) {
+      std::cout << "        warmPool: size " << forward.warm_pool->size << ", refill "
+                << forward.warm_pool->refill_per_second << "/s\n";
+    }
+    if (forward.load_balance.has_value()) {
+      std::cout << "        loadBalance: " << forward.load_balance->replicas << " replicas, "
+                << LoadBalanceStrategyToString(forward.load_balance->strategy) << "\n";
+    }
     std::cout << "        passthrough:\n";
     PrintStringMap(forward.annotations, "          ");
     std::cout << "      healthCheck:\n";
@@ -333,6 +398,32 @@ const char* KubectlBinary() {
   return "kubectl";
 }
 
+//! Absolute path of the running kubeforward binary; native-engine forwards re-execute it as their tunnel process.
+std::string SelfExecutablePath() {
+#if defined(__linux__)
+  std::error_code ec;
+  const auto path = std::filesystem::read_symlink("/proc/self/exe", ec);
+  if (!ec) {
+    return path.string();
+  }
+#elif defined(__APPLE__)
+  uint32_t size = 0;
+  (void)_NSGetExecutablePath(nullptr, &size);
+  std::string path(size, '\0');
+  if (_NSGetExecutablePath(path.data(), &size) == 0) {
+    path.resize(std::strlen(path.c_str()));
+    std::error_code ec;
+    const auto canonical = std::filesystem::weakly_canonical(path, ec);
+    return ec ? path : canonical.string();
+  }
+#endif
+  return "kubeforward";
+}
+
+bool UsesNativeEngine(const kubeforward::runtime::ResolvedEnvironment& env) {
+  return env.settings.port_forward_engine == kubeforward::config::PortForwardEngine::kNative;
+}
+
 bool UseNoopRunner() {
   if (const char* value = std::getenv("KUBEFORWARD_USE_NOOP_RUNNER")) {
     return std::string(value) == "1";
@@ -340,6 +431,31 @@ bool UseNoopRunner() {
   return false;
 }
 
+//! How forward ports are packed into port-forward processes, each of which holds one upgraded API connection.
+enum class LaunchMode {
+  //! One process per port mapping.
+  kPort,
+  //! One process per forward and bind address.
+  kForward,
+  //! One process per target pod: forwards naming the same resource, namespace, context and restart policy share it.
+  kPod,
+};
+
+//! `KUBEFORWARD_LAUNCH_MODE=port|forward` narrows process sharing; the default packs every TCP port aimed at the
+//! same target into one process so the API server sees one connection per pod.
+LaunchMode LaunchModeFromEnvironment() {
+  if (const char* value = std::getenv("KUBEFORWARD_LAUNCH_MODE")) {
+    const std::string mode(value);
+    if (mode == "port") {
+      return LaunchMode::kPort;
+    }
+    if (mode == "forward") {
+      return LaunchMode::kForward;
+    }
+  }
+  return LaunchMode::kPod;
+}
+
 bool SkipReadinessCheck() {
   if (const char* value = std::getenv("KUBEFORWARD_SKIP_READINESS_CHECK")) {
     return std::string(value) == "1";
@@ -347,6 +463,38 @@ bool SkipReadinessCheck() {
   return false;
 }
 
+//! Whether a foreground forward's local ports are owned by kubeforward's proxy instead of kubectl.
+//! `KUBEFORWARD_LOCAL_PROXY=all` proxies every foreground forward, `off` none; by default only
+//! `restartPolicy: replace` forwards are proxied, since they are the ones whose kubectl gets restarted, plus forwards
+//! with a warm pool, which only the proxy can keep. Load-balanced forwards are always proxied: several kubectl
+//! processes serve their local ports.
+bool UsesLocalProxy(const kubeforward::runtime::ResolvedForward& forward, bool daemon) {
+  if (daemon || UseNoopRunner()) {
+    return false;
+  }
+  if (forward.load_balance.has_value()) {
+    return true;
+  }
+  const char* value = std::getenv("KUBEFORWARD_LOCAL_PROXY");
+  const std::string mode = value != nullptr ? value : "";
+  if (mode == "off") {
+    return false;
+  }
+  return mode == "all" || forward.restart_policy == kubeforward::config::RestartPolicy::kReplace ||
+         forward.warm_pool.has_value();
+}
+
+//! `KUBEFORWARD_EVENT_BACKEND=poll|epoll|io_uring` picks the local proxy's readiness backend; unknown values and
+//! backends the kernel refuses fall back to the platform default.
+kubeforward::runtime::EventLoopBackend EventBackendFromEnvironment() {
+  if (const char* value = std::getenv("KUBEFORWARD_EVENT_BACKEND")) {
+    if (const auto backend = kubeforward::runtime::ParseEventLoopBackend(value)) {
+      return *backend;
+    }
+  }
+  return kubeforward::runtime::PlatformEventLoopBackend();
+}
+
 std::unique_ptr<kubeforward::runtime::ProcessRunner> MakeProcessRunner() {
   if (UseNoopRunner()) {
     return std::make_unique<kubeforward::runtime::NoopProcessRunner>();
@@ -392,8 +540,8 @@ std::optional<std::filesystem::path> ResolveExecutablePath(const std::string& ex
   return std::nullopt;
 }
 
-bool ValidateKubectlExecutable(std::string& error) {
-  if (ResolveExecutablePath(KubectlBinary()).has_value()) {
+bool ValidateKubectlExecutable(const kubeforward::runtime::ResolvedEnvironment& env, std::string& error) {
+  if (UsesNativeEngine(env) || ResolveExecutablePath(KubectlBinary()).has_value()) {
     error.clear();
     return true;
   }
@@ -469,6 +617,89 @@ int StartupTimeoutMs() {
   return static_cast<int>(parsed);
 }
 
+//! Maximum number of forwards that may be starting (launched but not yet ready) at once; 0 means unlimited.
+size_t StartupParallelism() {
+  constexpr long kMaximumStartupParallelism = 4096;
+
+  const char* value = std::getenv("KUBEFORWARD_STARTUP_PARALLELISM");
+  if (value == nullptr || value[0] == '\0') {
+    return 0;
+  }
+
+  char* end = nullptr;
+  errno = 0;
+  const long parsed = std::strtol(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || parsed < 0 || parsed > kMaximumStartupParallelism) {
+    return 0;
+  }
+
+  return static_cast<size_t>(parsed);
+}
+
+//! Backoff used when respawning `restartPolicy: replace` forwards; KUBEFORWARD_RESTART_BACKOFF_MS overrides the first
+//! delay (default 500ms), later delays double up to 30s with jitter.
+kubeforward::runtime::RestartBackoffPolicy RestartBackoffPolicyFromEnvironment() {
+  constexpr long kMinimumInitialDelayMs = 10;
+  constexpr long kMaximumInitialDelayMs = 60000;
+
+  kubeforward::runtime::RestartBackoffPolicy policy;
+  const char* value = std::getenv("KUBEFORWARD_RESTART_BACKOFF_MS");
+  if (value == nullptr || value[0] == '\0') {
+    return policy;
+  }
+
+  char* end = nullptr;
+  errno = 0;
+  const long parsed = std::strtol(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || parsed < kMinimumInitialDelayMs || parsed > kMaximumInitialDelayMs) {
+    return policy;
+  }
+
+  policy.initial_delay = std::chrono::milliseconds(parsed);
+  return policy;
+}
+
+//! How long a deployment, service or statefulset target stays pinned to the pod it resolved to;
+//! KUBEFORWARD_POD_CACHE_TTL_MS overrides the default of five minutes and 0 turns pinning off.
+std::chrono::milliseconds PodCacheTtlFromEnvironment() {
+  constexpr long kDefaultTtlMs = 300000;
+  constexpr long kMaximumTtlMs = 86400000;
+
+  const char* value = std::getenv("KUBEFORWARD_POD_CACHE_TTL_MS");
+  if (value == nullptr || value[0] == '\0') {
+    return std::chrono::milliseconds(kDefaultTtlMs);
+  }
+
+  char* end = nullptr;
+  errno = 0;
+  const long parsed = std::strtol(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || parsed < 0 || parsed > kMaximumTtlMs) {
+    return std::chrono::milliseconds(kDefaultTtlMs);
+  }
+
+  return std::chrono::milliseconds(parsed);
+}
+
+//! How long `down` and a replacing `up` let the connections relayed by a foreground session's local proxy finish
+//! before its forwards are stopped; KUBEFORWARD_DRAIN_TIMEOUT_MS sets it and the default 0 stops them right away.
+std::chrono::milliseconds DrainTimeoutFromEnvironment() {
+  constexpr long kMaximumDrainTimeoutMs = 3600000;
+
+  const char* value = std::getenv("KUBEFORWARD_DRAIN_TIMEOUT_MS");
+  if (value == nullptr || value[0] == '\0') {
+    return std::chrono::milliseconds(0);
+  }
+
+  char* end = nullptr;
+  errno = 0;
+  const long parsed = std::strtol(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || parsed < 0 || parsed > kMaximumDrainTimeoutMs) {
+    return std::chrono::milliseconds(0);
+  }
+
+  return std::chrono::milliseconds(parsed);
+}
+
 std::string ShellQuote(const std::string& value) {
   std::string quoted = "'";
   for (char ch : value) {
@@ -499,6 +730,16 @@ bool CommandProducesOutput(const std::string& command) {
 }
 
 TcpPortReadinessProbe ProbeTcpPortListeningForReadiness(const std::string& bind_address, int port) {
+  switch (kubeforward::runtime::ProbeTcpListener(bind_address, port)) {
+    case kubeforward::runtime::TcpListenerProbe::kListening:
+      return TcpPortReadinessProbe::kReady;
+    case kubeforward::runtime::TcpListenerProbe::kNotListening:
+      return TcpPortReadinessProbe::kNotReady;
+    case kubeforward::runtime::TcpListenerProbe::kUnavailable:
+      break;
+  }
+
+  // Platforms without an in-process socket table fall back to lsof/ss.
   if (const auto lsof_path = ResolveExecutablePath("lsof")) {
     std::ostringstream command;
     command << ShellQuote(lsof_path->string()) << " -nP -iTCP@" << ShellQuote(bind_address) << ":" << port
@@ -532,34 +773,82 @@ std::optional<int> PollProcessExitStatus(int pid) {
   return std::nullopt;
 }
 
-bool WaitForForwardReady(const kubeforward::runtime::ManagedForwardProcess& process, std::string& error) {
-  const int timeout_ms = StartupTimeoutMs();
-  const int poll_interval_ms = 100;
-  int waited_ms = 0;
+//! Port kubectl itself listens on for `mapping`: the proxy's upstream port when proxied, the local port otherwise.
+int KubectlListenPort(const kubeforward::runtime::ManagedPortMapping& mapping) {
+  return mapping.upstream_port != 0 ? mapping.upstream_port : mapping.local_port;
+}
 
-  while (waited_ms <= timeout_ms) {
-    const auto exit_status = PollProcessExitStatus(process.pid);
-    if (exit_status.has_value()) {
-      error = "forward '" + process.forward_name + "' exited before becoming ready with " +
-              DescribeWaitStatus(*exit_status);
-      return false;
-    }
+std::string KubectlListenAddress(const kubeforward::runtime::ManagedForwardProcess& process) {
+  return process.upstream_port != 0 ? "127.0.0.1" : process.bind_address;
+}
 
-    const auto readiness = ProbeTcpPortListeningForReadiness(process.bind_address, process.local_port);
-    if (readiness == TcpPortReadinessProbe::kReady) {
-      error.clear();
-      return true;
-    }
+enum class ForwardReadiness {
+  kPending,
+  kReady,
+  kFailed,
+};
+
+//! Readiness bookkeeping for one started forward whose local ports are not all bound yet.
+struct PendingForwardReadiness {
+  size_t forward_index = 0;
+  std::vector<int> waiting_ports;
+  std::chrono::steady_clock::time_point deadline;
+};
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval_ms));
-    waited_ms += poll_interval_ms;
+//! Runs one non-blocking readiness check, dropping ports that are now bound from `pending.waiting_ports`; `error` is
+//! set only when the forward failed.
+ForwardReadiness PollForwardReadiness(const kubeforward::runtime::ManagedForwardProcess& process,
+                                      PendingForwardReadiness& pending, std::string& error) {
+  const auto exit_status = PollProcessExitStatus(process.pid);
+  if (exit_status.has_value()) {
+    error = "forward '" + process.forward_name + "' exited before becoming ready with " +
+            DescribeWaitStatus(*exit_status);
+    return ForwardReadiness::kFailed;
+  }
+
+  auto& waiting = pending.waiting_ports;
+  waiting.erase(std::remove_if(waiting.begin(), waiting.end(),
+                               [&](int port) {
+                                 return ProbeTcpPortListeningForReadiness(KubectlListenAddress(process), port) ==
+                                        TcpPortReadinessProbe::kReady;
+                               }),
+                waiting.end());
+  if (waiting.empty()) {
+    error.clear();
+    return ForwardReadiness::kReady;
   }
 
-  std::ostringstream oss;
-  oss << "forward '" << process.forward_name << "' did not open "
-      << process.bind_address << ":" << process.local_port << " within " << timeout_ms << "ms";
-  error = oss.str();
-  return false;
+  if (std::chrono::steady_clock::now() >= pending.deadline) {
+    std::ostringstream oss;
+    oss << "forward '" << process.forward_name << "' did not open "
+        << KubectlListenAddress(process) << ":" << waiting.front() << " within " << StartupTimeoutMs() << "ms";
+    error = oss.str();
+    return ForwardReadiness::kFailed;
+  }
+
+  error.clear();
+  return ForwardReadiness::kPending;
+}
+
+//! Applies one kubectl output line to a started forward: "Forwarding from" for one of its local ports means that
+//! listener is bound, while lost-connection and error lines fail it without waiting for the process to exit.
+ForwardReadiness ApplyForwardOutputEvent(const kubeforward::runtime::ManagedForwardProcess& process,
+                                         PendingForwardReadiness& pending,
+                                         const kubeforward::runtime::KubectlOutputEvent& event, std::string& error) {
+  switch (event.kind) {
+    case kubeforward::runtime::KubectlOutputEventKind::kForwarding: {
+      auto& waiting = pending.waiting_ports;
+      waiting.erase(std::remove(waiting.begin(), waiting.end(), event.local_port), waiting.end());
+      error.clear();
+      return waiting.empty() ? ForwardReadiness::kReady : ForwardReadiness::kPending;
+    }
+    case kubeforward::runtime::KubectlOutputEventKind::kConnectionLost:
+    case kubeforward::runtime::KubectlOutputEventKind::kError:
+      error = "forward '" + process.forward_name + "' failed: " + event.line;
+      return ForwardReadiness::kFailed;
+  }
+  error.clear();
+  return ForwardReadiness::kPending;
 }
 
 std::string SanitizeLogToken(const std::string& token) {
@@ -590,13 +879,40 @@ std::filesystem::path BuildForwardLogPath(const std::string& normalized_config_p
   return logs_dir / filename.str();
 }
 
+//! Where the kubeconfig shared by the kubectl processes of a session is written. It holds credentials, so it lives in a
+//! directory private to the current user.
+std::filesystem::path SharedKubeconfigPathForSession(const std::string& normalized_config_path,
+                                                     const std::string& env_name) {
+  const size_t hash = std::hash<std::string>{}(normalized_config_path);
+  const auto credentials_dir =
+      std::filesystem::temp_directory_path() / "kubeforward" / ("credentials-" + std::to_string(::getuid()));
+  return credentials_dir / (std::to_string(hash) + "-" + SanitizeLogToken(env_name) + ".kubeconfig");
+}
+
+//! Whether kubectl gets a shared kubeconfig with the credentials of exec plugins already filled in;
+//! `KUBEFORWARD_SHARED_CREDENTIALS=off` lets every kubectl run the plugins itself.
+bool UsesSharedCredentials(const kubeforward::runtime::ResolvedEnvironment& env) {
+  if (UseNoopRunner() || UsesNativeEngine(env)) {
+    return false;
+  }
+  const char* value = std::getenv("KUBEFORWARD_SHARED_CREDENTIALS");
+  return value == nullptr || std::string(value) != "off";
+}
+
+//! How long an exec credential plugin may take; cloud plugins may have to refresh an SSO session first.
+constexpr std::chrono::milliseconds kExecPluginTimeout(30000);
+
+//! Builds one `kubectl port-forward` invocation (or the native engine's equivalent) serving `ports`, which must all
+//! share the first port's bind address.
 bool BuildKubectlPortForwardArgv(const kubeforward::runtime::ResolvedEnvironment& env,
                                  const kubeforward::runtime::ResolvedForward& forward,
-                                 const kubeforward::config::PortMapping& port, std::vector<std::string>& argv,
-                                 std::string& error) {
-  if (port.protocol != kubeforward::config::PortProtocol::kTcp) {
-    error = "unsupported protocol for kubectl port-forward (only tcp is supported)";
-    return false;
+                                 const std::vector<kubeforward::config::PortMapping>& ports,
+                                 std::vector<std::string>& argv, std::string& error) {
+  for (const auto& port : ports) {
+    if (port.protocol != kubeforward::config::PortProtocol::kTcp) {
+      error = "unsupported protocol for kubectl port-forward (only tcp is supported)";
+      return false;
+    }
   }
 
   if (!forward.resource.name.has_value() || forward.resource.name->empty()) {
@@ -605,7 +921,29 @@ bool BuildKubectlPortForwardArgv(const kubeforward::runtime::ResolvedEnvironment
   }
 
   const std::string target = ResourceKindTargetPrefix(forward.resource.kind) + "/" + *forward.resource.name;
-  argv = {KubectlBinary(), "port-forward", target, std::to_string(port.local_port) + ":" + std::to_string(port.remote_port)};
+  if (UsesNativeEngine(env)) {
+    // Same shape as kubectl's argv so readiness, identity checks and restarts treat both engines alike.
+    argv = {SelfExecutablePath(), "native-port-forward", target};
+    for (const auto& port : ports) {
+      argv.push_back(std::to_string(port.local_port) + ":" + std::to_string(port.remote_port));
+    }
+    argv.push_back("--namespace");
+    argv.push_back(forward.namespace_name);
+    argv.push_back("--api-server");
+    argv.push_back(env.settings.api_server.value_or(""));
+    const auto& bind_address = ports.front().bind_address;
+    if (bind_address.has_value() && !bind_address->empty()) {
+      argv.push_back("--address");
+      argv.push_back(*bind_address);
+    }
+    error.clear();
+    return true;
+  }
+
+  argv = {KubectlBinary(), "port-forward", target};
+  for (const auto& port : ports) {
+    argv.push_back(std::to_string(port.local_port) + ":" + std::to_string(port.remote_port));
+  }
   argv.push_back("--namespace");
   argv.push_back(forward.namespace_name);
   if (forward.context.has_value() && !forward.context->empty()) {
@@ -616,9 +954,10 @@ bool BuildKubectlPortForwardArgv(const kubeforward::runtime::ResolvedEnvironment
     argv.push_back("--kubeconfig");
     argv.push_back(*env.settings.kubeconfig);
   }
-  if (port.bind_address.has_value() && !port.bind_address->empty()) {
+  const auto& bind_address = ports.front().bind_address;
+  if (bind_address.has_value() && !bind_address->empty()) {
     argv.push_back("--address");
-    argv.push_back(*port.bind_address);
+    argv.push_back(*bind_address);
   }
   error.clear();
   return true;
@@ -756,12 +1095,160 @@ std::vector<const kubeforward::runtime::ManagedSession*> MatchingSessions(
   return matches;
 }
 
+//! Removes the shared kubeconfig of a session that is gone, unless another session of the same config and
+//! environment (one that replaced it) still uses it.
+void RemoveSharedKubeconfig(const std::filesystem::path& state_path, const std::string& normalized_config_path,
+                            const std::string& env_name) {
+  const auto load = kubeforward::runtime::LoadSessions(
+      state_path, {.config_path = normalized_config_path, .environment = env_name});
+  if (!load.ok() || !load.state.sessions.empty()) {
+    return;
+  }
+  std::error_code ec;
+  std::filesystem::remove(SharedKubeconfigPathForSession(normalized_config_path, env_name), ec);
+}
+
 struct PreparedForwardLaunch {
   std::string forward_name;
   kubeforward::config::PortMapping port;
+  //! Further mappings served by the same kubectl process (same bind address, tcp only).
+  std::vector<kubeforward::config::PortMapping> additional_ports;
   kubeforward::runtime::StartProcessRequest request;
+  kubeforward::config::RestartPolicy restart_policy = kubeforward::config::RestartPolicy::kFailFast;
+  //! Loopback ports kubectl listens on behind the local proxy, one per mapping (`port` first); empty when kubectl
+  //! binds the local ports itself.
+  std::vector<int> upstream_ports;
+  //! Keep `upstream_ports` taken for kubectl, across its restarts too; shared with the copies PinLaunchTarget() makes.
+  std::vector<std::shared_ptr<const kubeforward::runtime::LoopbackPortReservation>> upstream_reservations;
+  //! Warm pool the proxy keeps for each of the launch's ports.
+  std::optional<kubeforward::config::WarmPool> warm_pool;
+  //! Set for foreground kubectl launches of deployment, service and statefulset targets, whose argv target may be
+  //! pinned to a resolved `pod/NAME` (see PinLaunchTarget()).
+  std::optional<kubeforward::runtime::PodLookupKey> pod_lookup;
+  //! Set on each of the per-pod launches of a load-balanced forward; they share `forward_name` and local ports.
+  std::optional<kubeforward::config::LoadBalance> load_balance;
+  //! The service of a per-pod launch, whose ready endpoints are looked up again when its pod is ejected.
+  std::optional<kubeforward::runtime::PodLookupKey> balanced_service;
+};
+
+//! Index of the `<kind>/<name>` target in a port-forward argv built by BuildKubectlPortForwardArgv().
+constexpr size_t kPortForwardTargetArg = 2;
+
+//! Points the `LOCAL:REMOTE` arguments of a port-forward argv at `remote_ports`, one per mapping in argv order.
+void SetForwardedRemotePorts(std::vector<std::string>& argv, const std::vector<int>& remote_ports) {
+  for (size_t i = 0; i < remote_ports.size() && kPortForwardTargetArg + 1 + i < argv.size(); ++i) {
+    auto& mapping = argv[kPortForwardTargetArg + 1 + i];
+    mapping = mapping.substr(0, mapping.rfind(':') + 1) + std::to_string(remote_ports[i]);
+  }
+}
+
+//! Remote ports of `launch` as configured, `port` first. For services they are service ports.
+std::vector<int> ConfiguredRemotePorts(const PreparedForwardLaunch& launch) {
+  std::vector<int> remote_ports = {launch.port.remote_port};
+  for (const auto& port : launch.additional_ports) {
+    remote_ports.push_back(port.remote_port);
+  }
+  return remote_ports;
+}
+
+//! Translates the service ports of `launch` to the target ports they have on `pod`; std::nullopt with `error` set
+//! when one of them has none there.
+std::optional<std::vector<int>> PodRemotePorts(const PreparedForwardLaunch& launch,
+                                               const kubeforward::runtime::ResolvedPod& pod,
+                                               kubeforward::config::ResourceKind kind, std::string& error) {
+  auto remote_ports = ConfiguredRemotePorts(launch);
+  if (kind != kubeforward::config::ResourceKind::kService) {
+    return remote_ports;
+  }
+  for (auto& remote_port : remote_ports) {
+    const auto target_port = pod.target_ports.find(remote_port);
+    if (target_port == pod.target_ports.end()) {
+      error = "service port " + std::to_string(remote_port) + " has no ready target port on pod/" + pod.name;
+      return std::nullopt;
+    }
+    remote_port = target_port->second;
+  }
+  return remote_ports;
+}
+
+//! A copy of `launch` whose kubectl targets the pod its target currently resolves to, so kubectl skips resolving it
+//! again. A pod is forwarded by pod port, so service ports become their target ports on that pod. When resolution
+//! or the translation fails the launch keeps its original target and ports and kubectl picks a pod itself.
+PreparedForwardLaunch PinLaunchTarget(const PreparedForwardLaunch& launch,
+                                      kubeforward::runtime::PodResolutionCache& pod_cache) {
+  auto pinned = launch;
+  if (!launch.pod_lookup.has_value() || launch.request.argv.size() <= kPortForwardTargetArg) {
+    return pinned;
+  }
+  auto& target = pinned.request.argv[kPortForwardTargetArg];
+  std::string error;
+  const auto pod = pod_cache.Resolve(*launch.pod_lookup, error);
+  const auto remote_ports =
+      pod.has_value() ? PodRemotePorts(launch, *pod, launch.pod_lookup->kind, error) : std::nullopt;
+  if (!remote_ports.has_value()) {
+    // `launch` may carry an earlier pin; fall back to the configured target.
+    target = ResourceKindTargetPrefix(launch.pod_lookup->kind) + "/" + launch.pod_lookup->name;
+    SetForwardedRemotePorts(pinned.request.argv, ConfiguredRemotePorts(launch));
+    std::cerr << "up: forward '" << launch.forward_name << "' is not pinned to a pod, kubectl resolves " << target
+              << ": " << error << "\n";
+    return pinned;
+  }
+  target = "pod/" + pod->name;
+  SetForwardedRemotePorts(pinned.request.argv, *remote_ports);
+  return pinned;
+}
+
+//! Ports served by one port-forward process and the forwards they belong to.
+struct LaunchPortGroup {
+  //! First forward of the group; every member shares its target, namespace, context and restart policy.
+  const kubeforward::runtime::ResolvedForward* forward = nullptr;
+  std::vector<std::string> forward_names;
+  std::vector<kubeforward::config::PortMapping> ports;
+
+  //! Name recorded for the process: member forward names joined with '+'.
+  std::string name() const {
+    std::string joined;
+    for (const auto& forward_name : forward_names) {
+      joined += (joined.empty() ? "" : "+") + forward_name;
+    }
+    return joined;
+  }
 };
 
+bool TargetsSamePod(const kubeforward::runtime::ResolvedForward& a, const kubeforward::runtime::ResolvedForward& b) {
+  return a.resource.kind == b.resource.kind && a.resource.name == b.resource.name &&
+         a.namespace_name == b.namespace_name && a.context == b.context && a.restart_policy == b.restart_policy &&
+         a.warm_pool == b.warm_pool && a.load_balance == b.load_balance;
+}
+
+//! Splits the environment's ports into process groups according to LaunchModeFromEnvironment(). TCP ports sharing a
+//! bind address are grouped per forward, or per target pod across forwards; every udp port gets its own group and
+//! with it its own tunnel behind the UDP relay.
+std::vector<LaunchPortGroup> GroupLaunchPorts(const kubeforward::runtime::ResolvedEnvironment& resolved_env) {
+  std::vector<LaunchPortGroup> groups;
+  const auto mode = LaunchModeFromEnvironment();
+  for (const auto& forward : resolved_env.forwards) {
+    for (const auto& port : forward.ports) {
+      const bool groupable = mode != LaunchMode::kPort && port.protocol == kubeforward::config::PortProtocol::kTcp;
+      const auto group = std::find_if(groups.begin(), groups.end(), [&](const LaunchPortGroup& candidate) {
+        const bool same_owner = mode == LaunchMode::kPod ? TargetsSamePod(*candidate.forward, forward)
+                                                         : candidate.forward == &forward;
+        return groupable && same_owner && candidate.ports.front().protocol == kubeforward::config::PortProtocol::kTcp &&
+               ResolveBindAddress(candidate.ports.front()) == ResolveBindAddress(port);
+      });
+      if (group == groups.end()) {
+        groups.push_back(LaunchPortGroup{.forward = &forward, .forward_names = {forward.name}, .ports = {port}});
+        continue;
+      }
+      group->ports.push_back(port);
+      if (group->forward_names.back() != forward.name) {
+        group->forward_names.push_back(forward.name);
+      }
+    }
+  }
+  return groups;
+}
+
 kubeforward::runtime::ManagedSession MakeManagedSession(const std::string& normalized_config_path,
                                                         const kubeforward::runtime::ResolvedEnvironment& resolved_env,
                                                         bool daemon) {
@@ -774,8 +1261,145 @@ kubeforward::runtime::ManagedSession MakeManagedSession(const std::string& norma
   return session;
 }
 
+//! Managed mappings for the additional ports of `launch`, carrying their proxy upstream ports along.
+std::vector<kubeforward::runtime::ManagedPortMapping> ToManagedPortMappings(const PreparedForwardLaunch& launch) {
+  std::vector<kubeforward::runtime::ManagedPortMapping> mappings;
+  mappings.reserve(launch.additional_ports.size());
+  for (size_t i = 0; i < launch.additional_ports.size(); ++i) {
+    const auto& port = launch.additional_ports[i];
+    mappings.push_back(kubeforward::runtime::ManagedPortMapping{
+        .local_port = port.local_port,
+        .remote_port = port.remote_port,
+        .upstream_port = i + 1 < launch.upstream_ports.size() ? launch.upstream_ports[i + 1] : 0,
+    });
+  }
+  return mappings;
+}
+
+//! Relay routes for every proxied `protocol` port: tcp ports go to the local proxy, udp ports to the UDP relay. The
+//! launches of a load-balanced forward share one route per local port, with one upstream per pod.
+std::vector<kubeforward::runtime::LocalProxyRoute> LocalProxyRoutes(const std::vector<PreparedForwardLaunch>& launches,
+                                                                    kubeforward::config::PortProtocol protocol) {
+  std::vector<kubeforward::runtime::LocalProxyRoute> routes;
+  for (const auto& launch : launches) {
+    for (size_t i = 0; i < launch.upstream_ports.size(); ++i) {
+      const auto& port = i == 0 ? launch.port : launch.additional_ports[i - 1];
+      if (port.protocol != protocol) {
+        continue;
+      }
+      const auto bind_address = ResolveBindAddress(port);
+      const auto shared = std::find_if(routes.begin(), routes.end(), [&](const auto& route) {
+        return launch.load_balance.has_value() && route.local_port == port.local_port &&
+               route.bind_address == bind_address;
+      });
+      if (shared != routes.end()) {
+        shared->balanced_upstream_ports.push_back(launch.upstream_ports[i]);
+        continue;
+      }
+      const bool least_connections =
+          launch.load_balance.has_value() &&
+          launch.load_balance->strategy == kubeforward::config::LoadBalanceStrategy::kLeastConnections;
+      routes.push_back(kubeforward::runtime::LocalProxyRoute{
+          .bind_address = bind_address,
+          .local_port = port.local_port,
+          .upstream_port = launch.upstream_ports[i],
+          .forward_name = launch.forward_name,
+          .warm_pool_size = launch.warm_pool.has_value() ? launch.warm_pool->size : 0,
+          .warm_pool_refill_per_second = launch.warm_pool.has_value() ? launch.warm_pool->refill_per_second : 0,
+          .balancing = least_connections ? kubeforward::runtime::UpstreamBalancing::kLeastConnections
+                                         : kubeforward::runtime::UpstreamBalancing::kRoundRobin,
+      });
+    }
+  }
+  return routes;
+}
+
+//! Per-forward totals of the bytes the local proxy relayed, printed when a foreground session ends.
+void PrintLocalProxyTraffic(const std::vector<kubeforward::runtime::LocalProxyRouteStats>& stats) {
+  std::map<std::string, kubeforward::runtime::LocalProxyRouteStats> by_forward;
+  for (const auto& route_stats : stats) {
+    auto& total = by_forward[route_stats.route.forward_name];
+    total.connections += route_stats.connections;
+    total.bytes_to_upstream += route_stats.bytes_to_upstream;
+    total.bytes_to_client += route_stats.bytes_to_client;
+    total.warm_hits += route_stats.warm_hits;
+    total.ejections += route_stats.ejections;
+    // Every local port of a load-balanced forward lists its pods in the same order.
+    total.upstream_connections.resize(std::max(total.upstream_connections.size(),
+                                               route_stats.upstream_connections.size()));
+    for (size_t i = 0; i < route_stats.upstream_connections.size(); ++i) {
+      total.upstream_connections[i] += route_stats.upstream_connections[i];
+    }
+  }
+  for (const auto& [forward_name, total] : by_forward) {
+    std::cout << "up: forward '" << forward_name << "' relayed " << total.connections << " connection(s), "
+              << total.bytes_to_upstream << " bytes sent, " << total.bytes_to_client << " bytes received";
+    if (total.warm_hits > 0) {
+      std::cout << ", " << total.warm_hits << " served from the warm pool";
+    }
+    if (total.upstream_connections.size() > 1) {
+      std::cout << ", per pod";
+      for (size_t i = 0; i < total.upstream_connections.size(); ++i) {
+        std::cout << (i == 0 ? " " : "/") << total.upstream_connections[i];
+      }
+      std::cout << ", " << total.ejections << " ejection(s)";
+    }
+    std::cout << "\n";
+  }
+}
+
+//! Ready endpoints each `loadBalance` forward opens tunnels to, at most `replicas` of them, by forward name; only pods
+//! with a target port for every port of the forward are used. Forwards whose service cannot be listed or has no such
+//! pod are left out, with a warning, and run on one pod kubectl picks.
+std::map<std::string, std::vector<kubeforward::runtime::ResolvedPod>> DiscoverBalancedPods(
+    const kubeforward::runtime::ResolvedEnvironment& resolved_env) {
+  std::map<std::string, std::vector<kubeforward::runtime::ResolvedPod>> balanced_pods;
+  if (UsesNativeEngine(resolved_env)) {
+    return balanced_pods;
+  }
+  for (const auto& forward : resolved_env.forwards) {
+    if (!forward.load_balance.has_value() || !forward.resource.name.has_value()) {
+      continue;
+    }
+    const kubeforward::runtime::PodLookupKey key{
+        .kind = forward.resource.kind,
+        .name = *forward.resource.name,
+        .namespace_name = forward.namespace_name,
+        .context = forward.context,
+        .kubeconfig = resolved_env.settings.kubeconfig,
+    };
+    std::string error;
+    const auto pods = kubeforward::runtime::LookupServicePodsWithKubectl(
+        KubectlBinary(), key, std::chrono::milliseconds(StartupTimeoutMs()), error);
+    if (!pods.has_value()) {
+      std::cerr << "up: forward '" << forward.name << "' is not load-balanced, kubectl picks one pod: " << error
+                << "\n";
+      continue;
+    }
+    std::vector<kubeforward::runtime::ResolvedPod> servable;
+    for (const auto& pod : *pods) {
+      const bool serves_every_port = std::all_of(forward.ports.begin(), forward.ports.end(), [&](const auto& port) {
+        return pod.target_ports.count(port.remote_port) != 0;
+      });
+      if (serves_every_port && servable.size() < static_cast<size_t>(forward.load_balance->replicas)) {
+        servable.push_back(pod);
+      }
+    }
+    if (servable.empty()) {
+      std::cerr << "up: forward '" << forward.name << "' is not load-balanced, kubectl picks one pod: no ready "
+                << "endpoint of " << key.name << " serves all of its ports\n";
+      continue;
+    }
+    balanced_pods[forward.name] = std::move(servable);
+  }
+  return balanced_pods;
+}
+
+//! Builds the launches for `resolved_env`. `balanced_pods` lists, by forward name, the pods a load-balanced forward
+//! opens one tunnel each to (see DiscoverBalancedPods()); forwards missing from it launch on their target.
 bool BuildPreparedLaunches(const std::string& normalized_config_path,
                            const kubeforward::runtime::ResolvedEnvironment& resolved_env, bool daemon,
+                           const std::map<std::string, std::vector<kubeforward::runtime::ResolvedPod>>& balanced_pods,
                            std::vector<PreparedForwardLaunch>& launches, std::string& error) {
   launches.clear();
 
@@ -786,20 +1410,106 @@ bool BuildPreparedLaunches(const std::string& normalized_config_path,
     return false;
   }
 
-  for (const auto& forward : resolved_env.forwards) {
-    for (const auto& port : forward.ports) {
+  for (auto& group : GroupLaunchPorts(resolved_env)) {
+    const auto& forward = *group.forward;
+    const auto& ports = group.ports;
+    const std::string launch_name = group.name();
+    // UDP never reaches kubectl directly: it only tunnels tcp, so the UDP relay frames datagrams onto a tcp port.
+    const bool udp = ports.front().protocol == kubeforward::config::PortProtocol::kUdp;
+    if (udp && daemon) {
+      error = "invalid forward '" + launch_name + "': udp ports need a foreground session (the udp relay runs inside "
+              "kubeforward)";
+      return false;
+    }
+    if (forward.load_balance.has_value() && daemon) {
+      error = "invalid forward '" + launch_name + "': loadBalance needs a foreground session (the local proxy spreads "
+              "connections over the pods)";
+      return false;
+    }
+    const bool proxied = udp || UsesLocalProxy(forward, daemon);
+    // A load-balanced forward gets one launch per discovered pod, all behind the same local ports; an empty pod name
+    // launches on the configured target.
+    std::vector<kubeforward::runtime::ResolvedPod> pods = {{}};
+    if (const auto balanced = balanced_pods.find(forward.name); balanced != balanced_pods.end() && !udp && proxied) {
+      pods = balanced->second;
+    }
+
+    for (const auto& pod : pods) {
+      // Behind the proxy kubectl listens on reserved loopback ports and kubeforward keeps the local ones.
+      std::vector<int> upstream_ports;
+      std::vector<std::shared_ptr<const kubeforward::runtime::LoopbackPortReservation>> upstream_reservations;
+      auto kubectl_ports = ports;
+      if (proxied) {
+        for (auto& kubectl_port : kubectl_ports) {
+          kubectl_port.protocol = kubeforward::config::PortProtocol::kTcp;
+          auto reservation = kubeforward::runtime::LoopbackPortReservation::Create(error);
+          if (reservation == nullptr) {
+            error = "failed to reserve proxy port for forward '" + launch_name + "': " + error;
+            return false;
+          }
+          upstream_ports.push_back(reservation->port());
+          upstream_reservations.push_back(std::move(reservation));
+          kubectl_port.local_port = upstream_ports.back();
+          kubectl_port.bind_address = "127.0.0.1";
+        }
+      }
+
       std::vector<std::string> argv;
-      if (!BuildKubectlPortForwardArgv(resolved_env, forward, port, argv, error)) {
-        error = "invalid forward '" + forward.name + "': " + error;
+      if (!BuildKubectlPortForwardArgv(resolved_env, forward, kubectl_ports, argv, error)) {
+        error = "invalid forward '" + launch_name + "': " + error;
         return false;
       }
+      if (!pod.name.empty()) {
+        argv[kPortForwardTargetArg] = "pod/" + pod.name;
+      }
+
+      // Only foreground sessions pin: daemons are never restarted by kubeforward, so kubectl resolves them just once.
+      std::optional<kubeforward::runtime::PodLookupKey> pod_lookup;
+      std::optional<kubeforward::runtime::PodLookupKey> balanced_service;
+      if (!daemon && !UsesNativeEngine(resolved_env) &&
+          forward.resource.kind != kubeforward::config::ResourceKind::kPod) {
+        const kubeforward::runtime::PodLookupKey key{
+            .kind = forward.resource.kind,
+            .name = *forward.resource.name,
+            .namespace_name = forward.namespace_name,
+            .context = forward.context,
+            .kubeconfig = resolved_env.settings.kubeconfig,
+        };
+        if (pod.name.empty()) {
+          pod_lookup = key;
+        } else {
+          balanced_service = key;
+        }
+      }
 
+      const auto& port = ports.front();
       kubeforward::runtime::StartProcessRequest request;
       request.cwd = cwd;
       request.daemon = daemon;
+      request.capture_output = !daemon;
       request.argv = std::move(argv);
-      request.log_path = BuildForwardLogPath(normalized_config_path, resolved_env.name, forward.name, port.local_port);
-      launches.push_back(PreparedForwardLaunch{.forward_name = forward.name, .port = port, .request = std::move(request)});
+      request.log_path = BuildForwardLogPath(normalized_config_path, resolved_env.name,
+                                             pod.name.empty() ? launch_name : launch_name + "-" + pod.name,
+                                             port.local_port);
+      launches.push_back(PreparedForwardLaunch{
+          .forward_name = launch_name,
+          .port = port,
+          .additional_ports = std::vector<kubeforward::config::PortMapping>(ports.begin() + 1, ports.end()),
+          .request = std::move(request),
+          .restart_policy = forward.restart_policy,
+          .upstream_ports = std::move(upstream_ports),
+          .upstream_reservations = std::move(upstream_reservations),
+          .warm_pool = forward.warm_pool,
+          .pod_lookup = std::move(pod_lookup),
+          .load_balance = pod.name.empty() ? std::nullopt : forward.load_balance,
+          .balanced_service = std::move(balanced_service),
+      });
+      if (!pod.name.empty()) {
+        // The pod is forwarded by pod port; DiscoverBalancedPods() only keeps pods with a target for every port.
+        SetForwardedRemotePorts(launches.back().request.argv,
+                                PodRemotePorts(launches.back(), pod, forward.resource.kind, error).value_or(
+                                    ConfiguredRemotePorts(launches.back())));
+      }
     }
   }
 
@@ -807,6 +1517,31 @@ bool BuildPreparedLaunches(const std::string& normalized_config_path,
   return true;
 }
 
+//! Points the argv of a forward that ran behind the local proxy at its local ports and bind address instead of the
+//! proxy's upstream ports; false when the argv does not have the shape BuildKubectlPortForwardArgv() gives it.
+bool UnproxyForwardArgv(const kubeforward::runtime::ManagedForwardProcess& forward, std::vector<std::string>& argv) {
+  const auto mappings = kubeforward::runtime::ManagedPortMappings(forward);
+  for (size_t i = 0; i < mappings.size(); ++i) {
+    const size_t index = kPortForwardTargetArg + 1 + i;
+    const auto& mapping = mappings[i];
+    // The remote side stays as it was: a pinned service launch forwards to the pod's target port.
+    const std::string listen = std::to_string(KubectlListenPort(mapping)) + ":";
+    if (index >= argv.size() || argv[index].rfind(listen, 0) != 0) {
+      return false;
+    }
+    argv[index] = std::to_string(mapping.local_port) + ":" + argv[index].substr(listen.size());
+  }
+  const auto address = std::find(argv.begin(), argv.end(), "--address");
+  if (address == argv.end() || std::next(address) == argv.end()) {
+    return false;
+  }
+  *std::next(address) = forward.bind_address;
+  return true;
+}
+
+//! Launches that bring `session` back after a failed replacement. The restoring command exits afterwards, so there is
+//! no local proxy: forwards that ran behind one are restored with kubectl binding their local ports itself. UDP
+//! forwards need the relay inside the replaced supervisor and are not restored.
 bool BuildPreparedLaunchesFromSession(const kubeforward::runtime::ManagedSession& session,
                                       std::vector<PreparedForwardLaunch>& launches, std::string& error) {
   launches.clear();
@@ -819,12 +1554,22 @@ bool BuildPreparedLaunchesFromSession(const kubeforward::runtime::ManagedSession
               "' has no stored argv";
       return false;
     }
+    if (forward.protocol == kubeforward::config::PortProtocol::kUdp) {
+      error = "session '" + session.id + "' cannot be restored because forward '" + forward.forward_name +
+              "' relays udp, which only a foreground 'up' serves; run 'up' again";
+      return false;
+    }
 
     kubeforward::runtime::StartProcessRequest request;
     request.argv = forward.argv;
     request.cwd = forward.cwd;
     request.daemon = session.daemon;
     request.log_path = forward.log_path;
+    if (forward.upstream_port != 0 && !UnproxyForwardArgv(forward, request.argv)) {
+      error = "session '" + session.id + "' cannot be restored because the stored argv of forward '" +
+              forward.forward_name + "' does not list its proxied ports";
+      return false;
+    }
 
     kubeforward::config::PortMapping port;
     port.local_port = forward.local_port;
@@ -832,9 +1577,18 @@ bool BuildPreparedLaunchesFromSession(const kubeforward::runtime::ManagedSession
     port.bind_address = forward.bind_address;
     port.protocol = forward.protocol;
 
+    std::vector<kubeforward::config::PortMapping> additional_ports;
+    for (const auto& mapping : forward.additional_ports) {
+      auto additional = port;
+      additional.local_port = mapping.local_port;
+      additional.remote_port = mapping.remote_port;
+      additional_ports.push_back(std::move(additional));
+    }
+
     launches.push_back(PreparedForwardLaunch{
         .forward_name = forward.forward_name,
         .port = port,
+        .additional_ports = std::move(additional_ports),
         .request = std::move(request),
     });
   }
@@ -874,6 +1628,17 @@ std::optional<std::string> ReadProcessCommandLine(int pid) {
     return std::nullopt;
   }
 
+  if (const auto argv = kubeforward::runtime::ReadProcessArgv(pid)) {
+    std::string command;
+    for (const auto& arg : *argv) {
+      if (!command.empty()) {
+        command.push_back(' ');
+      }
+      command += arg;
+    }
+    return command;
+  }
+
   std::array<char, 256> buffer {};
   std::string output;
   const std::string command = "ps -p " + std::to_string(pid) + " -o command=";
@@ -922,6 +1687,19 @@ bool ShouldSignalManagedProcess(const kubeforward::runtime::ManagedForwardProces
     return true;
   }
 
+  if (!process.fingerprint.empty()) {
+    switch (kubeforward::runtime::CompareProcessFingerprint(process.pid, process.fingerprint)) {
+      case kubeforward::runtime::FingerprintMatch::kMatch:
+        reason.clear();
+        return true;
+      case kubeforward::runtime::FingerprintMatch::kMismatch:
+        reason = "refusing to signal pid because it now belongs to a different process (pid reused)";
+        return false;
+      case kubeforward::runtime::FingerprintMatch::kUnavailable:
+        break;
+    }
+  }
+
   const auto live_command = ReadProcessCommandLine(process.pid);
   if (!live_command.has_value()) {
     reason = "refusing to signal pid because process identity cannot be verified";
@@ -934,10 +1712,13 @@ bool ShouldSignalManagedProcess(const kubeforward::runtime::ManagedForwardProces
     return true;
   }
 
-  const std::string expected_port_mapping = std::to_string(process.local_port) + ":" + std::to_string(process.remote_port);
+  const auto mappings = kubeforward::runtime::ManagedPortMappings(process);
+  const bool owns_every_mapping = std::all_of(mappings.begin(), mappings.end(), [&](const auto& mapping) {
+    // The remote side is the pod's target port rather than the service port once a service launch is pinned.
+    return live_command->find(" " + std::to_string(KubectlListenPort(mapping)) + ":") != std::string::npos;
+  });
   if (live_command->find(expected_binary) != std::string::npos &&
-      live_command->find("port-forward") != std::string::npos &&
-      live_command->find(expected_port_mapping) != std::string::npos) {
+      live_command->find("port-forward") != std::string::npos && owns_every_mapping) {
     reason.clear();
     return true;
   }
@@ -946,23 +1727,45 @@ bool ShouldSignalManagedProcess(const kubeforward::runtime::ManagedForwardProces
   return false;
 }
 
-void StopSessionProcesses(const kubeforward::runtime::ManagedSession& session, kubeforward::runtime::ProcessRunner& runner,
-                          const std::string& error_prefix, bool& stop_failed, int& stopped_processes) {
-  for (const auto& process : session.forwards) {
-    std::string identity_error;
-    if (!ShouldSignalManagedProcess(process, identity_error)) {
-      std::cerr << error_prefix << process.pid << ": " << identity_error << "\n";
-      stop_failed = true;
-      continue;
-    }
-    std::string stop_error;
-    if (!runner.Stop(process.pid, stop_error)) {
-      std::cerr << error_prefix << process.pid << ": " << stop_error << "\n";
-      stop_failed = true;
+//! Stops every process of `sessions` whose identity checks out with one batched ProcessRunner::StopAll call, so all
+//! of them share a single SIGTERM grace period. Returns one flag per session telling whether any of its processes
+//! was skipped (`skip_prefix`) or failed to stop (`stop_prefix`).
+std::vector<bool> StopSessionsProcesses(const std::vector<const kubeforward::runtime::ManagedSession*>& sessions,
+                                        kubeforward::runtime::ProcessRunner& runner, const std::string& skip_prefix,
+                                        const std::string& stop_prefix, int& stopped_processes) {
+  std::vector<bool> session_failed(sessions.size(), false);
+  std::vector<int> pids;
+  std::vector<size_t> pid_sessions;
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    for (const auto& process : sessions[i]->forwards) {
+      std::string identity_error;
+      if (!ShouldSignalManagedProcess(process, identity_error)) {
+        std::cerr << skip_prefix << process.pid << ": " << identity_error << "\n";
+        session_failed[i] = true;
+        continue;
+      }
+      pids.push_back(process.pid);
+      pid_sessions.push_back(i);
+    }
+  }
+
+  const auto results = runner.StopAll(pids);
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].stopped) {
+      std::cerr << stop_prefix << results[i].pid << ": " << results[i].error << "\n";
+      session_failed[pid_sessions[i]] = true;
       continue;
     }
     ++stopped_processes;
   }
+  return session_failed;
+}
+
+void StopSessionProcesses(const kubeforward::runtime::ManagedSession& session, kubeforward::runtime::ProcessRunner& runner,
+                          const std::string& error_prefix, bool& stop_failed, int& stopped_processes) {
+  if (StopSessionsProcesses({&session}, runner, error_prefix, error_prefix, stopped_processes).front()) {
+    stop_failed = true;
+  }
 }
 
 void StopStartedSession(kubeforward::runtime::ManagedSession& session, kubeforward::runtime::ProcessRunner& runner) {
@@ -972,22 +1775,191 @@ void StopStartedSession(kubeforward::runtime::ManagedSession& session, kubeforwa
   session.forwards.clear();
 }
 
+//! Time a supervisor gets on top of the drain deadline to stop its forwards (SIGTERM, then SIGKILL) and clear its
+//! session from the state.
+constexpr std::chrono::milliseconds kSupervisorStopGrace(5000);
+
+//! Whether the foreground `up` recorded as the session's supervisor is still that process and has not exited.
+bool SupervisorRunning(const kubeforward::runtime::ManagedSession& session) {
+  return session.supervisor_pid > 0 && session.supervisor_pid != ::getpid() &&
+         !session.supervisor_fingerprint.empty() &&
+         kubeforward::runtime::CompareProcessFingerprint(session.supervisor_pid, session.supervisor_fingerprint) ==
+             kubeforward::runtime::FingerprintMatch::kMatch &&
+         !kubeforward::runtime::IsZombieProcess(session.supervisor_pid);
+}
+
+//! Asks the live foreground supervisors of `sessions` to drain their local proxies for up to `drain_timeout` (0 stops
+//! them right away), then waits until each one stopped its forwards, cleared its session and exited, so its local
+//! ports are free again. Returns whether any supervisor was asked, in which case the state file changed underneath
+//! the caller. Daemon sessions have no supervisor; they, and supervisors that do not finish in time, are left to the
+//! regular stop.
+bool DrainSessionSupervisors(const std::filesystem::path& state_path,
+                             const std::vector<const kubeforward::runtime::ManagedSession*>& sessions,
+                             std::chrono::milliseconds drain_timeout, const std::string& command_name) {
+  std::map<std::string, kubeforward::runtime::ManagedSession> supervised;
+  for (const auto* session : sessions) {
+    if (SupervisorRunning(*session)) {
+      supervised.emplace(session->id, *session);
+    }
+  }
+  if (supervised.empty()) {
+    return false;
+  }
+
+  // The supervisor reads the deadline from its session once SIGTERM arrives.
+  std::string save_error;
+  if (!kubeforward::runtime::UpdateState(
+          state_path,
+          [&](kubeforward::runtime::RuntimeState& state) {
+            for (auto& stored_session : state.sessions) {
+              if (supervised.count(stored_session.id) != 0) {
+                stored_session.drain_timeout_ms = static_cast<int>(drain_timeout.count());
+              }
+            }
+          },
+          save_error)) {
+    std::cerr << command_name << ": failed to request draining in runtime state '" << state_path.string()
+              << "': " << save_error << "\n";
+    return false;
+  }
+  if (drain_timeout.count() > 0) {
+    std::cerr << command_name << ": draining " << supervised.size() << " foreground session(s) for up to "
+              << drain_timeout.count() << "ms\n";
+  }
+  for (const auto& [id, session] : supervised) {
+    (void)::kill(session.supervisor_pid, SIGTERM);
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + drain_timeout + kSupervisorStopGrace;
+  while (true) {
+    // The session is cleared before the supervisor exits, and only the exit releases its proxy's listeners.
+    for (auto it = supervised.begin(); it != supervised.end();) {
+      it = SupervisorRunning(it->second) ? std::next(it) : supervised.erase(it);
+    }
+    if (supervised.empty() || std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  for (const auto& [id, session] : supervised) {
+    std::cerr << command_name << ": supervisor pid " << session.supervisor_pid
+              << " did not finish draining in time; stopping its forwards\n";
+  }
+  return true;
+}
+
+//! Builds the state entry for a launch that was just started with `pid`.
+using ManagedProcessFactory = std::function<kubeforward::runtime::ManagedForwardProcess(size_t launch_index, int pid)>;
+
+//! Starts every launch, keeping at most StartupParallelism() forwards in the starting state, and waits on all
+//! readiness signals together: kubectl's "Forwarding from" line wakes the wait immediately, and the listener probe
+//! covers output that is not followed. Any start or readiness failure stops the forwards started so far.
+//! `other_output`, when set, receives the output events of processes this call is not waiting on (the running
+//! forwards of a supervised session), and a foreground signal then stops the wait like a failure.
+bool StartLaunchesConcurrently(const std::vector<PreparedForwardLaunch>& launches,
+                               const ManagedProcessFactory& make_process, const std::string& start_error_prefix,
+                               kubeforward::runtime::ProcessRunner& runner,
+                               kubeforward::runtime::ForwardOutputMonitor& output_monitor,
+                               kubeforward::runtime::ManagedSession& session, std::string& error,
+                               std::vector<kubeforward::runtime::ForwardOutputEvent>* other_output = nullptr) {
+  const bool check_readiness = !UseNoopRunner() && !SkipReadinessCheck();
+  const size_t parallelism = StartupParallelism();
+  const auto startup_timeout = std::chrono::milliseconds(StartupTimeoutMs());
+  const auto poll_interval = std::chrono::milliseconds(100);
+
+  std::vector<PendingForwardReadiness> pending;
+  size_t next_launch = 0;
+  while (next_launch < launches.size() || !pending.empty()) {
+    while (next_launch < launches.size() && (parallelism == 0 || pending.size() < parallelism)) {
+      const auto& launch = launches[next_launch];
+      const bool follow_log = launch.request.daemon && !launch.request.capture_output;
+      const auto log_offset = follow_log ? kubeforward::runtime::CurrentFileSize(launch.request.log_path) : 0;
+      std::string start_error;
+      const auto started = runner.Start(launch.request, start_error);
+      if (!started.has_value()) {
+        error = start_error_prefix + " '" + launch.forward_name + "': " + start_error;
+        StopStartedSession(session, runner);
+        return false;
+      }
+
+      session.forwards.push_back(make_process(next_launch, started->pid));
+      if (!UseNoopRunner()) {
+        session.forwards.back().fingerprint =
+            kubeforward::runtime::ReadProcessFingerprint(started->pid).value_or(kubeforward::runtime::ProcessFingerprint{});
+      }
+      if (started->stdout_fd >= 0 || started->stderr_fd >= 0) {
+        output_monitor.TrackPipes(started->pid, started->stdout_fd, started->stderr_fd);
+      } else if (follow_log && check_readiness) {
+        output_monitor.TrackLogFile(started->pid, launch.request.log_path, log_offset);
+      }
+      ++next_launch;
+      if (check_readiness) {
+        std::vector<int> waiting_ports;
+        for (const auto& mapping : kubeforward::runtime::ManagedPortMappings(session.forwards.back())) {
+          waiting_ports.push_back(KubectlListenPort(mapping));
+        }
+        pending.push_back(PendingForwardReadiness{
+            .forward_index = session.forwards.size() - 1,
+            .waiting_ports = std::move(waiting_ports),
+            .deadline = std::chrono::steady_clock::now() + startup_timeout,
+        });
+      }
+    }
+
+    for (auto it = pending.begin(); it != pending.end();) {
+      const auto readiness = PollForwardReadiness(session.forwards[it->forward_index], *it, error);
+      if (readiness == ForwardReadiness::kFailed) {
+        StopStartedSession(session, runner);
+        return false;
+      }
+      it = readiness == ForwardReadiness::kReady ? pending.erase(it) : std::next(it);
+    }
+
+    if (pending.empty()) {
+      continue;
+    }
+    if (other_output != nullptr && g_foreground_signal != 0) {
+      error = start_error_prefix + ": interrupted by signal " + std::to_string(g_foreground_signal);
+      StopStartedSession(session, runner);
+      return false;
+    }
+    for (const auto& output : output_monitor.Wait(poll_interval)) {
+      const auto pending_it = std::find_if(pending.begin(), pending.end(), [&](const PendingForwardReadiness& entry) {
+        return session.forwards[entry.forward_index].pid == output.pid;
+      });
+      if (pending_it == pending.end()) {
+        if (other_output != nullptr) {
+          other_output->push_back(output);
+        }
+        continue;
+      }
+      const auto readiness =
+          ApplyForwardOutputEvent(session.forwards[pending_it->forward_index], *pending_it, output.event, error);
+      if (readiness == ForwardReadiness::kFailed) {
+        StopStartedSession(session, runner);
+        return false;
+      }
+      if (readiness == ForwardReadiness::kReady) {
+        pending.erase(pending_it);
+      }
+    }
+  }
+
+  error.clear();
+  return true;
+}
+
 bool StartManagedSession(const std::string& normalized_config_path,
                          const kubeforward::runtime::ResolvedEnvironment& resolved_env, bool daemon,
                          const std::vector<PreparedForwardLaunch>& launches, kubeforward::runtime::ProcessRunner& runner,
+                         kubeforward::runtime::ForwardOutputMonitor& output_monitor,
                          kubeforward::runtime::ManagedSession& session, std::string& error) {
   session = MakeManagedSession(normalized_config_path, resolved_env, daemon);
+  session.forwards.reserve(launches.size());
 
-  for (const auto& launch : launches) {
-    std::string start_error;
-    const auto started = runner.Start(launch.request, start_error);
-    if (!started.has_value()) {
-      error = "failed to start forward '" + launch.forward_name + "': " + start_error;
-      StopStartedSession(session, runner);
-      return false;
-    }
-
-    kubeforward::runtime::ManagedForwardProcess process{
+  const auto make_process = [&](size_t launch_index, int pid) {
+    const auto& launch = launches[launch_index];
+    return kubeforward::runtime::ManagedForwardProcess{
         .environment = resolved_env.name,
         .forward_name = launch.forward_name,
         .argv = launch.request.argv,
@@ -997,18 +1969,13 @@ bool StartManagedSession(const std::string& normalized_config_path,
         .local_port = launch.port.local_port,
         .remote_port = launch.port.remote_port,
         .protocol = launch.port.protocol,
-        .pid = started->pid,
+        .pid = pid,
+        .additional_ports = ToManagedPortMappings(launch),
+        .upstream_port = launch.upstream_ports.empty() ? 0 : launch.upstream_ports.front(),
     };
-    session.forwards.push_back(process);
-
-    if (!UseNoopRunner() && !SkipReadinessCheck() && !WaitForForwardReady(process, error)) {
-      StopStartedSession(session, runner);
-      return false;
-    }
-  }
-
-  error.clear();
-  return true;
+  };
+  return StartLaunchesConcurrently(launches, make_process, "failed to start forward", runner, output_monitor, session,
+                                   error);
 }
 
 bool StartManagedSession(const kubeforward::runtime::ManagedSession& snapshot,
@@ -1017,34 +1984,28 @@ bool StartManagedSession(const kubeforward::runtime::ManagedSession& snapshot,
   session = snapshot;
   session.forwards.clear();
   session.forwards.reserve(launches.size());
-
-  for (size_t i = 0; i < launches.size(); ++i) {
-    const auto& launch = launches[i];
-    const auto& snapshot_forward = snapshot.forwards[i];
-
-    std::string start_error;
-    const auto started = runner.Start(launch.request, start_error);
-    if (!started.has_value()) {
-      error = "failed to restore forward '" + launch.forward_name + "': " + start_error;
-      StopStartedSession(session, runner);
-      return false;
+  // The restoring command exits afterwards, so the restored forwards run without a supervisor.
+  session.supervisor_pid = 0;
+  session.supervisor_fingerprint = {};
+  session.drain_timeout_ms = 0;
+
+  const auto make_process = [&](size_t launch_index, int pid) {
+    const auto& launch = launches[launch_index];
+    auto restored_forward = snapshot.forwards[launch_index];
+    restored_forward.pid = pid;
+    // Without the proxy, kubectl listens on the local ports (see BuildPreparedLaunchesFromSession()).
+    restored_forward.upstream_port = 0;
+    for (auto& mapping : restored_forward.additional_ports) {
+      mapping.upstream_port = 0;
     }
-
-    auto restored_forward = snapshot_forward;
-    restored_forward.pid = started->pid;
     restored_forward.argv = launch.request.argv;
     restored_forward.cwd = launch.request.cwd.string();
     restored_forward.log_path = launch.request.log_path.string();
-    session.forwards.push_back(std::move(restored_forward));
-
-    if (!UseNoopRunner() && !SkipReadinessCheck() && !WaitForForwardReady(session.forwards.back(), error)) {
-      StopStartedSession(session, runner);
-      return false;
-    }
-  }
-
-  error.clear();
-  return true;
+    return restored_forward;
+  };
+  kubeforward::runtime::ForwardOutputMonitor output_monitor;
+  return StartLaunchesConcurrently(launches, make_process, "failed to restore forward", runner, output_monitor, session,
+                                   error);
 }
 
 void RemoveMatchingSessions(kubeforward::runtime::RuntimeState& state, const std::string& normalized_config_path,
@@ -1141,48 +2102,439 @@ struct ForegroundExitEvent {
   int pid = 0;
   int status = 0;
   std::string forward_name;
+  //! kubectl output line that failed a still-running forward (e.g. "lost connection to pod"); empty for real exits.
+  std::string failure;
+};
+
+//! Restart bookkeeping for one foreground forward; only used when its launch has `restartPolicy: replace`.
+struct ForegroundRestartState {
+  kubeforward::runtime::RestartBackoff backoff;
+  std::chrono::steady_clock::time_point started_at;
+  //! Set while the forward is down and waiting for its next restart attempt.
+  std::optional<std::chrono::steady_clock::time_point> restart_at;
 };
 
-int RunForegroundSession(const std::filesystem::path& state_path, const kubeforward::runtime::RuntimeState& state_snapshot,
-                         kubeforward::runtime::ManagedSession& session, kubeforward::runtime::ProcessRunner& runner) {
+enum class ForwardRestartOutcome {
+  kRestarted,
+  //! The new process did not become ready; try again after the next backoff delay.
+  kRetry,
+  //! The session can no longer be supervised (it was removed from state or state cannot be written).
+  kAbandon,
+  //! A signal arrived before the new process was ready; it was stopped again.
+  kInterrupted,
+};
+
+//! Respawns `session.forwards[forward_index]` from its launch, waits for readiness again and swaps the new pid into
+//! the stored session under the state lock, leaving every other session and forward untouched. The wait gives up as
+//! soon as a foreground signal arrives, and output of the other forwards seen meanwhile is appended to
+//! `other_output` for the supervisor loop.
+ForwardRestartOutcome RestartForegroundForward(const std::filesystem::path& state_path,
+                                               const PreparedForwardLaunch& launch,
+                                               kubeforward::runtime::ManagedSession& session, size_t forward_index,
+                                               kubeforward::runtime::ProcessRunner& runner,
+                                               kubeforward::runtime::ForwardOutputMonitor& output_monitor,
+                                               std::vector<kubeforward::runtime::ForwardOutputEvent>& other_output,
+                                               std::string& error) {
+  const auto previous = session.forwards[forward_index];
+  auto restarted = session;
+  restarted.forwards.clear();
+  const auto make_process = [&](size_t, int pid) {
+    auto forward = previous;
+    forward.argv = launch.request.argv;
+    forward.pid = pid;
+    forward.fingerprint = {};
+    forward.restart_count = previous.restart_count + 1;
+    return forward;
+  };
+  if (!StartLaunchesConcurrently({launch}, make_process, "failed to restart forward", runner, output_monitor, restarted,
+                                 error, &other_output)) {
+    return g_foreground_signal != 0 ? ForwardRestartOutcome::kInterrupted : ForwardRestartOutcome::kRetry;
+  }
+
+  const auto& replacement = restarted.forwards.front();
+  bool session_found = false;
+  std::string save_error;
+  const bool saved = kubeforward::runtime::UpdateState(
+      state_path,
+      [&](kubeforward::runtime::RuntimeState& state) {
+        for (auto& stored_session : state.sessions) {
+          if (stored_session.id != session.id) {
+            continue;
+          }
+          session_found = true;
+          for (auto& forward : stored_session.forwards) {
+            if (forward.pid == previous.pid && forward.forward_name == previous.forward_name) {
+              forward = replacement;
+            }
+          }
+        }
+      },
+      save_error);
+  if (!saved || !session_found) {
+    StopStartedSession(restarted, runner);
+    error = saved ? "session '" + session.id + "' is no longer in runtime state; stopping supervision"
+                  : "failed to save runtime state '" + state_path.string() + "': " + save_error;
+    return ForwardRestartOutcome::kAbandon;
+  }
+
+  session.forwards[forward_index] = replacement;
+  error.clear();
+  return ForwardRestartOutcome::kRestarted;
+}
+
+//! Lets the connections relayed by `local_proxy` finish for as long as the SIGTERM sender (`down` or a replacing
+//! `up`) asked in the session's state, while new connections are refused. The forwards keep running meanwhile since
+//! the in-flight connections go through them.
+void DrainForegroundProxy(const std::filesystem::path& state_path, const kubeforward::runtime::ManagedSession& session,
+                          kubeforward::runtime::LocalForwardProxy& local_proxy) {
+  if (!local_proxy.running()) {
+    return;
+  }
+  const auto load = kubeforward::runtime::LoadState(state_path);
+  const auto stored = std::find_if(load.state.sessions.begin(), load.state.sessions.end(),
+                                   [&](const auto& stored_session) { return stored_session.id == session.id; });
+  if (!load.ok() || stored == load.state.sessions.end() || stored->drain_timeout_ms <= 0) {
+    return;
+  }
+
+  const std::chrono::milliseconds timeout(stored->drain_timeout_ms);
+  std::cerr << "up: draining " << local_proxy.active_connections() << " connection(s) for up to " << timeout.count()
+            << "ms\n";
+  if (local_proxy.Drain(timeout)) {
+    std::cerr << "up: every connection finished\n";
+  } else {
+    std::cerr << "up: " << local_proxy.active_connections() << " connection(s) still open after " << timeout.count()
+              << "ms; closing them\n";
+  }
+}
+
+//! `launches[index]`, a per-pod launch of a load-balanced forward whose pod was ejected, moved to a ready endpoint of
+//! its service that no other live launch of the forward uses (`live(i)`), on the same upstream ports. Other pods are
+//! preferred over the ejected one. std::nullopt with `error` set when the service has no such endpoint.
+std::optional<PreparedForwardLaunch> RelocateBalancedLaunch(const std::vector<PreparedForwardLaunch>& launches,
+                                                            size_t index, const std::function<bool(size_t)>& live,
+                                                            std::string& error) {
+  const auto& launch = launches[index];
+  const auto pods = kubeforward::runtime::LookupServicePodsWithKubectl(
+      KubectlBinary(), *launch.balanced_service, std::chrono::milliseconds(StartupTimeoutMs()), error);
+  if (!pods.has_value()) {
+    return std::nullopt;
+  }
+  std::set<std::string> used_targets;
+  for (size_t other = 0; other < launches.size(); ++other) {
+    if (other != index && live(other) && launches[other].forward_name == launch.forward_name &&
+        launches[other].request.argv.size() > kPortForwardTargetArg) {
+      used_targets.insert(launches[other].request.argv[kPortForwardTargetArg]);
+    }
+  }
+  const auto& ejected_target = launch.request.argv[kPortForwardTargetArg];
+  std::optional<PreparedForwardLaunch> same_pod;
+  for (const auto& pod : *pods) {
+    const std::string target = "pod/" + pod.name;
+    std::string port_error;
+    const auto remote_ports = PodRemotePorts(launch, pod, launch.balanced_service->kind, port_error);
+    if (used_targets.count(target) != 0 || !remote_ports.has_value()) {
+      continue;
+    }
+    auto relocated = launch;
+    relocated.request.argv[kPortForwardTargetArg] = target;
+    SetForwardedRemotePorts(relocated.request.argv, *remote_ports);
+    if (target != ejected_target) {
+      error.clear();
+      return relocated;
+    }
+    same_pod = std::move(relocated);
+  }
+  if (!same_pod.has_value()) {
+    error = "no other ready endpoint of service/" + launch.balanced_service->name + " is free";
+    return std::nullopt;
+  }
+  error.clear();
+  return same_pod;
+}
+
+//! Supervises a started foreground session until a signal or an unreplaced forward exit. `pod_cache`, when set,
+//! re-pins restarted launches and forgets a pin once its pod connection was lost or a restart on it failed. A SIGTERM
+//! that came with a drain request drains `local_proxy` before the forwards are stopped. `shared_kubeconfig`, when set,
+//! refreshes the credentials kubectl reads before a forward is restarted. Works on its own copy of `launches`: the
+//! launches of ejected load-balanced pods move to other ready endpoints of their service.
+int RunForegroundSession(const std::filesystem::path& state_path, kubeforward::runtime::ManagedSession& session,
+                         std::vector<PreparedForwardLaunch> launches, kubeforward::runtime::ProcessRunner& runner,
+                         kubeforward::runtime::ForwardOutputMonitor& output_monitor,
+                         kubeforward::runtime::PodResolutionCache* pod_cache,
+                         kubeforward::runtime::LocalForwardProxy* local_proxy,
+                         kubeforward::runtime::SharedKubeconfig* shared_kubeconfig) {
+  // Sleeps until a forward exits, kubectl prints something, a restart is due or a signal arrives instead of polling
+  // on a timer.
+  kubeforward::runtime::ProcessWatcher watcher;
   g_foreground_signal = 0;
+  g_foreground_wake_fd = watcher.wake_fd();
   ScopedSignalHandler sigint_handler(SIGINT);
   ScopedSignalHandler sigterm_handler(SIGTERM);
 
+  // Only advertised once SIGTERM is handled, so a `down` asking for a drain cannot kill this process outright.
+  session.supervisor_pid = ::getpid();
+  session.supervisor_fingerprint = kubeforward::runtime::ReadProcessFingerprint(session.supervisor_pid)
+                                       .value_or(kubeforward::runtime::ProcessFingerprint{});
+  std::string supervisor_error;
+  if (!kubeforward::runtime::UpdateState(
+          state_path,
+          [&](kubeforward::runtime::RuntimeState& state) {
+            for (auto& stored_session : state.sessions) {
+              if (stored_session.id == session.id) {
+                stored_session.supervisor_pid = session.supervisor_pid;
+                stored_session.supervisor_fingerprint = session.supervisor_fingerprint;
+              }
+            }
+          },
+          supervisor_error)) {
+    std::cerr << "up: failed to record the supervisor in runtime state '" << state_path.string()
+              << "'; down will not drain this session: " << supervisor_error << "\n";
+  }
+
   const size_t total_forwards = session.forwards.size();
-  const int poll_interval_ms = 100;
   std::vector<ForegroundExitEvent> exited_forwards;
   exited_forwards.reserve(total_forwards);
   std::set<int> exited_pids;
-  while (g_foreground_signal == 0) {
-    for (const auto& forward : session.forwards) {
-      if (exited_pids.count(forward.pid) != 0) {
+  std::vector<int> exit_candidates;
+  std::vector<ForegroundRestartState> restarts;
+  restarts.reserve(total_forwards);
+  const auto backoff_policy = RestartBackoffPolicyFromEnvironment();
+  for (const auto& forward : session.forwards) {
+    watcher.WatchProcess(forward.pid);
+    exit_candidates.push_back(forward.pid);
+    restarts.push_back(ForegroundRestartState{
+        .backoff = kubeforward::runtime::RestartBackoff(backoff_policy),
+        .started_at = std::chrono::steady_clock::now(),
+    });
+  }
+
+  // Forwards killed by a signal (e.g. by `down` or the user) are never replaced; kubectl exiting on its own after a
+  // pod rollout or a lost pod connection is.
+  const auto replaces = [&](size_t index) {
+    return index < launches.size() && launches[index].restart_policy == kubeforward::config::RestartPolicy::kReplace;
+  };
+  const auto schedule_restart = [&](size_t index, const std::string& reason) {
+    auto& restart = restarts[index];
+    const auto now = std::chrono::steady_clock::now();
+    restart.backoff.RecordUptime(std::chrono::duration_cast<std::chrono::milliseconds>(now - restart.started_at));
+    const auto delay = restart.backoff.NextDelay();
+    restart.restart_at = now + delay;
+    std::cerr << "up: foreground forward '" << session.forwards[index].forward_name << "' " << reason
+              << "; restarting in " << delay.count() << "ms\n";
+  };
+  const auto forget_pinned_pod = [&](size_t index) {
+    if (pod_cache != nullptr && index < launches.size() && launches[index].pod_lookup.has_value()) {
+      pod_cache->Invalidate(*launches[index].pod_lookup);
+    }
+  };
+  // A failing pod launch of a load-balanced forward is ejected instead of ending the session, as long as another pod
+  // of the forward is still served; the proxy routes around it once its port refuses connections.
+  std::vector<bool> ejected(total_forwards, false);
+  const auto ejectable = [&](size_t index) {
+    if (index >= launches.size() || !launches[index].load_balance.has_value()) {
+      return false;
+    }
+    for (size_t other = 0; other < launches.size() && other < total_forwards; ++other) {
+      if (other != index && !ejected[other] && launches[other].load_balance.has_value() &&
+          launches[other].forward_name == launches[index].forward_name) {
+        return true;
+      }
+    }
+    return false;
+  };
+  const auto eject = [&](size_t index, const std::string& reason) {
+    ejected[index] = true;
+    const auto& argv = session.forwards[index].argv;
+    std::cerr << "up: forward '" << session.forwards[index].forward_name << "' ejected "
+              << (argv.size() > kPortForwardTargetArg ? argv[kPortForwardTargetArg] : "a pod") << ", which " << reason
+              << "\n";
+    // Another ready endpoint of the service may take over its upstream ports; looked up once the backoff allows.
+    if (launches[index].balanced_service.has_value()) {
+      auto& restart = restarts[index];
+      const auto now = std::chrono::steady_clock::now();
+      restart.backoff.RecordUptime(std::chrono::duration_cast<std::chrono::milliseconds>(now - restart.started_at));
+      restart.restart_at = now + restart.backoff.NextDelay();
+    }
+  };
+  const auto find_forward = [&](int pid) {
+    for (size_t index = 0; index < session.forwards.size(); ++index) {
+      if (session.forwards[index].pid == pid && !restarts[index].restart_at.has_value() && !ejected[index]) {
+        return std::optional<size_t>(index);
+      }
+    }
+    return std::optional<size_t>();
+  };
+
+  // Output of running forwards that arrived while a restarted forward was waited on.
+  std::vector<kubeforward::runtime::ForwardOutputEvent> deferred_output;
+  bool abandoned = false;
+  while (g_foreground_signal == 0 && !abandoned) {
+    for (const int pid : exit_candidates) {
+      const auto index = find_forward(pid);
+      if (!index.has_value() || exited_pids.count(pid) != 0) {
         continue;
       }
       int status = 0;
-      const pid_t wait_result = ::waitpid(forward.pid, &status, WNOHANG);
-      if (wait_result == forward.pid) {
-        exited_pids.insert(forward.pid);
-        exited_forwards.push_back(ForegroundExitEvent{
-            .pid = forward.pid,
-            .status = status,
-            .forward_name = forward.forward_name,
-        });
+      const pid_t wait_result = ::waitpid(pid, &status, WNOHANG);
+      if (wait_result != pid) {
+        continue;
+      }
+      exited_pids.insert(pid);
+      if (replaces(*index) && !WIFSIGNALED(status)) {
+        schedule_restart(*index, "exited with " + DescribeWaitStatus(status));
+        continue;
+      }
+      if (ejectable(*index)) {
+        eject(*index, "exited with " + DescribeWaitStatus(status));
+        continue;
       }
+      exited_forwards.push_back(ForegroundExitEvent{
+          .pid = pid,
+          .status = status,
+          .forward_name = session.forwards[*index].forward_name,
+      });
     }
     if (!exited_forwards.empty()) {
       break;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval_ms));
+
+    auto timeout = std::chrono::milliseconds(-1);
+    for (const auto& restart : restarts) {
+      if (!restart.restart_at.has_value()) {
+        continue;
+      }
+      const auto remaining = std::max(std::chrono::milliseconds(0),
+                                      std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          *restart.restart_at - std::chrono::steady_clock::now()));
+      timeout = timeout.count() < 0 ? remaining : std::min(timeout, remaining);
+    }
+    if (!deferred_output.empty()) {
+      timeout = std::chrono::milliseconds(0);
+    }
+    watcher.SetDescriptors(output_monitor.PipeDescriptors());
+    exit_candidates = watcher.Wait(timeout);
+    auto outputs = std::move(deferred_output);
+    deferred_output.clear();
+    for (auto& output : output_monitor.Wait(std::chrono::milliseconds(0))) {
+      outputs.push_back(std::move(output));
+    }
+    for (const auto& output : outputs) {
+      if (output.event.kind != kubeforward::runtime::KubectlOutputEventKind::kConnectionLost) {
+        continue;
+      }
+      const auto index = find_forward(output.pid);
+      if (!index.has_value() || exited_pids.count(output.pid) != 0) {
+        continue;
+      }
+      exited_pids.insert(output.pid);
+      forget_pinned_pod(*index);
+      if (replaces(*index)) {
+        std::string stop_error;
+        if (!runner.Stop(output.pid, stop_error)) {
+          std::cerr << "up: failed to stop pid " << output.pid << ": " << stop_error << "\n";
+        }
+        schedule_restart(*index, "lost its pod connection");
+        continue;
+      }
+      if (ejectable(*index)) {
+        std::string stop_error;
+        if (!runner.Stop(output.pid, stop_error)) {
+          std::cerr << "up: failed to stop pid " << output.pid << ": " << stop_error << "\n";
+        }
+        eject(*index, "lost its pod connection");
+        continue;
+      }
+      exited_forwards.push_back(ForegroundExitEvent{
+          .pid = output.pid,
+          .forward_name = session.forwards[*index].forward_name,
+          .failure = output.event.line,
+      });
+    }
+
+    for (size_t index = 0; index < restarts.size() && g_foreground_signal == 0 && !abandoned; ++index) {
+      auto& restart = restarts[index];
+      if (!restart.restart_at.has_value() || std::chrono::steady_clock::now() < *restart.restart_at) {
+        continue;
+      }
+      std::string restart_error;
+      if (ejected[index]) {
+        restart.restart_at.reset();
+        restart.started_at = std::chrono::steady_clock::now();
+        const auto relocated = RelocateBalancedLaunch(
+            launches, index, [&](size_t other) { return !ejected[other]; }, restart_error);
+        const auto outcome =
+            relocated.has_value() ? RestartForegroundForward(state_path, *relocated, session, index, runner,
+                                                             output_monitor, deferred_output, restart_error)
+                                  : ForwardRestartOutcome::kRetry;
+        if (outcome == ForwardRestartOutcome::kRestarted) {
+          launches[index] = *relocated;
+          ejected[index] = false;
+          // The restart closed and opened pipes, whose numbers the new pidfd or pipes may reuse.
+          watcher.SetDescriptors(output_monitor.PipeDescriptors());
+          watcher.WatchProcess(session.forwards[index].pid);
+          std::cout << "up: forward '" << session.forwards[index].forward_name << "' replaced its ejected pod with "
+                    << relocated->request.argv[kPortForwardTargetArg] << "\n";
+        } else if (outcome == ForwardRestartOutcome::kRetry) {
+          const auto delay = restart.backoff.NextDelay();
+          restart.restart_at = restart.started_at + delay;
+          std::cerr << "up: forward '" << session.forwards[index].forward_name << "' runs one pod short: "
+                    << restart_error << "; looking again in " << delay.count() << "ms\n";
+        } else if (outcome == ForwardRestartOutcome::kAbandon) {
+          std::cerr << "up: " << restart_error << "\n";
+          abandoned = true;
+        }
+        continue;
+      }
+      // An expired credential would only make kubectl fail again; a refresh failure leaves the last one in place.
+      if (shared_kubeconfig != nullptr && !shared_kubeconfig->Update(restart_error) && !restart_error.empty()) {
+        std::cerr << "up: failed to refresh the shared credentials: " << restart_error << "\n";
+        restart_error.clear();
+      }
+      const auto outcome = RestartForegroundForward(
+          state_path, pod_cache != nullptr ? PinLaunchTarget(launches[index], *pod_cache) : launches[index], session,
+          index, runner, output_monitor, deferred_output, restart_error);
+      restart.restart_at.reset();
+      restart.started_at = std::chrono::steady_clock::now();
+      switch (outcome) {
+        case ForwardRestartOutcome::kRestarted:
+          // The restart closed and opened pipes, whose numbers the new pidfd or pipes may reuse.
+          watcher.SetDescriptors(output_monitor.PipeDescriptors());
+          watcher.WatchProcess(session.forwards[index].pid);
+          std::cout << "up: restarted forward '" << session.forwards[index].forward_name << "' (restart "
+                    << session.forwards[index].restart_count << ")\n";
+          break;
+        case ForwardRestartOutcome::kRetry:
+          std::cerr << "up: " << restart_error << "\n";
+          forget_pinned_pod(index);
+          schedule_restart(index, "failed to restart");
+          break;
+        case ForwardRestartOutcome::kAbandon:
+          std::cerr << "up: " << restart_error << "\n";
+          abandoned = true;
+          break;
+        case ForwardRestartOutcome::kInterrupted:
+          break;
+      }
+    }
   }
 
-  StopStartedSession(session, runner);
+  g_foreground_wake_fd = -1;
+  if (g_foreground_signal == SIGTERM && local_proxy != nullptr) {
+    DrainForegroundProxy(state_path, session, *local_proxy);
+  }
 
-  auto cleaned_state = state_snapshot;
-  RemoveMatchingSessions(cleaned_state, session.config_path, session.environment);
+  // Flush whatever kubectl printed right before exiting so the terminal shows its last words.
+  (void)output_monitor.Wait(std::chrono::milliseconds(0));
+  StopStartedSession(session, runner);
 
   std::string save_error;
-  if (!kubeforward::runtime::SaveState(state_path, cleaned_state, save_error)) {
+  if (!kubeforward::runtime::UpdateState(
+          state_path,
+          [&](kubeforward::runtime::RuntimeState& state) {
+            RemoveMatchingSessions(state, session.config_path, session.environment);
+          },
+          save_error)) {
     std::cerr << "up: failed to save runtime state '" << state_path.string() << "': " << save_error << "\n";
     return 2;
   }
@@ -1190,8 +2542,22 @@ int RunForegroundSession(const std::filesystem::path& state_path, const kubeforw
   if (g_foreground_signal != 0) {
     return ExitCodeFromSignal(g_foreground_signal);
   }
+  if (abandoned) {
+    return 2;
+  }
 
-  if (exited_forwards.size() == total_forwards) {
+  for (const auto& exited_forward : exited_forwards) {
+    if (!exited_forward.failure.empty()) {
+      std::cerr << "up: foreground forward '" << exited_forward.forward_name << "' failed: " << exited_forward.failure
+                << "\n";
+      return 2;
+    }
+  }
+
+  // Ejected pods of load-balanced forwards are gone already and do not count as still running.
+  const auto supervised_forwards =
+      total_forwards - static_cast<size_t>(std::count(ejected.begin(), ejected.end(), true));
+  if (exited_forwards.size() == supervised_forwards) {
     bool all_succeeded = true;
     for (const auto& exited_forward : exited_forwards) {
       if (!WIFEXITED(exited_forward.status) || WEXITSTATUS(exited_forward.status) != 0) {
@@ -1205,7 +2571,7 @@ int RunForegroundSession(const std::filesystem::path& state_path, const kubeforw
   }
 
   const auto& first_exited_forward = exited_forwards.front();
-  if (exited_forwards.size() < total_forwards) {
+  if (exited_forwards.size() < supervised_forwards) {
     std::cerr << "up: foreground forward '" << first_exited_forward.forward_name
               << "' exited with " << DescribeWaitStatus(first_exited_forward.status)
               << " while other foreground forwards were still running\n";
@@ -1254,7 +2620,7 @@ int RunUpCommand(const std::vector<std::string>& args) {
     }
     return 2;
   }
-  const auto& resolved_env = plan_result.plan->environments.at(0);
+  auto resolved_env = plan_result.plan->environments.at(0);
   const auto normalized_config_path = NormalizePath(options.config_path);
   const auto state_path = kubeforward::runtime::DefaultStatePathForConfig(normalized_config_path);
   const auto state_load = kubeforward::runtime::LoadState(state_path);
@@ -1282,21 +2648,65 @@ int RunUpCommand(const std::vector<std::string>& args) {
     }
   }
 
+  // Exec credential plugins run once per user here instead of once per kubectl process: every kubectl of the session,
+  // including the lookups below, reads a kubeconfig that carries their credentials. A missing kubectl is reported by
+  // the preflight below.
+  std::string kubectl_error;
+  const bool kubectl_usable = !UseNoopRunner() && ValidateKubectlExecutable(resolved_env, kubectl_error);
+  std::optional<kubeforward::runtime::SharedKubeconfig> shared_kubeconfig;
+  if (kubectl_usable && UsesSharedCredentials(resolved_env)) {
+    std::set<std::string> contexts;
+    for (const auto& forward : resolved_env.forwards) {
+      contexts.insert(forward.context.value_or(""));
+    }
+    shared_kubeconfig.emplace(
+        resolved_env.settings.kubeconfig, std::move(contexts),
+        SharedKubeconfigPathForSession(normalized_config_path, resolved_env.name),
+        [](const std::vector<std::string>& argv, const kubeforward::runtime::CommandEnvironment& environment,
+           std::string& output, std::string& error) {
+          return kubeforward::runtime::RunCommandCapturingOutput(argv, environment, kExecPluginTimeout, output, error);
+        });
+    std::string credentials_error;
+    if (const auto path = shared_kubeconfig->Update(credentials_error)) {
+      resolved_env.settings.kubeconfig = path->string();
+    } else {
+      if (!credentials_error.empty()) {
+        std::cerr << "up: every kubectl runs its credential plugins itself: " << credentials_error << "\n";
+      }
+      shared_kubeconfig.reset();
+    }
+  }
+
+  // Load-balanced forwards need their services' endpoints before their launches can be laid out.
+  std::map<std::string, std::vector<kubeforward::runtime::ResolvedPod>> balanced_pods;
+  if (!options.daemon && kubectl_usable) {
+    balanced_pods = DiscoverBalancedPods(resolved_env);
+  }
+
   std::vector<PreparedForwardLaunch> launches;
   std::string launch_error;
-  if (!BuildPreparedLaunches(normalized_config_path, resolved_env, options.daemon, launches, launch_error)) {
+  if (!BuildPreparedLaunches(normalized_config_path, resolved_env, options.daemon, balanced_pods, launches,
+                             launch_error)) {
     std::cerr << "up: " << launch_error << "\n";
     return 2;
   }
 
   if (!UseNoopRunner()) {
     std::string preflight_error;
-    if (!kubeforward::runtime::CheckRuntimeSessionPortConflicts(state, normalized_config_path, resolved_env,
-                                                                preflight_error)) {
+    // Answered from the claim indexes of this state file and of every state file the shared registry points at, so
+    // sockets held by sessions of other config files are rejected here rather than by bind() halfway through.
+    const auto claims = kubeforward::runtime::LookupRegisteredPortClaims(
+        state_path, kubeforward::runtime::PortClaimKeys(resolved_env));
+    if (!claims.ok()) {
+      std::cerr << "up: preflight failed: " << claims.errors.front() << "\n";
+      return 2;
+    }
+    if (!kubeforward::runtime::CheckPortClaimConflicts(claims.claims, normalized_config_path, resolved_env,
+                                                       preflight_error)) {
       std::cerr << "up: preflight failed: " << preflight_error << "\n";
       return 2;
     }
-    if (!ValidateKubectlExecutable(preflight_error)) {
+    if (!ValidateKubectlExecutable(resolved_env, preflight_error)) {
       std::cerr << "up: preflight failed: " << preflight_error << "\n";
       return 2;
     }
@@ -1307,12 +2717,18 @@ int RunUpCommand(const std::vector<std::string>& args) {
   }
 
   if (!existing_sessions.empty()) {
-    bool replace_stop_failed = false;
+    std::vector<const kubeforward::runtime::ManagedSession*> replaced_sessions;
     for (const auto& existing_session : existing_sessions) {
-      StopSessionProcesses(existing_session, *runner, "up: failed to stop replaced pid ", replace_stop_failed,
-                           replaced_processes);
+      replaced_sessions.push_back(&existing_session);
+    }
+    // Foreground sessions being replaced are stopped by their own supervisors, whose proxies hold the local ports;
+    // they get to finish their in-flight connections first when a drain is configured.
+    if (!UseNoopRunner()) {
+      (void)DrainSessionSupervisors(state_path, replaced_sessions, DrainTimeoutFromEnvironment(), "up");
     }
-    if (replace_stop_failed) {
+    const auto replace_failures = StopSessionsProcesses(replaced_sessions, *runner, "up: failed to stop replaced pid ",
+                                                        "up: failed to stop replaced pid ", replaced_processes);
+    if (std::find(replace_failures.begin(), replace_failures.end(), true) != replace_failures.end()) {
       return 2;
     }
 
@@ -1332,10 +2748,38 @@ int RunUpCommand(const std::vector<std::string>& args) {
     }
   }
 
+  // Deployment, service and statefulset targets are resolved to a pod once and kubectl is pointed at `pod/NAME`;
+  // restarts reuse the pin until it expires or its pod fails.
+  std::optional<kubeforward::runtime::PodResolutionCache> pod_cache;
+  const auto pod_cache_ttl = PodCacheTtlFromEnvironment();
+  if (!options.daemon && !UseNoopRunner() && pod_cache_ttl.count() > 0) {
+    // Resolving is part of starting up, so it shares the startup budget.
+    pod_cache.emplace(pod_cache_ttl, [](const kubeforward::runtime::PodLookupKey& key, std::string& error) {
+      return kubeforward::runtime::LookupPodWithKubectl(KubectlBinary(), key,
+                                                        std::chrono::milliseconds(StartupTimeoutMs()), error);
+    });
+    for (auto& launch : launches) {
+      launch = PinLaunchTarget(launch, *pod_cache);
+    }
+  }
+
+  // The proxy takes the local ports before kubectl starts so they keep accepting across kubectl restarts; it lives
+  // as long as this (foreground) command.
+  kubeforward::runtime::LocalForwardProxy local_proxy(std::chrono::milliseconds(10000),
+                                                      kubeforward::runtime::StreamRelayMode::kAuto,
+                                                      EventBackendFromEnvironment());
   kubeforward::runtime::ManagedSession session;
+  kubeforward::runtime::ForwardOutputMonitor output_monitor;
+  kubeforward::runtime::UdpForwardRelay udp_relay(std::chrono::milliseconds(60000), EventBackendFromEnvironment());
   std::string start_error;
-  if (!StartManagedSession(normalized_config_path, resolved_env, options.daemon, launches, *runner, session,
-                           start_error)) {
+  const auto proxy_routes = LocalProxyRoutes(launches, kubeforward::config::PortProtocol::kTcp);
+  const auto udp_routes = LocalProxyRoutes(launches, kubeforward::config::PortProtocol::kUdp);
+  if ((!proxy_routes.empty() && !local_proxy.Start(proxy_routes, start_error)) ||
+      (!udp_routes.empty() && !udp_relay.Start(udp_routes, start_error)) ||
+      !StartManagedSession(normalized_config_path, resolved_env, options.daemon, launches, *runner, output_monitor,
+                           session, start_error)) {
+    local_proxy.Stop();
+    udp_relay.Stop();
     if (existing_sessions.empty()) {
       std::cerr << "up: " << start_error << "\n";
       return 2;
@@ -1385,13 +2829,28 @@ int RunUpCommand(const std::vector<std::string>& args) {
   if (options.verbose) {
     std::cout << "  state: " << state_path.string() << "\n";
     std::cout << "  kubectl: " << KubectlBinary() << "\n";
+    if (shared_kubeconfig.has_value()) {
+      std::cout << "  credentials: " << *resolved_env.settings.kubeconfig << "\n";
+    }
     std::cout << "  replaced: " << replaced_processes << "\n";
     std::cout << "  logs: " << DefaultLogsDirectoryForConfig(normalized_config_path).string() << "\n";
     PrintForwardNames(resolved_env, "  ");
   }
 
   if (!options.daemon && !UseNoopRunner()) {
-    return RunForegroundSession(state_path, next_state, session, *runner);
+    const int exit_code = RunForegroundSession(state_path, session, launches, *runner, output_monitor,
+                                               pod_cache.has_value() ? &*pod_cache : nullptr, &local_proxy,
+                                               shared_kubeconfig.has_value() ? &*shared_kubeconfig : nullptr);
+    if (shared_kubeconfig.has_value()) {
+      RemoveSharedKubeconfig(state_path, normalized_config_path, resolved_env.name);
+    }
+    local_proxy.Stop();
+    udp_relay.Stop();
+    auto traffic = local_proxy.Stats();
+    const auto udp_traffic = udp_relay.Stats();
+    traffic.insert(traffic.end(), udp_traffic.begin(), udp_traffic.end());
+    PrintLocalProxyTraffic(traffic);
+    return exit_code;
   }
 
   return 0;
@@ -1408,7 +2867,10 @@ int RunDownCommand(const std::vector<std::string>& args) {
 
   const auto normalized_config_path = NormalizePath(options.config_path);
   const auto state_path = kubeforward::runtime::DefaultStatePathForConfig(normalized_config_path);
-  const auto state_load = kubeforward::runtime::LoadState(state_path);
+  // Only the sessions of this config (and environment) are decoded; the others are left to the state store.
+  const kubeforward::runtime::SessionQuery query{.config_path = normalized_config_path,
+                                                 .environment = options.env_filter};
+  const auto state_load = kubeforward::runtime::LoadSessions(state_path, query);
   if (!state_load.ok()) {
     std::cerr << "down: failed to load runtime state '" << state_path.string() << "'.\n";
     for (const auto& error : state_load.errors) {
@@ -1417,7 +2879,7 @@ int RunDownCommand(const std::vector<std::string>& args) {
     return 2;
   }
   kubeforward::runtime::RuntimeState state = state_load.state;
-  const auto matched_sessions = MatchingSessions(state, normalized_config_path, options.env_filter);
+  auto matched_sessions = MatchingSessions(state, normalized_config_path, options.env_filter);
   const size_t matched_session_count = matched_sessions.size();
   size_t matched_forwards = 0;
   std::set<std::string> matched_environments;
@@ -1429,45 +2891,60 @@ int RunDownCommand(const std::vector<std::string>& args) {
     matched_environment_forward_counts[session->environment] += forward_count;
   }
 
+  // Drained supervisors stop their own forwards and clear their sessions; only what is left is stopped below.
+  const auto drain_timeout = DrainTimeoutFromEnvironment();
+  if (drain_timeout.count() > 0 && !UseNoopRunner() &&
+      DrainSessionSupervisors(state_path, matched_sessions, drain_timeout, "down")) {
+    const auto reload = kubeforward::runtime::LoadSessions(state_path, query);
+    if (!reload.ok()) {
+      std::cerr << "down: failed to reload runtime state '" << state_path.string() << "'.\n";
+      for (const auto& error : reload.errors) {
+        std::cerr << "  - " << error << "\n";
+      }
+      return 2;
+    }
+    state = reload.state;
+    matched_sessions = MatchingSessions(state, normalized_config_path, options.env_filter);
+  }
+
   auto runner = MakeProcessRunner();
   int stopped_processes = 0;
   bool stop_failed = false;
 
-  auto stop_session = [&](const kubeforward::runtime::ManagedSession& session) -> bool {
-    if (session.config_path != normalized_config_path) {
-      return false;
-    }
-    if (!options.env_filter.empty() && session.environment != options.env_filter) {
-      return false;
-    }
-    bool session_failed = false;
-    for (const auto& process : session.forwards) {
-      std::string identity_error;
-      if (!ShouldSignalManagedProcess(process, identity_error)) {
-        std::cerr << "down: skipped pid " << process.pid << ": " << identity_error << "\n";
-        stop_failed = true;
-        session_failed = true;
-        continue;
-      }
-      std::string stop_error;
-      if (!runner->Stop(process.pid, stop_error)) {
-        std::cerr << "down: failed to stop pid " << process.pid << ": " << stop_error << "\n";
-        stop_failed = true;
-        session_failed = true;
-      } else {
-        ++stopped_processes;
-      }
+  // Every matched session is stopped in one batch so stuck tunnels share a single grace period.
+  const auto session_failed = StopSessionsProcesses(matched_sessions, *runner, "down: skipped pid ",
+                                                    "down: failed to stop pid ", stopped_processes);
+  std::set<const kubeforward::runtime::ManagedSession*> stopped_sessions;
+  for (size_t i = 0; i < matched_sessions.size(); ++i) {
+    if (session_failed[i]) {
+      stop_failed = true;
+    } else {
+      stopped_sessions.insert(matched_sessions[i]);
     }
-    return !session_failed;
-  };
-
-  state.sessions.erase(std::remove_if(state.sessions.begin(), state.sessions.end(), stop_session), state.sessions.end());
+  }
 
+  std::set<std::string> stopped_ids;
+  for (const auto* session : stopped_sessions) {
+    stopped_ids.insert(session->id);
+  }
   std::string save_error;
-  if (!kubeforward::runtime::SaveState(state_path, state, save_error)) {
+  if (!kubeforward::runtime::UpdateState(
+          state_path,
+          [&](kubeforward::runtime::RuntimeState& current) {
+            auto& sessions = current.sessions;
+            sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                          [&](const kubeforward::runtime::ManagedSession& session) {
+                                            return stopped_ids.count(session.id) != 0;
+                                          }),
+                           sessions.end());
+          },
+          save_error)) {
     std::cerr << "down: failed to save runtime state '" << state_path.string() << "': " << save_error << "\n";
     return 2;
   }
+  for (const auto& env_name : matched_environments) {
+    RemoveSharedKubeconfig(state_path, normalized_config_path, env_name);
+  }
 
   if (stop_failed) {
     return 2;
@@ -1579,6 +3056,137 @@ int RunPlanCommand(const std::vector<std::string>& args) {
   return 0;
 }
 
+//! Whether the process recorded for `process` still runs; a reused pid does not count.
+bool ForwardProcessRunning(const kubeforward::runtime::ManagedForwardProcess& process) {
+  if (process.pid <= 0 || (::kill(process.pid, 0) != 0 && errno != EPERM)) {
+    return false;
+  }
+  return process.fingerprint.empty() ||
+         kubeforward::runtime::CompareProcessFingerprint(process.pid, process.fingerprint) !=
+             kubeforward::runtime::FingerprintMatch::kMismatch;
+}
+
+//! status reads the runtime state without the state lock, so prompts polling it never wait behind up or down.
+int RunStatusCommand(const std::vector<std::string>& args) {
+  CommandOptions options;
+  int parse_exit_code = 0;
+  if (!ParseCommandOptions(args, "status", "Show the port-forwards running for one or all environments.", options,
+                           parse_exit_code)) {
+    return parse_exit_code;
+  }
+
+  const auto normalized_config_path = NormalizePath(options.config_path);
+  const auto state_path = kubeforward::runtime::DefaultStatePathForConfig(normalized_config_path);
+  const auto state_load = kubeforward::runtime::LoadSessionsWithoutLock(
+      state_path, {.config_path = normalized_config_path, .environment = options.env_filter});
+  if (!state_load.ok()) {
+    std::cerr << "status: failed to load runtime state '" << state_path.string() << "'.\n";
+    for (const auto& error : state_load.errors) {
+      std::cerr << "  - " << error << "\n";
+    }
+    return 2;
+  }
+
+  const auto& sessions = state_load.state.sessions;
+  std::cout << "status: " << sessions.size() << " session(s)\n";
+  if (options.verbose) {
+    std::cout << "  state: " << state_path.string() << "\n";
+  }
+  for (const auto& session : sessions) {
+    size_t running = 0;
+    for (const auto& process : session.forwards) {
+      running += ForwardProcessRunning(process) ? 1 : 0;
+    }
+    std::cout << "  - " << session.environment << ": " << running << "/" << CountSessionForwards(session)
+              << " forward(s) running (" << RunMode(session.daemon) << ")\n";
+    if (!options.verbose) {
+      continue;
+    }
+    for (const auto& process : session.forwards) {
+      std::cout << "      " << process.forward_name << " " << process.bind_address << ":" << process.local_port
+                << " pid " << process.pid << (ForwardProcessRunning(process) ? " running" : " stopped") << "\n";
+    }
+  }
+  return 0;
+}
+
+//! Parses a whole decimal port number (1-65535); std::nullopt for anything else, including trailing characters.
+std::optional<int> ParsePortNumber(const std::string& text) {
+  char* end = nullptr;
+  errno = 0;
+  const long parsed = std::strtol(text.c_str(), &end, 10);
+  if (errno != 0 || end == text.c_str() || *end != '\0' || parsed < 1 || parsed > 65535) {
+    return std::nullopt;
+  }
+  return static_cast<int>(parsed);
+}
+
+//! Hidden `native-port-forward` entry point: the tunnel process launched for forwards using the native engine.
+int RunNativePortForwardCommand(const std::vector<std::string>& args) {
+  std::string target;
+  std::vector<std::string> port_specs;
+  kubeforward::runtime::NativePortForwardOptions forward_options;
+
+  cxxopts::Options options(args.front(), "Serve pod ports through the API server without kubectl.");
+  options.add_options()
+      ("n,namespace", "Pod namespace", cxxopts::value<std::string>(forward_options.namespace_name))
+      ("api-server", "Plain-HTTP API server URL", cxxopts::value<std::string>(forward_options.api_server))
+      ("address", "Local bind address",
+          cxxopts::value<std::string>(forward_options.bind_address)->default_value("127.0.0.1"))
+      ("target", "pod/NAME", cxxopts::value<std::string>(target))
+      ("ports", "LOCAL:REMOTE mappings", cxxopts::value<std::vector<std::string>>(port_specs));
+
+  const auto c_args = ToCArgs(args);
+  const int argc = static_cast<int>(c_args.size());
+  char** argv = const_cast<char**>(c_args.data());
+
+  try {
+    options.parse_positional({"target", "ports"});
+    options.parse(argc, argv);
+  } catch (const cxxopts::exceptions::exception& e) {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  constexpr std::string_view kPodPrefix = "pod/";
+  if (target.rfind(kPodPrefix, 0) != 0 || target.size() == kPodPrefix.size()) {
+    std::cerr << "error: native port-forward only supports pod/NAME targets, got '" << target << "'\n";
+    return 1;
+  }
+  forward_options.pod = target.substr(kPodPrefix.size());
+  for (const auto& spec : port_specs) {
+    const auto colon = spec.find(':');
+    const auto local_port = ParsePortNumber(spec.substr(0, colon));
+    const auto remote_port = ParsePortNumber(colon == std::string::npos ? spec : spec.substr(colon + 1));
+    if (!local_port.has_value() || !remote_port.has_value()) {
+      std::cerr << "error: invalid port mapping '" << spec << "'\n";
+      return 2;
+    }
+    forward_options.ports.push_back(
+        kubeforward::runtime::NativePortForwardPort{.local_port = *local_port, .remote_port = *remote_port});
+  }
+
+  kubeforward::runtime::NativePortForwarder forwarder;
+  std::string error;
+  g_foreground_signal = 0;
+  ScopedSignalHandler sigint_handler(SIGINT);
+  ScopedSignalHandler sigterm_handler(SIGTERM);
+  if (!forwarder.Start(forward_options, error)) {
+    std::cerr << "error: " << error << "\n";
+    return 1;
+  }
+  for (const auto& port : forward_options.ports) {
+    std::cout << "Forwarding from " << forward_options.bind_address << ":" << port.local_port << " -> "
+              << port.remote_port << std::endl;
+  }
+
+  while (g_foreground_signal == 0 && !forwarder.lost()) {
+    ::usleep(100 * 1000);
+  }
+  forwarder.Stop();
+  return forwarder.lost() ? 1 : 0;
+}
+
 }  // namespace
 
 namespace kubeforward {
@@ -1621,6 +3229,16 @@ int run_cli(const std::vector<std::string>& args) {
     return RunDownCommand(sub_args);
   }
 
+  if (command == "status") {
+    auto sub_args = BuildSubcommandArgs(args, 2, "status");
+    return RunStatusCommand(sub_args);
+  }
+
+  if (command == "native-port-forward") {
+    auto sub_args = BuildSubcommandArgs(args, 2, "native-port-forward");
+    return RunNativePortForwardCommand(sub_args);
+  }
+
   if (!command.empty() && command[0] == '-') {
     auto sub_args = BuildSubcommandArgs(args, 1, "plan");
     return RunPlanCommand(sub_args);
@@ -201,6 +201,18 @@ PortProtocol ParseProtocol(const std::string& value, const std::string& context,
   return PortProtocol::kTcp;
 }
 
+PortForwardEngine ParsePortForwardEngine(const std::string& value, const std::string& context,
+                                         std::vector<ConfigLoadError>& errors) {
+  if (value.empty() || value == "kubectl") {
+    return PortForwardEngine::kKubectl;
+  }
+  if (value == "native") {
+    return PortForwardEngine::kNative;
+  }
+  AddError(errors, context, "invalid portForwardEngine '" + value + "' (expected kubectl or native)");
+  return PortForwardEngine::kKubectl;
+}
+
 RestartPolicy ParseRestartPolicy(const std::string& value, const std::string& context,
                                  std::vector<ConfigLoadError>& errors) {
   if (value.empty() || value == "fail-fast") {
@@ -213,6 +225,18 @@ RestartPolicy ParseRestartPolicy(const std::string& value, const std::string& co
   return RestartPolicy::kFailFast;
 }
 
+LoadBalanceStrategy ParseLoadBalanceStrategy(const std::string& value, const std::string& context,
+                                             std::vector<ConfigLoadError>& errors) {
+  if (value.empty() || value == "roundRobin") {
+    return LoadBalanceStrategy::kRoundRobin;
+  }
+  if (value == "leastConnections") {
+    return LoadBalanceStrategy::kLeastConnections;
+  }
+  AddError(errors, context, "invalid strategy '" + value + "' (expected roundRobin or leastConnections)");
+  return LoadBalanceStrategy::kRoundRobin;
+}
+
 void ParseHealthCheck(const YAML::Node& node, const std::string& context, std::optional<HealthCheck>& out,
                       std::vector<ConfigLoadError>& errors) {
   if (!node) {
@@ -280,7 +304,9 @@ TargetDefaults ParseTargetDefaults(const YAML::Node& node, const std::string& co
   if (enforce_key_whitelist) {
     EnsureAllowedKeys(
         node, context,
-        MakeSet(std::vector<std::string>{"kubeconfig", "context", "namespace", "bindAddress", "labels"}), errors);
+        MakeSet(std::vector<std::string>{"kubeconfig", "context", "namespace", "bindAddress", "portForwardEngine",
+                                         "apiServer", "labels"}),
+        errors);
   }
 
   if (const auto kube = ReadOptionalString(node["kubeconfig"], context + ".kubeconfig", errors)) {
@@ -299,6 +325,12 @@ TargetDefaults ParseTargetDefaults(const YAML::Node& node, const std::string& co
       defaults.bind_address = bind;
     }
   }
+  if (const auto engine = ReadOptionalString(node["portForwardEngine"], context + ".portForwardEngine", errors)) {
+    defaults.port_forward_engine = ParsePortForwardEngine(*engine, context + ".portForwardEngine", errors);
+  }
+  if (const auto api_server = ReadOptionalString(node["apiServer"], context + ".apiServer", errors)) {
+    defaults.api_server = api_server;
+  }
   defaults.labels = ParseStringMap(node["labels"], context + ".labels", errors);
   return defaults;
 }
@@ -393,6 +425,74 @@ PortMapping ParsePortMapping(const YAML::Node& node, const std::string& context,
   return mapping;
 }
 
+void ParseWarmPool(const YAML::Node& node, const std::string& context, std::optional<WarmPool>& out,
+                   std::vector<ConfigLoadError>& errors) {
+  if (!node) {
+    out.reset();
+    return;
+  }
+  if (!node.IsMap()) {
+    AddError(errors, context, "expected mapping for warmPool");
+    out.reset();
+    return;
+  }
+
+  EnsureAllowedKeys(node, context, MakeSet(std::vector<std::string>{"size", "refillPerSecond"}), errors);
+
+  WarmPool pool;
+  if (const auto size = ReadOptionalInt(node["size"], context + ".size", errors)) {
+    if (*size < 1 || *size > 64) {
+      AddError(errors, context + ".size", "must be between 1 and 64");
+    } else {
+      pool.size = *size;
+    }
+  } else {
+    AddError(errors, context + ".size", "warmPool requires a size");
+  }
+  if (const auto refill = ReadOptionalInt(node["refillPerSecond"], context + ".refillPerSecond", errors)) {
+    if (*refill < 1 || *refill > 1000) {
+      AddError(errors, context + ".refillPerSecond", "must be between 1 and 1000");
+    } else {
+      pool.refill_per_second = *refill;
+    }
+  }
+  if (pool.size > 0) {
+    out = pool;
+  }
+}
+
+void ParseLoadBalance(const YAML::Node& node, const std::string& context, std::optional<LoadBalance>& out,
+                      std::vector<ConfigLoadError>& errors) {
+  if (!node) {
+    out.reset();
+    return;
+  }
+  if (!node.IsMap()) {
+    AddError(errors, context, "expected mapping for loadBalance");
+    out.reset();
+    return;
+  }
+
+  EnsureAllowedKeys(node, context, MakeSet(std::vector<std::string>{"replicas", "strategy"}), errors);
+
+  LoadBalance balance;
+  if (const auto replicas = ReadOptionalInt(node["replicas"], context + ".replicas", errors)) {
+    if (*replicas < 1 || *replicas > 32) {
+      AddError(errors, context + ".replicas", "must be between 1 and 32");
+    } else {
+      balance.replicas = *replicas;
+    }
+  } else {
+    AddError(errors, context + ".replicas", "loadBalance requires replicas");
+  }
+  if (const auto strategy = ReadOptionalString(node["strategy"], context + ".strategy", errors)) {
+    balance.strategy = ParseLoadBalanceStrategy(*strategy, context + ".strategy", errors);
+  }
+  if (balance.replicas > 0) {
+    out = balance;
+  }
+}
+
 void ParseForwardAnnotations(const YAML::Node& node, const std::string& context, ForwardDefinition& forward,
                              std::vector<ConfigLoadError>& errors) {
   if (!node) {
@@ -409,6 +509,8 @@ void ParseForwardAnnotations(const YAML::Node& node, const std::string& context,
     forward.restart_policy = ParseRestartPolicy(*restart, context + ".restartPolicy", errors);
   }
   ParseHealthCheck(node["healthCheck"], context + ".healthCheck", forward.health_check, errors);
+  ParseWarmPool(node["warmPool"], context + ".warmPool", forward.warm_pool, errors);
+  ParseLoadBalance(node["loadBalance"], context + ".loadBalance", forward.load_balance, errors);
 }
 
 ForwardDefinition ParseForward(const YAML::Node& node, const std::string& context,
@@ -438,6 +540,10 @@ ForwardDefinition ParseForward(const YAML::Node& node, const std::string& contex
     }
   }
   ParseForwardAnnotations(node["annotations"], context + ".annotations", forward, errors);
+  if (forward.load_balance.has_value() && forward.resource.kind != ResourceKind::kService) {
+    // Only services have an endpoint list to spread over.
+    AddError(errors, context + ".annotations.loadBalance", "requires resource.kind service");
+  }
   forward.env = ParseStringMap(node["env"], context + ".env", errors);
 
   // Capture passthrough annotations for unknown consumers.
@@ -447,7 +553,8 @@ ForwardDefinition ParseForward(const YAML::Node& node, const std::string& contex
         continue;
       }
       const std::string key = entry.first.as<std::string>();
-      if (key == "detach" || key == "restartPolicy" || key == "healthCheck") {
+      if (key == "detach" || key == "restartPolicy" || key == "healthCheck" || key == "warmPool" ||
+          key == "loadBalance") {
         continue;
       }
       forward.annotations[key] = YAML::Dump(entry.second);
@@ -468,7 +575,8 @@ EnvironmentDefinition ParseEnvironment(const std::string& name, const YAML::Node
   }
   EnsureAllowedKeys(node, context,
                     MakeSet(std::vector<std::string>{"extends", "description", "kubeconfig", "context", "namespace",
-                                                     "bindAddress", "labels", "guards", "forwards"}),
+                                                     "bindAddress", "portForwardEngine", "apiServer", "labels",
+                                                     "guards", "forwards"}),
                     errors);
   if (const auto extends = ReadOptionalString(node["extends"], context + ".extends", errors)) {
     env.extends = extends;
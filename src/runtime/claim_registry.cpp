@@ -0,0 +1,358 @@
+#include "kubeforward/runtime/claim_registry.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+// Registry layout (all integers little-endian):
+//   header   "KFCLAIM\0", u32 format version, u32 entry count, u32 path count, u32 reserved
+//   entries  one per registered claim, sorted by hash: u64 PortClaimHash, u32 path index, u32 reserved
+//   paths    one per state file: u32 offset, u32 length of its absolute path, stored after the path table
+//
+// A lookup binary-searches the entries and reads only the paths of the matches.
+constexpr char kRegistryMagic[8] = {'K', 'F', 'C', 'L', 'A', 'I', 'M', '\0'};
+constexpr std::uint32_t kRegistryFormatVersion = 1;
+constexpr size_t kRegistryHeaderSize = 24;
+constexpr size_t kRegistryEntrySize = 16;
+constexpr size_t kRegistryPathEntrySize = 8;
+
+void PutU32(std::string& out, std::uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out.push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+void PutU64(std::string& out, std::uint64_t value) {
+  for (int shift = 0; shift < 64; shift += 8) {
+    out.push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+std::uint64_t GetLittleEndian(const char* data, size_t width) {
+  std::uint64_t value = 0;
+  for (size_t i = 0; i < width; ++i) {
+    value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+//! A validated, mapped registry file; empty when the file is missing, empty or not a registry.
+class RegistryView {
+ public:
+  RegistryView() = default;
+  RegistryView(const RegistryView&) = delete;
+  RegistryView& operator=(const RegistryView&) = delete;
+  ~RegistryView() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  //! Maps and validates `path`. Returns false with `error` set only when an existing file cannot be mapped; a file
+  //! in another format is treated as empty and replaced by the next registration.
+  bool Map(const std::filesystem::path& path, std::string& error) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return true;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < kRegistryHeaderSize) {
+      ::close(fd);
+      return true;
+    }
+    const auto size = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      error = "failed to map claim registry: " + std::string(std::strerror(errno));
+      return false;
+    }
+    data_ = static_cast<const char*>(mapping);
+    size_ = size;
+
+    const auto entry_count = GetLittleEndian(data_ + 12, 4);
+    const auto path_count = GetLittleEndian(data_ + 16, 4);
+    const auto tables_end =
+        kRegistryHeaderSize + entry_count * kRegistryEntrySize + path_count * kRegistryPathEntrySize;
+    if (std::memcmp(data_, kRegistryMagic, sizeof(kRegistryMagic)) != 0 ||
+        GetLittleEndian(data_ + 8, 4) != kRegistryFormatVersion || tables_end > size_) {
+      return true;
+    }
+    entry_count_ = static_cast<std::uint32_t>(entry_count);
+    path_count_ = static_cast<std::uint32_t>(path_count);
+    return true;
+  }
+
+  std::uint32_t entry_count() const { return entry_count_; }
+
+  std::uint64_t EntryHash(std::uint32_t index) const {
+    return GetLittleEndian(data_ + kRegistryHeaderSize + index * kRegistryEntrySize, 8);
+  }
+
+  std::uint32_t EntryPath(std::uint32_t index) const {
+    return static_cast<std::uint32_t>(GetLittleEndian(data_ + kRegistryHeaderSize + index * kRegistryEntrySize + 8, 4));
+  }
+
+  //! Path `index` of the path table; std::nullopt when it is out of bounds.
+  std::optional<std::string> Path(std::uint32_t index) const {
+    if (index >= path_count_) {
+      return std::nullopt;
+    }
+    const auto* entry =
+        data_ + kRegistryHeaderSize + entry_count_ * kRegistryEntrySize + index * kRegistryPathEntrySize;
+    const auto offset = GetLittleEndian(entry, 4);
+    const auto length = GetLittleEndian(entry + 4, 4);
+    if (offset > size_ || length > size_ - offset) {
+      return std::nullopt;
+    }
+    return std::string(data_ + offset, length);
+  }
+
+  //! First entry whose hash is not below `hash`.
+  std::uint32_t LowerBound(std::uint64_t hash) const {
+    std::uint32_t low = 0;
+    std::uint32_t high = entry_count_;
+    while (low < high) {
+      const auto middle = low + (high - low) / 2;
+      if (EntryHash(middle) < hash) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low;
+  }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  std::uint32_t entry_count_ = 0;
+  std::uint32_t path_count_ = 0;
+};
+
+std::string EncodeRegistry(const std::vector<std::pair<std::uint64_t, std::string>>& claims) {
+  std::vector<std::string> paths;
+  std::map<std::string, std::uint32_t> path_indexes;
+  for (const auto& [hash, path] : claims) {
+    if (path_indexes.emplace(path, static_cast<std::uint32_t>(paths.size())).second) {
+      paths.push_back(path);
+    }
+  }
+
+  std::string out(kRegistryMagic, sizeof(kRegistryMagic));
+  PutU32(out, kRegistryFormatVersion);
+  PutU32(out, static_cast<std::uint32_t>(claims.size()));
+  PutU32(out, static_cast<std::uint32_t>(paths.size()));
+  PutU32(out, 0);
+  for (const auto& [hash, path] : claims) {
+    PutU64(out, hash);
+    PutU32(out, path_indexes.at(path));
+    PutU32(out, 0);
+  }
+  auto offset = out.size() + paths.size() * kRegistryPathEntrySize;
+  for (const auto& path : paths) {
+    PutU32(out, static_cast<std::uint32_t>(offset));
+    PutU32(out, static_cast<std::uint32_t>(path.size()));
+    offset += path.size();
+  }
+  for (const auto& path : paths) {
+    out.append(path);
+  }
+  return out;
+}
+
+std::string RegistryPathString(const std::filesystem::path& state_path) {
+  std::error_code ec;
+  const auto absolute = std::filesystem::absolute(state_path, ec);
+  return (ec ? state_path : absolute).lexically_normal().string();
+}
+
+int LockRegistry(const std::filesystem::path& registry_path, int lock_mode, std::string& error) {
+  const auto lock_path = registry_path.string() + ".lock";
+  const int lock_fd = ::open(lock_path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+  if (lock_fd < 0) {
+    error = "failed to open claim registry lock file: " + std::string(std::strerror(errno));
+    return -1;
+  }
+  if (::flock(lock_fd, lock_mode) != 0) {
+    error = "failed to lock claim registry: " + std::string(std::strerror(errno));
+    ::close(lock_fd);
+    return -1;
+  }
+  return lock_fd;
+}
+
+bool WriteRegistry(const std::filesystem::path& registry_path, const std::string& contents, std::string& error) {
+  std::ostringstream temporary;
+  temporary << registry_path.string() << ".tmp." << ::getpid();
+  const auto temporary_path = temporary.str();
+  const int fd = ::open(temporary_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    error = "failed to write claim registry: " + std::string(std::strerror(errno));
+    return false;
+  }
+  size_t written = 0;
+  while (written < contents.size()) {
+    const ssize_t count = ::write(fd, contents.data() + written, contents.size() - written);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      error = "failed to write claim registry: " + std::string(std::strerror(errno));
+      ::close(fd);
+      ::unlink(temporary_path.c_str());
+      return false;
+    }
+    written += static_cast<size_t>(count);
+  }
+  ::close(fd);
+  if (::rename(temporary_path.c_str(), registry_path.c_str()) != 0) {
+    error = "failed to replace claim registry: " + std::string(std::strerror(errno));
+    ::unlink(temporary_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::filesystem::path ClaimRegistryPath() {
+  return std::filesystem::temp_directory_path() / "kubeforward" /
+         ("claims-" + std::to_string(::getuid()) + ".registry");
+}
+
+bool RegisterStateClaims(const std::filesystem::path& registry_path, const std::filesystem::path& state_path,
+                         const std::vector<PortClaimKey>& keys, std::string& error) {
+  std::error_code directory_ec;
+  std::filesystem::create_directories(registry_path.parent_path(), directory_ec);
+  const int lock_fd = LockRegistry(registry_path, LOCK_EX, error);
+  if (lock_fd < 0) {
+    return false;
+  }
+
+  const auto own_path = RegistryPathString(state_path);
+  std::set<std::uint64_t> wanted;
+  for (const auto& key : keys) {
+    wanted.insert(PortClaimHash(key));
+  }
+
+  RegistryView registry;
+  if (!registry.Map(registry_path, error)) {
+    ::close(lock_fd);
+    return false;
+  }
+  std::vector<std::pair<std::uint64_t, std::string>> claims;
+  std::set<std::uint64_t> registered;
+  std::map<std::uint32_t, std::optional<std::string>> live_paths;
+  bool pruned = false;
+  for (std::uint32_t i = 0; i < registry.entry_count(); ++i) {
+    const auto path_index = registry.EntryPath(i);
+    auto live = live_paths.find(path_index);
+    if (live == live_paths.end()) {
+      auto path = registry.Path(path_index);
+      std::error_code ec;
+      if (path.has_value() && *path != own_path && !std::filesystem::exists(*path, ec)) {
+        path.reset();
+      }
+      live = live_paths.emplace(path_index, std::move(path)).first;
+    }
+    if (!live->second.has_value()) {
+      pruned = true;
+    } else if (*live->second == own_path) {
+      registered.insert(registry.EntryHash(i));
+    } else {
+      claims.emplace_back(registry.EntryHash(i), *live->second);
+    }
+  }
+  if (!pruned && registered == wanted) {
+    ::close(lock_fd);
+    error.clear();
+    return true;
+  }
+
+  for (const auto hash : wanted) {
+    claims.emplace_back(hash, own_path);
+  }
+  std::sort(claims.begin(), claims.end());
+  const bool written = WriteRegistry(registry_path, EncodeRegistry(claims), error);
+  ::close(lock_fd);
+  if (written) {
+    error.clear();
+  }
+  return written;
+}
+
+ClaimRegistryLookup LookupClaimRegistry(const std::filesystem::path& registry_path,
+                                        const std::vector<PortClaimKey>& keys) {
+  ClaimRegistryLookup lookup;
+  std::error_code ec;
+  if (!std::filesystem::exists(registry_path, ec)) {
+    return lookup;
+  }
+  std::string error;
+  const int lock_fd = LockRegistry(registry_path, LOCK_SH, error);
+  if (lock_fd < 0) {
+    lookup.errors.push_back(error);
+    return lookup;
+  }
+
+  RegistryView registry;
+  if (!registry.Map(registry_path, error)) {
+    lookup.errors.push_back(error);
+    ::close(lock_fd);
+    return lookup;
+  }
+  std::set<std::uint32_t> path_indexes;
+  for (const auto& key : keys) {
+    const auto hash = PortClaimHash(key);
+    for (auto i = registry.LowerBound(hash); i < registry.entry_count() && registry.EntryHash(i) == hash; ++i) {
+      path_indexes.insert(registry.EntryPath(i));
+    }
+  }
+  for (const auto index : path_indexes) {
+    if (auto path = registry.Path(index)) {
+      lookup.state_paths.emplace_back(std::move(*path));
+    }
+  }
+  ::close(lock_fd);
+  return lookup;
+}
+
+PortClaimLookup LookupRegisteredPortClaims(const std::filesystem::path& state_path,
+                                           const std::vector<PortClaimKey>& keys) {
+  auto lookup = LookupPortClaims(state_path, keys);
+  if (!lookup.ok()) {
+    return lookup;
+  }
+  const auto registered = LookupClaimRegistry(ClaimRegistryPath(), keys);
+  const auto own_path = RegistryPathString(state_path);
+  for (const auto& path : registered.state_paths) {
+    std::error_code ec;
+    if (path == own_path || !std::filesystem::exists(path, ec)) {
+      continue;
+    }
+    auto other = LookupPortClaims(path, keys);
+    if (other.ok()) {
+      std::move(other.claims.begin(), other.claims.end(), std::back_inserter(lookup.claims));
+    }
+  }
+  return lookup;
+}
+
+}  // namespace kubeforward::runtime
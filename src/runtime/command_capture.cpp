@@ -0,0 +1,156 @@
+#include "kubeforward/runtime/command_capture.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace kubeforward::runtime {
+namespace {
+
+//! kubeforward's environment with `overrides` applied, as NAME=VALUE strings.
+std::vector<std::string> MergedEnvironment(const CommandEnvironment& overrides) {
+  std::vector<std::string> merged;
+  for (char** entry = environ; entry != nullptr && *entry != nullptr; ++entry) {
+    const std::string current(*entry);
+    const auto name = current.substr(0, current.find('='));
+    bool overridden = false;
+    for (const auto& [override_name, value] : overrides) {
+      overridden = overridden || override_name == name;
+    }
+    if (!overridden) {
+      merged.push_back(current);
+    }
+  }
+  for (const auto& [name, value] : overrides) {
+    merged.push_back(name + "=" + value);
+  }
+  return merged;
+}
+
+}  // namespace
+
+bool RunCommandCapturingOutput(const std::vector<std::string>& args, const CommandEnvironment& environment,
+                               std::chrono::milliseconds timeout, std::string& output, std::string& error) {
+  int out_pipe[2] = {-1, -1};
+  int err_pipe[2] = {-1, -1};
+  if (::pipe(out_pipe) != 0 || ::pipe(err_pipe) != 0) {
+    error = std::string("failed to create pipe: ") + std::strerror(errno);
+    for (const int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return false;
+  }
+
+  // Everything the child needs is built before fork(): other threads may hold allocator locks.
+  std::vector<char*> argv;
+  for (const auto& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  const auto merged_environment = MergedEnvironment(environment);
+  std::vector<char*> envp;
+  for (const auto& entry : merged_environment) {
+    envp.push_back(const_cast<char*>(entry.c_str()));
+  }
+  envp.push_back(nullptr);
+  const std::string exec_failure = "failed to execute " + args.front() + ": ";
+
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    error = std::string("failed to fork: ") + std::strerror(errno);
+    for (const int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]}) {
+      ::close(fd);
+    }
+    return false;
+  }
+  if (pid == 0) {
+    (void)::setpgid(0, 0);
+    ::dup2(out_pipe[1], STDOUT_FILENO);
+    ::dup2(err_pipe[1], STDERR_FILENO);
+    for (const int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]}) {
+      ::close(fd);
+    }
+    // execvp() searches PATH with the new environment in place, like execvpe() where it exists.
+    if (!environment.empty()) {
+      environ = envp.data();
+    }
+    ::execvp(argv[0], argv.data());
+    const char* reason = std::strerror(errno);
+    (void)::write(STDERR_FILENO, exec_failure.data(), exec_failure.size());
+    (void)::write(STDERR_FILENO, reason, std::strlen(reason));
+    (void)::write(STDERR_FILENO, "\n", 1);
+    ::_exit(127);
+  }
+  ::close(out_pipe[1]);
+  ::close(err_pipe[1]);
+
+  // Drain both pipes together so a chatty stderr cannot block the child while stdout is being read.
+  std::string stderr_output;
+  pollfd fds[2] = {{.fd = out_pipe[0], .events = POLLIN, .revents = 0},
+                   {.fd = err_pipe[0], .events = POLLIN, .revents = 0}};
+  std::string* sinks[2] = {&output, &stderr_output};
+  output.clear();
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  bool timed_out = false;
+  while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+    const auto remaining =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) {
+      timed_out = true;
+      break;
+    }
+    if (::poll(fds, 2, static_cast<int>(remaining.count())) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (size_t i = 0; i < 2; ++i) {
+      if (fds[i].fd < 0 || fds[i].revents == 0) {
+        continue;
+      }
+      char buffer[4096];
+      const ssize_t count = ::read(fds[i].fd, buffer, sizeof(buffer));
+      if (count > 0) {
+        sinks[i]->append(buffer, static_cast<size_t>(count));
+      } else if (count == 0 || errno != EINTR) {
+        ::close(fds[i].fd);
+        fds[i].fd = -1;
+      }
+    }
+  }
+  for (const auto& fd : fds) {
+    if (fd.fd >= 0) {
+      ::close(fd.fd);
+    }
+  }
+
+  if (timed_out) {
+    (void)::kill(-pid, SIGKILL);
+  }
+  int status = 0;
+  while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (timed_out) {
+    error = args.front() + " did not answer within " + std::to_string(timeout.count()) + "ms";
+    return false;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    while (!stderr_output.empty() && (stderr_output.back() == '\n' || stderr_output.back() == '\r')) {
+      stderr_output.pop_back();
+    }
+    error = stderr_output.empty() ? args.front() + " failed" : stderr_output;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace kubeforward::runtime
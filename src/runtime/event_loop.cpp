@@ -0,0 +1,489 @@
+#include "kubeforward/runtime/event_loop.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include <poll.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_FEAT_EXT_ARG) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define KF_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace kubeforward::runtime {
+namespace {
+
+unsigned EventsFromPollMask(unsigned mask) {
+  unsigned events = 0;
+  if ((mask & (POLLIN | POLLPRI)) != 0) {
+    events |= kEventReadable;
+  }
+  if ((mask & POLLOUT) != 0) {
+    events |= kEventWritable;
+  }
+  if ((mask & (POLLHUP | POLLERR | POLLNVAL)) != 0) {
+    events |= kEventHangup;
+  }
+  return events;
+}
+
+short PollMaskFromEvents(unsigned events) {
+  short mask = 0;
+  if ((events & kEventReadable) != 0) {
+    mask |= POLLIN;
+  }
+  if ((events & kEventWritable) != 0) {
+    mask |= POLLOUT;
+  }
+  return mask;
+}
+
+class PollEventLoop final : public EventLoop {
+ public:
+  bool Watch(int fd, unsigned events, std::string& error) override {
+    if (events == 0) {
+      interest_.erase(fd);
+    } else {
+      interest_[fd] = events;
+    }
+    error.clear();
+    return true;
+  }
+
+  void Forget(int fd) override { interest_.erase(fd); }
+
+  bool Wait(int timeout_ms, std::vector<ReadyEvent>& ready, std::string& error) override {
+    ready.clear();
+    poll_fds_.clear();
+    for (const auto& [fd, events] : interest_) {
+      poll_fds_.push_back(pollfd{.fd = fd, .events = PollMaskFromEvents(events), .revents = 0});
+    }
+    const int count = ::poll(poll_fds_.data(), static_cast<nfds_t>(poll_fds_.size()), timeout_ms);
+    if (count < 0) {
+      if (errno == EINTR) {
+        return true;
+      }
+      error = std::string("poll failed: ") + std::strerror(errno);
+      return false;
+    }
+    for (const auto& poll_fd : poll_fds_) {
+      if (poll_fd.revents != 0) {
+        ready.push_back(ReadyEvent{.fd = poll_fd.fd, .events = EventsFromPollMask(poll_fd.revents)});
+      }
+    }
+    return true;
+  }
+
+  EventLoopBackend backend() const override { return EventLoopBackend::kPoll; }
+
+ private:
+  std::unordered_map<int, unsigned> interest_;
+  std::vector<pollfd> poll_fds_;
+};
+
+#if defined(__linux__)
+class EpollEventLoop final : public EventLoop {
+ public:
+  static std::unique_ptr<EpollEventLoop> Create() {
+    const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+      return nullptr;
+    }
+    return std::unique_ptr<EpollEventLoop>(new EpollEventLoop(epoll_fd));
+  }
+
+  ~EpollEventLoop() override { ::close(epoll_fd_); }
+
+  bool Watch(int fd, unsigned events, std::string& error) override {
+    const auto existing = interest_.find(fd);
+    if (existing != interest_.end() && existing->second == events) {
+      return true;
+    }
+    // Descriptors without interest are removed outright: epoll would keep reporting EPOLLHUP for them.
+    if (events == 0) {
+      Forget(fd);
+      return true;
+    }
+    epoll_event event{};
+    event.events = (events & kEventReadable ? EPOLLIN : 0u) | (events & kEventWritable ? EPOLLOUT : 0u);
+    event.data.fd = fd;
+    const int op = existing == interest_.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (::epoll_ctl(epoll_fd_, op, fd, &event) != 0) {
+      error = std::string("epoll_ctl failed: ") + std::strerror(errno);
+      return false;
+    }
+    interest_[fd] = events;
+    return true;
+  }
+
+  void Forget(int fd) override {
+    if (interest_.erase(fd) != 0) {
+      (void)::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+  }
+
+  bool Wait(int timeout_ms, std::vector<ReadyEvent>& ready, std::string& error) override {
+    ready.clear();
+    epoll_event events[256];
+    const int count = ::epoll_wait(epoll_fd_, events, 256, timeout_ms);
+    if (count < 0) {
+      if (errno == EINTR) {
+        return true;
+      }
+      error = std::string("epoll_wait failed: ") + std::strerror(errno);
+      return false;
+    }
+    for (int i = 0; i < count; ++i) {
+      unsigned mask = 0;
+      mask |= (events[i].events & EPOLLIN) ? POLLIN : 0;
+      mask |= (events[i].events & EPOLLOUT) ? POLLOUT : 0;
+      mask |= (events[i].events & (EPOLLHUP | EPOLLERR)) ? POLLHUP : 0;
+      ready.push_back(ReadyEvent{.fd = events[i].data.fd, .events = EventsFromPollMask(mask)});
+    }
+    return true;
+  }
+
+  EventLoopBackend backend() const override { return EventLoopBackend::kEpoll; }
+
+ private:
+  explicit EpollEventLoop(int epoll_fd) : epoll_fd_(epoll_fd) {}
+
+  int epoll_fd_;
+  std::unordered_map<int, unsigned> interest_;
+};
+#endif
+
+#if defined(KF_HAVE_IO_URING)
+//! io_uring backend built on one-shot IORING_OP_POLL_ADD requests.
+//!
+//! A one-shot poll checks readiness when it is armed, so re-arming after every completion gives the same
+//! level-triggered behaviour as epoll. All re-arms and cancellations of one loop iteration are queued in the
+//! submission ring and handed to the kernel together with the wait in a single io_uring_enter call.
+class IoUringEventLoop final : public EventLoop {
+ public:
+  static std::unique_ptr<IoUringEventLoop> Create() {
+    io_uring_params params{};
+    const int ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (ring_fd < 0) {
+      return nullptr;
+    }
+    auto loop = std::unique_ptr<IoUringEventLoop>(new IoUringEventLoop(ring_fd));
+    if ((params.features & IORING_FEAT_EXT_ARG) == 0 || (params.features & IORING_FEAT_SINGLE_MMAP) == 0 ||
+        !loop->MapRings(params)) {
+      return nullptr;
+    }
+    return loop;
+  }
+
+  ~IoUringEventLoop() override {
+    if (sqes_ != MAP_FAILED) {
+      ::munmap(sqes_, sqes_size_);
+    }
+    if (ring_ != MAP_FAILED) {
+      ::munmap(ring_, ring_size_);
+    }
+    ::close(ring_fd_);
+  }
+
+  bool Watch(int fd, unsigned events, std::string& error) override {
+    error.clear();
+    if (events == 0) {
+      const auto entry = entries_.find(fd);
+      if (entry != entries_.end()) {
+        Disarm(entry->second);
+        entries_.erase(entry);
+      }
+      return true;
+    }
+    auto& entry = entries_[fd];
+    if (entry.interest == events) {
+      return true;
+    }
+    Disarm(entry);
+    entry.interest = events;
+    arm_queue_.push_back(fd);
+    return true;
+  }
+
+  void Forget(int fd) override {
+    const auto entry = entries_.find(fd);
+    if (entry == entries_.end()) {
+      return;
+    }
+    const bool armed = entry->second.armed_token != 0;
+    Disarm(entry->second);
+    entries_.erase(entry);
+    if (armed) {
+      // The armed poll pins the file; cancel it now so closing the descriptor really releases the socket.
+      (void)Enter(0, 0, nullptr);
+    }
+  }
+
+  bool Wait(int timeout_ms, std::vector<ReadyEvent>& ready, std::string& error) override {
+    ready.clear();
+    for (const ReadyEvent& event : flushed_ready_) {
+      if (entries_.count(event.fd) != 0) {
+        ready.push_back(event);
+      }
+    }
+    flushed_ready_.clear();
+    while (!cancel_queue_.empty()) {
+      if (!QueueCancel(cancel_queue_.back())) {
+        error = "io_uring submission queue is full";
+        return false;
+      }
+      cancel_queue_.pop_back();
+    }
+    for (const int fd : arm_queue_) {
+      const auto entry = entries_.find(fd);
+      if (entry == entries_.end() || entry->second.interest == 0 || entry->second.armed_token != 0) {
+        continue;
+      }
+      io_uring_sqe* sqe = NextSqe();
+      if (sqe == nullptr) {
+        error = "io_uring submission queue is full";
+        return false;
+      }
+      const uint64_t token = ++next_token_;
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = fd;
+      sqe->poll32_events = static_cast<uint32_t>(PollMaskFromEvents(entry->second.interest));
+      sqe->user_data = token;
+      tokens_[token] = fd;
+      entry->second.armed_token = token;
+    }
+    arm_queue_.clear();
+
+    __kernel_timespec timeout{};
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+    // Completions reaped while flushing a full ring are already waiting; do not block on top of them.
+    const bool poll_only = !ready.empty();
+    const int result = Enter(poll_only ? 0 : 1, poll_only ? 0 : IORING_ENTER_GETEVENTS,
+                             timeout_ms >= 0 ? &timeout : nullptr);
+    if (result < 0 && result != -ETIME && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+      error = std::string("io_uring_enter failed: ") + std::strerror(-result);
+      return false;
+    }
+    Reap(ready);
+    return true;
+  }
+
+  EventLoopBackend backend() const override { return EventLoopBackend::kIoUring; }
+
+ private:
+  static constexpr unsigned kRingEntries = 256;
+  //! user_data of POLL_REMOVE requests, whose completions carry no readiness.
+  static constexpr uint64_t kCancelToken = 0;
+
+  struct Entry {
+    unsigned interest = 0;
+    //! user_data of the armed poll request; 0 when nothing is armed.
+    uint64_t armed_token = 0;
+  };
+
+  explicit IoUringEventLoop(int ring_fd) : ring_fd_(ring_fd) {}
+
+  bool MapRings(const io_uring_params& params) {
+    const size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    const size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+    ring_ = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                   IORING_OFF_SQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+      return false;
+    }
+    auto* base = static_cast<char*>(ring_);
+    sq_head_ = reinterpret_cast<uint32_t*>(base + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_array_ = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+    cq_head_ = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    return true;
+  }
+
+  uint32_t PendingSubmissions() const { return *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE); }
+
+  //! Returns a zeroed submission slot, flushing the ring to the kernel first when it is full, or nullptr when the
+  //! kernel would not take the queued entries. A flush refused for a full completion ring reaps it into
+  //! `flushed_ready_` and tries once more.
+  io_uring_sqe* NextSqe() {
+    if (PendingSubmissions() >= sq_entries_) {
+      const int result = Enter(0, 0, nullptr);
+      if (result == -EBUSY || result == -EAGAIN) {
+        Reap(flushed_ready_);
+        (void)Enter(0, 0, nullptr);
+      }
+      if (PendingSubmissions() >= sq_entries_) {
+        return nullptr;
+      }
+    }
+    const uint32_t tail = *sq_tail_;
+    const uint32_t index = tail & sq_mask_;
+    auto* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+  }
+
+  void Disarm(Entry& entry) {
+    if (entry.armed_token == 0) {
+      return;
+    }
+    if (!QueueCancel(entry.armed_token)) {
+      // Retried by the next Wait, which fails instead of waiting when the ring still has no room.
+      cancel_queue_.push_back(entry.armed_token);
+    }
+    // A completion racing the cancellation finds no token and is dropped.
+    tokens_.erase(entry.armed_token);
+    entry.armed_token = 0;
+  }
+
+  bool QueueCancel(uint64_t token) {
+    io_uring_sqe* sqe = NextSqe();
+    if (sqe == nullptr) {
+      return false;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = token;
+    sqe->user_data = kCancelToken;
+    return true;
+  }
+
+  //! Submits everything queued and optionally waits for `min_complete` completions; returns -errno on failure.
+  int Enter(unsigned min_complete, unsigned flags, __kernel_timespec* timeout) {
+    io_uring_getevents_arg arg{};
+    arg.ts = reinterpret_cast<uint64_t>(timeout);
+    const long result = ::syscall(__NR_io_uring_enter, ring_fd_, PendingSubmissions(), min_complete,
+                                  flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    return result < 0 ? -errno : static_cast<int>(result);
+  }
+
+  void Reap(std::vector<ReadyEvent>& ready) {
+    uint32_t head = *cq_head_;
+    const uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      if (cqe.user_data == kCancelToken) {
+        continue;
+      }
+      const auto token = tokens_.find(cqe.user_data);
+      if (token == tokens_.end()) {
+        continue;
+      }
+      const int fd = token->second;
+      tokens_.erase(token);
+      const auto entry = entries_.find(fd);
+      if (entry == entries_.end() || entry->second.armed_token != cqe.user_data) {
+        continue;
+      }
+      entry->second.armed_token = 0;
+      arm_queue_.push_back(fd);
+      if (cqe.res > 0) {
+        ready.push_back(ReadyEvent{.fd = fd, .events = EventsFromPollMask(static_cast<unsigned>(cqe.res))});
+      } else if (cqe.res < 0 && cqe.res != -ECANCELED) {
+        ready.push_back(ReadyEvent{.fd = fd, .events = kEventHangup});
+      }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+  int ring_fd_;
+  void* ring_ = MAP_FAILED;
+  size_t ring_size_ = 0;
+  void* sqes_ = MAP_FAILED;
+  size_t sqes_size_ = 0;
+  uint32_t* sq_head_ = nullptr;
+  uint32_t* sq_tail_ = nullptr;
+  uint32_t sq_mask_ = 0;
+  uint32_t sq_entries_ = 0;
+  uint32_t* sq_array_ = nullptr;
+  uint32_t* cq_head_ = nullptr;
+  uint32_t* cq_tail_ = nullptr;
+  uint32_t cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  std::unordered_map<int, Entry> entries_;
+  std::unordered_map<uint64_t, int> tokens_;
+  //! Poll requests whose cancellation did not fit in the ring yet.
+  std::vector<uint64_t> cancel_queue_;
+  //! Readiness reaped while flushing a full ring, reported by the next Wait.
+  std::vector<ReadyEvent> flushed_ready_;
+  std::vector<int> arm_queue_;
+  uint64_t next_token_ = kCancelToken;
+};
+#endif
+
+}  // namespace
+
+const char* EventLoopBackendName(EventLoopBackend backend) {
+  switch (backend) {
+    case EventLoopBackend::kPoll:
+      return "poll";
+    case EventLoopBackend::kEpoll:
+      return "epoll";
+    case EventLoopBackend::kIoUring:
+      return "io_uring";
+  }
+  return "poll";
+}
+
+std::optional<EventLoopBackend> ParseEventLoopBackend(const std::string& value) {
+  if (value == "poll") {
+    return EventLoopBackend::kPoll;
+  }
+  if (value == "epoll") {
+    return EventLoopBackend::kEpoll;
+  }
+  if (value == "io_uring") {
+    return EventLoopBackend::kIoUring;
+  }
+  return std::nullopt;
+}
+
+EventLoopBackend PlatformEventLoopBackend() {
+#if defined(__linux__)
+  return EventLoopBackend::kEpoll;
+#else
+  return EventLoopBackend::kPoll;
+#endif
+}
+
+std::unique_ptr<EventLoop> CreateEventLoop(EventLoopBackend preferred) {
+#if defined(KF_HAVE_IO_URING)
+  if (preferred == EventLoopBackend::kIoUring) {
+    if (auto loop = IoUringEventLoop::Create()) {
+      return loop;
+    }
+    preferred = EventLoopBackend::kEpoll;
+  }
+#endif
+#if defined(__linux__)
+  if (preferred != EventLoopBackend::kPoll) {
+    if (auto loop = EpollEventLoop::Create()) {
+      return loop;
+    }
+  }
+#endif
+  return std::make_unique<PollEventLoop>();
+}
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,216 @@
+#include "kubeforward/runtime/kubectl_output.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+bool StartsWith(std::string_view value, std::string_view prefix) {
+  return value.size() >= prefix.size() && value.compare(0, prefix.size(), prefix) == 0;
+}
+
+//! Extracts LOCAL from "Forwarding from ADDR:LOCAL -> REMOTE" (ADDR may be a bracketed IPv6 literal).
+int ParseForwardingLocalPort(std::string_view line) {
+  constexpr std::string_view kPrefix = "Forwarding from ";
+  const auto arrow = line.find(" -> ", kPrefix.size());
+  if (arrow == std::string_view::npos) {
+    return 0;
+  }
+  const auto endpoint = line.substr(kPrefix.size(), arrow - kPrefix.size());
+  const auto colon = endpoint.rfind(':');
+  if (colon == std::string_view::npos || colon + 1 >= endpoint.size()) {
+    return 0;
+  }
+  const std::string port_text(endpoint.substr(colon + 1));
+  char* end = nullptr;
+  const long port = std::strtol(port_text.c_str(), &end, 10);
+  if (end == port_text.c_str() || *end != '\0' || port <= 0 || port > 65535) {
+    return 0;
+  }
+  return static_cast<int>(port);
+}
+
+std::optional<KubectlOutputEvent> ClassifyLine(std::string_view line) {
+  if (StartsWith(line, "Forwarding from ")) {
+    const int port = ParseForwardingLocalPort(line);
+    if (port > 0) {
+      return KubectlOutputEvent{.kind = KubectlOutputEventKind::kForwarding, .local_port = port, .line = std::string(line)};
+    }
+    return std::nullopt;
+  }
+  if (line.find("lost connection to pod") != std::string_view::npos) {
+    return KubectlOutputEvent{.kind = KubectlOutputEventKind::kConnectionLost, .line = std::string(line)};
+  }
+  if (StartsWith(line, "Unable to listen on") || StartsWith(line, "error: ") || StartsWith(line, "Error from server")) {
+    return KubectlOutputEvent{.kind = KubectlOutputEventKind::kError, .line = std::string(line)};
+  }
+  return std::nullopt;
+}
+
+}  // namespace
+
+std::vector<KubectlOutputEvent> KubectlOutputParser::Feed(std::string_view chunk) {
+  std::vector<KubectlOutputEvent> events;
+  partial_line_.append(chunk);
+
+  size_t line_start = 0;
+  while (true) {
+    const auto newline = partial_line_.find('\n', line_start);
+    if (newline == std::string::npos) {
+      break;
+    }
+    std::string_view line(partial_line_.data() + line_start, newline - line_start);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (auto event = ClassifyLine(line)) {
+      events.push_back(std::move(*event));
+    }
+    line_start = newline + 1;
+  }
+  partial_line_.erase(0, line_start);
+  return events;
+}
+
+ForwardOutputMonitor::~ForwardOutputMonitor() {
+  for (auto& source : sources_) {
+    if (source.fd >= 0) {
+      ::close(source.fd);
+    }
+  }
+}
+
+void ForwardOutputMonitor::TrackPipes(int pid, int stdout_fd, int stderr_fd) {
+  if (stdout_fd >= 0) {
+    sources_.push_back(Source{.pid = pid, .fd = stdout_fd});
+  }
+  if (stderr_fd >= 0) {
+    sources_.push_back(Source{.pid = pid, .fd = stderr_fd, .to_stderr = true});
+  }
+}
+
+void ForwardOutputMonitor::TrackLogFile(int pid, const std::filesystem::path& log_path, std::uintmax_t offset) {
+  if (log_path.empty()) {
+    return;
+  }
+  sources_.push_back(Source{.pid = pid, .log_path = log_path, .log_offset = offset});
+}
+
+void ForwardOutputMonitor::Untrack(int pid) {
+  for (auto& source : sources_) {
+    if (source.pid == pid && source.fd >= 0) {
+      ::close(source.fd);
+      source.fd = -1;
+    }
+  }
+  sources_.erase(std::remove_if(sources_.begin(), sources_.end(),
+                                [pid](const Source& source) { return source.pid == pid; }),
+                 sources_.end());
+}
+
+void ForwardOutputMonitor::Drain(Source& source, std::vector<ForwardOutputEvent>& events) {
+  std::array<char, 4096> buffer{};
+  const auto consume = [&](std::string_view chunk) {
+    for (auto& event : source.parser.Feed(chunk)) {
+      events.push_back(ForwardOutputEvent{.pid = source.pid, .event = std::move(event)});
+    }
+  };
+
+  if (source.fd < 0) {
+    std::ifstream input(source.log_path, std::ios::binary);
+    if (!input.is_open()) {
+      return;
+    }
+    if (CurrentFileSize(source.log_path) < source.log_offset) {
+      source.log_offset = 0;
+    }
+    input.seekg(static_cast<std::streamoff>(source.log_offset));
+    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0) {
+      const auto count = static_cast<size_t>(input.gcount());
+      source.log_offset += count;
+      consume(std::string_view(buffer.data(), count));
+    }
+    return;
+  }
+
+  while (true) {
+    const ssize_t count = ::read(source.fd, buffer.data(), buffer.size());
+    if (count > 0) {
+      std::ostream& echo = source.to_stderr ? std::cerr : std::cout;
+      echo.write(buffer.data(), count);
+      echo.flush();
+      consume(std::string_view(buffer.data(), static_cast<size_t>(count)));
+      continue;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      ::close(source.fd);
+      source.fd = -1;
+    }
+    return;
+  }
+}
+
+std::vector<int> ForwardOutputMonitor::PipeDescriptors() const {
+  std::vector<int> fds;
+  for (const auto& source : sources_) {
+    if (source.fd >= 0) {
+      fds.push_back(source.fd);
+    }
+  }
+  return fds;
+}
+
+std::vector<ForwardOutputEvent> ForwardOutputMonitor::Wait(std::chrono::milliseconds timeout) {
+  std::vector<pollfd> poll_fds;
+  for (const auto& source : sources_) {
+    if (source.fd >= 0) {
+      poll_fds.push_back(pollfd{.fd = source.fd, .events = POLLIN, .revents = 0});
+    }
+  }
+
+  if (poll_fds.empty()) {
+    std::this_thread::sleep_for(timeout);
+  } else {
+    (void)::poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), static_cast<int>(timeout.count()));
+  }
+
+  std::vector<ForwardOutputEvent> events;
+  for (auto& source : sources_) {
+    if (source.fd >= 0) {
+      const auto polled = std::find_if(poll_fds.begin(), poll_fds.end(),
+                                       [&](const pollfd& entry) { return entry.fd == source.fd; });
+      if (polled == poll_fds.end() || polled->revents == 0) {
+        continue;
+      }
+    } else if (source.log_path.empty()) {
+      continue;
+    }
+    Drain(source, events);
+  }
+
+  sources_.erase(std::remove_if(sources_.begin(), sources_.end(),
+                                [](const Source& source) { return source.fd < 0 && source.log_path.empty(); }),
+                 sources_.end());
+  return events;
+}
+
+std::uintmax_t CurrentFileSize(const std::filesystem::path& path) {
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(path, ec);
+  return ec ? 0 : size;
+}
+
+}  // namespace kubeforward::runtime
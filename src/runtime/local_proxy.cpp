@@ -0,0 +1,734 @@
+#include "kubeforward/runtime/local_proxy.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+constexpr auto kUpstreamRetryInterval = std::chrono::milliseconds(100);
+//! How long an upstream of a balanced route stays out of rotation after refusing a connection.
+constexpr auto kUpstreamEjectionPeriod = std::chrono::milliseconds(5000);
+
+bool SetNonBlocking(int fd) {
+  const int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+//! Configures an accepted or connecting socket; on macOS SO_NOSIGPIPE replaces MSG_NOSIGNAL.
+bool PrepareStreamSocket(int fd) {
+#if defined(SO_NOSIGPIPE)
+  const int enabled = 1;
+  (void)::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+  return SetNonBlocking(fd);
+}
+
+std::optional<sockaddr_in> MakeIpv4Address(const std::string& address, int port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (port < 0 || port > 65535 || ::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    return std::nullopt;
+  }
+  return addr;
+}
+
+void CloseFd(int& fd) {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+//! One accepted client and its (possibly not yet connected) upstream socket.
+struct RelayConnection {
+  RelayConnection(RelayBufferPool& pool, StreamRelayMode mode) : outbound(pool, mode), inbound(pool, mode) {}
+
+  int client_fd = -1;
+  int upstream_fd = -1;
+  int upstream_port = 0;
+  bool connecting = false;
+  //! Queued for processing in the current loop iteration.
+  bool touched = false;
+  std::chrono::steady_clock::time_point accepted_at;
+  //! Set while waiting to retry an upstream that refused the connection.
+  std::optional<std::chrono::steady_clock::time_point> retry_at;
+  //! Index of the listener (route) that accepted the client, for byte accounting.
+  size_t route = 0;
+  //! Index into the listener's upstreams; valid once `upstream_assigned`.
+  size_t upstream = 0;
+  bool upstream_assigned = false;
+  //! Whether the established upstream was counted in its Upstream::connections.
+  bool counted = false;
+  StreamRelay outbound;
+  StreamRelay inbound;
+
+  bool established() const { return upstream_fd >= 0 && !connecting; }
+  bool finished() const { return outbound.shut() && inbound.shut(); }
+
+  ~RelayConnection() {
+    CloseFd(client_fd);
+    CloseFd(upstream_fd);
+  }
+};
+
+enum class ConnectResult {
+  kConnected,
+  kInProgress,
+  kRefused,
+};
+
+//! Starts a non-blocking connect to 127.0.0.1:`port`; `fd` is the new socket unless the connect was refused.
+ConnectResult ConnectLoopback(int port, int& fd) {
+  const auto addr = MakeIpv4Address("127.0.0.1", port);
+  fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (!addr.has_value() || fd < 0 || !PrepareStreamSocket(fd)) {
+    CloseFd(fd);
+    return ConnectResult::kRefused;
+  }
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) == 0) {
+    return ConnectResult::kConnected;
+  }
+  if (errno == EINPROGRESS || errno == EINTR) {
+    return ConnectResult::kInProgress;
+  }
+  CloseFd(fd);
+  return ConnectResult::kRefused;
+}
+
+//! Expects the previous upstream socket to be closed already.
+ConnectResult StartUpstreamConnect(RelayConnection& connection) {
+  const auto result = ConnectLoopback(connection.upstream_port, connection.upstream_fd);
+  connection.connecting = result == ConnectResult::kInProgress;
+  return result;
+}
+
+//! Re-issues connect() on an in-flight socket: EISCONN means it completed, EALREADY that it is still pending.
+ConnectResult PollUpstreamConnect(RelayConnection& connection) {
+  const auto addr = MakeIpv4Address("127.0.0.1", connection.upstream_port);
+  if (::connect(connection.upstream_fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) == 0 ||
+      errno == EISCONN) {
+    connection.connecting = false;
+    return ConnectResult::kConnected;
+  }
+  if (errno == EALREADY || errno == EINPROGRESS || errno == EINTR) {
+    return ConnectResult::kInProgress;
+  }
+  connection.connecting = false;
+  return ConnectResult::kRefused;
+}
+
+//! An upstream connection opened for a route's warm pool before any client asked for it.
+struct WarmUpstream {
+  size_t route = 0;
+  size_t upstream = 0;
+  bool connecting = false;
+};
+
+//! Whether a pooled upstream is still usable: nothing read yet, or data the server sent first. EOF or an error means
+//! kubectl (or the pod) closed the stream.
+bool WarmUpstreamAlive(int fd) {
+  char byte = 0;
+  const ssize_t count = ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return count > 0 || (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
+
+}  // namespace
+
+LocalForwardProxy::LocalForwardProxy(std::chrono::milliseconds upstream_retry_window, StreamRelayMode relay_mode,
+                                     EventLoopBackend event_backend)
+    : upstream_retry_window_(upstream_retry_window), relay_mode_(relay_mode), event_backend_(event_backend) {}
+
+LocalForwardProxy::~LocalForwardProxy() { Stop(); }
+
+bool LocalForwardProxy::Start(const std::vector<LocalProxyRoute>& routes, std::string& error) {
+  if (running()) {
+    error = "local proxy is already running";
+    return false;
+  }
+  listeners_.clear();
+
+  const auto fail = [&](const std::string& message) {
+    error = message;
+    for (auto& listener : listeners_) {
+      CloseFd(listener->fd);
+    }
+    listeners_.clear();
+    return false;
+  };
+
+  for (const auto& route : routes) {
+    const auto addr = MakeIpv4Address(route.bind_address, route.local_port);
+    if (!addr.has_value()) {
+      return fail("invalid proxy listen address " + route.bind_address + ":" + std::to_string(route.local_port));
+    }
+    auto listener = std::make_unique<Listener>();
+    listener->fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    listener->route = route;
+    listener->upstreams = std::vector<Upstream>(1 + route.balanced_upstream_ports.size());
+    listener->upstreams[0].port = route.upstream_port;
+    for (size_t i = 0; i < route.balanced_upstream_ports.size(); ++i) {
+      listener->upstreams[i + 1].port = route.balanced_upstream_ports[i];
+    }
+    if (listener->fd < 0) {
+      return fail(std::string("failed to create proxy listener: ") + std::strerror(errno));
+    }
+    const int listener_fd = listener->fd;
+    listeners_.push_back(std::move(listener));
+
+    const int reuse = 1;
+    (void)::setsockopt(listener_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(listener_fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) != 0 ||
+        ::listen(listener_fd, SOMAXCONN) != 0 || !SetNonBlocking(listener_fd)) {
+      return fail("failed to listen on " + route.bind_address + ":" + std::to_string(route.local_port) + ": " +
+                  std::strerror(errno));
+    }
+  }
+
+  if (::pipe(wake_pipe_) != 0 || !SetNonBlocking(wake_pipe_[0]) || !SetNonBlocking(wake_pipe_[1])) {
+    CloseFd(wake_pipe_[0]);
+    CloseFd(wake_pipe_[1]);
+    return fail("failed to create proxy wake pipe");
+  }
+
+  stopping_ = false;
+  draining_ = false;
+  active_connections_ = 0;
+  listeners_closed_ = false;
+  thread_ = std::thread([this]() { Run(); });
+  error.clear();
+  return true;
+}
+
+void LocalForwardProxy::Stop() {
+  if (thread_.joinable()) {
+    stopping_ = true;
+    const char byte = 0;
+    (void)::write(wake_pipe_[1], &byte, 1);
+    thread_.join();
+  }
+  for (auto& listener : listeners_) {
+    CloseFd(listener->fd);
+  }
+  CloseFd(wake_pipe_[0]);
+  CloseFd(wake_pipe_[1]);
+}
+
+bool LocalForwardProxy::Drain(std::chrono::milliseconds timeout) {
+  if (!running()) {
+    return true;
+  }
+  draining_ = true;
+  const char byte = 0;
+  (void)::write(wake_pipe_[1], &byte, 1);
+  std::unique_lock<std::mutex> lock(drain_mutex_);
+  return drain_progress_.wait_for(lock, timeout,
+                                  [this]() { return listeners_closed_ && active_connections_.load() == 0; });
+}
+
+std::vector<LocalProxyRouteStats> LocalForwardProxy::Stats() const {
+  std::vector<LocalProxyRouteStats> stats;
+  stats.reserve(listeners_.size());
+  for (const auto& listener : listeners_) {
+    std::vector<uint64_t> upstream_connections;
+    for (const auto& upstream : listener->upstreams) {
+      upstream_connections.push_back(upstream.connections.load());
+    }
+    stats.push_back(LocalProxyRouteStats{
+        .route = listener->route,
+        .connections = listener->connections.load(),
+        .bytes_to_upstream = listener->bytes_to_upstream.load(),
+        .bytes_to_client = listener->bytes_to_client.load(),
+        .warm_hits = listener->warm_hits.load(),
+        .upstream_connections = std::move(upstream_connections),
+        .ejections = listener->ejections.load(),
+    });
+  }
+  return stats;
+}
+
+void LocalForwardProxy::Run() {
+  // splice() into a socket whose peer is gone raises SIGPIPE (there is no MSG_NOSIGNAL for it); keep it pending on
+  // this thread instead of killing the process. The EPIPE error is still reported and closes the connection.
+  sigset_t sigpipe;
+  sigemptyset(&sigpipe);
+  sigaddset(&sigpipe, SIGPIPE);
+  (void)::pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+  const auto loop = CreateEventLoop(event_backend_);
+  std::string loop_error;
+  std::unordered_map<int, size_t> listener_by_fd;
+  if (!loop->Watch(wake_pipe_[0], kEventReadable, loop_error)) {
+    return;
+  }
+  for (size_t i = 0; i < listeners_.size(); ++i) {
+    if (!loop->Watch(listeners_[i]->fd, kEventReadable, loop_error)) {
+      return;
+    }
+    listener_by_fd[listeners_[i]->fd] = i;
+  }
+
+  RelayBufferPool buffer_pool;
+  std::unordered_map<RelayConnection*, std::unique_ptr<RelayConnection>> connections;
+  std::unordered_map<int, RelayConnection*> connection_by_fd;
+  //! Connections waiting for their next upstream connect attempt.
+  std::vector<RelayConnection*> retrying;
+  std::vector<RelayConnection*> touched;
+  std::vector<ReadyEvent> ready;
+  std::unordered_map<int, WarmUpstream> warm_by_fd;
+  //! Established warm upstreams per route; the newest is handed out first since it is the least likely to have been
+  //! closed for idling.
+  std::vector<std::vector<int>> warm_ready(listeners_.size());
+  std::vector<size_t> warm_connecting(listeners_.size(), 0);
+  std::vector<std::chrono::steady_clock::time_point> next_refill(listeners_.size(), std::chrono::steady_clock::now());
+
+  const auto touch = [&](RelayConnection* connection) {
+    if (!connection->touched) {
+      connection->touched = true;
+      touched.push_back(connection);
+    }
+  };
+  // Descriptors leave the loop before they are closed; see EventLoop.
+  const auto close_upstream = [&](RelayConnection& connection) {
+    if (connection.upstream_fd >= 0) {
+      loop->Forget(connection.upstream_fd);
+      connection_by_fd.erase(connection.upstream_fd);
+      CloseFd(connection.upstream_fd);
+    }
+  };
+  // Re-declares what the connection waits for; a socket with nothing to wait for is unwatched entirely, otherwise a
+  // peer that hung up keeps reporting a hangup and spins the loop while the other direction is still draining.
+  const auto sync_interest = [&](RelayConnection& connection) {
+    unsigned client_events = 0;
+    unsigned upstream_events = 0;
+    if (connection.connecting) {
+      upstream_events = kEventWritable;
+    } else if (connection.established()) {
+      client_events |= connection.outbound.wants_read() ? kEventReadable : 0;
+      client_events |= connection.inbound.pending() ? kEventWritable : 0;
+      upstream_events |= connection.inbound.wants_read() ? kEventReadable : 0;
+      upstream_events |= connection.outbound.pending() ? kEventWritable : 0;
+    }
+    bool ok = loop->Watch(connection.client_fd, client_events, loop_error);
+    if (connection.upstream_fd >= 0) {
+      connection_by_fd[connection.upstream_fd] = &connection;
+      ok = loop->Watch(connection.upstream_fd, upstream_events, loop_error) && ok;
+    }
+    if (!ok) {
+      connection.outbound.Abort();
+      connection.inbound.Abort();
+    }
+  };
+
+  const auto in_rotation = [](const Upstream& upstream, std::chrono::steady_clock::time_point now) {
+    return upstream.ejected_until <= now;
+  };
+  // Chooses the upstream for the next connect to `listener`, among those in rotation or, once every upstream is
+  // ejected, among all of them.
+  const auto pick_upstream = [&](Listener& listener, std::chrono::steady_clock::time_point now) {
+    const auto& upstreams = listener.upstreams;
+    const bool any_in_rotation = std::any_of(upstreams.begin(), upstreams.end(),
+                                             [&](const Upstream& upstream) { return in_rotation(upstream, now); });
+    std::optional<size_t> chosen;
+    for (size_t step = 0; step < upstreams.size(); ++step) {
+      const size_t index = (listener.next_upstream + step) % upstreams.size();
+      if (any_in_rotation && !in_rotation(upstreams[index], now)) {
+        continue;
+      }
+      if (!chosen.has_value()) {
+        chosen = index;
+        if (listener.route.balancing == UpstreamBalancing::kRoundRobin) {
+          break;
+        }
+      } else if (upstreams[index].active < upstreams[*chosen].active) {
+        chosen = index;
+      }
+    }
+    listener.next_upstream = (*chosen + 1) % upstreams.size();
+    return *chosen;
+  };
+  const auto release_upstream = [&](RelayConnection& connection) {
+    if (connection.upstream_assigned) {
+      --listeners_[connection.route]->upstreams[connection.upstream].active;
+      connection.upstream_assigned = false;
+    }
+  };
+  const auto assign_upstream = [&](RelayConnection& connection, size_t index) {
+    release_upstream(connection);
+    auto& upstream = listeners_[connection.route]->upstreams[index];
+    ++upstream.active;
+    connection.upstream = index;
+    connection.upstream_assigned = true;
+    connection.upstream_port = upstream.port;
+  };
+  // Takes a refusing upstream of a balanced route out of rotation; true when another one is still in rotation.
+  const auto eject_upstream = [&](Listener& listener, size_t index, std::chrono::steady_clock::time_point now) {
+    if (listener.upstreams.size() < 2) {
+      return false;
+    }
+    auto& upstream = listener.upstreams[index];
+    if (in_rotation(upstream, now)) {
+      listener.ejections.fetch_add(1);
+    }
+    upstream.ejected_until = now + kUpstreamEjectionPeriod;
+    return std::any_of(listener.upstreams.begin(), listener.upstreams.end(),
+                       [&](const Upstream& candidate) { return in_rotation(candidate, now); });
+  };
+
+  bool accepting = true;
+  const auto warm_deficit = [&](size_t route) {
+    if (!accepting) {
+      return false;
+    }
+    const auto size = static_cast<size_t>(std::max(listeners_[route]->route.warm_pool_size, 0));
+    const size_t open = warm_ready[route].size() + warm_connecting[route];
+    return open < size;
+  };
+  const auto close_warm = [&](int fd) {
+    const auto warm = warm_by_fd.find(fd);
+    if (warm == warm_by_fd.end()) {
+      return;
+    }
+    auto& pool = warm_ready[warm->second.route];
+    if (warm->second.connecting) {
+      --warm_connecting[warm->second.route];
+    } else {
+      pool.erase(std::remove(pool.begin(), pool.end(), fd), pool.end());
+    }
+    warm_by_fd.erase(warm);
+    loop->Forget(fd);
+    int closing = fd;
+    CloseFd(closing);
+  };
+  const auto warm_established = [&](int fd, WarmUpstream& warm) {
+    if (warm.connecting) {
+      warm.connecting = false;
+      --warm_connecting[warm.route];
+    }
+    warm_ready[warm.route].push_back(fd);
+    // Readable now means the stream was closed, or a server-first protocol greeted; see WarmUpstreamAlive().
+    if (!loop->Watch(fd, kEventReadable, loop_error)) {
+      close_warm(fd);
+    }
+  };
+  // Opens at most one warm upstream per route per refill interval while the pool is short.
+  const auto refill_warm_pools = [&](std::chrono::steady_clock::time_point now) {
+    for (size_t i = 0; i < listeners_.size(); ++i) {
+      if (!warm_deficit(i) || now < next_refill[i]) {
+        continue;
+      }
+      const int refill_per_second = std::max(listeners_[i]->route.warm_pool_refill_per_second, 1);
+      next_refill[i] = now + std::chrono::milliseconds(1000) / refill_per_second;
+      const size_t upstream = pick_upstream(*listeners_[i], now);
+      int fd = -1;
+      const auto result = ConnectLoopback(listeners_[i]->upstreams[upstream].port, fd);
+      if (result == ConnectResult::kRefused) {
+        // kubectl is not listening yet (or restarting); the next interval tries again.
+        (void)eject_upstream(*listeners_[i], upstream, now);
+        continue;
+      }
+      auto& warm = warm_by_fd[fd];
+      warm.route = i;
+      warm.upstream = upstream;
+      if (result == ConnectResult::kConnected) {
+        warm_established(fd, warm);
+        continue;
+      }
+      warm.connecting = true;
+      ++warm_connecting[i];
+      if (!loop->Watch(fd, kEventWritable, loop_error)) {
+        close_warm(fd);
+      }
+    }
+  };
+  // Handles readiness on a warm upstream: a finished connect joins the pool, a closed stream leaves it.
+  const auto warm_ready_event = [&](int fd) {
+    auto& warm = warm_by_fd.at(fd);
+    if (warm.connecting) {
+      int socket_error = 0;
+      socklen_t length = sizeof(socket_error);
+      if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &socket_error, &length) != 0 || socket_error != 0) {
+        close_warm(fd);
+      } else {
+        warm_established(fd, warm);
+      }
+      return;
+    }
+    if (!WarmUpstreamAlive(fd)) {
+      close_warm(fd);
+    } else if (!loop->Watch(fd, 0, loop_error)) {
+      // Data is waiting for the future client; stop watching so it does not spin the loop.
+      close_warm(fd);
+    }
+  };
+  // Hands the newest live warm upstream of `route` to a new client; -1 when the pool is empty.
+  const auto take_warm = [&](size_t route, size_t& upstream) {
+    auto& pool = warm_ready[route];
+    while (!pool.empty()) {
+      const int fd = pool.back();
+      if (!WarmUpstreamAlive(fd)) {
+        close_warm(fd);
+        continue;
+      }
+      pool.pop_back();
+      upstream = warm_by_fd.at(fd).upstream;
+      warm_by_fd.erase(fd);
+      return fd;
+    }
+    return -1;
+  };
+
+  // Reports drain progress to Drain(); the empty critical section orders the update before its wait.
+  const auto report_drain_progress = [&]() {
+    if (draining_) {
+      {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+      }
+      drain_progress_.notify_all();
+    }
+  };
+  // Draining: no new clients, and the warm pools have nobody left to serve.
+  const auto close_listeners = [&]() {
+    accepting = false;
+    for (auto& listener : listeners_) {
+      loop->Forget(listener->fd);
+      CloseFd(listener->fd);
+    }
+    listener_by_fd.clear();
+    while (!warm_by_fd.empty()) {
+      close_warm(warm_by_fd.begin()->first);
+    }
+    {
+      std::lock_guard<std::mutex> lock(drain_mutex_);
+      listeners_closed_ = true;
+    }
+    drain_progress_.notify_all();
+  };
+
+  while (!stopping_) {
+    if (draining_ && accepting) {
+      close_listeners();
+    }
+    const auto now = std::chrono::steady_clock::now();
+    refill_warm_pools(now);
+    int timeout_ms = -1;
+    const auto wait_until = [&](std::chrono::steady_clock::time_point deadline) {
+      const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+      const int wait_ms = static_cast<int>(std::max<long long>(remaining, 0));
+      timeout_ms = timeout_ms < 0 ? wait_ms : std::min(timeout_ms, wait_ms);
+    };
+    for (const auto* connection : retrying) {
+      wait_until(*connection->retry_at);
+    }
+    for (size_t i = 0; i < listeners_.size(); ++i) {
+      if (warm_deficit(i)) {
+        wait_until(next_refill[i]);
+      }
+    }
+
+    if (!loop->Wait(timeout_ms, ready, loop_error)) {
+      break;
+    }
+    if (stopping_) {
+      break;
+    }
+
+    for (const auto& event : ready) {
+      if (event.fd == wake_pipe_[0]) {
+        char drain[64];
+        while (::read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+        }
+        continue;
+      }
+      const auto listener_index = listener_by_fd.find(event.fd);
+      if (listener_index != listener_by_fd.end()) {
+        const size_t i = listener_index->second;
+        while (true) {
+          const int client_fd = ::accept(listeners_[i]->fd, nullptr, nullptr);
+          if (client_fd < 0) {
+            break;
+          }
+          auto connection = std::make_unique<RelayConnection>(buffer_pool, relay_mode_);
+          connection->client_fd = client_fd;
+          connection->upstream_port = listeners_[i]->route.upstream_port;
+          connection->route = i;
+          listeners_[i]->connections.fetch_add(1);
+          connection->accepted_at = std::chrono::steady_clock::now();
+          if (!PrepareStreamSocket(client_fd)) {
+            continue;
+          }
+          connection_by_fd[client_fd] = connection.get();
+          size_t warm_upstream = 0;
+          const int warm_fd = take_warm(i, warm_upstream);
+          if (warm_fd >= 0) {
+            listeners_[i]->warm_hits.fetch_add(1);
+            assign_upstream(*connection, warm_upstream);
+            connection->upstream_fd = warm_fd;
+            connection_by_fd[warm_fd] = connection.get();
+            touch(connection.get());
+          } else {
+            connection->retry_at = connection->accepted_at;
+            retrying.push_back(connection.get());
+          }
+          connections.emplace(connection.get(), std::move(connection));
+        }
+        continue;
+      }
+      if (warm_by_fd.count(event.fd) != 0) {
+        warm_ready_event(event.fd);
+        continue;
+      }
+      const auto connection = connection_by_fd.find(event.fd);
+      if (connection != connection_by_fd.end()) {
+        touch(connection->second);
+      }
+    }
+
+    // Connections whose upstream retry is due join the ready ones.
+    const auto step_time = std::chrono::steady_clock::now();
+    retrying.erase(std::remove_if(retrying.begin(), retrying.end(),
+                                  [&](RelayConnection* connection) {
+                                    if (step_time < *connection->retry_at) {
+                                      return false;
+                                    }
+                                    touch(connection);
+                                    return true;
+                                  }),
+                   retrying.end());
+
+    // Advance only the touched connections: (re)connect due upstreams, complete in-flight connects, pump the rest.
+    for (auto* connection : touched) {
+      connection->touched = false;
+      bool failed = false;
+      if (connection->retry_at.has_value() && step_time >= *connection->retry_at) {
+        connection->retry_at.reset();
+        close_upstream(*connection);
+        assign_upstream(*connection, pick_upstream(*listeners_[connection->route], step_time));
+        if (StartUpstreamConnect(*connection) == ConnectResult::kRefused) {
+          failed = true;
+        }
+      } else if (connection->connecting && PollUpstreamConnect(*connection) == ConnectResult::kRefused) {
+        close_upstream(*connection);
+        failed = true;
+      }
+
+      if (failed) {
+        // The upstream is not listening (kubectl restarting or stopped). Move on to another upstream of a balanced
+        // route right away; otherwise hold the client until the retry window closes.
+        if (eject_upstream(*listeners_[connection->route], connection->upstream, step_time)) {
+          connection->retry_at = step_time;
+          retrying.push_back(connection);
+        } else if (step_time - connection->accepted_at < upstream_retry_window_) {
+          connection->retry_at = step_time + kUpstreamRetryInterval;
+          retrying.push_back(connection);
+        } else {
+          connection->outbound.Abort();
+          connection->inbound.Abort();
+        }
+      } else if (connection->established()) {
+        auto& listener = *listeners_[connection->route];
+        if (!connection->counted) {
+          connection->counted = true;
+          listener.upstreams[connection->upstream].connections.fetch_add(1);
+        }
+        const uint64_t outbound_before = connection->outbound.bytes_moved();
+        const uint64_t inbound_before = connection->inbound.bytes_moved();
+        const bool failed_pump =
+            connection->outbound.Pump(connection->client_fd, connection->upstream_fd) ==
+                StreamRelay::Result::kFailed ||
+            connection->inbound.Pump(connection->upstream_fd, connection->client_fd) == StreamRelay::Result::kFailed;
+        listener.bytes_to_upstream.fetch_add(connection->outbound.bytes_moved() - outbound_before);
+        listener.bytes_to_client.fetch_add(connection->inbound.bytes_moved() - inbound_before);
+        if (failed_pump) {
+          connection->outbound.Abort();
+          connection->inbound.Abort();
+        }
+      }
+
+      if (!connection->finished()) {
+        sync_interest(*connection);
+      }
+      if (connection->finished()) {
+        close_upstream(*connection);
+        loop->Forget(connection->client_fd);
+        connection_by_fd.erase(connection->client_fd);
+        release_upstream(*connection);
+        connections.erase(connection);
+      }
+    }
+    touched.clear();
+    if (active_connections_.exchange(connections.size()) != connections.size()) {
+      report_drain_progress();
+    }
+  }
+
+  while (!warm_by_fd.empty()) {
+    close_warm(warm_by_fd.begin()->first);
+  }
+}
+
+int ReserveLoopbackPort(std::string& error) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    error = std::string("failed to create socket: ") + std::strerror(errno);
+    return 0;
+  }
+  auto addr = *MakeIpv4Address("127.0.0.1", 0);
+  socklen_t length = sizeof(addr);
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+    error = std::string("failed to reserve loopback port: ") + std::strerror(errno);
+    ::close(fd);
+    return 0;
+  }
+  ::close(fd);
+  error.clear();
+  return ntohs(addr.sin_port);
+}
+
+std::unique_ptr<LoopbackPortReservation> LoopbackPortReservation::Create(std::string& error) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    error = std::string("failed to create socket: ") + std::strerror(errno);
+    return nullptr;
+  }
+  (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  const int reuse = 1;
+  (void)::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  auto addr = *MakeIpv4Address("127.0.0.1", 0);
+  socklen_t length = sizeof(addr);
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+    error = std::string("failed to reserve loopback port: ") + std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+  error.clear();
+#if defined(__linux__)
+  return std::unique_ptr<LoopbackPortReservation>(new LoopbackPortReservation(fd, ntohs(addr.sin_port)));
+#else
+  // BSD sockets refuse a second bind of the same address even with SO_REUSEADDR, which would lock the child out.
+  ::close(fd);
+  return std::unique_ptr<LoopbackPortReservation>(new LoopbackPortReservation(-1, ntohs(addr.sin_port)));
+#endif
+}
+
+LoopbackPortReservation::~LoopbackPortReservation() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+}  // namespace kubeforward::runtime
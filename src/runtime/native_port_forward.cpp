@@ -0,0 +1,758 @@
+#include "kubeforward/runtime/native_port_forward.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+constexpr size_t kReadChunkSize = 32 * 1024;
+//! Stop reading a source once this much is queued for its destination; poll then waits for the peer to drain.
+constexpr size_t kMaxPendingBytes = 256 * 1024;
+constexpr size_t kMaxHandshakeBytes = 16 * 1024;
+constexpr const char* kProtocolV4 = "v4.channel.k8s.io";
+constexpr unsigned char kDataChannel = 0;
+constexpr unsigned char kErrorChannel = 1;
+
+constexpr unsigned char kOpcodeContinuation = 0x0;
+constexpr unsigned char kOpcodeText = 0x1;
+constexpr unsigned char kOpcodeBinary = 0x2;
+constexpr unsigned char kOpcodeClose = 0x8;
+constexpr unsigned char kOpcodePing = 0x9;
+constexpr unsigned char kOpcodePong = 0xA;
+
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+bool SetNonBlocking(int fd) {
+  const int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+bool PrepareStreamSocket(int fd) {
+#if defined(SO_NOSIGPIPE)
+  const int enabled = 1;
+  (void)::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+  return SetNonBlocking(fd);
+}
+
+void CloseFd(int& fd) {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+uint32_t RotateLeft(uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); }
+
+//! SHA-1 is only needed to verify the handshake's Sec-WebSocket-Accept, not for anything security-relevant.
+std::array<unsigned char, 20> Sha1(const std::string& input) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::string message = input;
+  const uint64_t bit_length = static_cast<uint64_t>(input.size()) * 8;
+  message.push_back(static_cast<char>(0x80));
+  while (message.size() % 64 != 56) {
+    message.push_back('\0');
+  }
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    message.push_back(static_cast<char>((bit_length >> shift) & 0xFF));
+  }
+
+  for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+      const auto* bytes = reinterpret_cast<const unsigned char*>(message.data() + chunk + i * 4);
+      w[i] = (uint32_t{bytes[0]} << 24) | (uint32_t{bytes[1]} << 16) | (uint32_t{bytes[2]} << 8) | bytes[3];
+    }
+    for (int i = 16; i < 80; ++i) {
+      w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i) {
+      uint32_t f = 0;
+      uint32_t k = 0;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      const uint32_t next = RotateLeft(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = RotateLeft(b, 30);
+      b = a;
+      a = next;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::array<unsigned char, 20> digest{};
+  for (int i = 0; i < 5; ++i) {
+    digest[i * 4] = static_cast<unsigned char>(h[i] >> 24);
+    digest[i * 4 + 1] = static_cast<unsigned char>(h[i] >> 16);
+    digest[i * 4 + 2] = static_cast<unsigned char>(h[i] >> 8);
+    digest[i * 4 + 3] = static_cast<unsigned char>(h[i]);
+  }
+  return digest;
+}
+
+std::string Base64Encode(const unsigned char* data, size_t size) {
+  static constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string encoded;
+  encoded.reserve((size + 2) / 3 * 4);
+  for (size_t i = 0; i < size; i += 3) {
+    const uint32_t group = (uint32_t{data[i]} << 16) | (i + 1 < size ? uint32_t{data[i + 1]} << 8 : 0) |
+                           (i + 2 < size ? uint32_t{data[i + 2]} : 0);
+    encoded.push_back(kAlphabet[(group >> 18) & 0x3F]);
+    encoded.push_back(kAlphabet[(group >> 12) & 0x3F]);
+    encoded.push_back(i + 1 < size ? kAlphabet[(group >> 6) & 0x3F] : '=');
+    encoded.push_back(i + 2 < size ? kAlphabet[group & 0x3F] : '=');
+  }
+  return encoded;
+}
+
+std::string ToLower(std::string value) {
+  for (auto& ch : value) {
+    ch = static_cast<char>(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+  }
+  return value;
+}
+
+std::string Trim(const std::string& value) {
+  const auto begin = value.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  const auto end = value.find_last_not_of(" \t\r");
+  return value.substr(begin, end - begin + 1);
+}
+
+//! Appends one masked client frame; RFC 6455 requires every client-to-server frame to be masked.
+void AppendClientFrame(std::string& out, unsigned char opcode, const unsigned char* prefix, size_t prefix_size,
+                       const char* data, size_t size, std::mt19937& random) {
+  const size_t length = prefix_size + size;
+  out.push_back(static_cast<char>(0x80 | opcode));
+  if (length < 126) {
+    out.push_back(static_cast<char>(0x80 | length));
+  } else if (length <= 0xFFFF) {
+    out.push_back(static_cast<char>(0x80 | 126));
+    out.push_back(static_cast<char>((length >> 8) & 0xFF));
+    out.push_back(static_cast<char>(length & 0xFF));
+  } else {
+    out.push_back(static_cast<char>(0x80 | 127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      out.push_back(static_cast<char>((static_cast<uint64_t>(length) >> shift) & 0xFF));
+    }
+  }
+  const uint32_t mask_word = random();
+  const unsigned char mask[4] = {static_cast<unsigned char>(mask_word >> 24), static_cast<unsigned char>(mask_word >> 16),
+                                 static_cast<unsigned char>(mask_word >> 8), static_cast<unsigned char>(mask_word)};
+  out.append(reinterpret_cast<const char*>(mask), sizeof(mask));
+  for (size_t i = 0; i < length; ++i) {
+    const unsigned char byte =
+        i < prefix_size ? prefix[i] : static_cast<unsigned char>(data[i - prefix_size]);
+    out.push_back(static_cast<char>(byte ^ mask[i % 4]));
+  }
+}
+
+enum class TunnelStage {
+  kConnecting,
+  kHandshake,
+  kOpen,
+};
+
+//! One accepted local connection and the WebSocket that carries it to the pod.
+struct Tunnel {
+  int client_fd = -1;
+  int api_fd = -1;
+  int remote_port = 0;
+  TunnelStage stage = TunnelStage::kConnecting;
+  std::string websocket_key;
+  //! Bytes queued for the API server: the upgrade request first, then frames.
+  std::string to_api;
+  //! Raw bytes from the API server not yet parsed as handshake or frames.
+  std::string from_api;
+  //! Demultiplexed channel 0 payload queued for the local client.
+  std::string to_client;
+  //! Error channel text; non-empty means the remote side refused or broke the forward.
+  std::string remote_error;
+  //! Bytes of the per-channel port prefix still to strip, indexed by channel.
+  size_t port_prefix_remaining[2] = {2, 2};
+  //! Channel of the message currently being received, for continuation frames.
+  int message_channel = -1;
+  bool client_eof = false;
+  //! The API server's TCP stream ended; frames already buffered in `from_api` are still delivered.
+  bool api_eof = false;
+  //! A close frame arrived or the error channel reported a failure.
+  bool api_closed = false;
+  bool finished = false;
+
+  ~Tunnel() {
+    CloseFd(client_fd);
+    CloseFd(api_fd);
+  }
+};
+
+enum class IoResult {
+  kOk,
+  kFailed,
+};
+
+IoResult FlushTo(int fd, std::string& pending) {
+  while (!pending.empty()) {
+    const ssize_t count = ::send(fd, pending.data(), pending.size(), kSendFlags);
+    if (count > 0) {
+      pending.erase(0, static_cast<size_t>(count));
+    } else if (count < 0 && errno == EINTR) {
+      continue;
+    } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      return IoResult::kFailed;
+    }
+  }
+  return IoResult::kOk;
+}
+
+//! Reads what is available from `fd` into `into` up to `limit` queued bytes; `eof` turns true on orderly shutdown.
+IoResult ReadInto(int fd, std::string& into, size_t limit, bool& eof) {
+  char buffer[kReadChunkSize];
+  while (!eof && into.size() < limit) {
+    const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count > 0) {
+      into.append(buffer, static_cast<size_t>(count));
+    } else if (count == 0) {
+      eof = true;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else {
+      return IoResult::kFailed;
+    }
+  }
+  return IoResult::kOk;
+}
+
+std::string BuildUpgradeRequest(const ApiServerEndpoint& endpoint, const NativePortForwardOptions& options,
+                                int remote_port, const std::string& websocket_key) {
+  std::string request = "GET " + endpoint.path_prefix + "/api/v1/namespaces/" + options.namespace_name + "/pods/" +
+                        options.pod + "/portforward?ports=" + std::to_string(remote_port) + " HTTP/1.1\r\n";
+  request += "Host: " + endpoint.host + ":" + std::to_string(endpoint.port) + "\r\n";
+  request += "Upgrade: websocket\r\n";
+  request += "Connection: Upgrade\r\n";
+  request += "Sec-WebSocket-Version: 13\r\n";
+  request += "Sec-WebSocket-Key: " + websocket_key + "\r\n";
+  request += std::string("Sec-WebSocket-Protocol: ") + kProtocolV4 + "\r\n";
+  request += "\r\n";
+  return request;
+}
+
+enum class HandshakeResult {
+  kPending,
+  kOpen,
+  kRejected,
+};
+
+//! Consumes the upgrade response once it is complete; leftover bytes stay in `from_api` as the first frames.
+HandshakeResult ParseHandshake(Tunnel& tunnel, std::string& error) {
+  const auto header_end = tunnel.from_api.find("\r\n\r\n");
+  if (header_end == std::string::npos) {
+    if (tunnel.from_api.size() > kMaxHandshakeBytes) {
+      error = "portforward upgrade response headers are too large";
+      return HandshakeResult::kRejected;
+    }
+    return HandshakeResult::kPending;
+  }
+  const std::string head = tunnel.from_api.substr(0, header_end);
+  tunnel.from_api.erase(0, header_end + 4);
+
+  const auto status_end = head.find("\r\n");
+  const std::string status_line = Trim(head.substr(0, status_end));
+  if (status_line.rfind("HTTP/1.1 101", 0) != 0 && status_line.rfind("HTTP/1.0 101", 0) != 0) {
+    error = "portforward upgrade rejected: " + status_line;
+    return HandshakeResult::kRejected;
+  }
+
+  std::string accept;
+  std::string protocol;
+  size_t line_start = status_end == std::string::npos ? head.size() : status_end + 2;
+  while (line_start < head.size()) {
+    auto line_end = head.find("\r\n", line_start);
+    if (line_end == std::string::npos) {
+      line_end = head.size();
+    }
+    const std::string line = head.substr(line_start, line_end - line_start);
+    const auto colon = line.find(':');
+    if (colon != std::string::npos) {
+      const std::string name = ToLower(Trim(line.substr(0, colon)));
+      if (name == "sec-websocket-accept") {
+        accept = Trim(line.substr(colon + 1));
+      } else if (name == "sec-websocket-protocol") {
+        protocol = Trim(line.substr(colon + 1));
+      }
+    }
+    line_start = line_end + 2;
+  }
+
+  if (accept != WebSocketAcceptKey(tunnel.websocket_key)) {
+    error = "portforward upgrade returned an invalid Sec-WebSocket-Accept";
+    return HandshakeResult::kRejected;
+  }
+  if (protocol != kProtocolV4) {
+    error = "API server did not negotiate a supported portforward protocol (got '" + protocol + "')";
+    return HandshakeResult::kRejected;
+  }
+  return HandshakeResult::kOpen;
+}
+
+void DeliverChannelPayload(Tunnel& tunnel, const char* data, size_t size) {
+  if (tunnel.message_channel != kDataChannel && tunnel.message_channel != kErrorChannel) {
+    return;
+  }
+  size_t& prefix = tunnel.port_prefix_remaining[tunnel.message_channel];
+  const size_t skipped = std::min(prefix, size);
+  prefix -= skipped;
+  data += skipped;
+  size -= skipped;
+  if (tunnel.message_channel == kDataChannel) {
+    tunnel.to_client.append(data, size);
+  } else {
+    tunnel.remote_error.append(data, size);
+  }
+}
+
+//! Parses every complete server frame in `from_api`; unmasked per RFC 6455 but a mask is tolerated.
+void ParseFrames(Tunnel& tunnel, std::mt19937& random) {
+  size_t offset = 0;
+  while (!tunnel.api_closed) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(tunnel.from_api.data() + offset);
+    const size_t available = tunnel.from_api.size() - offset;
+    if (available < 2) {
+      break;
+    }
+    const unsigned char opcode = bytes[0] & 0x0F;
+    const bool masked = (bytes[1] & 0x80) != 0;
+    uint64_t length = bytes[1] & 0x7F;
+    size_t header = 2;
+    if (length == 126) {
+      if (available < 4) {
+        break;
+      }
+      length = (uint64_t{bytes[2]} << 8) | bytes[3];
+      header = 4;
+    } else if (length == 127) {
+      if (available < 10) {
+        break;
+      }
+      length = 0;
+      for (int i = 0; i < 8; ++i) {
+        length = (length << 8) | bytes[2 + i];
+      }
+      header = 10;
+    }
+    const size_t mask_offset = header;
+    if (masked) {
+      header += 4;
+    }
+    if (available < header || available - header < length) {
+      break;
+    }
+
+    std::string payload(reinterpret_cast<const char*>(bytes + header), static_cast<size_t>(length));
+    if (masked) {
+      for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(payload[i] ^ bytes[mask_offset + i % 4]);
+      }
+    }
+    offset += header + static_cast<size_t>(length);
+
+    switch (opcode) {
+      case kOpcodeBinary:
+      case kOpcodeText:
+        if (payload.empty()) {
+          tunnel.message_channel = -1;
+          break;
+        }
+        tunnel.message_channel = static_cast<unsigned char>(payload[0]);
+        DeliverChannelPayload(tunnel, payload.data() + 1, payload.size() - 1);
+        break;
+      case kOpcodeContinuation:
+        DeliverChannelPayload(tunnel, payload.data(), payload.size());
+        break;
+      case kOpcodePing:
+        AppendClientFrame(tunnel.to_api, kOpcodePong, nullptr, 0, payload.data(), payload.size(), random);
+        break;
+      case kOpcodePong:
+        break;
+      case kOpcodeClose:
+      default:
+        tunnel.api_closed = true;
+        break;
+    }
+  }
+  tunnel.from_api.erase(0, offset);
+}
+
+std::string ApiServerLabel(const ApiServerEndpoint& endpoint) {
+  return endpoint.host + ":" + std::to_string(endpoint.port);
+}
+
+}  // namespace
+
+bool ParseApiServerEndpoint(const std::string& url, ApiServerEndpoint& endpoint, std::string& error) {
+  constexpr const char* kScheme = "http://";
+  if (url.rfind("https://", 0) == 0) {
+    error = "apiServer '" + url +
+            "' uses https; the native port-forward engine only speaks plain HTTP (run `kubectl proxy` and point "
+            "apiServer at it)";
+    return false;
+  }
+  if (url.rfind(kScheme, 0) != 0) {
+    error = "apiServer '" + url + "' must start with http://";
+    return false;
+  }
+
+  const std::string rest = url.substr(std::strlen(kScheme));
+  const auto slash = rest.find('/');
+  const std::string authority = rest.substr(0, slash);
+  std::string prefix = slash == std::string::npos ? "" : rest.substr(slash);
+  while (!prefix.empty() && prefix.back() == '/') {
+    prefix.pop_back();
+  }
+
+  ApiServerEndpoint parsed;
+  parsed.path_prefix = prefix;
+  const auto colon = authority.rfind(':');
+  parsed.host = colon == std::string::npos ? authority : authority.substr(0, colon);
+  if (colon != std::string::npos) {
+    const std::string port_text = authority.substr(colon + 1);
+    int port = 0;
+    bool valid = !port_text.empty() && port_text.size() <= 5;
+    for (const char ch : port_text) {
+      valid = valid && ch >= '0' && ch <= '9';
+      port = port * 10 + (ch - '0');
+    }
+    if (!valid || port <= 0 || port > 65535) {
+      error = "apiServer '" + url + "' has an invalid port";
+      return false;
+    }
+    parsed.port = port;
+  }
+  if (parsed.host.empty()) {
+    error = "apiServer '" + url + "' is missing a host";
+    return false;
+  }
+
+  endpoint = parsed;
+  error.clear();
+  return true;
+}
+
+std::string WebSocketAcceptKey(const std::string& client_key) {
+  const auto digest = Sha1(client_key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+  return Base64Encode(digest.data(), digest.size());
+}
+
+NativePortForwarder::~NativePortForwarder() { Stop(); }
+
+std::string NativePortForwarder::lost_reason() const { return lost_ ? lost_reason_ : std::string(); }
+
+bool NativePortForwarder::Start(const NativePortForwardOptions& options, std::string& error) {
+  if (running()) {
+    error = "native port-forward is already running";
+    return false;
+  }
+  if (options.pod.empty() || options.namespace_name.empty() || options.ports.empty()) {
+    error = "native port-forward needs a pod, a namespace, and at least one port";
+    return false;
+  }
+  if (!ParseApiServerEndpoint(options.api_server, endpoint_, error)) {
+    return false;
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* resolved = nullptr;
+  const int lookup = ::getaddrinfo(endpoint_.host.c_str(), std::to_string(endpoint_.port).c_str(), &hints, &resolved);
+  if (lookup != 0 || resolved == nullptr) {
+    error = "failed to resolve API server " + ApiServerLabel(endpoint_) + ": " + ::gai_strerror(lookup);
+    return false;
+  }
+  std::memcpy(&api_address_, resolved->ai_addr, resolved->ai_addrlen);
+  api_address_length_ = static_cast<socklen_t>(resolved->ai_addrlen);
+  ::freeaddrinfo(resolved);
+
+  const auto fail = [&](const std::string& message) {
+    error = message;
+    for (auto& listener : listeners_) {
+      CloseFd(listener.fd);
+    }
+    listeners_.clear();
+    return false;
+  };
+
+  for (const auto& port : options.ports) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port.local_port));
+    if (port.local_port <= 0 || port.local_port > 65535 ||
+        ::inet_pton(AF_INET, options.bind_address.c_str(), &addr.sin_addr) != 1) {
+      return fail("invalid listen address " + options.bind_address + ":" + std::to_string(port.local_port));
+    }
+    Listener listener{.fd = ::socket(AF_INET, SOCK_STREAM, 0), .port = port};
+    if (listener.fd < 0) {
+      return fail(std::string("failed to create listener: ") + std::strerror(errno));
+    }
+    listeners_.push_back(listener);
+
+    const int reuse = 1;
+    (void)::setsockopt(listener.fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(listener.fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listener.fd, SOMAXCONN) != 0 || !SetNonBlocking(listener.fd)) {
+      return fail("unable to listen on " + options.bind_address + ":" + std::to_string(port.local_port) + ": " +
+                  std::strerror(errno));
+    }
+  }
+
+  if (::pipe(wake_pipe_) != 0 || !SetNonBlocking(wake_pipe_[0]) || !SetNonBlocking(wake_pipe_[1])) {
+    CloseFd(wake_pipe_[0]);
+    CloseFd(wake_pipe_[1]);
+    return fail("failed to create native port-forward wake pipe");
+  }
+
+  options_ = options;
+  stopping_ = false;
+  lost_ = false;
+  lost_reason_.clear();
+  thread_ = std::thread([this]() { Run(); });
+  error.clear();
+  return true;
+}
+
+void NativePortForwarder::Stop() {
+  if (thread_.joinable()) {
+    stopping_ = true;
+    const char byte = 0;
+    (void)::write(wake_pipe_[1], &byte, 1);
+    thread_.join();
+  }
+  for (auto& listener : listeners_) {
+    CloseFd(listener.fd);
+  }
+  listeners_.clear();
+  CloseFd(wake_pipe_[0]);
+  CloseFd(wake_pipe_[1]);
+}
+
+void NativePortForwarder::Run() {
+  std::random_device seed_source;
+  std::mt19937 random(seed_source());
+  std::vector<std::unique_ptr<Tunnel>> tunnels;
+  std::vector<pollfd> poll_fds;
+
+  const auto mark_lost = [this](const std::string& reason) {
+    if (!lost_) {
+      lost_reason_ = reason;
+      lost_ = true;
+      std::cerr << "error: " << reason << "\n";
+    }
+  };
+
+  while (!stopping_) {
+    poll_fds.clear();
+    poll_fds.push_back(pollfd{.fd = wake_pipe_[0], .events = POLLIN, .revents = 0});
+    for (const auto& listener : listeners_) {
+      poll_fds.push_back(pollfd{.fd = listener.fd, .events = POLLIN, .revents = 0});
+    }
+    for (const auto& tunnel : tunnels) {
+      short client_events = 0;
+      short api_events = 0;
+      if (tunnel->stage == TunnelStage::kConnecting) {
+        api_events = POLLOUT;
+      } else {
+        if (!tunnel->api_eof && !tunnel->api_closed && tunnel->to_client.size() < kMaxPendingBytes) {
+          api_events |= POLLIN;
+        }
+        if (!tunnel->to_api.empty()) {
+          api_events |= POLLOUT;
+        }
+      }
+      if (tunnel->stage == TunnelStage::kOpen && !tunnel->client_eof && tunnel->to_api.size() < kMaxPendingBytes) {
+        client_events |= POLLIN;
+      }
+      if (!tunnel->to_client.empty()) {
+        client_events |= POLLOUT;
+      }
+      poll_fds.push_back(pollfd{.fd = client_events != 0 ? tunnel->client_fd : -1, .events = client_events, .revents = 0});
+      poll_fds.push_back(pollfd{.fd = api_events != 0 ? tunnel->api_fd : -1, .events = api_events, .revents = 0});
+    }
+
+    if (::poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), -1) < 0 && errno != EINTR) {
+      // The relay stops serving here, so the loss has to be reported for the supervisor to replace this process.
+      mark_lost(std::string("poll failed: ") + std::strerror(errno));
+      break;
+    }
+    if (stopping_) {
+      break;
+    }
+    char drain[64];
+    while (::read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+    }
+
+    for (size_t i = 0; i < listeners_.size(); ++i) {
+      if (poll_fds[i + 1].revents == 0) {
+        continue;
+      }
+      while (true) {
+        const int client_fd = ::accept(listeners_[i].fd, nullptr, nullptr);
+        if (client_fd < 0) {
+          break;
+        }
+        auto tunnel = std::make_unique<Tunnel>();
+        tunnel->client_fd = client_fd;
+        tunnel->remote_port = listeners_[i].port.remote_port;
+        if (!PrepareStreamSocket(client_fd)) {
+          continue;
+        }
+        tunnel->api_fd = ::socket(api_address_.ss_family, SOCK_STREAM, 0);
+        if (tunnel->api_fd < 0 || !PrepareStreamSocket(tunnel->api_fd)) {
+          continue;
+        }
+        if (::connect(tunnel->api_fd, reinterpret_cast<const sockaddr*>(&api_address_), api_address_length_) != 0 &&
+            errno != EINPROGRESS && errno != EINTR) {
+          mark_lost("cannot reach API server " + ApiServerLabel(endpoint_) + ": " + std::strerror(errno));
+          continue;
+        }
+        unsigned char key_bytes[16];
+        for (auto& byte : key_bytes) {
+          byte = static_cast<unsigned char>(random());
+        }
+        tunnel->websocket_key = Base64Encode(key_bytes, sizeof(key_bytes));
+        tunnels.push_back(std::move(tunnel));
+      }
+    }
+
+    for (auto& tunnel : tunnels) {
+      if (tunnel->stage == TunnelStage::kConnecting) {
+        // Re-issuing connect() reports completion (EISCONN) or the failure of the in-flight attempt.
+        if (::connect(tunnel->api_fd, reinterpret_cast<const sockaddr*>(&api_address_), api_address_length_) != 0 &&
+            errno != EISCONN) {
+          if (errno != EALREADY && errno != EINPROGRESS && errno != EINTR) {
+            mark_lost("cannot reach API server " + ApiServerLabel(endpoint_) + ": " + std::strerror(errno));
+            tunnel->finished = true;
+          }
+          continue;
+        }
+        tunnel->stage = TunnelStage::kHandshake;
+        tunnel->to_api = BuildUpgradeRequest(endpoint_, options_, tunnel->remote_port, tunnel->websocket_key);
+      }
+
+      if (FlushTo(tunnel->api_fd, tunnel->to_api) == IoResult::kFailed ||
+          ReadInto(tunnel->api_fd, tunnel->from_api,
+                   tunnel->stage == TunnelStage::kOpen ? kMaxPendingBytes : kMaxHandshakeBytes + 1,
+                   tunnel->api_eof) == IoResult::kFailed) {
+        tunnel->finished = true;
+        continue;
+      }
+
+      if (tunnel->stage == TunnelStage::kHandshake) {
+        std::string handshake_error;
+        const auto result = ParseHandshake(*tunnel, handshake_error);
+        if (result == HandshakeResult::kRejected) {
+          mark_lost(handshake_error + " (pod " + options_.namespace_name + "/" + options_.pod + ")");
+          tunnel->finished = true;
+          continue;
+        }
+        if (result == HandshakeResult::kPending) {
+          if (tunnel->api_eof) {
+            mark_lost("API server " + ApiServerLabel(endpoint_) + " closed the connection during the portforward upgrade");
+            tunnel->finished = true;
+          }
+          continue;
+        }
+        tunnel->stage = TunnelStage::kOpen;
+      }
+
+      if (tunnel->to_client.size() < kMaxPendingBytes) {
+        ParseFrames(*tunnel, random);
+      }
+      if (!tunnel->remote_error.empty()) {
+        std::cerr << "error forwarding port " << tunnel->remote_port << " to pod " << options_.namespace_name << "/"
+                  << options_.pod << ": " << tunnel->remote_error << "\n";
+        tunnel->remote_error.clear();
+        tunnel->api_closed = true;
+      }
+
+      if (!tunnel->client_eof && tunnel->to_api.size() < kMaxPendingBytes) {
+        std::string chunk;
+        bool client_eof = false;
+        if (ReadInto(tunnel->client_fd, chunk, kReadChunkSize, client_eof) == IoResult::kFailed) {
+          tunnel->finished = true;
+          continue;
+        }
+        if (!chunk.empty()) {
+          AppendClientFrame(tunnel->to_api, kOpcodeBinary, &kDataChannel, 1, chunk.data(), chunk.size(), random);
+        }
+        if (client_eof) {
+          // v4 cannot half-close a channel, so the tunnel stays up until the pod side closes it.
+          tunnel->client_eof = true;
+        }
+      }
+
+      if (FlushTo(tunnel->api_fd, tunnel->to_api) == IoResult::kFailed ||
+          FlushTo(tunnel->client_fd, tunnel->to_client) == IoResult::kFailed) {
+        tunnel->finished = true;
+        continue;
+      }
+      if (tunnel->to_client.empty() && tunnel->api_eof && !tunnel->api_closed) {
+        // Frames held back while the client was slow can only be parsed now that the queue drained.
+        ParseFrames(*tunnel, random);
+        if (FlushTo(tunnel->client_fd, tunnel->to_client) == IoResult::kFailed) {
+          tunnel->finished = true;
+          continue;
+        }
+      }
+      if (tunnel->to_client.empty() && (tunnel->api_closed || tunnel->api_eof)) {
+        tunnel->finished = true;
+      }
+    }
+
+    tunnels.erase(std::remove_if(tunnels.begin(), tunnels.end(), [](const auto& tunnel) { return tunnel->finished; }),
+                  tunnels.end());
+  }
+}
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,332 @@
+#include "kubeforward/runtime/pod_resolver.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <utility>
+
+#include "kubeforward/runtime/command_capture.h"
+
+namespace kubeforward::runtime {
+namespace {
+
+const char* WorkloadResource(config::ResourceKind kind) {
+  switch (kind) {
+    case config::ResourceKind::kDeployment:
+      return "deployment";
+    case config::ResourceKind::kStatefulSet:
+      return "statefulset";
+    case config::ResourceKind::kService:
+      return "service";
+    case config::ResourceKind::kPod:
+      return "pod";
+  }
+  return "pod";
+}
+
+std::vector<std::string> KubectlGetArgv(const std::string& kubectl, const PodLookupKey& key) {
+  std::vector<std::string> argv = {kubectl, "get"};
+  argv.push_back("--namespace");
+  argv.push_back(key.namespace_name);
+  if (key.context.has_value() && !key.context->empty()) {
+    argv.push_back("--context");
+    argv.push_back(*key.context);
+  }
+  if (key.kubeconfig.has_value() && !key.kubeconfig->empty()) {
+    argv.push_back("--kubeconfig");
+    argv.push_back(*key.kubeconfig);
+  }
+  return argv;
+}
+
+std::string TargetName(const PodLookupKey& key) { return std::string(WorkloadResource(key.kind)) + "/" + key.name; }
+
+std::optional<int> ParsePort(const std::string& text) {
+  char* end = nullptr;
+  errno = 0;
+  const long port = std::strtol(text.c_str(), &end, 10);
+  if (text.empty() || errno != 0 || *end != '\0' || port < 1 || port > 65535) {
+    return std::nullopt;
+  }
+  return static_cast<int>(port);
+}
+
+//! The workload's selector on the first line as the matchLabels map, then one `KEY OPERATOR VALUE...` line per
+//! matchExpressions entry.
+constexpr const char* kWorkloadSelectorJsonPath =
+    "jsonpath={.spec.selector.matchLabels}{\"\\n\"}"
+    "{range .spec.selector.matchExpressions[*]}{.key}{\" \"}{.operator}{\" \"}{.values[*]}{\"\\n\"}{end}";
+
+//! Turns the output of kWorkloadSelectorJsonPath into a `--selector` argument; std::nullopt when it cannot be
+//! parsed, an empty string when the selector has no requirements.
+std::optional<std::string> ParseWorkloadSelector(const std::string& output) {
+  std::istringstream lines(output);
+  std::string line;
+  std::getline(lines, line);
+  const auto labels = line.empty() ? std::optional<std::map<std::string, std::string>>(std::in_place)
+                                   : ParseLabelSelectorJson(line);
+  if (!labels.has_value()) {
+    return std::nullopt;
+  }
+  std::vector<std::string> requirements;
+  for (const auto& [label, value] : *labels) {
+    requirements.push_back(label + "=" + value);
+  }
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::string op;
+    if (!(fields >> key)) {
+      continue;
+    }
+    fields >> op;
+    std::string values;
+    for (std::string value; fields >> value;) {
+      values += (values.empty() ? "" : ",") + value;
+    }
+    if (op == "In" || op == "NotIn") {
+      requirements.push_back(key + (op == "In" ? " in (" : " notin (") + values + ")");
+    } else if (op == "Exists" || op == "DoesNotExist") {
+      requirements.push_back((op == "Exists" ? "" : "!") + key);
+    } else {
+      return std::nullopt;
+    }
+  }
+  std::string selector;
+  for (const auto& requirement : requirements) {
+    selector += (selector.empty() ? "" : ",") + requirement;
+  }
+  return selector;
+}
+
+}  // namespace
+
+bool PodLookupKey::operator<(const PodLookupKey& other) const {
+  return std::tie(kind, name, namespace_name, context, kubeconfig) <
+         std::tie(other.kind, other.name, other.namespace_name, other.context, other.kubeconfig);
+}
+
+PodResolutionCache::PodResolutionCache(std::chrono::milliseconds ttl, PodLookup lookup)
+    : ttl_(ttl), lookup_(std::move(lookup)) {}
+
+std::optional<ResolvedPod> PodResolutionCache::Resolve(const PodLookupKey& key, std::string& error) {
+  const auto now = std::chrono::steady_clock::now();
+  const auto cached = entries_.find(key);
+  if (cached != entries_.end() && now - cached->second.resolved_at < ttl_) {
+    error.clear();
+    return cached->second.pod;
+  }
+
+  ++lookups_;
+  auto pod = lookup_(key, error);
+  if (!pod.has_value()) {
+    entries_.erase(key);
+    return std::nullopt;
+  }
+  entries_[key] = Entry{.pod = *pod, .resolved_at = now};
+  error.clear();
+  return pod;
+}
+
+void PodResolutionCache::Invalidate(const PodLookupKey& key) { entries_.erase(key); }
+
+std::optional<std::map<std::string, std::string>> ParseLabelSelectorJson(const std::string& json) {
+  std::map<std::string, std::string> labels;
+  size_t pos = 0;
+  const auto skip_space = [&]() {
+    while (pos < json.size() && std::isspace(static_cast<unsigned char>(json[pos])) != 0) {
+      ++pos;
+    }
+  };
+  const auto read_string = [&]() -> std::optional<std::string> {
+    skip_space();
+    if (pos >= json.size() || json[pos] != '"') {
+      return std::nullopt;
+    }
+    std::string value;
+    for (++pos; pos < json.size(); ++pos) {
+      if (json[pos] == '"') {
+        ++pos;
+        return value;
+      }
+      if (json[pos] == '\\' && pos + 1 < json.size()) {
+        ++pos;
+      }
+      value.push_back(json[pos]);
+    }
+    return std::nullopt;
+  };
+
+  skip_space();
+  if (pos >= json.size() || json[pos] != '{') {
+    return std::nullopt;
+  }
+  ++pos;
+  skip_space();
+  if (pos < json.size() && json[pos] == '}') {
+    return labels;
+  }
+  while (true) {
+    const auto label = read_string();
+    skip_space();
+    if (!label.has_value() || pos >= json.size() || json[pos] != ':') {
+      return std::nullopt;
+    }
+    ++pos;
+    const auto value = read_string();
+    if (!value.has_value()) {
+      return std::nullopt;
+    }
+    labels[*label] = *value;
+    skip_space();
+    if (pos < json.size() && json[pos] == ',') {
+      ++pos;
+      continue;
+    }
+    if (pos < json.size() && json[pos] == '}') {
+      return labels;
+    }
+    return std::nullopt;
+  }
+}
+
+std::optional<ResolvedPod> LookupPodWithKubectl(const std::string& kubectl, const PodLookupKey& key,
+                                                std::chrono::milliseconds timeout, std::string& error) {
+  if (key.kind == config::ResourceKind::kPod) {
+    error.clear();
+    return ResolvedPod{.name = key.name};
+  }
+
+  if (key.kind == config::ResourceKind::kService) {
+    auto pods = LookupServicePodsWithKubectl(kubectl, key, timeout, error);
+    if (!pods.has_value()) {
+      return std::nullopt;
+    }
+    return pods->front();
+  }
+
+  std::string output;
+  auto selector_argv = KubectlGetArgv(kubectl, key);
+  selector_argv.insert(selector_argv.begin() + 2, {WorkloadResource(key.kind), key.name});
+  selector_argv.push_back("-o");
+  selector_argv.push_back(kWorkloadSelectorJsonPath);
+  if (!RunCommandCapturingOutput(selector_argv, {}, timeout, output, error)) {
+    error = "failed to resolve " + TargetName(key) + ": " + error;
+    return std::nullopt;
+  }
+  const auto selector = ParseWorkloadSelector(output);
+  if (!selector.has_value() || selector->empty()) {
+    error = TargetName(key) + " has no selector to resolve pods with";
+    return std::nullopt;
+  }
+
+  auto pods_argv = KubectlGetArgv(kubectl, key);
+  pods_argv.insert(pods_argv.begin() + 2, {"pods", "--selector", *selector});
+  pods_argv.push_back("-o");
+  pods_argv.push_back(
+      "jsonpath={range .items[*]}{.metadata.name}{\" \"}{.status.phase}{\" \"}"
+      "{.status.conditions[?(@.type==\"Ready\")].status}{\" \"}{.metadata.deletionTimestamp}{\"\\n\"}{end}");
+  if (!RunCommandCapturingOutput(pods_argv, {}, timeout, output, error)) {
+    error = "failed to list pods of " + TargetName(key) + ": " + error;
+    return std::nullopt;
+  }
+
+  std::optional<std::string> chosen;
+  std::istringstream lines(output);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string name;
+    std::string phase;
+    std::string ready;
+    std::string deleting;
+    fields >> name >> phase >> ready >> deleting;
+    if (name.empty() || phase != "Running" || ready != "True" || !deleting.empty()) {
+      continue;
+    }
+    if (!chosen.has_value() || name < *chosen) {
+      chosen = name;
+    }
+  }
+  if (!chosen.has_value()) {
+    error = TargetName(key) + " has no running and ready pods";
+    return std::nullopt;
+  }
+  error.clear();
+  return ResolvedPod{.name = *chosen};
+}
+
+std::optional<std::vector<ResolvedPod>> LookupServicePodsWithKubectl(const std::string& kubectl,
+                                                                    const PodLookupKey& key,
+                                                                    std::chrono::milliseconds timeout,
+                                                                    std::string& error) {
+  // Endpoint ports carry the name of the service port they serve (empty for a single unnamed one), not its number.
+  auto service_argv = KubectlGetArgv(kubectl, key);
+  service_argv.insert(service_argv.begin() + 2, {"service", key.name});
+  service_argv.push_back("-o");
+  service_argv.push_back("jsonpath={range .spec.ports[*]}{.port}{\"=\"}{.name}{\" \"}{end}");
+  std::string output;
+  if (!RunCommandCapturingOutput(service_argv, {}, timeout, output, error)) {
+    error = "failed to resolve " + TargetName(key) + ": " + error;
+    return std::nullopt;
+  }
+  std::map<std::string, int> service_ports;
+  std::istringstream service_entries(output);
+  for (std::string entry; service_entries >> entry;) {
+    const auto separator = entry.find('=');
+    const auto port = ParsePort(entry.substr(0, separator));
+    if (separator != std::string::npos && port.has_value()) {
+      service_ports[entry.substr(separator + 1)] = *port;
+    }
+  }
+
+  auto argv = KubectlGetArgv(kubectl, key);
+  argv.insert(argv.begin() + 2, {"endpoints", key.name});
+  argv.push_back("-o");
+  // One line per subset: its pods, then its `name=port` pairs. Only `addresses` are listed: endpoints that are not
+  // ready sit in `notReadyAddresses`.
+  argv.push_back(
+      "jsonpath={range .subsets[*]}{.addresses[*].targetRef.name}{\"|\"}"
+      "{range .ports[*]}{.name}{\"=\"}{.port}{\" \"}{end}{\"\\n\"}{end}");
+  if (!RunCommandCapturingOutput(argv, {}, timeout, output, error)) {
+    error = "failed to resolve " + TargetName(key) + ": " + error;
+    return std::nullopt;
+  }
+  // A pod serving several ports of the service may be listed once per subset.
+  std::map<std::string, ResolvedPod> pods;
+  std::istringstream subsets(output);
+  for (std::string subset; std::getline(subsets, subset);) {
+    const auto separator = subset.find('|');
+    std::map<int, int> target_ports;
+    std::istringstream port_entries(separator == std::string::npos ? "" : subset.substr(separator + 1));
+    for (std::string entry; port_entries >> entry;) {
+      const auto equals = entry.find('=');
+      const auto service_port = service_ports.find(entry.substr(0, equals));
+      const auto port = ParsePort(equals == std::string::npos ? "" : entry.substr(equals + 1));
+      if (service_port != service_ports.end() && port.has_value()) {
+        target_ports[service_port->second] = *port;
+      }
+    }
+    std::istringstream names(subset.substr(0, separator));
+    for (std::string name; names >> name;) {
+      auto& pod = pods[name];
+      pod.name = name;
+      pod.target_ports.insert(target_ports.begin(), target_ports.end());
+    }
+  }
+  if (pods.empty()) {
+    error = TargetName(key) + " has no ready endpoints";
+    return std::nullopt;
+  }
+  error.clear();
+  std::vector<ResolvedPod> resolved;
+  for (auto& [name, pod] : pods) {
+    resolved.push_back(std::move(pod));
+  }
+  return resolved;
+}
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,234 @@
+#include "kubeforward/runtime/port_probe.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace kubeforward::runtime {
+namespace {
+
+#if defined(__linux__)
+
+//! Address a probe must match, kept in network byte order.
+struct ProbeTarget {
+  uint16_t port = 0;
+  in_addr ipv4{};
+};
+
+std::optional<ProbeTarget> MakeProbeTarget(const std::string& bind_address, int port) {
+  if (port <= 0 || port > 65535) {
+    return std::nullopt;
+  }
+  ProbeTarget target;
+  target.port = static_cast<uint16_t>(port);
+  if (::inet_pton(AF_INET, bind_address.c_str(), &target.ipv4) != 1) {
+    return std::nullopt;
+  }
+  return target;
+}
+
+bool MatchesIpv4Listener(const ProbeTarget& target, uint32_t listener_addr) {
+  return listener_addr == INADDR_ANY || listener_addr == target.ipv4.s_addr;
+}
+
+bool MatchesIpv6Listener(const ProbeTarget& target, const std::array<uint32_t, 4>& listener_words) {
+  in6_addr listener{};
+  std::memcpy(&listener, listener_words.data(), sizeof(listener));
+  if (IN6_IS_ADDR_UNSPECIFIED(&listener)) {
+    return true;
+  }
+  if (IN6_IS_ADDR_V4MAPPED(&listener)) {
+    uint32_t mapped = 0;
+    std::memcpy(&mapped, &listener.s6_addr[12], sizeof(mapped));
+    return MatchesIpv4Listener(target, mapped);
+  }
+  return false;
+}
+
+//! Dumps listening sockets for one address family through NETLINK_SOCK_DIAG. Returns nullopt when netlink is
+//! unavailable so callers can fall back to procfs.
+std::optional<bool> QuerySockDiagListener(const ProbeTarget& target, int family) {
+  const int fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  struct {
+    nlmsghdr header;
+    inet_diag_req_v2 request;
+  } message{};
+  message.header.nlmsg_len = sizeof(message);
+  message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  message.request.sdiag_family = static_cast<uint8_t>(family);
+  message.request.sdiag_protocol = IPPROTO_TCP;
+  message.request.idiag_states = 1U << TCP_LISTEN;
+
+  sockaddr_nl kernel{};
+  kernel.nl_family = AF_NETLINK;
+  if (::sendto(fd, &message, sizeof(message), 0, reinterpret_cast<const sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  alignas(nlmsghdr) std::array<char, 16384> buffer{};
+  bool found = false;
+  while (true) {
+    const ssize_t received = ::recv(fd, buffer.data(), buffer.size(), 0);
+    if (received < 0) {
+      ::close(fd);
+      return std::nullopt;
+    }
+    if (received == 0) {
+      break;
+    }
+
+    auto remaining = static_cast<int>(received);
+    for (auto* header = reinterpret_cast<nlmsghdr*>(buffer.data()); NLMSG_OK(header, remaining);
+         header = NLMSG_NEXT(header, remaining)) {
+      if (header->nlmsg_type == NLMSG_DONE) {
+        ::close(fd);
+        return found;
+      }
+      if (header->nlmsg_type == NLMSG_ERROR) {
+        ::close(fd);
+        return std::nullopt;
+      }
+      if (found) {
+        continue;
+      }
+
+      const auto* diag = reinterpret_cast<const inet_diag_msg*>(NLMSG_DATA(header));
+      if (ntohs(diag->id.idiag_sport) != target.port) {
+        continue;
+      }
+      if (diag->idiag_family == AF_INET) {
+        found = MatchesIpv4Listener(target, diag->id.idiag_src[0]);
+      } else {
+        const std::array<uint32_t, 4> words = {diag->id.idiag_src[0], diag->id.idiag_src[1], diag->id.idiag_src[2],
+                                               diag->id.idiag_src[3]};
+        found = MatchesIpv6Listener(target, words);
+      }
+    }
+  }
+
+  ::close(fd);
+  return found;
+}
+
+std::optional<uint32_t> ParseHexWord(const std::string& value) {
+  char* end = nullptr;
+  const unsigned long parsed = std::strtoul(value.c_str(), &end, 16);
+  if (value.empty() || end == nullptr || *end != '\0') {
+    return std::nullopt;
+  }
+  return static_cast<uint32_t>(parsed);
+}
+
+//! Parses one /proc/net/tcp{,6} table. Returns nullopt when the file cannot be read.
+std::optional<bool> ScanProcNetTcp(const ProbeTarget& target, const char* path, bool ipv6) {
+  std::ifstream input(path);
+  if (!input.is_open()) {
+    return std::nullopt;
+  }
+
+  std::string line;
+  std::getline(input, line);
+  while (std::getline(input, line)) {
+    // Layout: "sl: LOCAL_ADDR:PORT REMOTE_ADDR:PORT ST ..." with addresses printed as raw 32-bit words.
+    std::istringstream fields(line);
+    std::string slot;
+    std::string local;
+    std::string remote;
+    std::string state;
+    if (!(fields >> slot >> local >> remote >> state) || state != "0A") {
+      continue;
+    }
+
+    const auto port_separator = local.find(':');
+    if (port_separator == std::string::npos) {
+      continue;
+    }
+    const auto listener_port = ParseHexWord(local.substr(port_separator + 1));
+    if (!listener_port.has_value() || *listener_port != target.port) {
+      continue;
+    }
+
+    const std::string address = local.substr(0, port_separator);
+    if (!ipv6 && address.size() == 8) {
+      const auto word = ParseHexWord(address);
+      if (word.has_value() && MatchesIpv4Listener(target, *word)) {
+        return true;
+      }
+    } else if (ipv6 && address.size() == 32) {
+      std::array<uint32_t, 4> words{};
+      bool valid = true;
+      for (size_t i = 0; i < words.size() && valid; ++i) {
+        const auto word = ParseHexWord(address.substr(i * 8, 8));
+        valid = word.has_value();
+        words[i] = word.value_or(0);
+      }
+      if (valid && MatchesIpv6Listener(target, words)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::optional<bool> QueryListener(const ProbeTarget& target, int family) {
+  if (const auto diag = QuerySockDiagListener(target, family)) {
+    return diag;
+  }
+  return family == AF_INET ? ScanProcNetTcp(target, "/proc/net/tcp", false)
+                           : ScanProcNetTcp(target, "/proc/net/tcp6", true);
+}
+
+#endif
+
+}  // namespace
+
+TcpListenerProbe ProbeTcpListener(const std::string& bind_address, int port) {
+#if defined(__linux__)
+  const auto target = MakeProbeTarget(bind_address, port);
+  if (!target.has_value()) {
+    return TcpListenerProbe::kNotListening;
+  }
+
+  bool probed = false;
+  for (const int family : {AF_INET, AF_INET6}) {
+    const auto listening = QueryListener(*target, family);
+    if (!listening.has_value()) {
+      continue;
+    }
+    if (*listening) {
+      return TcpListenerProbe::kListening;
+    }
+    probed = true;
+  }
+  return probed ? TcpListenerProbe::kNotListening : TcpListenerProbe::kUnavailable;
+#else
+  (void)bind_address;
+  (void)port;
+  return TcpListenerProbe::kUnavailable;
+#endif
+}
+
+}  // namespace kubeforward::runtime
@@ -0,0 +1,278 @@
+#include "kubeforward/runtime/process_identity.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+
+#if defined(__APPLE__)
+#include <libproc.h>
+#include <sys/proc_info.h>
+#include <sys/sysctl.h>
+#endif
+
+namespace kubeforward::runtime {
+namespace {
+
+std::uint64_t HashArgv(const std::vector<std::string>& argv) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  const auto mix = [&hash](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  };
+  for (const auto& arg : argv) {
+    for (const char ch : arg) {
+      mix(static_cast<unsigned char>(ch));
+    }
+    mix(0);
+  }
+  return hash;
+}
+
+std::uint64_t InodeOf(const std::string& path) {
+  struct stat info {};
+  if (path.empty() || ::stat(path.c_str(), &info) != 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(info.st_ino);
+}
+
+#if defined(__linux__)
+
+std::string ProcPath(int pid, const char* entry) { return "/proc/" + std::to_string(pid) + "/" + entry; }
+
+//! Field 22 of /proc/PID/stat. The comm field may contain spaces and parentheses, so parsing starts after the last ')'.
+std::optional<std::uint64_t> ReadLinuxStartTime(int pid) {
+  std::ifstream input(ProcPath(pid, "stat"));
+  std::string line;
+  if (!std::getline(input, line)) {
+    return std::nullopt;
+  }
+  const auto comm_end = line.rfind(')');
+  if (comm_end == std::string::npos) {
+    return std::nullopt;
+  }
+
+  std::istringstream fields(line.substr(comm_end + 1));
+  std::string field;
+  // Fields after comm start at 3 (state); starttime is field 22.
+  for (int index = 3; index <= 22; ++index) {
+    if (!(fields >> field)) {
+      return std::nullopt;
+    }
+  }
+  try {
+    return static_cast<std::uint64_t>(std::stoull(field));
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
+std::string ReadLinuxCmdline(int pid) {
+  std::ifstream input(ProcPath(pid, "cmdline"), std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+}
+
+//! True for a user process that is still inside execve(): posix_spawn() returns once the child has switched to the
+//! new image, but the kernel publishes the new argv (and /proc/PID/exe) a moment later. Zombies and kernel threads
+//! (PF_KTHREAD) also have an empty cmdline, permanently, so they are excluded.
+bool IsLinuxExecInFlight(int pid) {
+  std::ifstream input(ProcPath(pid, "stat"));
+  std::string line;
+  if (!std::getline(input, line)) {
+    return false;
+  }
+  const auto comm_end = line.rfind(')');
+  if (comm_end == std::string::npos) {
+    return false;
+  }
+  std::istringstream fields(line.substr(comm_end + 1));
+  std::string state;
+  std::string field;
+  fields >> state;
+  // Fields 4..9 are ppid, pgrp, session, tty_nr, tpgid, flags.
+  for (int index = 4; index <= 9; ++index) {
+    if (!(fields >> field)) {
+      return false;
+    }
+  }
+  constexpr unsigned long kPfKthread = 0x00200000UL;
+  try {
+    return state != "Z" && state != "X" && (std::stoul(field) & kPfKthread) == 0;
+  } catch (...) {
+    return false;
+  }
+}
+
+//! Reads /proc/PID/cmdline, giving a freshly spawned child a short bounded window to finish publishing its argv.
+std::string ReadSettledLinuxCmdline(int pid) {
+  std::string raw = ReadLinuxCmdline(pid);
+  for (int attempt = 0; raw.empty() && attempt < 50 && IsLinuxExecInFlight(pid); ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    raw = ReadLinuxCmdline(pid);
+  }
+  return raw;
+}
+
+#elif defined(__APPLE__)
+
+std::optional<std::uint64_t> ReadDarwinStartTime(int pid) {
+  proc_bsdinfo info {};
+  if (::proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, sizeof(info)) != static_cast<int>(sizeof(info))) {
+    return std::nullopt;
+  }
+  return static_cast<std::uint64_t>(info.pbi_start_tvsec) * 1000000ULL +
+         static_cast<std::uint64_t>(info.pbi_start_tvusec);
+}
+
+std::uint64_t ReadDarwinExeInode(int pid) {
+  char path[PROC_PIDPATHINFO_MAXSIZE] = {};
+  if (::proc_pidpath(pid, path, sizeof(path)) <= 0) {
+    return 0;
+  }
+  return InodeOf(path);
+}
+
+#endif
+
+}  // namespace
+
+std::optional<std::vector<std::string>> ReadProcessArgv(int pid) {
+  if (pid <= 0) {
+    return std::nullopt;
+  }
+#if defined(__linux__)
+  const std::string raw = ReadSettledLinuxCmdline(pid);
+  if (raw.empty()) {
+    // Zombies and kernel threads expose an empty cmdline.
+    return std::nullopt;
+  }
+
+  std::vector<std::string> argv;
+  size_t start = 0;
+  while (start < raw.size()) {
+    auto end = raw.find('\0', start);
+    if (end == std::string::npos) {
+      end = raw.size();
+    }
+    argv.push_back(raw.substr(start, end - start));
+    start = end + 1;
+  }
+  return argv;
+#elif defined(__APPLE__)
+  int mib[3] = {CTL_KERN, KERN_PROCARGS2, pid};
+  size_t size = 0;
+  if (::sysctl(mib, 3, nullptr, &size, nullptr, 0) != 0 || size < sizeof(int)) {
+    return std::nullopt;
+  }
+  std::string buffer(size, '\0');
+  if (::sysctl(mib, 3, buffer.data(), &size, nullptr, 0) != 0 || size < sizeof(int)) {
+    return std::nullopt;
+  }
+  buffer.resize(size);
+
+  // Layout: int argc, exec path, NUL padding, then argc NUL-terminated arguments.
+  int argc = 0;
+  std::memcpy(&argc, buffer.data(), sizeof(argc));
+  size_t offset = buffer.find('\0', sizeof(int));
+  while (offset < buffer.size() && buffer[offset] == '\0') {
+    ++offset;
+  }
+
+  std::vector<std::string> argv;
+  while (static_cast<int>(argv.size()) < argc && offset < buffer.size()) {
+    const auto end = buffer.find('\0', offset);
+    if (end == std::string::npos) {
+      break;
+    }
+    argv.push_back(buffer.substr(offset, end - offset));
+    offset = end + 1;
+  }
+  if (argv.empty()) {
+    return std::nullopt;
+  }
+  return argv;
+#else
+  return std::nullopt;
+#endif
+}
+
+std::optional<ProcessFingerprint> ReadProcessFingerprint(int pid) {
+  if (pid <= 0) {
+    return std::nullopt;
+  }
+#if defined(__linux__)
+  // Settle first so /proc/PID/exe already points at the new image rather than the launcher's.
+  (void)ReadSettledLinuxCmdline(pid);
+  const auto start_time = ReadLinuxStartTime(pid);
+  const std::uint64_t exe_inode = InodeOf(ProcPath(pid, "exe"));
+#elif defined(__APPLE__)
+  const auto start_time = ReadDarwinStartTime(pid);
+  const std::uint64_t exe_inode = ReadDarwinExeInode(pid);
+#else
+  const std::optional<std::uint64_t> start_time;
+  const std::uint64_t exe_inode = 0;
+#endif
+  if (!start_time.has_value()) {
+    return std::nullopt;
+  }
+
+  ProcessFingerprint fingerprint;
+  fingerprint.start_time = *start_time;
+  fingerprint.exe_inode = exe_inode;
+  if (const auto argv = ReadProcessArgv(pid)) {
+    fingerprint.cmdline_hash = HashArgv(*argv);
+  }
+  return fingerprint;
+}
+
+bool IsZombieProcess(int pid) {
+  if (pid <= 0) {
+    return false;
+  }
+#if defined(__linux__)
+  std::ifstream input(ProcPath(pid, "stat"));
+  std::string line;
+  if (!std::getline(input, line)) {
+    return false;
+  }
+  const auto comm_end = line.rfind(')');
+  if (comm_end == std::string::npos) {
+    return false;
+  }
+  std::istringstream fields(line.substr(comm_end + 1));
+  std::string state;
+  fields >> state;
+  return state == "Z";
+#elif defined(__APPLE__)
+  proc_bsdinfo info {};
+  return ::proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, sizeof(info)) == static_cast<int>(sizeof(info)) &&
+         info.pbi_status == SZOMB;
+#else
+  return false;
+#endif
+}
+
+FingerprintMatch CompareProcessFingerprint(int pid, const ProcessFingerprint& expected) {
+  const auto live = ReadProcessFingerprint(pid);
+  if (!live.has_value() || expected.empty()) {
+    return FingerprintMatch::kUnavailable;
+  }
+  if (live->start_time != expected.start_time) {
+    return FingerprintMatch::kMismatch;
+  }
+  // Fields that could not be read at either end (e.g. /proc/PID/exe of another user) are not compared.
+  if (live->exe_inode != 0 && expected.exe_inode != 0 && live->exe_inode != expected.exe_inode) {
+    return FingerprintMatch::kMismatch;
+  }
+  if (live->cmdline_hash != 0 && expected.cmdline_hash != 0 && live->cmdline_hash != expected.cmdline_hash) {
+    return FingerprintMatch::kMismatch;
+  }
+  return FingerprintMatch::kMatch;
+}
+
+}  // namespace kubeforward::runtime
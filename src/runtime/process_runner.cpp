@@ -1,5 +1,6 @@
 #include "kubeforward/runtime/process_runner.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cstring>
@@ -10,11 +11,25 @@
 
 #include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+// posix_spawn_file_actions_addchdir_np() is what makes the spawn path usable (forwards run in the config directory);
+// it ships with macOS 10.15+ and glibc 2.29+.
+#if defined(__APPLE__) || (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+#define KF_HAVE_POSIX_SPAWN_CHDIR 1
+#else
+#define KF_HAVE_POSIX_SPAWN_CHDIR 0
+#endif
+
+extern char** environ;
+
 namespace {
 
+using kubeforward::runtime::StartedProcess;
+using kubeforward::runtime::StartProcessRequest;
+
 std::vector<char*> ToExecArgv(const std::vector<std::string>& args) {
   std::vector<char*> argv;
   argv.reserve(args.size() + 1);
@@ -25,6 +40,29 @@ std::vector<char*> ToExecArgv(const std::vector<std::string>& args) {
   return argv;
 }
 
+void ClosePipe(int (&fds)[2]) {
+  for (int& fd : fds) {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+}
+
+//! Creates a pipe whose ends are both close-on-exec; the child dup2()s the write end onto a standard stream.
+bool OpenOutputPipe(int (&fds)[2]) {
+  if (::pipe(fds) != 0) {
+    fds[0] = -1;
+    fds[1] = -1;
+    return false;
+  }
+  if (::fcntl(fds[0], F_SETFD, FD_CLOEXEC) != 0 || ::fcntl(fds[1], F_SETFD, FD_CLOEXEC) != 0) {
+    ClosePipe(fds);
+    return false;
+  }
+  return true;
+}
+
 bool IsProcessGroupAlive(pid_t pgid) {
   if (pgid <= 0) {
     return false;
@@ -60,25 +98,25 @@ bool WaitForProcessGroupExit(pid_t pgid, int timeout_ms) {
   return !IsProcessGroupAlive(pgid);
 }
 
-}  // namespace
-
-namespace kubeforward::runtime {
-
-std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessRequest& request, std::string& error) {
-  if (request.argv.empty()) {
-    error = "process argv cannot be empty";
-    return std::nullopt;
-  }
-
-  if (request.daemon && !request.log_path.empty()) {
-    std::error_code ec;
-    std::filesystem::create_directories(request.log_path.parent_path(), ec);
-    if (ec) {
-      error = "failed to create log directory: " + ec.message();
-      return std::nullopt;
+//! Waits until every group in `pgids` is gone or `timeout_ms` elapses; exited groups are removed from `pgids`.
+void WaitForProcessGroupsExit(std::vector<pid_t>& pgids, int timeout_ms) {
+  const int step_ms = 50;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (true) {
+    pgids.erase(std::remove_if(pgids.begin(), pgids.end(),
+                               [](pid_t pgid) {
+                                 return ::waitpid(pgid, nullptr, WNOHANG) == pgid || !IsProcessGroupAlive(pgid);
+                               }),
+                pgids.end());
+    if (pgids.empty() || std::chrono::steady_clock::now() >= deadline) {
+      return;
     }
+    std::this_thread::sleep_for(std::chrono::milliseconds(step_ms));
   }
+}
 
+//! Classic fork()+execvp() launch; the child reports exec/chdir/redirection errno back over a close-on-exec pipe.
+std::optional<StartedProcess> ForkAndExec(const StartProcessRequest& request, std::string& error) {
   int exec_pipe[2] = {-1, -1};
   if (::pipe(exec_pipe) != 0) {
     error = "failed to create exec status pipe";
@@ -91,9 +129,22 @@ std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessReques
     return std::nullopt;
   }
 
+  int stdout_pipe[2] = {-1, -1};
+  int stderr_pipe[2] = {-1, -1};
+  if (request.capture_output && (!OpenOutputPipe(stdout_pipe) || !OpenOutputPipe(stderr_pipe))) {
+    error = "failed to create output capture pipes";
+    ClosePipe(stdout_pipe);
+    ClosePipe(stderr_pipe);
+    ::close(exec_pipe[0]);
+    ::close(exec_pipe[1]);
+    return std::nullopt;
+  }
+
   const pid_t pid = ::fork();
   if (pid < 0) {
     error = "failed to fork process";
+    ClosePipe(stdout_pipe);
+    ClosePipe(stderr_pipe);
     ::close(exec_pipe[0]);
     ::close(exec_pipe[1]);
     return std::nullopt;
@@ -109,7 +160,15 @@ std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessReques
       _exit(127);
     }
 
-    if (request.daemon) {
+    if (request.daemon && request.capture_output) {
+      const int in_fd = ::open("/dev/null", O_RDONLY);
+      if (in_fd < 0 || ::dup2(in_fd, STDIN_FILENO) < 0) {
+        const int child_errno = errno;
+        (void)::write(exec_pipe[1], &child_errno, sizeof(child_errno));
+        _exit(127);
+      }
+      ::close(in_fd);
+    } else if (request.daemon) {
       const char* sink_path = "/dev/null";
       std::string sink_path_storage;
       if (!request.log_path.empty()) {
@@ -144,6 +203,14 @@ std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessReques
       ::close(out_fd);
     }
 
+    if (request.capture_output) {
+      if (::dup2(stdout_pipe[1], STDOUT_FILENO) < 0 || ::dup2(stderr_pipe[1], STDERR_FILENO) < 0) {
+        const int child_errno = errno;
+        (void)::write(exec_pipe[1], &child_errno, sizeof(child_errno));
+        _exit(127);
+      }
+    }
+
     auto argv = ToExecArgv(request.argv);
     ::execvp(argv[0], argv.data());
 
@@ -154,6 +221,14 @@ std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessReques
 
   ::close(exec_pipe[1]);
   (void)::setpgid(pid, pid);
+  if (stdout_pipe[1] >= 0) {
+    ::close(stdout_pipe[1]);
+    stdout_pipe[1] = -1;
+  }
+  if (stderr_pipe[1] >= 0) {
+    ::close(stderr_pipe[1]);
+    stderr_pipe[1] = -1;
+  }
 
   int child_errno = 0;
   const ssize_t read_count = ::read(exec_pipe[0], &child_errno, sizeof(child_errno));
@@ -164,13 +239,153 @@ std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessReques
     oss << "failed to exec '" << request.argv.front() << "': " << std::strerror(child_errno);
     error = oss.str();
     (void)::waitpid(pid, nullptr, 0);
+    ClosePipe(stdout_pipe);
+    ClosePipe(stderr_pipe);
     return std::nullopt;
   }
 
+  for (const int fd : {stdout_pipe[0], stderr_pipe[0]}) {
+    if (fd >= 0) {
+      (void)::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+  }
+
   error.clear();
-  return StartedProcess{static_cast<int>(pid)};
+  return StartedProcess{
+      .pid = static_cast<int>(pid),
+      .stdout_fd = stdout_pipe[0],
+      .stderr_fd = stderr_pipe[0],
+  };
 }
 
+#if KF_HAVE_POSIX_SPAWN_CHDIR
+//! posix_spawnp() launch: no page-table copy in the parent, process group and redirections applied by the spawn
+//! attributes/file actions, and exec failures returned directly as the spawn error code.
+std::optional<StartedProcess> SpawnAndExec(const StartProcessRequest& request, std::string& error) {
+  int stdout_pipe[2] = {-1, -1};
+  int stderr_pipe[2] = {-1, -1};
+  if (request.capture_output && (!OpenOutputPipe(stdout_pipe) || !OpenOutputPipe(stderr_pipe))) {
+    error = "failed to create output capture pipes";
+    ClosePipe(stdout_pipe);
+    ClosePipe(stderr_pipe);
+    return std::nullopt;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attributes;
+  ::posix_spawn_file_actions_init(&actions);
+  ::posix_spawnattr_init(&attributes);
+  (void)::posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+  (void)::posix_spawnattr_setpgroup(&attributes, 0);
+
+  int action_result = 0;
+  const auto add = [&action_result](int result) {
+    if (action_result == 0) {
+      action_result = result;
+    }
+  };
+  if (!request.cwd.empty()) {
+    add(::posix_spawn_file_actions_addchdir_np(&actions, request.cwd.c_str()));
+  }
+  const std::string sink_path = request.log_path.empty() ? "/dev/null" : request.log_path.string();
+  if (request.daemon) {
+    add(::posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0));
+    if (!request.capture_output) {
+      add(::posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, sink_path.c_str(), O_CREAT | O_WRONLY | O_APPEND,
+                                             0644));
+      add(::posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO));
+    }
+  }
+  if (request.capture_output) {
+    add(::posix_spawn_file_actions_adddup2(&actions, stdout_pipe[1], STDOUT_FILENO));
+    add(::posix_spawn_file_actions_adddup2(&actions, stderr_pipe[1], STDERR_FILENO));
+  }
+
+  pid_t pid = -1;
+  int spawn_result = action_result;
+  if (spawn_result == 0) {
+    auto argv = ToExecArgv(request.argv);
+    spawn_result = ::posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+  }
+  ::posix_spawn_file_actions_destroy(&actions);
+  ::posix_spawnattr_destroy(&attributes);
+
+  for (int* write_end : {&stdout_pipe[1], &stderr_pipe[1]}) {
+    if (*write_end >= 0) {
+      ::close(*write_end);
+      *write_end = -1;
+    }
+  }
+
+  if (spawn_result != 0) {
+    std::ostringstream oss;
+    oss << "failed to exec '" << request.argv.front() << "': " << std::strerror(spawn_result);
+    error = oss.str();
+    ClosePipe(stdout_pipe);
+    ClosePipe(stderr_pipe);
+    return std::nullopt;
+  }
+
+  for (const int fd : {stdout_pipe[0], stderr_pipe[0]}) {
+    if (fd >= 0) {
+      (void)::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+  }
+
+  error.clear();
+  return StartedProcess{
+      .pid = static_cast<int>(pid),
+      .stdout_fd = stdout_pipe[0],
+      .stderr_fd = stderr_pipe[0],
+  };
+}
+#endif
+
+}  // namespace
+
+namespace kubeforward::runtime {
+
+std::vector<StopProcessResult> ProcessRunner::StopAll(const std::vector<int>& pids) {
+  std::vector<StopProcessResult> results;
+  results.reserve(pids.size());
+  for (const int pid : pids) {
+    StopProcessResult result{.pid = pid};
+    result.stopped = Stop(pid, result.error);
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+std::optional<StartedProcess> PosixProcessRunner::Start(const StartProcessRequest& request, std::string& error) {
+  if (request.argv.empty()) {
+    error = "process argv cannot be empty";
+    return std::nullopt;
+  }
+
+  if (request.daemon && !request.log_path.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(request.log_path.parent_path(), ec);
+    if (ec) {
+      error = "failed to create log directory: " + ec.message();
+      return std::nullopt;
+    }
+  }
+
+#if KF_HAVE_POSIX_SPAWN_CHDIR
+  if (strategy_ != LaunchStrategy::kFork) {
+    return SpawnAndExec(request, error);
+  }
+#else
+  if (strategy_ == LaunchStrategy::kSpawn) {
+    error = "posix_spawn launch strategy is not supported on this platform";
+    return std::nullopt;
+  }
+#endif
+  return ForkAndExec(request, error);
+}
+
+bool PosixProcessRunner::SupportsSpawn() { return KF_HAVE_POSIX_SPAWN_CHDIR != 0; }
+
 bool PosixProcessRunner::Stop(int pid, std::string& error) {
   if (pid <= 0) {
     std::ostringstream oss;
@@ -214,13 +429,64 @@ bool PosixProcessRunner::Stop(int pid, std::string& error) {
   return true;
 }
 
+std::vector<StopProcessResult> PosixProcessRunner::StopAll(const std::vector<int>& pids) {
+  std::vector<StopProcessResult> results;
+  results.reserve(pids.size());
+  std::vector<pid_t> terminating;
+  for (const int pid : pids) {
+    StopProcessResult result{.pid = pid};
+    if (pid <= 0) {
+      result.error = "invalid pid " + std::to_string(pid);
+    } else if (::kill(-static_cast<pid_t>(pid), SIGTERM) == 0) {
+      terminating.push_back(static_cast<pid_t>(pid));
+    } else if (errno == ESRCH) {
+      result.stopped = true;
+    } else {
+      std::ostringstream oss;
+      oss << "failed to send SIGTERM to process group " << pid << ": " << std::strerror(errno);
+      result.error = oss.str();
+    }
+    results.push_back(std::move(result));
+  }
+
+  WaitForProcessGroupsExit(terminating, 3000);
+
+  std::vector<pid_t> killing;
+  for (const pid_t pgid : terminating) {
+    if (::kill(-pgid, SIGKILL) == 0 || errno == ESRCH) {
+      killing.push_back(pgid);
+      continue;
+    }
+    auto& result = *std::find_if(results.begin(), results.end(), [&](const auto& entry) { return entry.pid == pgid; });
+    std::ostringstream oss;
+    oss << "failed to send SIGKILL to process group " << pgid << ": " << std::strerror(errno);
+    result.error = oss.str();
+  }
+
+  WaitForProcessGroupsExit(killing, 1000);
+
+  for (auto& result : results) {
+    if (!result.error.empty() || result.stopped) {
+      continue;
+    }
+    if (std::find(killing.begin(), killing.end(), static_cast<pid_t>(result.pid)) != killing.end()) {
+      std::ostringstream oss;
+      oss << "process group " << result.pid << " did not exit after SIGKILL";
+      result.error = oss.str();
+      continue;
+    }
+    result.stopped = true;
+  }
+  return results;
+}
+
 std::optional<StartedProcess> NoopProcessRunner::Start(const StartProcessRequest& request, std::string& error) {
   if (request.argv.empty()) {
     error = "process argv cannot be empty";
     return std::nullopt;
   }
   error.clear();
-  return StartedProcess{next_pid_++};
+  return StartedProcess{.pid = next_pid_++};
 }
 
 bool NoopProcessRunner::Stop(int pid, std::string& error) {
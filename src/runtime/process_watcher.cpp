@@ -0,0 +1,248 @@
+#include "kubeforward/runtime/process_watcher.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+namespace kubeforward::runtime {
+namespace {
+
+constexpr std::chrono::milliseconds kPolledProcessInterval(100);
+
+bool OpenWakePipe(int (&fds)[2]) {
+  if (::pipe(fds) != 0) {
+    fds[0] = -1;
+    fds[1] = -1;
+    return false;
+  }
+  for (const int fd : fds) {
+    (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    (void)::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  }
+  return true;
+}
+
+void DrainWakePipe(int fd) {
+  std::array<char, 64> buffer{};
+  while (::read(fd, buffer.data(), buffer.size()) > 0) {
+  }
+}
+
+//! Caps the wait while some process can only be re-checked by polling.
+int EffectiveTimeoutMs(std::chrono::milliseconds timeout, bool has_polled_pids) {
+  if (!has_polled_pids) {
+    return timeout.count() < 0 ? -1 : static_cast<int>(timeout.count());
+  }
+  if (timeout.count() < 0 || timeout > kPolledProcessInterval) {
+    return static_cast<int>(kPolledProcessInterval.count());
+  }
+  return static_cast<int>(timeout.count());
+}
+
+#if defined(__linux__)
+int OpenPidfd(int pid) {
+#if defined(SYS_pidfd_open)
+  return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+#endif
+
+}  // namespace
+
+ProcessWatcher::ProcessWatcher() {
+  (void)OpenWakePipe(wake_pipe_);
+#if defined(__linux__)
+  event_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+#elif defined(__APPLE__)
+  event_fd_ = ::kqueue();
+  if (event_fd_ >= 0) {
+    (void)::fcntl(event_fd_, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+  if (wake_pipe_[0] >= 0) {
+    AddDescriptor(wake_pipe_[0]);
+  }
+}
+
+ProcessWatcher::~ProcessWatcher() {
+  for (const auto& [pidfd, pid] : pidfds_) {
+    (void)pid;
+    ::close(pidfd);
+  }
+  for (const int fd : {event_fd_, wake_pipe_[0], wake_pipe_[1]}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+void ProcessWatcher::AddDescriptor(int fd) {
+  if (fd < 0) {
+    return;
+  }
+  struct stat info {};
+  const DescriptorIdentity identity =
+      ::fstat(fd, &info) == 0 ? DescriptorIdentity{.device = info.st_dev, .inode = info.st_ino} : DescriptorIdentity{};
+  const auto known = descriptors_.find(fd);
+  if (known != descriptors_.end() && known->second == identity) {
+    return;
+  }
+  // A known number on another file was closed and reused: closing dropped the old registration with it.
+  descriptors_[fd] = identity;
+  if (event_fd_ < 0) {
+    return;
+  }
+#if defined(__linux__)
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  (void)::epoll_ctl(event_fd_, EPOLL_CTL_ADD, fd, &event);
+#elif defined(__APPLE__)
+  struct kevent change {};
+  EV_SET(&change, fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+  (void)::kevent(event_fd_, &change, 1, nullptr, 0, nullptr);
+#endif
+}
+
+void ProcessWatcher::RemoveDescriptor(int fd) {
+  if (descriptors_.erase(fd) == 0 || event_fd_ < 0 || pidfds_.count(fd) != 0) {
+    return;
+  }
+  // The descriptor may already be closed, in which case the kernel dropped the registration itself; a number reused
+  // by a pidfd is left alone above.
+#if defined(__linux__)
+  (void)::epoll_ctl(event_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#elif defined(__APPLE__)
+  struct kevent change {};
+  EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+  (void)::kevent(event_fd_, &change, 1, nullptr, 0, nullptr);
+#endif
+}
+
+void ProcessWatcher::SetDescriptors(const std::vector<int>& fds) {
+  std::vector<int> stale;
+  for (const auto& [fd, identity] : descriptors_) {
+    (void)identity;
+    if (fd != wake_pipe_[0] && std::find(fds.begin(), fds.end(), fd) == fds.end()) {
+      stale.push_back(fd);
+    }
+  }
+  for (const int fd : stale) {
+    RemoveDescriptor(fd);
+  }
+  for (const int fd : fds) {
+    AddDescriptor(fd);
+  }
+}
+
+void ProcessWatcher::WatchProcess(int pid) {
+  if (pid <= 0) {
+    return;
+  }
+#if defined(__linux__)
+  if (event_fd_ >= 0) {
+    const int pidfd = OpenPidfd(pid);
+    if (pidfd >= 0) {
+      // A descriptor still listed under this number was closed by its owner; its registration went with it.
+      descriptors_.erase(pidfd);
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.fd = pidfd;
+      if (::epoll_ctl(event_fd_, EPOLL_CTL_ADD, pidfd, &event) == 0) {
+        pidfds_[pidfd] = pid;
+        return;
+      }
+      ::close(pidfd);
+    }
+  }
+#elif defined(__APPLE__)
+  if (event_fd_ >= 0) {
+    struct kevent change {};
+    EV_SET(&change, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    if (::kevent(event_fd_, &change, 1, nullptr, 0, nullptr) == 0) {
+      return;
+    }
+  }
+#endif
+  polled_pids_.insert(pid);
+}
+
+std::vector<int> ProcessWatcher::Wait(std::chrono::milliseconds timeout) {
+  std::vector<int> exited;
+  const int timeout_ms = EffectiveTimeoutMs(timeout, !polled_pids_.empty());
+
+#if defined(__linux__)
+  if (event_fd_ >= 0) {
+    std::array<epoll_event, 32> events{};
+    const int count = ::epoll_wait(event_fd_, events.data(), static_cast<int>(events.size()), timeout_ms);
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == wake_pipe_[0]) {
+        DrainWakePipe(fd);
+        continue;
+      }
+      const auto pidfd = pidfds_.find(fd);
+      if (pidfd != pidfds_.end()) {
+        exited.push_back(pidfd->second);
+        (void)::epoll_ctl(event_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        pidfds_.erase(pidfd);
+      }
+    }
+    exited.insert(exited.end(), polled_pids_.begin(), polled_pids_.end());
+    return exited;
+  }
+#elif defined(__APPLE__)
+  if (event_fd_ >= 0) {
+    std::array<struct kevent, 32> events{};
+    timespec wait_time{};
+    timespec* wait_time_ptr = nullptr;
+    if (timeout_ms >= 0) {
+      wait_time.tv_sec = timeout_ms / 1000;
+      wait_time.tv_nsec = static_cast<long>(timeout_ms % 1000) * 1000000L;
+      wait_time_ptr = &wait_time;
+    }
+    const int count = ::kevent(event_fd_, nullptr, 0, events.data(), static_cast<int>(events.size()), wait_time_ptr);
+    for (int i = 0; i < count; ++i) {
+      if (events[i].filter == EVFILT_PROC) {
+        exited.push_back(static_cast<int>(events[i].ident));
+      } else if (static_cast<int>(events[i].ident) == wake_pipe_[0]) {
+        DrainWakePipe(wake_pipe_[0]);
+      }
+    }
+    exited.insert(exited.end(), polled_pids_.begin(), polled_pids_.end());
+    return exited;
+  }
+#endif
+
+  std::vector<pollfd> poll_fds;
+  for (const auto& [fd, identity] : descriptors_) {
+    (void)identity;
+    poll_fds.push_back(pollfd{.fd = fd, .events = POLLIN, .revents = 0});
+  }
+  (void)::poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), timeout_ms);
+  if (wake_pipe_[0] >= 0) {
+    DrainWakePipe(wake_pipe_[0]);
+  }
+  exited.insert(exited.end(), polled_pids_.begin(), polled_pids_.end());
+  return exited;
+}
+
+}  // namespace kubeforward::runtime
@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "kubeforward/runtime/native_port_forward.h"
+
 namespace kubeforward::runtime {
 namespace {
 
@@ -23,6 +25,12 @@ config::TargetDefaults MergeTargetDefaults(const config::TargetDefaults& base, c
   if (override.bind_address.has_value()) {
     merged.bind_address = override.bind_address;
   }
+  if (override.port_forward_engine.has_value()) {
+    merged.port_forward_engine = override.port_forward_engine;
+  }
+  if (override.api_server.has_value()) {
+    merged.api_server = override.api_server;
+  }
   for (const auto& [key, value] : override.labels) {
     merged.labels[key] = value;
   }
@@ -68,6 +76,8 @@ std::vector<ResolvedForward> ResolveForwards(const std::string& env_name,
     forward.detach = source.detach;
     forward.restart_policy = source.restart_policy;
     forward.health_check = source.health_check;
+    forward.warm_pool = source.warm_pool;
+    forward.load_balance = source.load_balance;
     forward.env = source.env;
     forward.annotations = source.annotations;
     forward.context = source.resource.context.has_value() ? source.resource.context : settings.context;
@@ -96,7 +106,28 @@ std::vector<ResolvedForward> ResolveForwards(const std::string& env_name,
   return forwards;
 }
 
+void ValidateNativeEngine(const ResolvedEnvironment& env, std::vector<PlanBuildError>& errors) {
+  if (env.settings.port_forward_engine != config::PortForwardEngine::kNative) {
+    return;
+  }
+  const std::string context = "environments." + env.name;
+  ApiServerEndpoint endpoint;
+  std::string error;
+  if (!env.settings.api_server.has_value() || env.settings.api_server->empty()) {
+    AddError(errors, context + ".apiServer", "portForwardEngine native requires apiServer");
+  } else if (!ParseApiServerEndpoint(*env.settings.api_server, endpoint, error)) {
+    AddError(errors, context + ".apiServer", error);
+  }
+  for (size_t i = 0; i < env.forwards.size(); ++i) {
+    if (env.forwards[i].resource.kind != config::ResourceKind::kPod) {
+      AddError(errors, context + ".forwards[" + std::to_string(i) + "].resource.kind",
+               "portForwardEngine native only supports pod targets");
+    }
+  }
+}
+
 void ValidateResolvedEnvironment(const ResolvedEnvironment& env, std::vector<PlanBuildError>& errors) {
+  ValidateNativeEngine(env, errors);
   if (!env.guards.allow_production) {
     return;
   }
@@ -0,0 +1,30 @@
+#include "kubeforward/runtime/restart_backoff.h"
+
+#include <algorithm>
+
+namespace kubeforward::runtime {
+
+RestartBackoff::RestartBackoff(RestartBackoffPolicy policy, std::uint64_t seed) : policy_(policy), rng_(seed) {}
+
+std::chrono::milliseconds RestartBackoff::NextDelay() {
+  const double max_ms = static_cast<double>(std::max<std::chrono::milliseconds::rep>(policy_.max_delay.count(), 0));
+  double base_ms = static_cast<double>(std::max<std::chrono::milliseconds::rep>(policy_.initial_delay.count(), 0));
+  for (int attempt = 0; attempt < attempts_ && base_ms < max_ms; ++attempt) {
+    base_ms *= policy_.multiplier;
+  }
+  base_ms = std::min(base_ms, max_ms);
+  ++attempts_;
+
+  const double jitter = std::clamp(policy_.jitter, 0.0, 1.0);
+  std::uniform_real_distribution<double> distribution(base_ms * (1.0 - jitter), base_ms);
+  const double delay_ms = jitter > 0.0 && base_ms > 0.0 ? distribution(rng_) : base_ms;
+  return std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(delay_ms));
+}
+
+void RestartBackoff::RecordUptime(std::chrono::milliseconds uptime) {
+  if (uptime >= policy_.stable_after) {
+    Reset();
+  }
+}
+
+}  // namespace kubeforward::runtime
@@ -1,11 +1,12 @@
 #include "kubeforward/runtime/session_conflicts.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <csignal>
-#include <set>
 #include <sstream>
 #include <string>
-#include <tuple>
+
+#include "kubeforward/runtime/process_identity.h"
 
 namespace {
 
@@ -16,13 +17,6 @@ std::string ResolveBindAddress(const kubeforward::config::PortMapping& port) {
   return "127.0.0.1";
 }
 
-std::string ResolveBindAddress(const kubeforward::runtime::ManagedForwardProcess& process) {
-  if (!process.bind_address.empty()) {
-    return process.bind_address;
-  }
-  return "127.0.0.1";
-}
-
 const char* PortProtocolToString(kubeforward::config::PortProtocol protocol) {
   switch (protocol) {
     case kubeforward::config::PortProtocol::kTcp:
@@ -33,67 +27,69 @@ const char* PortProtocolToString(kubeforward::config::PortProtocol protocol) {
   return "unknown";
 }
 
-using PortClaimKey = std::tuple<std::string, int, kubeforward::config::PortProtocol>;
-
-PortClaimKey PortClaimFor(const kubeforward::config::PortMapping& port) {
-  return {ResolveBindAddress(port), port.local_port, port.protocol};
-}
-
-PortClaimKey PortClaimFor(const kubeforward::runtime::ManagedForwardProcess& process) {
-  return {ResolveBindAddress(process), process.local_port, process.protocol};
-}
-
-bool IsPidAlive(int pid) {
-  if (pid <= 0) {
+//! Whether the process that claimed a socket still runs. A pid now owned by another process (its fingerprint no longer
+//! matches) does not count; claims without a fingerprint fall back to the pid alone.
+bool IsClaimHolderAlive(const kubeforward::runtime::PortClaim& claim) {
+  if (claim.pid <= 0) {
     return false;
   }
-  if (::kill(pid, 0) == 0) {
-    return true;
+  if (::kill(claim.pid, 0) != 0 && errno != EPERM) {
+    return false;
   }
-  return errno == EPERM;
+  return claim.fingerprint.empty() ||
+         kubeforward::runtime::CompareProcessFingerprint(claim.pid, claim.fingerprint) !=
+             kubeforward::runtime::FingerprintMatch::kMismatch;
 }
 
 }  // namespace
 
 namespace kubeforward::runtime {
 
-bool CheckRuntimeSessionPortConflicts(const RuntimeState& state, const std::string& normalized_config_path,
-                                      const ResolvedEnvironment& target_env, std::string& error) {
-  std::set<PortClaimKey> target_ports;
-  for (const auto& forward : target_env.forwards) {
+std::vector<PortClaimKey> PortClaimKeys(const ResolvedEnvironment& env) {
+  std::vector<PortClaimKey> keys;
+  for (const auto& forward : env.forwards) {
     for (const auto& port : forward.ports) {
-      target_ports.insert(PortClaimFor(port));
+      PortClaimKey key{
+          .bind_address = ResolveBindAddress(port), .local_port = port.local_port, .protocol = port.protocol};
+      if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+        keys.push_back(std::move(key));
+      }
     }
   }
+  return keys;
+}
 
-  for (const auto& session : state.sessions) {
-    if (session.config_path == normalized_config_path && session.environment == target_env.name) {
+bool CheckPortClaimConflicts(const std::vector<PortClaim>& claims, const std::string& normalized_config_path,
+                             const ResolvedEnvironment& target_env, std::string& error) {
+  for (const auto& claim : claims) {
+    if (claim.config_path == normalized_config_path && claim.environment == target_env.name) {
       continue;
     }
-    for (const auto& process : session.forwards) {
-      if (target_ports.count(PortClaimFor(process)) == 0) {
-        continue;
-      }
-      if (!IsPidAlive(process.pid)) {
-        continue;
-      }
-      std::ostringstream oss;
-      oss << "local "
-          << PortProtocolToString(process.protocol)
-          << " port "
-          << process.local_port
-          << " on "
-          << ResolveBindAddress(process)
-          << " is already claimed by running session '"
-          << session.id
-          << "'";
-      error = oss.str();
-      return false;
+    if (!IsClaimHolderAlive(claim)) {
+      continue;
     }
+    std::ostringstream oss;
+    oss << "local "
+        << PortProtocolToString(claim.key.protocol)
+        << " port "
+        << claim.key.local_port
+        << " on "
+        << claim.key.bind_address
+        << " is already claimed by running session '"
+        << claim.session_id
+        << "'";
+    error = oss.str();
+    return false;
   }
 
   error.clear();
   return true;
 }
 
+bool CheckRuntimeSessionPortConflicts(const RuntimeState& state, const std::string& normalized_config_path,
+                                      const ResolvedEnvironment& target_env, std::string& error) {
+  return CheckPortClaimConflicts(PortClaimsOf(state, PortClaimKeys(target_env)), normalized_config_path, target_env,
+                                 error);
+}
+
 }  // namespace kubeforward::runtime
@@ -0,0 +1,440 @@
+#include "kubeforward/runtime/shared_kubeconfig.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+//! Credentials are renewed this long before they expire, so a kubectl started on them still gets to connect.
+constexpr std::chrono::seconds kCredentialRefreshMargin(60);
+
+std::optional<std::chrono::system_clock::time_point> ParseRfc3339(const std::string& text) {
+  std::tm fields{};
+  std::istringstream input(text);
+  input >> std::get_time(&fields, "%Y-%m-%dT%H:%M:%S");
+  if (input.fail()) {
+    return std::nullopt;
+  }
+  std::string rest;
+  std::getline(input, rest);
+  size_t pos = 0;
+  if (pos < rest.size() && rest[pos] == '.') {
+    ++pos;
+    while (pos < rest.size() && rest[pos] >= '0' && rest[pos] <= '9') {
+      ++pos;
+    }
+  }
+  long offset_seconds = 0;
+  if (rest.substr(pos) == "Z" || rest.substr(pos) == "z") {
+    offset_seconds = 0;
+  } else if (rest.size() == pos + 6 && (rest[pos] == '+' || rest[pos] == '-') && rest[pos + 3] == ':') {
+    try {
+      offset_seconds = std::stol(rest.substr(pos + 1, 2)) * 3600 + std::stol(rest.substr(pos + 4, 2)) * 60;
+    } catch (...) {
+      return std::nullopt;
+    }
+    offset_seconds = rest[pos] == '-' ? -offset_seconds : offset_seconds;
+  } else {
+    return std::nullopt;
+  }
+  const std::time_t utc = ::timegm(&fields);
+  if (utc == static_cast<std::time_t>(-1)) {
+    return std::nullopt;
+  }
+  return std::chrono::system_clock::from_time_t(utc - offset_seconds);
+}
+
+std::string JsonQuote(const std::string& value) {
+  std::ostringstream quoted;
+  quoted << '"';
+  for (const char ch : value) {
+    switch (ch) {
+      case '"':
+        quoted << "\\\"";
+        break;
+      case '\\':
+        quoted << "\\\\";
+        break;
+      case '\n':
+        quoted << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(ch) < 0x20) {
+          quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch) << std::dec;
+        } else {
+          quoted << ch;
+        }
+    }
+  }
+  quoted << '"';
+  return quoted.str();
+}
+
+std::string Base64Encode(const std::string& data) {
+  static constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string encoded;
+  encoded.reserve((data.size() + 2) / 3 * 4);
+  for (size_t i = 0; i < data.size(); i += 3) {
+    const size_t count = std::min<size_t>(3, data.size() - i);
+    uint32_t chunk = 0;
+    for (size_t j = 0; j < 3; ++j) {
+      chunk = (chunk << 8) | (j < count ? static_cast<unsigned char>(data[i + j]) : 0);
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      encoded.push_back(j <= count ? kAlphabet[(chunk >> (18 - 6 * j)) & 0x3f] : '=');
+    }
+  }
+  return encoded;
+}
+
+std::string ScalarOr(const YAML::Node& node, const std::string& fallback = "") {
+  return node && node.IsScalar() ? node.as<std::string>() : fallback;
+}
+
+//! kubectl resolves file references relative to the kubeconfig that holds them.
+void MakePathAbsolute(YAML::Node node, const char* key, const std::filesystem::path& directory) {
+  const auto value = ScalarOr(node[key]);
+  if (!value.empty() && std::filesystem::path(value).is_relative()) {
+    node[key] = (directory / value).lexically_normal().string();
+  }
+}
+
+//! Runs the `exec` plugin of a kubeconfig user for `cluster`, the way kubectl would without a terminal.
+std::optional<ExecCredential> RunExecPlugin(const YAML::Node& exec, const YAML::Node& cluster,
+                                            const ExecPluginRunner& runner, std::string& error) {
+  if (ScalarOr(exec["interactiveMode"]) == "Always") {
+    error = "it needs an interactive terminal";
+    return std::nullopt;
+  }
+  std::vector<std::string> argv = {ScalarOr(exec["command"])};
+  if (argv.front().empty()) {
+    error = "it has no command";
+    return std::nullopt;
+  }
+  if (exec["args"] && exec["args"].IsSequence()) {
+    for (const auto& arg : exec["args"]) {
+      argv.push_back(ScalarOr(arg));
+    }
+  }
+  CommandEnvironment environment;
+  if (exec["env"] && exec["env"].IsSequence()) {
+    for (const auto& variable : exec["env"]) {
+      environment.emplace_back(ScalarOr(variable["name"]), ScalarOr(variable["value"]));
+    }
+  }
+  std::string cluster_info;
+  if (ScalarOr(exec["provideClusterInfo"]) == "true") {
+    const bool insecure = ScalarOr(cluster["insecure-skip-tls-verify"]) == "true";
+    cluster_info = ",\"cluster\":{\"server\":" + JsonQuote(ScalarOr(cluster["server"])) +
+                   ",\"certificate-authority-data\":" + JsonQuote(ScalarOr(cluster["certificate-authority-data"])) +
+                   ",\"insecure-skip-tls-verify\":" + (insecure ? "true" : "false") + "}";
+  }
+  const auto api_version = ScalarOr(exec["apiVersion"], "client.authentication.k8s.io/v1beta1");
+  const auto exec_info = "{\"apiVersion\":" + JsonQuote(api_version) +
+                         ",\"kind\":\"ExecCredential\",\"spec\":{\"interactive\":false" + cluster_info + "}}";
+  environment.emplace_back("KUBERNETES_EXEC_INFO", exec_info);
+
+  std::string output;
+  if (!runner(argv, environment, output, error)) {
+    return std::nullopt;
+  }
+  return ParseExecCredential(output, error);
+}
+
+//! Writes `contents` to `path` atomically, readable only by the current user, inside a directory no one else can
+//! enter.
+bool WritePrivateFile(const std::filesystem::path& path, const std::string& contents, std::string& error) {
+  const auto directory = path.parent_path();
+  std::error_code ec;
+  std::filesystem::create_directories(directory, ec);
+  struct stat info {};
+  if (ec || ::stat(directory.c_str(), &info) != 0) {
+    error = "failed to create '" + directory.string() + "'";
+    return false;
+  }
+  if (info.st_uid != ::getuid()) {
+    error = "refusing to write credentials into '" + directory.string() + "', which belongs to another user";
+    return false;
+  }
+  if ((info.st_mode & 077) != 0 && ::chmod(directory.c_str(), 0700) != 0) {
+    error = "failed to restrict '" + directory.string() + "': " + std::strerror(errno);
+    return false;
+  }
+
+  const auto temporary = path.string() + ".tmp." + std::to_string(::getpid());
+  const int fd = ::open(temporary.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_NOFOLLOW, 0600);
+  if (fd < 0) {
+    error = "failed to write '" + temporary + "': " + std::strerror(errno);
+    return false;
+  }
+  size_t written = 0;
+  while (written < contents.size()) {
+    const ssize_t count = ::write(fd, contents.data() + written, contents.size() - written);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      error = "failed to write '" + temporary + "': " + std::strerror(errno);
+      ::close(fd);
+      ::unlink(temporary.c_str());
+      return false;
+    }
+    written += static_cast<size_t>(count);
+  }
+  ::close(fd);
+  if (::rename(temporary.c_str(), path.c_str()) != 0) {
+    error = "failed to replace '" + path.string() + "': " + std::strerror(errno);
+    ::unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+struct SharedKubeconfig::Source {
+  //! Entries by name, from the first file defining them (kubectl's merge rule), with file references made absolute.
+  std::map<std::string, YAML::Node> clusters;
+  std::map<std::string, YAML::Node> users;
+  std::map<std::string, YAML::Node> contexts;
+  std::string current_context;
+};
+
+std::optional<ExecCredential> ParseExecCredential(const std::string& json, std::string& error) {
+  YAML::Node root;
+  try {
+    root = YAML::Load(json);
+  } catch (const YAML::Exception& e) {
+    error = std::string("invalid ExecCredential: ") + e.what();
+    return std::nullopt;
+  }
+  const auto status = root.IsMap() ? root["status"] : YAML::Node();
+  if (!status || !status.IsMap()) {
+    error = "ExecCredential has no status";
+    return std::nullopt;
+  }
+
+  ExecCredential credential;
+  try {
+    credential.token = ScalarOr(status["token"]);
+    credential.client_certificate_data = ScalarOr(status["clientCertificateData"]);
+    credential.client_key_data = ScalarOr(status["clientKeyData"]);
+    if (const auto expiry = ScalarOr(status["expirationTimestamp"]); !expiry.empty()) {
+      credential.expires_at = ParseRfc3339(expiry);
+      if (!credential.expires_at.has_value()) {
+        error = "ExecCredential has an invalid expirationTimestamp '" + expiry + "'";
+        return std::nullopt;
+      }
+    }
+  } catch (const YAML::Exception& e) {
+    error = std::string("invalid ExecCredential: ") + e.what();
+    return std::nullopt;
+  }
+  if (credential.token.empty() &&
+      (credential.client_certificate_data.empty() || credential.client_key_data.empty())) {
+    error = "ExecCredential has neither a token nor a client certificate and key";
+    return std::nullopt;
+  }
+  error.clear();
+  return credential;
+}
+
+std::vector<std::filesystem::path> ResolveKubeconfigFiles(const std::optional<std::string>& explicit_path) {
+  if (explicit_path.has_value() && !explicit_path->empty()) {
+    return {*explicit_path};
+  }
+  std::vector<std::filesystem::path> files;
+  if (const char* value = std::getenv("KUBECONFIG"); value != nullptr && value[0] != '\0') {
+    std::istringstream entries(value);
+    std::string entry;
+    while (std::getline(entries, entry, ':')) {
+      if (!entry.empty()) {
+        files.emplace_back(entry);
+      }
+    }
+    return files;
+  }
+  if (const char* home = std::getenv("HOME"); home != nullptr && home[0] != '\0') {
+    files.push_back(std::filesystem::path(home) / ".kube" / "config");
+  }
+  return files;
+}
+
+SharedKubeconfig::SharedKubeconfig(std::optional<std::string> kubeconfig, std::set<std::string> contexts,
+                                   std::filesystem::path output_path, ExecPluginRunner runner)
+    : kubeconfig_(std::move(kubeconfig)),
+      contexts_(std::move(contexts)),
+      output_path_(std::move(output_path)),
+      runner_(std::move(runner)) {}
+
+SharedKubeconfig::~SharedKubeconfig() = default;
+
+std::optional<std::filesystem::path> SharedKubeconfig::Update(std::string& error) {
+  error.clear();
+  if (source_ == nullptr) {
+    auto source = std::make_unique<Source>();
+    const auto files = ResolveKubeconfigFiles(kubeconfig_);
+    const bool explicit_file = kubeconfig_.has_value() && !kubeconfig_->empty();
+    size_t loaded = 0;
+    for (const auto& file : files) {
+      // Like kubectl, missing $KUBECONFIG entries are skipped; an explicit --kubeconfig must exist.
+      if (!explicit_file && !std::filesystem::exists(file)) {
+        continue;
+      }
+      YAML::Node root;
+      try {
+        root = YAML::LoadFile(file.string());
+      } catch (const YAML::Exception& e) {
+        error = "failed to read kubeconfig '" + file.string() + "': " + e.what();
+        return std::nullopt;
+      }
+      ++loaded;
+      if (!root.IsMap()) {
+        continue;
+      }
+      const auto directory = std::filesystem::absolute(file).parent_path();
+      const auto merge = [&](const char* list_key, const char* entry_key, std::map<std::string, YAML::Node>& entries,
+                             const std::vector<const char*>& path_keys) {
+        const auto list = root[list_key];
+        if (!list || !list.IsSequence()) {
+          return;
+        }
+        for (const auto& item : list) {
+          const auto name = item.IsMap() ? ScalarOr(item["name"]) : "";
+          if (name.empty() || entries.count(name) != 0) {
+            continue;
+          }
+          auto entry = item[entry_key] ? YAML::Clone(item[entry_key]) : YAML::Node(YAML::NodeType::Map);
+          for (const char* path_key : path_keys) {
+            MakePathAbsolute(entry, path_key, directory);
+          }
+          if (const auto exec = entry["exec"]; exec && exec.IsMap() &&
+                                               ScalarOr(exec["command"]).find('/') != std::string::npos) {
+            MakePathAbsolute(exec, "command", directory);
+          }
+          entries.emplace(name, entry);
+        }
+      };
+      merge("clusters", "cluster", source->clusters, {"certificate-authority"});
+      merge("users", "user", source->users, {"client-certificate", "client-key", "tokenFile"});
+      merge("contexts", "context", source->contexts, {});
+      if (source->current_context.empty()) {
+        source->current_context = ScalarOr(root["current-context"]);
+      }
+    }
+    if (loaded == 0) {
+      // No kubeconfig at all (kubectl then uses in-cluster credentials): there are no plugins to share.
+      return std::nullopt;
+    }
+    source_ = std::move(source);
+  }
+
+  YAML::Node clusters(YAML::NodeType::Sequence);
+  YAML::Node users(YAML::NodeType::Sequence);
+  YAML::Node contexts(YAML::NodeType::Sequence);
+  std::set<std::string> added_clusters;
+  std::set<std::string> added_users;
+  std::string current_context;
+  bool uses_exec = false;
+  const auto now = std::chrono::system_clock::now();
+  for (const auto& requested : contexts_) {
+    const auto& name = requested.empty() ? source_->current_context : requested;
+    if (name.empty()) {
+      error = "kubeconfig has no current-context";
+      return std::nullopt;
+    }
+    const auto context = source_->contexts.find(name);
+    if (context == source_->contexts.end()) {
+      error = "context \"" + name + "\" not found in kubeconfig";
+      return std::nullopt;
+    }
+    const auto cluster_name = ScalarOr(context->second["cluster"]);
+    const auto cluster = source_->clusters.find(cluster_name);
+    if (cluster == source_->clusters.end()) {
+      error = "cluster \"" + cluster_name + "\" of context \"" + name + "\" not found in kubeconfig";
+      return std::nullopt;
+    }
+    if (added_clusters.insert(cluster_name).second) {
+      YAML::Node entry;
+      entry["name"] = cluster_name;
+      entry["cluster"] = cluster->second;
+      clusters.push_back(entry);
+    }
+
+    const auto user_name = ScalarOr(context->second["user"]);
+    const auto user = source_->users.find(user_name);
+    if (!user_name.empty() && added_users.insert(user_name).second) {
+      // A copy: assigning to a YAML::Node writes through to the node it refers to, and the source is reused.
+      YAML::Node user_node =
+          user != source_->users.end() ? YAML::Clone(user->second) : YAML::Node(YAML::NodeType::Map);
+      if (const auto exec = user_node["exec"]; exec && exec.IsMap()) {
+        uses_exec = true;
+        auto cached = credentials_.find(user_name);
+        if (cached == credentials_.end() || (cached->second.expires_at.has_value() &&
+                                             *cached->second.expires_at - kCredentialRefreshMargin <= now)) {
+          ++plugin_runs_;
+          auto credential = RunExecPlugin(exec, cluster->second, runner_, error);
+          if (!credential.has_value()) {
+            error = "exec plugin of user \"" + user_name + "\" failed: " + error;
+            return std::nullopt;
+          }
+          cached = credentials_.insert_or_assign(user_name, std::move(*credential)).first;
+        }
+
+        user_node = YAML::Node(YAML::NodeType::Map);
+        if (!cached->second.token.empty()) {
+          user_node["token"] = cached->second.token;
+        } else {
+          user_node["client-certificate-data"] = Base64Encode(cached->second.client_certificate_data);
+          user_node["client-key-data"] = Base64Encode(cached->second.client_key_data);
+        }
+      }
+      YAML::Node entry;
+      entry["name"] = user_name;
+      entry["user"] = user_node;
+      users.push_back(entry);
+    }
+
+    YAML::Node entry;
+    entry["name"] = name;
+    entry["context"] = context->second;
+    contexts.push_back(entry);
+    if (requested.empty()) {
+      current_context = name;
+    }
+  }
+  if (!uses_exec) {
+    return std::nullopt;
+  }
+
+  YAML::Node root;
+  root["apiVersion"] = "v1";
+  root["kind"] = "Config";
+  root["clusters"] = clusters;
+  root["users"] = users;
+  root["contexts"] = contexts;
+  if (!current_context.empty()) {
+    root["current-context"] = current_context;
+  }
+  YAML::Emitter emitter;
+  emitter << root;
+  if (!WritePrivateFile(output_path_, std::string(emitter.c_str()) + "\n", error)) {
+    return std::nullopt;
+  }
+  return output_path_;
+}
+
+}  // namespace kubeforward::runtime
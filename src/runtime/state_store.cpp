@@ -2,30 +2,34 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
 #include <sstream>
+#include <tuple>
 
 #include <fcntl.h>
+#include <sched.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "kubeforward/runtime/claim_registry.h"
+
 namespace kubeforward::runtime {
 namespace {
 
-const char* PortProtocolToString(config::PortProtocol protocol) {
-  switch (protocol) {
-    case config::PortProtocol::kTcp:
-      return "tcp";
-    case config::PortProtocol::kUdp:
-      return "udp";
-  }
-  return "tcp";
-}
-
 config::PortProtocol ParsePortProtocol(const YAML::Node& node) {
   if (!node || !node.IsScalar()) {
     return config::PortProtocol::kTcp;
@@ -46,47 +50,22 @@ std::string NormalizeConfigPath(const std::string& config_path) {
   return absolute_path.lexically_normal().string();
 }
 
-YAML::Node SerializeState(const RuntimeState& state) {
-  YAML::Node root;
-  YAML::Node sessions(YAML::NodeType::Sequence);
-  for (const auto& session : state.sessions) {
-    YAML::Node session_node;
-    session_node["id"] = session.id;
-    session_node["configPath"] = session.config_path;
-    session_node["environment"] = session.environment;
-    session_node["daemon"] = session.daemon;
-    session_node["startedAtUtc"] = session.started_at_utc;
-
-    YAML::Node forwards(YAML::NodeType::Sequence);
-    for (const auto& forward : session.forwards) {
-      YAML::Node forward_node;
-      forward_node["environment"] = forward.environment;
-      forward_node["name"] = forward.forward_name;
-      YAML::Node argv(YAML::NodeType::Sequence);
-      for (const auto& arg : forward.argv) {
-        argv.push_back(arg);
-      }
-      forward_node["argv"] = argv;
-      forward_node["cwd"] = forward.cwd;
-      forward_node["logPath"] = forward.log_path;
-      forward_node["bindAddress"] = forward.bind_address;
-      forward_node["localPort"] = forward.local_port;
-      forward_node["remotePort"] = forward.remote_port;
-      forward_node["protocol"] = PortProtocolToString(forward.protocol);
-      forward_node["pid"] = forward.pid;
-      forwards.push_back(forward_node);
-    }
-    session_node["forwards"] = forwards;
-    sessions.push_back(session_node);
-  }
-  root["sessions"] = sessions;
-  return root;
+ProcessFingerprint ParseFingerprint(const YAML::Node& node) {
+  const auto read_field = [&](const char* key) {
+    return node[key] ? node[key].as<std::uint64_t>() : std::uint64_t{0};
+  };
+  return ProcessFingerprint{
+      .start_time = read_field("startTime"),
+      .exe_inode = read_field("exeInode"),
+      .cmdline_hash = read_field("cmdlineHash"),
+  };
 }
 
 void AddStateError(std::vector<std::string>& errors, const std::string& context, const std::string& message) {
   errors.push_back(context + ": " + message);
 }
 
+//! Parses a state file written before the binary format; the next write migrates it.
 RuntimeState ParseStateNode(const YAML::Node& root, std::vector<std::string>& errors) {
   RuntimeState state;
   if (!root) {
@@ -122,6 +101,11 @@ RuntimeState ParseStateNode(const YAML::Node& root, std::vector<std::string>& er
       session.environment = node["environment"] ? node["environment"].as<std::string>() : "";
       session.daemon = node["daemon"] ? node["daemon"].as<bool>() : false;
       session.started_at_utc = node["startedAtUtc"] ? node["startedAtUtc"].as<std::string>() : "";
+      session.supervisor_pid = node["supervisorPid"] ? node["supervisorPid"].as<int>() : 0;
+      if (const auto fingerprint = node["supervisorFingerprint"]) {
+        session.supervisor_fingerprint = ParseFingerprint(fingerprint);
+      }
+      session.drain_timeout_ms = node["drainTimeoutMs"] ? node["drainTimeoutMs"].as<int>() : 0;
     } catch (const YAML::BadConversion&) {
       AddStateError(errors, context, "invalid scalar type");
       continue;
@@ -173,6 +157,24 @@ RuntimeState ParseStateNode(const YAML::Node& root, std::vector<std::string>& er
           forward.remote_port = forward_node["remotePort"] ? forward_node["remotePort"].as<int>() : 0;
           forward.protocol = ParsePortProtocol(forward_node["protocol"]);
           forward.pid = forward_node["pid"] ? forward_node["pid"].as<int>() : 0;
+          if (const auto additional_ports = forward_node["additionalPorts"]) {
+            if (!additional_ports.IsSequence()) {
+              AddStateError(errors, forward_context + ".additionalPorts", "expected list");
+              continue;
+            }
+            for (const auto& mapping_node : additional_ports) {
+              forward.additional_ports.push_back(ManagedPortMapping{
+                  .local_port = mapping_node["localPort"] ? mapping_node["localPort"].as<int>() : 0,
+                  .remote_port = mapping_node["remotePort"] ? mapping_node["remotePort"].as<int>() : 0,
+                  .upstream_port = mapping_node["upstreamPort"] ? mapping_node["upstreamPort"].as<int>() : 0,
+              });
+            }
+          }
+          if (const auto fingerprint = forward_node["fingerprint"]) {
+            forward.fingerprint = ParseFingerprint(fingerprint);
+          }
+          forward.restart_count = forward_node["restarts"] ? forward_node["restarts"].as<int>() : 0;
+          forward.upstream_port = forward_node["upstreamPort"] ? forward_node["upstreamPort"].as<int>() : 0;
         } catch (const YAML::BadConversion&) {
           AddStateError(errors, forward_context, "invalid scalar type");
           continue;
@@ -186,6 +188,683 @@ RuntimeState ParseStateNode(const YAML::Node& root, std::vector<std::string>& er
   return state;
 }
 
+// Binary state layout, all integers little-endian:
+//
+//   header   magic "KFSTATE\0", u32 version, u32 session count, u64 file size, u64 generation (bumped by every
+//            snapshot, so a journal can tell which snapshot it extends; version 1 headers stop before it)
+//   table    one entry per session: u64 record offset, u32 record length, u32 reserved, u64 FNV-1a hashes of the
+//            session id, config path and environment
+//   claims   (version 3) u32 count, u32 reserved, then one entry per claimed local socket, sorted by hash: u64 FNV-1a
+//            hash of bind address, port and protocol, u32 session index, u32 forward index, u32 port mapping index,
+//            u32 reserved
+//   records  one per session; strings are u32-length-prefixed bytes, lists u32-count-prefixed
+//
+// The table lets a lookup decode only the sessions whose hashes match instead of every record in the file, and the
+// claim index does the same for the sessions holding a local socket.
+constexpr char kStateMagic[8] = {'K', 'F', 'S', 'T', 'A', 'T', 'E', '\0'};
+constexpr std::uint32_t kStateFormatVersion = 3;
+constexpr size_t kStateHeaderSize = 32;
+constexpr size_t kVersion1StateHeaderSize = 24;
+constexpr size_t kStateTableEntrySize = 40;
+constexpr size_t kStateClaimsHeaderSize = 8;
+constexpr size_t kStateClaimEntrySize = 24;
+
+std::uint64_t StableHash(const std::string& value) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (const char ch : value) {
+    hash ^= static_cast<unsigned char>(ch);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+PortClaimKey ClaimKeyOf(const ManagedForwardProcess& forward, const ManagedPortMapping& mapping) {
+  return PortClaimKey{
+      .bind_address = forward.bind_address.empty() ? "127.0.0.1" : forward.bind_address,
+      .local_port = mapping.local_port,
+      .protocol = forward.protocol,
+  };
+}
+
+class StateEncoder {
+ public:
+  void U8(std::uint8_t value) { buffer_.push_back(static_cast<char>(value)); }
+
+  void U32(std::uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      U8(static_cast<std::uint8_t>(value >> shift));
+    }
+  }
+
+  void U64(std::uint64_t value) {
+    for (int shift = 0; shift < 64; shift += 8) {
+      U8(static_cast<std::uint8_t>(value >> shift));
+    }
+  }
+
+  void I32(int value) { U32(static_cast<std::uint32_t>(value)); }
+
+  void String(const std::string& value) {
+    U32(static_cast<std::uint32_t>(value.size()));
+    buffer_.append(value);
+  }
+
+  void Fingerprint(const ProcessFingerprint& fingerprint) {
+    U64(fingerprint.start_time);
+    U64(fingerprint.exe_inode);
+    U64(fingerprint.cmdline_hash);
+  }
+
+  //! Overwrites the u64 at `offset`, for sizes only known once everything after them is written.
+  void PatchU64(size_t offset, std::uint64_t value) {
+    for (size_t i = 0; i < 8; ++i) {
+      buffer_[offset + i] = static_cast<char>(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  void PatchU32(size_t offset, std::uint32_t value) {
+    for (size_t i = 0; i < 4; ++i) {
+      buffer_[offset + i] = static_cast<char>(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  void Raw(const char* data, size_t size) { buffer_.append(data, size); }
+  size_t size() const { return buffer_.size(); }
+  const std::string& buffer() const { return buffer_; }
+
+ private:
+  std::string buffer_;
+};
+
+//! Bounds-checked reader over a mapped state file; any read past the end marks it failed and yields zeros.
+class StateDecoder {
+ public:
+  StateDecoder(const char* data, size_t size) : data_(data), size_(size) {}
+
+  bool ok() const { return ok_; }
+
+  std::uint8_t U8() {
+    if (!Need(1)) {
+      return 0;
+    }
+    return static_cast<std::uint8_t>(data_[pos_++]);
+  }
+
+  std::uint32_t U32() {
+    std::uint32_t value = 0;
+    for (int shift = 0; shift < 32 && ok_; shift += 8) {
+      value |= static_cast<std::uint32_t>(U8()) << shift;
+    }
+    return ok_ ? value : 0;
+  }
+
+  std::uint64_t U64() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64 && ok_; shift += 8) {
+      value |= static_cast<std::uint64_t>(U8()) << shift;
+    }
+    return ok_ ? value : 0;
+  }
+
+  int I32() { return static_cast<int>(U32()); }
+
+  std::string String() {
+    const auto length = U32();
+    if (!Need(length)) {
+      return {};
+    }
+    std::string value(data_ + pos_, length);
+    pos_ += length;
+    return value;
+  }
+
+  ProcessFingerprint Fingerprint() {
+    ProcessFingerprint fingerprint;
+    fingerprint.start_time = U64();
+    fingerprint.exe_inode = U64();
+    fingerprint.cmdline_hash = U64();
+    return fingerprint;
+  }
+
+  //! Reads a list count, rejecting counts that could not fit in the remaining bytes at `min_item_size` each.
+  std::uint32_t Count(size_t min_item_size) {
+    const auto count = U32();
+    if (ok_ && static_cast<std::uint64_t>(count) * min_item_size > size_ - pos_) {
+      ok_ = false;
+      return 0;
+    }
+    return count;
+  }
+
+ private:
+  bool Need(size_t bytes) {
+    if (!ok_ || bytes > size_ - pos_) {
+      ok_ = false;
+    }
+    return ok_;
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  bool ok_ = true;
+};
+
+//! Session fields other than the forwards, which are journaled separately when only they change.
+void EncodeSessionFields(const ManagedSession& session, StateEncoder& out) {
+  out.String(session.id);
+  out.String(session.config_path);
+  out.String(session.environment);
+  out.U8(session.daemon ? 1 : 0);
+  out.String(session.started_at_utc);
+  out.I32(session.supervisor_pid);
+  out.Fingerprint(session.supervisor_fingerprint);
+  out.I32(session.drain_timeout_ms);
+}
+
+void EncodeForward(const ManagedForwardProcess& forward, StateEncoder& out) {
+  out.String(forward.environment);
+  out.String(forward.forward_name);
+  out.U32(static_cast<std::uint32_t>(forward.argv.size()));
+  for (const auto& arg : forward.argv) {
+    out.String(arg);
+  }
+  out.String(forward.cwd);
+  out.String(forward.log_path);
+  out.String(forward.bind_address);
+  out.I32(forward.local_port);
+  out.I32(forward.remote_port);
+  out.U8(forward.protocol == config::PortProtocol::kUdp ? 1 : 0);
+  out.I32(forward.pid);
+  out.U32(static_cast<std::uint32_t>(forward.additional_ports.size()));
+  for (const auto& mapping : forward.additional_ports) {
+    out.I32(mapping.local_port);
+    out.I32(mapping.remote_port);
+    out.I32(mapping.upstream_port);
+  }
+  out.Fingerprint(forward.fingerprint);
+  out.I32(forward.restart_count);
+  out.I32(forward.upstream_port);
+}
+
+void EncodeSession(const ManagedSession& session, StateEncoder& out) {
+  EncodeSessionFields(session, out);
+  out.U32(static_cast<std::uint32_t>(session.forwards.size()));
+  for (const auto& forward : session.forwards) {
+    EncodeForward(forward, out);
+  }
+}
+
+ManagedForwardProcess DecodeForward(StateDecoder& in) {
+  ManagedForwardProcess forward;
+  forward.environment = in.String();
+  forward.forward_name = in.String();
+  const auto argc = in.Count(4);
+  forward.argv.reserve(argc);
+  for (std::uint32_t k = 0; k < argc && in.ok(); ++k) {
+    forward.argv.push_back(in.String());
+  }
+  forward.cwd = in.String();
+  forward.log_path = in.String();
+  forward.bind_address = in.String();
+  forward.local_port = in.I32();
+  forward.remote_port = in.I32();
+  forward.protocol = in.U8() == 1 ? config::PortProtocol::kUdp : config::PortProtocol::kTcp;
+  forward.pid = in.I32();
+  const auto mapping_count = in.Count(12);
+  for (std::uint32_t k = 0; k < mapping_count && in.ok(); ++k) {
+    ManagedPortMapping mapping;
+    mapping.local_port = in.I32();
+    mapping.remote_port = in.I32();
+    mapping.upstream_port = in.I32();
+    forward.additional_ports.push_back(mapping);
+  }
+  forward.fingerprint = in.Fingerprint();
+  forward.restart_count = in.I32();
+  forward.upstream_port = in.I32();
+  return forward;
+}
+
+std::optional<ManagedSession> DecodeSession(StateDecoder& in) {
+  ManagedSession session;
+  session.id = in.String();
+  session.config_path = in.String();
+  session.environment = in.String();
+  session.daemon = in.U8() != 0;
+  session.started_at_utc = in.String();
+  session.supervisor_pid = in.I32();
+  session.supervisor_fingerprint = in.Fingerprint();
+  session.drain_timeout_ms = in.I32();
+  const auto forward_count = in.Count(4);
+  session.forwards.reserve(forward_count);
+  for (std::uint32_t i = 0; i < forward_count && in.ok(); ++i) {
+    session.forwards.push_back(DecodeForward(in));
+  }
+  if (!in.ok()) {
+    return std::nullopt;
+  }
+  return session;
+}
+
+std::string EncodeState(const RuntimeState& state, std::uint64_t generation) {
+  StateEncoder out;
+  out.Raw(kStateMagic, sizeof(kStateMagic));
+  out.U32(kStateFormatVersion);
+  out.U32(static_cast<std::uint32_t>(state.sessions.size()));
+  out.U64(0);
+  out.U64(generation);
+  const size_t table_offset = out.size();
+  for (const auto& session : state.sessions) {
+    out.U64(0);
+    out.U32(0);
+    out.U32(0);
+    out.U64(StableHash(session.id));
+    out.U64(StableHash(session.config_path));
+    out.U64(StableHash(session.environment));
+  }
+
+  struct ClaimEntry {
+    std::uint64_t hash;
+    std::uint32_t session;
+    std::uint32_t forward;
+    std::uint32_t mapping;
+  };
+  std::vector<ClaimEntry> claims;
+  for (size_t session = 0; session < state.sessions.size(); ++session) {
+    const auto& forwards = state.sessions[session].forwards;
+    for (size_t forward = 0; forward < forwards.size(); ++forward) {
+      const auto mappings = ManagedPortMappings(forwards[forward]);
+      for (size_t mapping = 0; mapping < mappings.size(); ++mapping) {
+        claims.push_back(ClaimEntry{
+            .hash = PortClaimHash(ClaimKeyOf(forwards[forward], mappings[mapping])),
+            .session = static_cast<std::uint32_t>(session),
+            .forward = static_cast<std::uint32_t>(forward),
+            .mapping = static_cast<std::uint32_t>(mapping),
+        });
+      }
+    }
+  }
+  std::stable_sort(claims.begin(), claims.end(),
+                   [](const ClaimEntry& left, const ClaimEntry& right) { return left.hash < right.hash; });
+  out.U32(static_cast<std::uint32_t>(claims.size()));
+  out.U32(0);
+  for (const auto& claim : claims) {
+    out.U64(claim.hash);
+    out.U32(claim.session);
+    out.U32(claim.forward);
+    out.U32(claim.mapping);
+    out.U32(0);
+  }
+
+  for (size_t i = 0; i < state.sessions.size(); ++i) {
+    const size_t record_offset = out.size();
+    EncodeSession(state.sessions[i], out);
+    const size_t entry = table_offset + i * kStateTableEntrySize;
+    out.PatchU64(entry, record_offset);
+    out.PatchU32(entry + 8, static_cast<std::uint32_t>(out.size() - record_offset));
+  }
+  out.PatchU64(16, out.size());
+  return out.buffer();
+}
+
+bool MatchesQuery(const ManagedSession& session, const SessionQuery& query) {
+  return (query.id.empty() || session.id == query.id) &&
+         (query.config_path.empty() || session.config_path == query.config_path) &&
+         (query.environment.empty() || session.environment == query.environment);
+}
+
+//! Where the parts of a binary state file are.
+struct SnapshotLayout {
+  std::uint32_t session_count = 0;
+  std::uint64_t generation = 0;
+  size_t table_offset = 0;
+  //! Whether the file carries a claim index (version 3 and later).
+  bool has_claims = false;
+  size_t claims_offset = 0;
+  std::uint32_t claim_count = 0;
+};
+
+std::optional<SnapshotLayout> ReadSnapshotLayout(const char* data, size_t size, std::vector<std::string>& errors) {
+  StateDecoder header(data, size);
+  for (size_t i = 0; i < sizeof(kStateMagic); ++i) {
+    (void)header.U8();
+  }
+  const auto version = header.U32();
+  SnapshotLayout layout;
+  layout.session_count = header.U32();
+  const auto file_size = header.U64();
+  if (version < 1 || version > kStateFormatVersion) {
+    errors.push_back("state parse error: unsupported state format version " + std::to_string(version));
+    return std::nullopt;
+  }
+  layout.generation = version == 1 ? 0 : header.U64();
+  layout.table_offset = version == 1 ? kVersion1StateHeaderSize : kStateHeaderSize;
+  const auto table_end =
+      layout.table_offset + static_cast<std::uint64_t>(layout.session_count) * kStateTableEntrySize;
+  if (!header.ok() || file_size != size || table_end > size) {
+    errors.push_back("state parse error: state file is truncated");
+    return std::nullopt;
+  }
+  if (version >= 3) {
+    layout.has_claims = true;
+    layout.claims_offset = static_cast<size_t>(table_end);
+    StateDecoder claims(data + layout.claims_offset, size - layout.claims_offset);
+    layout.claim_count = claims.U32();
+    if (!claims.ok() || layout.claims_offset + kStateClaimsHeaderSize +
+                                static_cast<std::uint64_t>(layout.claim_count) * kStateClaimEntrySize >
+                            size) {
+      errors.push_back("state parse error: state file is truncated");
+      return std::nullopt;
+    }
+  }
+  return layout;
+}
+
+//! Decodes the record of session `index`; std::nullopt with an error added when it is out of bounds or truncated.
+std::optional<ManagedSession> DecodeSnapshotSession(const char* data, size_t size, const SnapshotLayout& layout,
+                                                    std::uint32_t index, std::vector<std::string>& errors) {
+  StateDecoder entry(data + layout.table_offset + index * kStateTableEntrySize, kStateTableEntrySize);
+  const auto offset = entry.U64();
+  const auto length = entry.U32();
+  if (offset > size || length > size - offset) {
+    errors.push_back("sessions[" + std::to_string(index) + "]: record out of bounds");
+    return std::nullopt;
+  }
+  StateDecoder record(data + offset, length);
+  auto session = DecodeSession(record);
+  if (!session.has_value()) {
+    errors.push_back("sessions[" + std::to_string(index) + "]: truncated record");
+  }
+  return session;
+}
+
+//! Decodes the sessions of a binary state file that match `query`, skipping the records of every other session, and
+//! returns the snapshot generation.
+std::uint64_t DecodeState(const char* data, size_t size, const SessionQuery& query, StateLoadResult& result) {
+  const auto layout = ReadSnapshotLayout(data, size, result.errors);
+  if (!layout.has_value()) {
+    return 0;
+  }
+
+  const auto id_hash = StableHash(query.id);
+  const auto config_hash = StableHash(query.config_path);
+  const auto environment_hash = StableHash(query.environment);
+  StateDecoder table(data + layout->table_offset, layout->session_count * kStateTableEntrySize);
+  for (std::uint32_t i = 0; i < layout->session_count; ++i) {
+    (void)table.U64();
+    (void)table.U32();
+    (void)table.U32();
+    const auto entry_id_hash = table.U64();
+    const auto entry_config_hash = table.U64();
+    const auto entry_environment_hash = table.U64();
+    if ((!query.id.empty() && entry_id_hash != id_hash) ||
+        (!query.config_path.empty() && entry_config_hash != config_hash) ||
+        (!query.environment.empty() && entry_environment_hash != environment_hash)) {
+      continue;
+    }
+    auto session = DecodeSnapshotSession(data, size, *layout, i, result.errors);
+    if (!session.has_value()) {
+      continue;
+    }
+    // Hashes only narrow the search down; a collision is settled on the decoded values.
+    if (MatchesQuery(*session, query)) {
+      result.state.sessions.push_back(std::move(*session));
+    }
+  }
+  return layout->generation;
+}
+
+// State journal, next to the snapshot as `<state>.journal`. Writes append the sessions they changed instead of
+// rewriting the snapshot:
+//
+//   header   magic "KFJOURN\0", u32 version, u32 reserved, u64 generation and u64 size of the snapshot it extends
+//   records  u32 payload length, u32 checksum (low half of the payload's FNV-1a hash), payload
+//
+// A payload is a record kind followed by a whole session, a session id, or a session id, forward index and forward.
+// Records only ever set values, so replaying them in order rebuilds the latest state. A journal whose header names
+// another snapshot is stale (its snapshot was compacted away) and is ignored, and replay stops at the first torn
+// record a crash may have left behind.
+constexpr char kJournalMagic[8] = {'K', 'F', 'J', 'O', 'U', 'R', 'N', '\0'};
+constexpr std::uint32_t kJournalFormatVersion = 1;
+constexpr size_t kJournalHeaderSize = 32;
+constexpr size_t kJournalRecordHeaderSize = 8;
+//! The journal is folded into a new snapshot once it outgrows the snapshot, and never before it reaches this size.
+constexpr size_t kJournalCompactionMinimumBytes = 64 * 1024;
+//! Writers publish within a few system calls, so readers that keep colliding with them are rare; past this long a
+//! reader only takes the lock if it is free.
+constexpr std::chrono::microseconds kLockFreeReadBudget(500);
+
+enum class JournalRecordKind : std::uint8_t {
+  kPutSession = 1,
+  kRemoveSession = 2,
+  kPutForward = 3,
+};
+
+//! Read-only mapping of a whole file; empty when the file is missing or empty.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  //! Maps `path`. Adds an error naming `what` when the file exists but cannot be mapped.
+  bool Map(const std::filesystem::path& path, const char* what, std::vector<std::string>& errors) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return true;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      return true;
+    }
+    const auto size = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      errors.push_back(std::string("failed to map ") + what + ": " + std::strerror(errno));
+      return false;
+    }
+    data_ = static_cast<const char*>(mapping);
+    size_ = size;
+    return true;
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+//! What ReadLockedState() found on disk, for the write that follows it under the same lock.
+struct StateFiles {
+  //! The snapshot is in the binary format (false when it is missing or still YAML).
+  bool binary_snapshot = false;
+  std::uint64_t snapshot_generation = 0;
+  size_t snapshot_size = 0;
+  //! Bytes of the journal up to its last intact record; 0 when there is no usable journal.
+  size_t journal_size = 0;
+};
+
+std::filesystem::path StateJournalPath(const std::filesystem::path& path) { return path.string() + ".journal"; }
+
+std::uint32_t JournalChecksum(const char* data, size_t size) {
+  return static_cast<std::uint32_t>(StableHash(std::string(data, size)));
+}
+
+void AppendJournalRecord(const StateEncoder& payload, std::string& journal) {
+  StateEncoder header;
+  header.U32(static_cast<std::uint32_t>(payload.size()));
+  header.U32(JournalChecksum(payload.buffer().data(), payload.size()));
+  journal.append(header.buffer());
+  journal.append(payload.buffer());
+}
+
+//! Journal records turning `before` into `after`, or std::nullopt when only a new snapshot can express the change
+//! (surviving sessions were reordered, or ids are not unique).
+std::optional<std::string> JournalRecords(const RuntimeState& before, const RuntimeState& after) {
+  std::map<std::string, const ManagedSession*> previous;
+  for (const auto& session : before.sessions) {
+    if (!previous.emplace(session.id, &session).second) {
+      return std::nullopt;
+    }
+  }
+  std::set<std::string> current;
+  std::vector<const std::string*> surviving_order;
+  for (const auto& session : after.sessions) {
+    if (!current.insert(session.id).second) {
+      return std::nullopt;
+    }
+    if (previous.count(session.id) != 0) {
+      surviving_order.push_back(&session.id);
+    }
+  }
+  size_t next_surviving = 0;
+  for (const auto& session : before.sessions) {
+    if (current.count(session.id) != 0 && *surviving_order[next_surviving++] != session.id) {
+      return std::nullopt;
+    }
+  }
+
+  std::string journal;
+  for (const auto& session : before.sessions) {
+    if (current.count(session.id) == 0) {
+      StateEncoder payload;
+      payload.U8(static_cast<std::uint8_t>(JournalRecordKind::kRemoveSession));
+      payload.String(session.id);
+      AppendJournalRecord(payload, journal);
+    }
+  }
+  for (const auto& session : after.sessions) {
+    const auto found = previous.find(session.id);
+    if (found != previous.end()) {
+      const auto& old_session = *found->second;
+      StateEncoder old_fields;
+      StateEncoder new_fields;
+      EncodeSessionFields(old_session, old_fields);
+      EncodeSessionFields(session, new_fields);
+      // Restarts and pid updates touch single forwards; those are journaled on their own.
+      if (old_fields.buffer() == new_fields.buffer() && old_session.forwards.size() == session.forwards.size()) {
+        for (size_t index = 0; index < session.forwards.size(); ++index) {
+          StateEncoder old_forward;
+          StateEncoder new_forward;
+          EncodeForward(old_session.forwards[index], old_forward);
+          EncodeForward(session.forwards[index], new_forward);
+          if (old_forward.buffer() == new_forward.buffer()) {
+            continue;
+          }
+          StateEncoder payload;
+          payload.U8(static_cast<std::uint8_t>(JournalRecordKind::kPutForward));
+          payload.String(session.id);
+          payload.U32(static_cast<std::uint32_t>(index));
+          payload.Raw(new_forward.buffer().data(), new_forward.size());
+          AppendJournalRecord(payload, journal);
+        }
+        continue;
+      }
+    }
+    StateEncoder payload;
+    payload.U8(static_cast<std::uint8_t>(JournalRecordKind::kPutSession));
+    EncodeSession(session, payload);
+    AppendJournalRecord(payload, journal);
+  }
+  return journal;
+}
+
+//! Calls `visit` with the kind and payload of every intact record in the journal extending the snapshot described by
+//! `files`, and records in `files` where the intact records end.
+void ForEachJournalRecord(const std::filesystem::path& path, StateFiles& files, std::vector<std::string>& errors,
+                          const std::function<void(JournalRecordKind, StateDecoder&)>& visit) {
+  // Read rather than mapped: writers truncate a torn tail in place, which would fault a mapping of it.
+  std::ifstream in(StateJournalPath(path), std::ios::binary);
+  if (!in) {
+    return;
+  }
+  const std::string journal((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (in.bad()) {
+    errors.push_back("failed to read state journal");
+    return;
+  }
+  if (journal.size() < kJournalHeaderSize) {
+    return;
+  }
+  const auto* data = journal.data();
+  const auto size = journal.size();
+
+  StateDecoder header(data, kJournalHeaderSize);
+  for (size_t i = 0; i < sizeof(kJournalMagic); ++i) {
+    (void)header.U8();
+  }
+  const auto version = header.U32();
+  (void)header.U32();
+  const auto snapshot_generation = header.U64();
+  const auto snapshot_size = header.U64();
+  if (std::memcmp(data, kJournalMagic, sizeof(kJournalMagic)) != 0 || version != kJournalFormatVersion ||
+      snapshot_generation != files.snapshot_generation || snapshot_size != files.snapshot_size) {
+    return;
+  }
+
+  size_t offset = kJournalHeaderSize;
+  while (size - offset >= kJournalRecordHeaderSize) {
+    StateDecoder record_header(data + offset, kJournalRecordHeaderSize);
+    const auto length = record_header.U32();
+    const auto checksum = record_header.U32();
+    const auto* payload_data = data + offset + kJournalRecordHeaderSize;
+    if (length > size - offset - kJournalRecordHeaderSize || JournalChecksum(payload_data, length) != checksum) {
+      break;
+    }
+    StateDecoder payload(payload_data, length);
+    const auto kind = static_cast<JournalRecordKind>(payload.U8());
+    visit(kind, payload);
+    offset += kJournalRecordHeaderSize + length;
+  }
+  files.journal_size = offset;
+}
+
+//! Replays the journal of `path` over the sessions read from its snapshot, keeping those matching `query`.
+void ReplayJournal(const std::filesystem::path& path, const SessionQuery& query, StateLoadResult& result,
+                   StateFiles& files) {
+  auto& sessions = result.state.sessions;
+  const auto find_session = [&](const std::string& id) {
+    return std::find_if(sessions.begin(), sessions.end(), [&](const ManagedSession& session) {
+      return session.id == id;
+    });
+  };
+  ForEachJournalRecord(path, files, result.errors, [&](JournalRecordKind kind, StateDecoder& payload) {
+    if (kind == JournalRecordKind::kPutSession) {
+      auto session = DecodeSession(payload);
+      if (session.has_value()) {
+        const auto existing = find_session(session->id);
+        if (existing != sessions.end()) {
+          *existing = std::move(*session);
+        } else if (MatchesQuery(*session, query)) {
+          sessions.push_back(std::move(*session));
+        }
+      }
+    } else if (kind == JournalRecordKind::kRemoveSession) {
+      const auto id = payload.String();
+      if (const auto existing = find_session(id); payload.ok() && existing != sessions.end()) {
+        sessions.erase(existing);
+      }
+    } else if (kind == JournalRecordKind::kPutForward) {
+      const auto id = payload.String();
+      const auto index = payload.U32();
+      auto forward = DecodeForward(payload);
+      const auto existing = find_session(id);
+      if (payload.ok() && existing != sessions.end() && index < existing->forwards.size()) {
+        existing->forwards[index] = std::move(forward);
+      }
+    }
+  });
+}
+
 std::filesystem::path StateLockPath(const std::filesystem::path& path) { return path.string() + ".lock"; }
 
 int OpenAndLockStateFile(const std::filesystem::path& path, int lock_mode, std::string& error) {
@@ -196,7 +875,8 @@ int OpenAndLockStateFile(const std::filesystem::path& path, int lock_mode, std::
     return -1;
   }
   if (::flock(lock_fd, lock_mode) != 0) {
-    error = "failed to lock state file: " + std::string(std::strerror(errno));
+    error = errno == EWOULDBLOCK ? std::string("state file is being written; try again")
+                                 : "failed to lock state file: " + std::string(std::strerror(errno));
     ::close(lock_fd);
     return -1;
   }
@@ -210,8 +890,424 @@ std::filesystem::path BuildTemporaryStatePath(const std::filesystem::path& path)
   return path.string() + suffix.str();
 }
 
+//! Reads the sessions matching `query` from the state file at `path` and its journal into `result`; the caller holds
+//! the state lock or checks the state sequence around the read. The snapshot is mapped rather than read, so sessions
+//! that do not match are never touched; it is only ever replaced by rename, never rewritten in place. YAML state from
+//! older versions is still read, and replaced by the binary format on the next write.
+void ReadLockedState(const std::filesystem::path& path, const SessionQuery& query, StateLoadResult& result,
+                     StateFiles& files) {
+  MappedFile snapshot;
+  if (!snapshot.Map(path, "state file", result.errors) || snapshot.size() == 0) {
+    return;
+  }
+  const auto* data = snapshot.data();
+  const auto size = snapshot.size();
+  files.snapshot_size = size;
+  if (size >= kVersion1StateHeaderSize && std::memcmp(data, kStateMagic, sizeof(kStateMagic)) == 0) {
+    files.binary_snapshot = true;
+    files.snapshot_generation = DecodeState(data, size, query, result);
+    ReplayJournal(path, query, result, files);
+  } else {
+    try {
+      const YAML::Node root = YAML::Load(std::string(data, size));
+      result.state = ParseStateNode(root, result.errors);
+      auto& sessions = result.state.sessions;
+      sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                    [&](const ManagedSession& session) { return !MatchesQuery(session, query); }),
+                     sessions.end());
+    } catch (const YAML::ParserException& ex) {
+      result.errors.push_back(std::string("state parse error: ") + ex.what());
+    }
+  }
+}
+
+PortClaim ClaimOf(const ManagedSession& session, const ManagedForwardProcess& forward, PortClaimKey key) {
+  return PortClaim{
+      .key = std::move(key),
+      .session_id = session.id,
+      .config_path = session.config_path,
+      .environment = session.environment,
+      .forward_name = forward.forward_name,
+      .pid = forward.pid,
+      .fingerprint = forward.fingerprint,
+  };
+}
+
+//! Decodes the snapshot session with id `id`, found through the hashes of the session table.
+std::optional<ManagedSession> FindSnapshotSession(const char* data, size_t size, const SnapshotLayout& layout,
+                                                  const std::string& id, std::vector<std::string>& errors) {
+  const auto id_hash = StableHash(id);
+  StateDecoder table(data + layout.table_offset, layout.session_count * kStateTableEntrySize);
+  for (std::uint32_t i = 0; i < layout.session_count; ++i) {
+    (void)table.U64();
+    (void)table.U32();
+    (void)table.U32();
+    const auto entry_id_hash = table.U64();
+    (void)table.U64();
+    (void)table.U64();
+    if (entry_id_hash != id_hash) {
+      continue;
+    }
+    auto session = DecodeSnapshotSession(data, size, layout, i, errors);
+    if (session.has_value() && session->id == id) {
+      return session;
+    }
+  }
+  return std::nullopt;
+}
+
+//! Looks `keys` up in the claim index of a version 3 snapshot and applies the journal on top: sessions the journal
+//! puts or removes are answered from their journaled form instead of the index.
+void LookupIndexedPortClaims(const std::filesystem::path& path, const char* data, size_t size,
+                             const SnapshotLayout& layout, const std::vector<PortClaimKey>& keys,
+                             PortClaimLookup& lookup) {
+  std::map<std::string, std::optional<ManagedSession>> journaled;
+  StateFiles files{.binary_snapshot = true, .snapshot_generation = layout.generation, .snapshot_size = size};
+  ForEachJournalRecord(path, files, lookup.errors, [&](JournalRecordKind kind, StateDecoder& payload) {
+    if (kind == JournalRecordKind::kPutSession) {
+      auto session = DecodeSession(payload);
+      if (session.has_value()) {
+        auto id = session->id;
+        journaled[id] = std::move(session);
+      }
+    } else if (kind == JournalRecordKind::kRemoveSession) {
+      const auto id = payload.String();
+      if (payload.ok()) {
+        journaled[id] = std::nullopt;
+      }
+    } else if (kind == JournalRecordKind::kPutForward) {
+      const auto id = payload.String();
+      const auto index = payload.U32();
+      auto forward = DecodeForward(payload);
+      if (!payload.ok()) {
+        return;
+      }
+      auto existing = journaled.find(id);
+      if (existing == journaled.end()) {
+        existing = journaled.emplace(id, FindSnapshotSession(data, size, layout, id, lookup.errors)).first;
+      }
+      if (existing->second.has_value() && index < existing->second->forwards.size()) {
+        existing->second->forwards[index] = std::move(forward);
+      }
+    }
+  });
+
+  // Index entries matching a key hash, as (session, forward, mapping) so the claims come out in session order.
+  std::set<std::tuple<std::uint32_t, std::uint32_t, std::uint32_t>> entries;
+  const auto* index = data + layout.claims_offset + kStateClaimsHeaderSize;
+  const auto entry_hash = [&](std::uint32_t i) {
+    StateDecoder entry(index + i * kStateClaimEntrySize, sizeof(std::uint64_t));
+    return entry.U64();
+  };
+  for (const auto& key : keys) {
+    const auto hash = PortClaimHash(key);
+    std::uint32_t low = 0;
+    std::uint32_t high = layout.claim_count;
+    while (low < high) {
+      const auto middle = low + (high - low) / 2;
+      if (entry_hash(middle) < hash) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    for (auto i = low; i < layout.claim_count && entry_hash(i) == hash; ++i) {
+      StateDecoder entry(index + i * kStateClaimEntrySize + sizeof(std::uint64_t),
+                         kStateClaimEntrySize - sizeof(std::uint64_t));
+      const auto session = entry.U32();
+      const auto forward = entry.U32();
+      const auto mapping = entry.U32();
+      if (session < layout.session_count) {
+        entries.emplace(session, forward, mapping);
+      }
+    }
+  }
+
+  std::optional<std::uint32_t> decoded_index;
+  std::optional<ManagedSession> decoded;
+  for (const auto& [session_index, forward_index, mapping_index] : entries) {
+    if (decoded_index != session_index) {
+      decoded_index = session_index;
+      decoded = DecodeSnapshotSession(data, size, layout, session_index, lookup.errors);
+    }
+    if (!decoded.has_value() || journaled.count(decoded->id) != 0 || forward_index >= decoded->forwards.size()) {
+      continue;
+    }
+    const auto& forward = decoded->forwards[forward_index];
+    const auto mappings = ManagedPortMappings(forward);
+    if (mapping_index >= mappings.size()) {
+      continue;
+    }
+    // Hashes only narrow the search; the key itself decides.
+    auto key = ClaimKeyOf(forward, mappings[mapping_index]);
+    if (std::find(keys.begin(), keys.end(), key) != keys.end()) {
+      lookup.claims.push_back(ClaimOf(*decoded, forward, std::move(key)));
+    }
+  }
+
+  RuntimeState journaled_state;
+  for (auto& [id, session] : journaled) {
+    if (session.has_value()) {
+      journaled_state.sessions.push_back(std::move(*session));
+    }
+  }
+  auto journaled_claims = PortClaimsOf(journaled_state, keys);
+  std::move(journaled_claims.begin(), journaled_claims.end(), std::back_inserter(lookup.claims));
+}
+
+std::filesystem::path StateSequencePath(const std::filesystem::path& path) { return path.string() + ".seq"; }
+
+//! Counter in `<state>.seq`, mapped shared by writers and lock-free readers (a seqlock): odd while a writer publishes
+//! a snapshot or journal records, and different after every publication, so a reader that saw the same even value
+//! before and after reading knows it read one consistent state.
+class StateSequence {
+ public:
+  StateSequence() = default;
+  StateSequence(const StateSequence&) = delete;
+  StateSequence& operator=(const StateSequence&) = delete;
+  ~StateSequence() {
+    if (counter_ != nullptr) {
+      ::munmap(counter_, sizeof(std::uint64_t));
+    }
+  }
+
+  //! Maps the counter, creating it when `writable`. Returns false with errno set when it cannot be mapped.
+  bool Map(const std::filesystem::path& path, bool writable) {
+    const auto sequence_path = StateSequencePath(path);
+    const int fd = writable ? ::open(sequence_path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644)
+                            : ::open(sequence_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 ||
+        (static_cast<size_t>(info.st_size) < sizeof(std::uint64_t) &&
+         (!writable || ::ftruncate(fd, static_cast<off_t>(sizeof(std::uint64_t))) != 0))) {
+      const int saved_errno = writable ? errno : EINVAL;
+      ::close(fd);
+      errno = saved_errno;
+      return false;
+    }
+    void* mapping = ::mmap(nullptr, sizeof(std::uint64_t), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                           fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+    counter_ = static_cast<std::uint64_t*>(mapping);
+    return true;
+  }
+
+  std::uint64_t Load() const { return Counter().load(std::memory_order_acquire); }
+
+  //! Whether no write was published since Load() returned `seen`.
+  bool Unchanged(std::uint64_t seen) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return Counter().load(std::memory_order_relaxed) == seen;
+  }
+
+  void BeginWrite() {
+    // Stays odd when a writer died halfway; readers then fall back to the lock until this write ends.
+    begun_ = Counter().load(std::memory_order_relaxed) | 1;
+    Counter().store(begun_, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void EndWrite() { Counter().store(begun_ + 1, std::memory_order_release); }
+
+ private:
+  std::atomic_ref<std::uint64_t> Counter() const { return std::atomic_ref<std::uint64_t>(*counter_); }
+
+  std::uint64_t* counter_ = nullptr;
+  std::uint64_t begun_ = 0;
+};
+
+static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free,
+              "the state sequence is shared between processes and must not need a lock");
+
+bool WriteFully(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    written += static_cast<size_t>(count);
+  }
+  return true;
+}
+
+//! Replaces the state file through a temporary file and rename() and drops the journal it absorbed; the caller holds
+//! the exclusive state lock.
+bool WriteStateSnapshot(const std::filesystem::path& path, const RuntimeState& state, std::uint64_t generation,
+                        StateSequence& sequence, std::string& error) {
+  const auto tmp_path = BuildTemporaryStatePath(path);
+  const int fd = ::open(tmp_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    error = "failed to open temporary state file for writing";
+    return false;
+  }
+  if (!WriteFully(fd, EncodeState(state, generation)) || ::fsync(fd) != 0) {
+    error = "failed to flush temporary state file";
+    ::close(fd);
+    std::error_code remove_ec;
+    std::filesystem::remove(tmp_path, remove_ec);
+    return false;
+  }
+  ::close(fd);
+
+  // Readers that would pair the new snapshot with the journal of the old one retry.
+  sequence.BeginWrite();
+  std::error_code rename_ec;
+  std::filesystem::rename(tmp_path, path, rename_ec);
+  if (rename_ec) {
+    sequence.EndWrite();
+    error = "failed to replace state file atomically: " + rename_ec.message();
+    std::error_code remove_ec;
+    std::filesystem::remove(tmp_path, remove_ec);
+    return false;
+  }
+  // A journal left behind by a crash right here names the replaced snapshot and is ignored from now on.
+  std::error_code remove_ec;
+  std::filesystem::remove(StateJournalPath(path), remove_ec);
+  sequence.EndWrite();
+
+  error.clear();
+  return true;
+}
+
+//! Appends `records` to the journal of the snapshot described by `files`, dropping a torn tail first, and syncs only
+//! what was appended.
+bool AppendStateJournal(const std::filesystem::path& path, const StateFiles& files, const std::string& records,
+                        StateSequence& sequence, std::string& error) {
+  const auto journal_path = StateJournalPath(path);
+  const int fd = ::open(journal_path.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    error = "failed to open state journal: " + std::string(std::strerror(errno));
+    return false;
+  }
+  std::string data;
+  if (files.journal_size == 0) {
+    StateEncoder header;
+    header.Raw(kJournalMagic, sizeof(kJournalMagic));
+    header.U32(kJournalFormatVersion);
+    header.U32(0);
+    header.U64(files.snapshot_generation);
+    header.U64(files.snapshot_size);
+    data = header.buffer();
+  }
+  data += records;
+  // Only publishing the records is fenced off from readers; syncing them to disk is not.
+  sequence.BeginWrite();
+  const bool appended = ::ftruncate(fd, static_cast<off_t>(files.journal_size)) == 0 &&
+                        ::lseek(fd, static_cast<off_t>(files.journal_size), SEEK_SET) >= 0 && WriteFully(fd, data);
+  sequence.EndWrite();
+  if (!appended || ::fdatasync(fd) != 0) {
+    error = "failed to append to state journal: " + std::string(std::strerror(errno));
+    ::close(fd);
+    return false;
+  }
+  ::close(fd);
+  error.clear();
+  return true;
+}
+
+//! Registers the sockets claimed by `state` in the registry shared with the other state files. Best effort: the
+//! registry only widens conflict checks, so a state write does not fail because of it.
+void RegisterClaimsOf(const std::filesystem::path& path, const RuntimeState& state) {
+  std::vector<PortClaimKey> keys;
+  for (const auto& session : state.sessions) {
+    for (const auto& forward : session.forwards) {
+      for (const auto& mapping : ManagedPortMappings(forward)) {
+        keys.push_back(ClaimKeyOf(forward, mapping));
+      }
+    }
+  }
+  std::string ignored;
+  (void)RegisterStateClaims(ClaimRegistryPath(), path, keys, ignored);
+}
+
+//! Persists `state`, which replaces `previous` (std::nullopt when the current state is unknown), under the exclusive
+//! state lock. Changes are appended to the journal; a new snapshot is written instead when there is no binary snapshot
+//! to extend yet, when the journal would outgrow the snapshot, or when no session is left.
+bool WriteLockedState(const std::filesystem::path& path, const RuntimeState* previous, const StateFiles& files,
+                      const RuntimeState& state, std::string& error) {
+  StateSequence sequence;
+  if (!sequence.Map(path, true)) {
+    error = "failed to open state sequence file: " + std::string(std::strerror(errno));
+    return false;
+  }
+  std::optional<bool> written;
+  if (previous != nullptr && files.binary_snapshot && !state.sessions.empty()) {
+    if (const auto records = JournalRecords(*previous, state)) {
+      if (records->empty()) {
+        error.clear();
+        return true;
+      }
+      const size_t journal_size = std::max(files.journal_size, kJournalHeaderSize) + records->size();
+      if (journal_size <= std::max(kJournalCompactionMinimumBytes, files.snapshot_size)) {
+        written = AppendStateJournal(path, files, *records, sequence, error);
+      }
+    }
+  }
+  if (!written.has_value()) {
+    written = WriteStateSnapshot(path, state, files.snapshot_generation + 1, sequence, error);
+  }
+  if (*written) {
+    RegisterClaimsOf(path, state);
+  }
+  return *written;
+}
+
+bool CreateStateDirectory(const std::filesystem::path& path, std::string& error) {
+  const auto parent = path.parent_path();
+  if (parent.empty()) {
+    return true;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(parent, ec);
+  if (ec) {
+    error = "failed to create state directory: " + ec.message();
+    return false;
+  }
+  return true;
+}
+
+//! Moves a state file (and its journal and sequence counter) still at the name used while state was YAML to `path`,
+//! under the old file's lock, unless `path` exists already.
+void MoveLegacyStateFile(const std::filesystem::path& legacy_path, const std::filesystem::path& path) {
+  std::error_code ec;
+  if (std::filesystem::exists(path, ec) || !std::filesystem::exists(legacy_path, ec)) {
+    return;
+  }
+  std::string lock_error;
+  const int lock_fd = OpenAndLockStateFile(legacy_path, LOCK_EX, lock_error);
+  if (lock_fd < 0) {
+    return;
+  }
+  if (!std::filesystem::exists(path, ec)) {
+    for (const auto* suffix : {".journal", ".seq", ""}) {
+      std::error_code rename_ec;
+      std::filesystem::rename(legacy_path.string() + suffix, path.string() + suffix, rename_ec);
+    }
+  }
+  ::close(lock_fd);
+}
+
 }  // namespace
 
+std::vector<ManagedPortMapping> ManagedPortMappings(const ManagedForwardProcess& process) {
+  std::vector<ManagedPortMapping> mappings;
+  mappings.reserve(process.additional_ports.size() + 1);
+  mappings.push_back(ManagedPortMapping{
+      .local_port = process.local_port, .remote_port = process.remote_port, .upstream_port = process.upstream_port});
+  mappings.insert(mappings.end(), process.additional_ports.begin(), process.additional_ports.end());
+  return mappings;
+}
+
 std::filesystem::path DefaultStatePathForConfig(const std::string& config_path) {
   if (const char* override_path = std::getenv("KUBEFORWARD_STATE_FILE")) {
     if (override_path[0] != '\0') {
@@ -222,10 +1318,37 @@ std::filesystem::path DefaultStatePathForConfig(const std::string& config_path)
   const std::string normalized = NormalizeConfigPath(config_path);
   const size_t hash = std::hash<std::string>{}(normalized);
   const auto base_dir = std::filesystem::temp_directory_path() / "kubeforward";
-  return base_dir / ("state-" + std::to_string(hash) + ".yaml");
+  const auto path = base_dir / ("state-" + std::to_string(hash) + ".bin");
+  MoveLegacyStateFile(base_dir / ("state-" + std::to_string(hash) + ".yaml"), path);
+  return path;
 }
 
-StateLoadResult LoadState(const std::filesystem::path& path) {
+std::uint64_t PortClaimHash(const PortClaimKey& key) {
+  return StableHash(key.bind_address + "|" + std::to_string(key.local_port) + "|" +
+                    (key.protocol == config::PortProtocol::kUdp ? "udp" : "tcp"));
+}
+
+std::vector<PortClaim> PortClaimsOf(const RuntimeState& state, const std::vector<PortClaimKey>& keys) {
+  std::vector<PortClaim> claims;
+  for (const auto& session : state.sessions) {
+    for (const auto& forward : session.forwards) {
+      for (const auto& mapping : ManagedPortMappings(forward)) {
+        auto key = ClaimKeyOf(forward, mapping);
+        if (std::find(keys.begin(), keys.end(), key) != keys.end()) {
+          claims.push_back(ClaimOf(session, forward, std::move(key)));
+        }
+      }
+    }
+  }
+  return claims;
+}
+
+StateLoadResult LoadState(const std::filesystem::path& path) { return LoadSessions(path, SessionQuery{}); }
+
+namespace {
+
+//! LoadSessions under the state lock taken with `lock_mode`.
+StateLoadResult LoadLockedSessions(const std::filesystem::path& path, const SessionQuery& query, int lock_mode) {
   StateLoadResult result;
   const auto parent = path.parent_path();
   if (!parent.empty()) {
@@ -237,78 +1360,131 @@ StateLoadResult LoadState(const std::filesystem::path& path) {
   }
 
   std::string lock_error;
-  const int lock_fd = OpenAndLockStateFile(path, LOCK_SH, lock_error);
+  const int lock_fd = OpenAndLockStateFile(path, lock_mode, lock_error);
   if (lock_fd < 0) {
     result.errors.push_back(lock_error);
     return result;
   }
 
-  std::ifstream input(path);
-  if (!input.is_open()) {
-    ::close(lock_fd);
-    return result;
-  }
-
-  std::stringstream buffer;
-  buffer << input.rdbuf();
-  try {
-    const YAML::Node root = YAML::Load(buffer.str());
-    result.state = ParseStateNode(root, result.errors);
-  } catch (const YAML::ParserException& ex) {
-    result.errors.push_back(std::string("state parse error: ") + ex.what());
-  }
+  StateFiles files;
+  ReadLockedState(path, query, result, files);
   ::close(lock_fd);
   return result;
 }
 
-bool SaveState(const std::filesystem::path& path, const RuntimeState& state, std::string& error) {
-  std::error_code ec;
+}  // namespace
+
+StateLoadResult LoadSessions(const std::filesystem::path& path, const SessionQuery& query) {
+  return LoadLockedSessions(path, query, LOCK_SH);
+}
+
+StateLoadResult LoadSessionsWithoutLock(const std::filesystem::path& path, const SessionQuery& query) {
+  StateSequence sequence;
+  if (sequence.Map(path, false)) {
+    const auto deadline = std::chrono::steady_clock::now() + kLockFreeReadBudget;
+    do {
+      const auto seen = sequence.Load();
+      if (seen % 2 == 0) {
+        StateLoadResult result;
+        StateFiles files;
+        ReadLockedState(path, query, result, files);
+        if (sequence.Unchanged(seen)) {
+          return result;
+        }
+      }
+      ::sched_yield();
+    } while (std::chrono::steady_clock::now() < deadline);
+  }
+  // No state written by this version yet, a writer died while publishing, or writers kept publishing: the lock settles
+  // it when nobody holds it, and the reader gives up rather than wait for a writer that does.
+  return LoadLockedSessions(path, query, LOCK_SH | LOCK_NB);
+}
+
+PortClaimLookup LookupPortClaims(const std::filesystem::path& path, const std::vector<PortClaimKey>& keys) {
+  PortClaimLookup lookup;
   const auto parent = path.parent_path();
   if (!parent.empty()) {
-    std::filesystem::create_directories(parent, ec);
-    if (ec) {
-      error = "failed to create state directory: " + ec.message();
-      return false;
+    std::error_code parent_ec;
+    const bool parent_exists = std::filesystem::exists(parent, parent_ec);
+    if (parent_ec || !parent_exists) {
+      return lookup;
+    }
+  }
+
+  std::string lock_error;
+  const int lock_fd = OpenAndLockStateFile(path, LOCK_SH, lock_error);
+  if (lock_fd < 0) {
+    lookup.errors.push_back(lock_error);
+    return lookup;
+  }
+
+  MappedFile snapshot;
+  if (snapshot.Map(path, "state file", lookup.errors) && snapshot.size() >= kVersion1StateHeaderSize &&
+      std::memcmp(snapshot.data(), kStateMagic, sizeof(kStateMagic)) == 0) {
+    std::vector<std::string> layout_errors;
+    const auto layout = ReadSnapshotLayout(snapshot.data(), snapshot.size(), layout_errors);
+    if (layout.has_value() && layout->has_claims) {
+      LookupIndexedPortClaims(path, snapshot.data(), snapshot.size(), *layout, keys, lookup);
+      ::close(lock_fd);
+      return lookup;
     }
   }
+  // State written before the claim index existed is scanned in full; its next write adds the index.
+  if (lookup.ok() && snapshot.size() != 0) {
+    StateLoadResult current;
+    StateFiles files;
+    ReadLockedState(path, SessionQuery{}, current, files);
+    lookup.claims = PortClaimsOf(current.state, keys);
+    lookup.errors = std::move(current.errors);
+  }
+  ::close(lock_fd);
+  return lookup;
+}
+
+bool SaveState(const std::filesystem::path& path, const RuntimeState& state, std::string& error) {
+  if (!CreateStateDirectory(path, error)) {
+    return false;
+  }
 
   const int lock_fd = OpenAndLockStateFile(path, LOCK_EX, error);
   if (lock_fd < 0) {
     return false;
   }
 
-  const auto tmp_path = BuildTemporaryStatePath(path);
-  std::ofstream out(tmp_path, std::ios::trunc);
-  if (!out.is_open()) {
-    error = "failed to open temporary state file for writing";
-    ::close(lock_fd);
+  // The current state is read only to journal the difference; state that cannot be read is simply replaced.
+  StateLoadResult current;
+  StateFiles files;
+  ReadLockedState(path, SessionQuery{}, current, files);
+  const bool written = WriteLockedState(path, current.ok() ? &current.state : nullptr, files, state, error);
+  ::close(lock_fd);
+  return written;
+}
+
+bool UpdateState(const std::filesystem::path& path, const std::function<void(RuntimeState&)>& mutate,
+                 std::string& error) {
+  if (!CreateStateDirectory(path, error)) {
     return false;
   }
-  out << SerializeState(state);
-  out.flush();
-  if (!out.good()) {
-    error = "failed to flush temporary state file";
-    out.close();
-    std::error_code remove_ec;
-    std::filesystem::remove(tmp_path, remove_ec);
-    ::close(lock_fd);
+
+  const int lock_fd = OpenAndLockStateFile(path, LOCK_EX, error);
+  if (lock_fd < 0) {
     return false;
   }
-  out.close();
 
-  std::error_code rename_ec;
-  std::filesystem::rename(tmp_path, path, rename_ec);
-  if (rename_ec) {
-    error = "failed to replace state file atomically: " + rename_ec.message();
-    std::error_code remove_ec;
-    std::filesystem::remove(tmp_path, remove_ec);
+  StateLoadResult current;
+  StateFiles files;
+  ReadLockedState(path, SessionQuery{}, current, files);
+  if (!current.ok()) {
+    error = "failed to read runtime state: " + current.errors.front();
     ::close(lock_fd);
     return false;
   }
 
+  const auto previous = current.state;
+  mutate(current.state);
+  const bool written = WriteLockedState(path, &previous, files, current.state, error);
   ::close(lock_fd);
-  error.clear();
-  return true;
+  return written;
 }
 
 }  // namespace kubeforward::runtime
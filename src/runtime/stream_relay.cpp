@@ -0,0 +1,193 @@
+#include "kubeforward/runtime/stream_relay.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+#if defined(__linux__)
+//! Requested pipe size; the kernel may clamp it (fs.pipe-max-size), so the real capacity is read back.
+constexpr int kSplicePipeSize = 256 * 1024;
+constexpr unsigned int kSpliceFlags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+#endif
+
+bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+}  // namespace
+
+std::unique_ptr<char[]> RelayBufferPool::Acquire() {
+  if (idle_.empty()) {
+    return std::make_unique<char[]>(kBufferSize);
+  }
+  auto buffer = std::move(idle_.back());
+  idle_.pop_back();
+  return buffer;
+}
+
+void RelayBufferPool::Release(std::unique_ptr<char[]> buffer) {
+  if (buffer && idle_.size() < max_idle_buffers_) {
+    idle_.push_back(std::move(buffer));
+  }
+}
+
+StreamRelay::StreamRelay(RelayBufferPool& pool, StreamRelayMode mode) : pool_(pool) {
+#if defined(__linux__)
+  if (mode == StreamRelayMode::kAuto && ::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) == 0) {
+    (void)::fcntl(pipe_[1], F_SETPIPE_SZ, kSplicePipeSize);
+    const int capacity = ::fcntl(pipe_[1], F_GETPIPE_SZ);
+    pipe_capacity_ = capacity > 0 ? static_cast<size_t>(capacity) : 64 * 1024;
+  } else {
+    pipe_[0] = -1;
+    pipe_[1] = -1;
+  }
+#else
+  (void)mode;
+#endif
+}
+
+StreamRelay::~StreamRelay() {
+  ClosePipe();
+  pool_.Release(std::move(buffer_));
+}
+
+bool StreamRelay::SupportsSplice() {
+#if defined(__linux__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void StreamRelay::ClosePipe() {
+  for (auto& fd : pipe_) {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  in_pipe_ = 0;
+}
+
+bool StreamRelay::wants_read() const {
+  if (eof_ || shut_) {
+    return false;
+  }
+  return spliced() ? in_pipe_ < pipe_capacity_ : end_ < RelayBufferPool::kBufferSize;
+}
+
+bool StreamRelay::pending() const { return spliced() ? in_pipe_ > 0 : begin_ < end_; }
+
+StreamRelay::Result StreamRelay::Pump(int from, int to) {
+  if (shut_) {
+    return Result::kOk;
+  }
+  const Result result = spliced() ? PumpSplice(from, to) : PumpCopy(from, to);
+  if (result == Result::kOk && eof_ && !pending()) {
+    (void)::shutdown(to, SHUT_WR);
+    shut_ = true;
+    ClosePipe();
+    pool_.Release(std::move(buffer_));
+  }
+  return result;
+}
+
+StreamRelay::Result StreamRelay::PumpSplice(int from, int to) {
+#if defined(__linux__)
+  bool progressed = true;
+  while (progressed) {
+    progressed = false;
+    if (!eof_ && in_pipe_ < pipe_capacity_) {
+      const ssize_t count = ::splice(from, nullptr, pipe_[1], nullptr, pipe_capacity_ - in_pipe_, kSpliceFlags);
+      if (count > 0) {
+        in_pipe_ += static_cast<size_t>(count);
+        progressed = true;
+      } else if (count == 0) {
+        eof_ = true;
+      } else if (errno == EINTR) {
+        progressed = true;
+      } else if ((errno == EINVAL || errno == ENOSYS) && in_pipe_ == 0) {
+        // The descriptors cannot be spliced (e.g. a socket type without splice support): copy instead.
+        ClosePipe();
+        return PumpCopy(from, to);
+      } else if (!WouldBlock()) {
+        return Result::kFailed;
+      }
+    }
+
+    if (in_pipe_ > 0) {
+      const ssize_t count = ::splice(pipe_[0], nullptr, to, nullptr, in_pipe_, kSpliceFlags);
+      if (count > 0) {
+        in_pipe_ -= static_cast<size_t>(count);
+        bytes_moved_ += static_cast<uint64_t>(count);
+        progressed = true;
+      } else if (count < 0 && errno == EINTR) {
+        progressed = true;
+      } else if (count == 0 || !WouldBlock()) {
+        return Result::kFailed;
+      }
+    }
+  }
+  return Result::kOk;
+#else
+  return PumpCopy(from, to);
+#endif
+}
+
+StreamRelay::Result StreamRelay::PumpCopy(int from, int to) {
+  bool progressed = true;
+  while (progressed) {
+    progressed = false;
+    if (!eof_ && end_ < RelayBufferPool::kBufferSize) {
+      if (!buffer_) {
+        buffer_ = pool_.Acquire();
+      }
+      const ssize_t count = ::read(from, buffer_.get() + end_, RelayBufferPool::kBufferSize - end_);
+      if (count > 0) {
+        end_ += static_cast<size_t>(count);
+        progressed = true;
+      } else if (count == 0) {
+        eof_ = true;
+      } else if (errno == EINTR) {
+        progressed = true;
+      } else if (!WouldBlock()) {
+        return Result::kFailed;
+      }
+    }
+
+    if (begin_ < end_) {
+      const ssize_t count = ::send(to, buffer_.get() + begin_, end_ - begin_, kSendFlags);
+      if (count > 0) {
+        begin_ += static_cast<size_t>(count);
+        bytes_moved_ += static_cast<uint64_t>(count);
+        progressed = true;
+      } else if (count < 0 && errno == EINTR) {
+        progressed = true;
+      } else if (count < 0 && !WouldBlock()) {
+        return Result::kFailed;
+      }
+    }
+
+    if (begin_ == end_) {
+      begin_ = 0;
+      end_ = 0;
+    }
+  }
+
+  // Hand the buffer back while nothing is queued so idle connections do not pin relay memory.
+  if (begin_ == end_ && buffer_) {
+    pool_.Release(std::move(buffer_));
+  }
+  return Result::kOk;
+}
+
+}  // namespace kubeforward::runtime
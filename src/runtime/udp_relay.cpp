@@ -0,0 +1,507 @@
+#include "kubeforward/runtime/udp_relay.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace kubeforward::runtime {
+namespace {
+
+//! Datagrams moved per recvmmsg/sendmmsg call.
+constexpr size_t kBatchSize = 32;
+//! Largest payload a 2-byte frame length can describe.
+constexpr size_t kMaxDatagramSize = 65535;
+//! Framed bytes a flow may queue towards a stalled tunnel before further datagrams are dropped.
+constexpr size_t kMaxQueuedBytes = 1024 * 1024;
+constexpr auto kExpirySweepInterval = std::chrono::milliseconds(1000);
+
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+bool SetNonBlocking(int fd) {
+  const int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+std::optional<sockaddr_in> MakeIpv4Address(const std::string& address, int port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (port < 0 || port > 65535 || ::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    return std::nullopt;
+  }
+  return addr;
+}
+
+void CloseFd(int& fd) {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+//! One client address on one route and its tunnel connection.
+struct UdpFlow {
+  size_t socket = 0;
+  sockaddr_in client{};
+  int tunnel_fd = -1;
+  bool connecting = false;
+  //! Framed datagrams not yet accepted by the tunnel.
+  std::string outbound;
+  size_t outbound_offset = 0;
+  //! Tunnel bytes not yet forming a complete frame.
+  std::string inbound;
+  std::chrono::steady_clock::time_point last_active;
+
+  ~UdpFlow() { CloseFd(tunnel_fd); }
+};
+
+//! A datagram waiting for the next sendmmsg on its route's socket.
+struct OutgoingDatagram {
+  sockaddr_in client{};
+  std::string payload;
+};
+
+std::string FlowKey(size_t socket, const sockaddr_in& client) {
+  std::string key(sizeof(socket) + sizeof(client.sin_addr) + sizeof(client.sin_port), '\0');
+  std::memcpy(key.data(), &socket, sizeof(socket));
+  std::memcpy(key.data() + sizeof(socket), &client.sin_addr, sizeof(client.sin_addr));
+  std::memcpy(key.data() + sizeof(socket) + sizeof(client.sin_addr), &client.sin_port, sizeof(client.sin_port));
+  return key;
+}
+
+//! Receives up to kBatchSize datagrams; returns how many arrived and fills their sizes and senders.
+size_t ReceiveBatch(int fd, std::vector<std::unique_ptr<char[]>>& buffers, size_t* sizes, sockaddr_in* senders) {
+#if defined(__linux__)
+  mmsghdr messages[kBatchSize];
+  iovec vectors[kBatchSize];
+  for (size_t i = 0; i < kBatchSize; ++i) {
+    vectors[i] = iovec{.iov_base = buffers[i].get(), .iov_len = kMaxDatagramSize};
+    messages[i] = mmsghdr{};
+    messages[i].msg_hdr.msg_name = &senders[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  const int count = ::recvmmsg(fd, messages, kBatchSize, MSG_DONTWAIT, nullptr);
+  if (count <= 0) {
+    return 0;
+  }
+  for (int i = 0; i < count; ++i) {
+    sizes[i] = messages[i].msg_len;
+  }
+  return static_cast<size_t>(count);
+#else
+  size_t count = 0;
+  for (; count < kBatchSize; ++count) {
+    socklen_t length = sizeof(senders[count]);
+    const ssize_t size = ::recvfrom(fd, buffers[count].get(), kMaxDatagramSize, 0,
+                                    reinterpret_cast<sockaddr*>(&senders[count]), &length);
+    if (size < 0) {
+      break;
+    }
+    sizes[count] = static_cast<size_t>(size);
+  }
+  return count;
+#endif
+}
+
+//! Sends queued datagrams in batches; whatever the socket refuses (a full send buffer) is dropped, as UDP would.
+void SendBatch(int fd, std::vector<OutgoingDatagram>& datagrams) {
+  size_t sent = 0;
+  while (sent < datagrams.size()) {
+#if defined(__linux__)
+    mmsghdr messages[kBatchSize];
+    iovec vectors[kBatchSize];
+    const size_t batch = std::min(kBatchSize, datagrams.size() - sent);
+    for (size_t i = 0; i < batch; ++i) {
+      auto& datagram = datagrams[sent + i];
+      vectors[i] = iovec{.iov_base = datagram.payload.data(), .iov_len = datagram.payload.size()};
+      messages[i] = mmsghdr{};
+      messages[i].msg_hdr.msg_name = &datagram.client;
+      messages[i].msg_hdr.msg_namelen = sizeof(datagram.client);
+      messages[i].msg_hdr.msg_iov = &vectors[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    const int count = ::sendmmsg(fd, messages, static_cast<unsigned int>(batch), MSG_DONTWAIT);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    sent += static_cast<size_t>(count);
+#else
+    const auto& datagram = datagrams[sent];
+    (void)::sendto(fd, datagram.payload.data(), datagram.payload.size(), 0,
+                   reinterpret_cast<const sockaddr*>(&datagram.client), sizeof(datagram.client));
+    ++sent;
+#endif
+  }
+  datagrams.clear();
+}
+
+//! Starts a non-blocking connect to the tunnel; false when it failed outright.
+bool ConnectTunnel(UdpFlow& flow, int upstream_port) {
+  const auto addr = MakeIpv4Address("127.0.0.1", upstream_port);
+  flow.tunnel_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (!addr.has_value() || flow.tunnel_fd < 0 || !SetNonBlocking(flow.tunnel_fd)) {
+    CloseFd(flow.tunnel_fd);
+    return false;
+  }
+#if defined(SO_NOSIGPIPE)
+  const int enabled = 1;
+  (void)::setsockopt(flow.tunnel_fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+  if (::connect(flow.tunnel_fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) == 0) {
+    return true;
+  }
+  if (errno == EINPROGRESS || errno == EINTR) {
+    flow.connecting = true;
+    return true;
+  }
+  CloseFd(flow.tunnel_fd);
+  return false;
+}
+
+//! Advances one flow: completes its connect, writes queued frames and collects complete frames coming back.
+//! Returns false once the tunnel failed or was closed by the remote side.
+bool PumpFlow(UdpFlow& flow, std::vector<std::string>& replies) {
+  if (flow.connecting) {
+    int socket_error = 0;
+    socklen_t length = sizeof(socket_error);
+    if (::getsockopt(flow.tunnel_fd, SOL_SOCKET, SO_ERROR, &socket_error, &length) != 0 || socket_error != 0) {
+      return false;
+    }
+    sockaddr_in peer{};
+    socklen_t peer_length = sizeof(peer);
+    if (::getpeername(flow.tunnel_fd, reinterpret_cast<sockaddr*>(&peer), &peer_length) != 0) {
+      // Still in progress.
+      return errno == ENOTCONN;
+    }
+    flow.connecting = false;
+  }
+
+  while (flow.outbound_offset < flow.outbound.size()) {
+    const ssize_t count = ::send(flow.tunnel_fd, flow.outbound.data() + flow.outbound_offset,
+                                 flow.outbound.size() - flow.outbound_offset, kSendFlags);
+    if (count > 0) {
+      flow.outbound_offset += static_cast<size_t>(count);
+    } else if (count < 0 && errno == EINTR) {
+      continue;
+    } else if (count < 0 && WouldBlock()) {
+      break;
+    } else {
+      return false;
+    }
+  }
+  if (flow.outbound_offset == flow.outbound.size()) {
+    flow.outbound.clear();
+    flow.outbound_offset = 0;
+  }
+
+  char buffer[16384];
+  while (true) {
+    const ssize_t count = ::read(flow.tunnel_fd, buffer, sizeof(buffer));
+    if (count > 0) {
+      flow.inbound.append(buffer, static_cast<size_t>(count));
+      ExtractDatagramFrames(flow.inbound, replies);
+    } else if (count < 0 && errno == EINTR) {
+      continue;
+    } else if (count < 0 && WouldBlock()) {
+      return true;
+    } else {
+      return false;
+    }
+  }
+}
+
+}  // namespace
+
+bool AppendDatagramFrame(std::string& stream, const char* data, size_t size) {
+  if (size > kMaxDatagramSize) {
+    return false;
+  }
+  stream.push_back(static_cast<char>((size >> 8) & 0xff));
+  stream.push_back(static_cast<char>(size & 0xff));
+  stream.append(data, size);
+  return true;
+}
+
+void ExtractDatagramFrames(std::string& stream, std::vector<std::string>& datagrams) {
+  size_t offset = 0;
+  while (stream.size() - offset >= 2) {
+    const size_t length = (static_cast<size_t>(static_cast<unsigned char>(stream[offset])) << 8) |
+                          static_cast<unsigned char>(stream[offset + 1]);
+    if (stream.size() - offset - 2 < length) {
+      break;
+    }
+    datagrams.emplace_back(stream, offset + 2, length);
+    offset += 2 + length;
+  }
+  stream.erase(0, offset);
+}
+
+UdpForwardRelay::UdpForwardRelay(std::chrono::milliseconds flow_idle_timeout, EventLoopBackend event_backend)
+    : flow_idle_timeout_(flow_idle_timeout), event_backend_(event_backend) {}
+
+UdpForwardRelay::~UdpForwardRelay() { Stop(); }
+
+bool UdpForwardRelay::Start(const std::vector<LocalProxyRoute>& routes, std::string& error) {
+  if (running()) {
+    error = "udp relay is already running";
+    return false;
+  }
+  sockets_.clear();
+
+  const auto fail = [&](const std::string& message) {
+    error = message;
+    for (auto& socket : sockets_) {
+      CloseFd(socket->fd);
+    }
+    sockets_.clear();
+    return false;
+  };
+
+  for (const auto& route : routes) {
+    const auto addr = MakeIpv4Address(route.bind_address, route.local_port);
+    if (!addr.has_value()) {
+      return fail("invalid udp listen address " + route.bind_address + ":" + std::to_string(route.local_port));
+    }
+    auto socket = std::make_unique<Socket>();
+    socket->fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    socket->route = route;
+    if (socket->fd < 0) {
+      return fail(std::string("failed to create udp socket: ") + std::strerror(errno));
+    }
+    const int socket_fd = socket->fd;
+    sockets_.push_back(std::move(socket));
+    if (::bind(socket_fd, reinterpret_cast<const sockaddr*>(&*addr), sizeof(*addr)) != 0 ||
+        !SetNonBlocking(socket_fd)) {
+      return fail("failed to bind udp " + route.bind_address + ":" + std::to_string(route.local_port) + ": " +
+                  std::strerror(errno));
+    }
+  }
+
+  if (::pipe(wake_pipe_) != 0 || !SetNonBlocking(wake_pipe_[0]) || !SetNonBlocking(wake_pipe_[1])) {
+    CloseFd(wake_pipe_[0]);
+    CloseFd(wake_pipe_[1]);
+    return fail("failed to create udp relay wake pipe");
+  }
+
+  stopping_ = false;
+  thread_ = std::thread([this]() { Run(); });
+  error.clear();
+  return true;
+}
+
+void UdpForwardRelay::Stop() {
+  if (thread_.joinable()) {
+    stopping_ = true;
+    const char byte = 0;
+    (void)::write(wake_pipe_[1], &byte, 1);
+    thread_.join();
+  }
+  for (auto& socket : sockets_) {
+    CloseFd(socket->fd);
+  }
+  CloseFd(wake_pipe_[0]);
+  CloseFd(wake_pipe_[1]);
+}
+
+std::vector<LocalProxyRouteStats> UdpForwardRelay::Stats() const {
+  std::vector<LocalProxyRouteStats> stats;
+  stats.reserve(sockets_.size());
+  for (const auto& socket : sockets_) {
+    stats.push_back(LocalProxyRouteStats{
+        .route = socket->route,
+        .connections = socket->flows.load(),
+        .bytes_to_upstream = socket->bytes_to_upstream.load(),
+        .bytes_to_client = socket->bytes_to_client.load(),
+    });
+  }
+  return stats;
+}
+
+void UdpForwardRelay::Run() {
+  // Tunnel writes use MSG_NOSIGNAL; this also covers platforms without it.
+  sigset_t sigpipe;
+  sigemptyset(&sigpipe);
+  sigaddset(&sigpipe, SIGPIPE);
+  (void)::pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+  const auto loop = CreateEventLoop(event_backend_);
+  std::string loop_error;
+  std::unordered_map<int, size_t> socket_by_fd;
+  if (!loop->Watch(wake_pipe_[0], kEventReadable, loop_error)) {
+    return;
+  }
+  for (size_t i = 0; i < sockets_.size(); ++i) {
+    if (!loop->Watch(sockets_[i]->fd, kEventReadable, loop_error)) {
+      return;
+    }
+    socket_by_fd[sockets_[i]->fd] = i;
+  }
+
+  std::unordered_map<std::string, std::unique_ptr<UdpFlow>> flows;
+  std::unordered_map<int, UdpFlow*> flow_by_fd;
+  std::vector<std::unique_ptr<char[]>> buffers;
+  for (size_t i = 0; i < kBatchSize; ++i) {
+    buffers.push_back(std::make_unique<char[]>(kMaxDatagramSize));
+  }
+  size_t sizes[kBatchSize];
+  sockaddr_in senders[kBatchSize];
+  std::vector<std::vector<OutgoingDatagram>> outgoing(sockets_.size());
+  std::vector<std::string> replies;
+  //! Keys of flows that received datagrams during this iteration.
+  std::vector<std::string> fresh;
+  std::vector<ReadyEvent> ready;
+  auto next_sweep = std::chrono::steady_clock::now() + kExpirySweepInterval;
+
+  const auto close_flow = [&](UdpFlow& flow) {
+    if (flow.tunnel_fd >= 0) {
+      loop->Forget(flow.tunnel_fd);
+      flow_by_fd.erase(flow.tunnel_fd);
+    }
+    flows.erase(FlowKey(flow.socket, flow.client));
+  };
+  // Pumps a flow, queues its replies for the client and updates what the loop waits for; closes it on failure.
+  const auto advance = [&](UdpFlow& flow) {
+    replies.clear();
+    const bool alive = PumpFlow(flow, replies);
+    auto& socket = *sockets_[flow.socket];
+    for (auto& reply : replies) {
+      socket.bytes_to_client.fetch_add(reply.size());
+      outgoing[flow.socket].push_back(OutgoingDatagram{.client = flow.client, .payload = std::move(reply)});
+    }
+    if (!replies.empty()) {
+      flow.last_active = std::chrono::steady_clock::now();
+    }
+    const unsigned events = flow.connecting ? kEventWritable
+                                            : kEventReadable | (flow.outbound.empty() ? 0u : kEventWritable);
+    if (!alive || !loop->Watch(flow.tunnel_fd, events, loop_error)) {
+      close_flow(flow);
+    }
+  };
+
+  while (!stopping_) {
+    const int timeout_ms =
+        flows.empty() ? -1
+                      : static_cast<int>(std::max<long long>(
+                            std::chrono::duration_cast<std::chrono::milliseconds>(
+                                next_sweep - std::chrono::steady_clock::now())
+                                .count(),
+                            0));
+    if (!loop->Wait(timeout_ms, ready, loop_error)) {
+      break;
+    }
+    if (stopping_) {
+      break;
+    }
+
+    for (const auto& event : ready) {
+      if (event.fd == wake_pipe_[0]) {
+        char drain[64];
+        while (::read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+        }
+        continue;
+      }
+      const auto socket_index = socket_by_fd.find(event.fd);
+      if (socket_index != socket_by_fd.end()) {
+        const size_t index = socket_index->second;
+        auto& socket = *sockets_[index];
+        // Bounded per wakeup so one busy route cannot starve the others.
+        for (int round = 0; round < 8; ++round) {
+          const size_t count = ReceiveBatch(socket.fd, buffers, sizes, senders);
+          const auto now = std::chrono::steady_clock::now();
+          for (size_t i = 0; i < count; ++i) {
+            auto& flow = flows[FlowKey(index, senders[i])];
+            if (!flow) {
+              flow = std::make_unique<UdpFlow>();
+              flow->socket = index;
+              flow->client = senders[i];
+              socket.flows.fetch_add(1);
+              if (!ConnectTunnel(*flow, socket.route.upstream_port)) {
+                // The tunnel is down (kubectl restarting): drop the datagram; the next one retries.
+                flows.erase(FlowKey(index, senders[i]));
+                continue;
+              }
+              flow_by_fd[flow->tunnel_fd] = flow.get();
+            }
+            flow->last_active = now;
+            // Flows with frames already queued are either listed here or waiting for a writable tunnel.
+            if (flow->outbound.empty()) {
+              fresh.push_back(FlowKey(index, senders[i]));
+            }
+            if (flow->outbound.size() - flow->outbound_offset < kMaxQueuedBytes &&
+                AppendDatagramFrame(flow->outbound, buffers[i].get(), sizes[i])) {
+              socket.bytes_to_upstream.fetch_add(sizes[i]);
+            }
+          }
+          if (count < kBatchSize) {
+            break;
+          }
+        }
+        continue;
+      }
+      const auto flow = flow_by_fd.find(event.fd);
+      if (flow != flow_by_fd.end()) {
+        flow->second->last_active = std::chrono::steady_clock::now();
+        advance(*flow->second);
+      }
+    }
+
+    // Push freshly queued datagrams right away instead of waiting for the tunnel's next writable event. Flows are
+    // looked up by key because handling an earlier event of this batch may have closed them.
+    for (const auto& key : fresh) {
+      const auto flow = flows.find(key);
+      if (flow == flows.end()) {
+        continue;
+      }
+      if (flow->second->connecting) {
+        if (!loop->Watch(flow->second->tunnel_fd, kEventWritable, loop_error)) {
+          close_flow(*flow->second);
+        }
+      } else {
+        advance(*flow->second);
+      }
+    }
+    fresh.clear();
+
+    for (size_t i = 0; i < outgoing.size(); ++i) {
+      if (!outgoing[i].empty()) {
+        SendBatch(sockets_[i]->fd, outgoing[i]);
+      }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= next_sweep) {
+      next_sweep = now + kExpirySweepInterval;
+      std::vector<UdpFlow*> idle;
+      for (const auto& [key, flow] : flows) {
+        if (now - flow->last_active >= flow_idle_timeout_) {
+          idle.push_back(flow.get());
+        }
+      }
+      for (auto* flow : idle) {
+        close_flow(*flow);
+      }
+    }
+  }
+}
+
+}  // namespace kubeforward::runtime
@@ -10,10 +10,13 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <signal.h>
 #include <sstream>
 #include <string>
+#include <sys/file.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 #include <thread>
 #include <unistd.h>
 #include <vector>
@@ -193,6 +196,15 @@ class ScopedListeningSocket {
   bool ok() const { return fd_ >= 0; }
   int port() const { return port_; }
 
+  //! Waits up to `timeout_ms` for a connection and returns it, or -1.
+  int Accept(int timeout_ms) const {
+    pollfd ready{.fd = fd_, .events = POLLIN, .revents = 0};
+    if (fd_ < 0 || ::poll(&ready, 1, timeout_ms) != 1) {
+      return -1;
+    }
+    return ::accept(fd_, nullptr, nullptr);
+  }
+
   bool AcceptPending() const {
     if (fd_ < 0) {
       return false;
@@ -227,6 +239,13 @@ void WriteFile(const std::filesystem::path& path, const std::string& contents) {
   output << contents;
 }
 
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream input(path);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
 std::filesystem::path WriteExecutableScript(const std::string& stem, const std::string& body) {
   const auto path = TempPath(stem, ".sh");
   WriteFile(path, body);
@@ -337,6 +356,66 @@ std::string TwoForwardConfigContents(const std::string& env_name, int first_loca
          "            remote: 80\n";
 }
 
+std::string MultiPortForwardConfigContents(const std::string& env_name, int first_local_port, int second_local_port) {
+  return "version: 1\n"
+         "metadata:\n"
+         "  project: cli-test\n"
+         "defaults:\n"
+         "  namespace: default\n"
+         "  bindAddress: 127.0.0.1\n"
+         "environments:\n"
+         "  " +
+         env_name +
+         ":\n"
+         "    forwards:\n"
+         "      - name: api\n"
+         "        resource:\n"
+         "          kind: deployment\n"
+         "          name: api\n"
+         "        ports:\n"
+         "          - local: " +
+         std::to_string(first_local_port) +
+         "\n"
+         "            remote: 80\n"
+         "          - local: " +
+         std::to_string(second_local_port) +
+         "\n"
+         "            remote: 81\n";
+}
+
+std::string SamePodForwardsConfigContents() {
+  return "version: 1\n"
+         "metadata:\n"
+         "  project: cli-test\n"
+         "defaults:\n"
+         "  namespace: default\n"
+         "  bindAddress: 127.0.0.1\n"
+         "environments:\n"
+         "  dev:\n"
+         "    forwards:\n"
+         "      - name: api-http\n"
+         "        resource:\n"
+         "          kind: deployment\n"
+         "          name: api\n"
+         "        ports:\n"
+         "          - local: 18085\n"
+         "            remote: 80\n"
+         "      - name: api-metrics\n"
+         "        resource:\n"
+         "          kind: deployment\n"
+         "          name: api\n"
+         "        ports:\n"
+         "          - local: 18086\n"
+         "            remote: 9090\n"
+         "      - name: worker\n"
+         "        resource:\n"
+         "          kind: deployment\n"
+         "          name: worker\n"
+         "        ports:\n"
+         "          - local: 18087\n"
+         "            remote: 80\n";
+}
+
 std::filesystem::path WriteTwoForwardConfig(const std::string& stem, const std::string& env_name, int first_local_port,
                                             int second_local_port, const std::string& bind_address = "127.0.0.1") {
   return WriteConfigFile(stem, TwoForwardConfigContents(env_name, first_local_port, second_local_port, bind_address));
@@ -550,6 +629,133 @@ TEST_CASE("up uses environment context as default and resource context as overri
   CHECK(ContainsAdjacentArgs(state.state.sessions.at(0).forwards.at(1).argv, "--context", "resource-cluster"));
 }
 
+TEST_CASE("up serves every tcp port of a forward from one kubectl process", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedStateFile state_file;
+  const auto config_path = WriteConfigFile("multi-port-forward", MultiPortForwardConfigContents("dev", 18081, 18082));
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  REQUIRE(state.state.sessions.at(0).forwards.size() == 1);
+  const auto& process = state.state.sessions.at(0).forwards.at(0);
+  CHECK(process.local_port == 18081);
+  REQUIRE(process.additional_ports.size() == 1);
+  CHECK(process.additional_ports.at(0).local_port == 18082);
+  CHECK(process.additional_ports.at(0).remote_port == 81);
+  CHECK(ContainsAdjacentArgs(process.argv, "18081:80", "18082:81"));
+}
+
+TEST_CASE("up launches native engine forwards through kubeforward instead of kubectl", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedStateFile state_file;
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", Fixture("native_engine.yaml"), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  REQUIRE(state.state.sessions.at(0).forwards.size() == 1);
+  const auto& argv = state.state.sessions.at(0).forwards.at(0).argv;
+  REQUIRE(argv.size() > 2);
+  CHECK(argv.at(0) != "kubectl");
+  CHECK(ContainsAdjacentArgs(argv, "native-port-forward", "pod/web-0"));
+  CHECK(ContainsAdjacentArgs(argv, "--api-server", "http://127.0.0.1:8001"));
+  CHECK(ContainsAdjacentArgs(argv, "--namespace", "default"));
+}
+
+TEST_CASE("native port-forward rejects malformed port mappings", "[cli]") {
+  for (const auto* spec : {"80x", "http", "8080:", "0:80", "8080:70000"}) {
+    const auto result = RunAndCapture({"kubeforward", "native-port-forward", "pod/web-0", spec, "--api-server",
+                                       "http://127.0.0.1:8001"});
+    CHECK(result.exit_code == 2);
+    CHECK(result.err.find("invalid port mapping") != std::string::npos);
+  }
+}
+
+TEST_CASE("up launch mode port keeps one kubectl process per port mapping", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedEnvVar launch_mode("KUBEFORWARD_LAUNCH_MODE", "port");
+  ScopedStateFile state_file;
+  const auto config_path =
+      WriteConfigFile("multi-port-forward-per-port", MultiPortForwardConfigContents("dev", 18083, 18084));
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  REQUIRE(state.state.sessions.at(0).forwards.size() == 2);
+  CHECK(state.state.sessions.at(0).forwards.at(0).additional_ports.empty());
+  CHECK(state.state.sessions.at(0).forwards.at(1).local_port == 18084);
+}
+
+TEST_CASE("up shares one kubectl process between forwards targeting the same pod", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedStateFile state_file;
+  const auto config_path = WriteConfigFile("same-pod-forwards", SamePodForwardsConfigContents());
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  const auto& processes = state.state.sessions.at(0).forwards;
+  REQUIRE(processes.size() == 2);
+  CHECK(processes.at(0).forward_name == "api-http+api-metrics");
+  CHECK(ContainsAdjacentArgs(processes.at(0).argv, "18085:80", "18086:9090"));
+  REQUIRE(processes.at(0).additional_ports.size() == 1);
+  CHECK(processes.at(0).additional_ports.at(0).local_port == 18086);
+  CHECK(processes.at(1).forward_name == "worker");
+}
+
+TEST_CASE("up launch mode forward keeps one kubectl process per forward", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedEnvVar launch_mode("KUBEFORWARD_LAUNCH_MODE", "forward");
+  ScopedStateFile state_file;
+  const auto config_path = WriteConfigFile("same-pod-forwards-per-forward", SamePodForwardsConfigContents());
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  REQUIRE(state.state.sessions.at(0).forwards.size() == 3);
+  CHECK(state.state.sessions.at(0).forwards.at(1).forward_name == "api-metrics");
+}
+
+TEST_CASE("up waits for every port of a grouped forward before reporting ready", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-grouped-partial",
+      "#!/bin/sh\n"
+      "local_port=\"${3%%:*}\"\n"
+      "trap 'exit 0' TERM INT\n"
+      "echo \"Forwarding from 127.0.0.1:$local_port -> 80\"\n"
+      "sleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int first_port = FindAvailableLoopbackPort();
+  int second_port = FindAvailableLoopbackPort();
+  while (second_port == first_port) {
+    second_port = FindAvailableLoopbackPort();
+  }
+  const auto config_path =
+      WriteConfigFile("grouped-partial-ready", MultiPortForwardConfigContents("dev", first_port, second_port));
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "500");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("did not open 127.0.0.1:" + std::to_string(second_port)) != std::string::npos);
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
 TEST_CASE("up daemon fails when kubectl exits before opening the local port", "[cli]") {
   ScopedStateFile state_file;
   const auto config_path = WriteSingleForwardConfig("daemon-exits-early", "dev", FindAvailableLoopbackPort());
@@ -788,6 +994,63 @@ TEST_CASE("down keeps sessions when process identity cannot be verified", "[cli]
   }
 }
 
+TEST_CASE("down refuses to signal a pid whose fingerprint no longer matches", "[cli]") {
+  ScopedStateFile state_file;
+  const int managed_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteSingleForwardConfig("down-fingerprint-mismatch", "dev", managed_port);
+  const std::string port_mapping = std::to_string(managed_port) + ":80";
+
+  kubeforward::runtime::PosixProcessRunner runner;
+  kubeforward::runtime::StartProcessRequest request;
+  request.argv = {"/bin/sh", "-c", "trap 'exit 0' TERM INT; sleep 30", "kubectl", "port-forward", port_mapping};
+  request.cwd = std::filesystem::current_path();
+
+  std::string error;
+  const auto started = runner.Start(request, error);
+  REQUIRE(started.has_value());
+  const int managed_pid = started->pid;
+  auto fingerprint = kubeforward::runtime::ReadProcessFingerprint(managed_pid);
+  if (!fingerprint.has_value()) {
+    CHECK(runner.Stop(managed_pid, error));
+    SUCCEED("process fingerprints are not available on this platform");
+    return;
+  }
+  // Simulates the recorded process having exited and its pid being handed to an unrelated process that happens to
+  // carry a matching command line.
+  fingerprint->start_time += 1;
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "fingerprint-mismatch-session";
+  session.config_path = std::filesystem::absolute(config_path).string();
+  session.environment = "dev";
+  session.daemon = true;
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+      .environment = "dev",
+      .forward_name = "api",
+      .argv = {"kubectl", "port-forward", "deployment/api", port_mapping},
+      .bind_address = "127.0.0.1",
+      .local_port = managed_port,
+      .remote_port = 80,
+      .pid = managed_pid,
+      .fingerprint = *fingerprint,
+  });
+  state.sessions.push_back(session);
+  REQUIRE(kubeforward::runtime::SaveState(state_file.path(), state, error));
+
+  const auto result = RunAndCapture({"kubeforward", "down", "--file", config_path.string(), "--env", "dev"});
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("pid reused") != std::string::npos);
+  CHECK(IsPidAlive(managed_pid));
+
+  const auto persisted_state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(persisted_state.ok());
+  REQUIRE(persisted_state.state.sessions.size() == 1);
+  CHECK(persisted_state.state.sessions.at(0).forwards.at(0).fingerprint.start_time == fingerprint->start_time);
+
+  CHECK(runner.Stop(managed_pid, error));
+}
+
 TEST_CASE("down keeps legacy sessions when restart metadata is missing", "[cli]") {
   ScopedStateFile state_file;
   const int managed_port = FindAvailableLoopbackPort();
@@ -888,6 +1151,59 @@ TEST_CASE("up preserves the running session when replacement kubectl is invalid"
   cleanup.Dismiss();
 }
 
+TEST_CASE("up rejects a local port claimed by a session of another config file", "[cli]") {
+  const int local_port = FindAvailableLoopbackPort();
+  const auto kubectl_dir = WriteKubectlOnPath("fake-kubectl-claims", "#!/bin/sh\ntrap 'exit 0' TERM INT\nsleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+  const auto first_config = WriteSingleForwardConfig("claims-first", "dev", local_port);
+  const auto second_config = WriteSingleForwardConfig("claims-second", "dev", local_port);
+
+  ScopedStateFile first_state;
+  ScopedCleanup cleanup([&]() { StopSessionPidsFromState(first_state.path()); });
+  REQUIRE(kubeforward::run_cli({"kubeforward", "up", "--file", first_config.string(), "--env", "dev", "--daemon"}) ==
+          0);
+
+  {
+    ScopedStateFile second_state;
+    const auto result =
+        RunAndCapture({"kubeforward", "up", "--file", second_config.string(), "--env", "dev", "--daemon"});
+    REQUIRE(result.exit_code == 2);
+    CHECK(result.err.find("is already claimed by running session") != std::string::npos);
+    CHECK(kubeforward::runtime::LoadState(second_state.path()).state.sessions.empty());
+  }
+}
+
+TEST_CASE("status reports running forwards without waiting on the state lock", "[cli]") {
+  ScopedStateFile state_file;
+  const int local_port = FindAvailableLoopbackPort();
+  const auto kubectl_dir = WriteKubectlOnPath("fake-kubectl-status", "#!/bin/sh\ntrap 'exit 0' TERM INT\nsleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+  const auto config_path = WriteSingleForwardConfig("status", "dev", local_port);
+  ScopedCleanup cleanup([&]() { StopSessionPidsFromState(state_file.path()); });
+
+  const auto empty = RunAndCapture({"kubeforward", "status", "--file", config_path.string()});
+  REQUIRE(empty.exit_code == 0);
+  CHECK(empty.out.find("status: 0 session(s)") != std::string::npos);
+
+  REQUIRE(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"}) == 0);
+  const int lock_fd = ::open((state_file.path().string() + ".lock").c_str(), O_RDWR);
+  REQUIRE(lock_fd >= 0);
+  REQUIRE(::flock(lock_fd, LOCK_EX) == 0);
+  const auto result = RunAndCapture({"kubeforward", "status", "--file", config_path.string(), "--verbose"});
+  ::close(lock_fd);
+  REQUIRE(result.exit_code == 0);
+  CHECK(result.out.find("status: 1 session(s)") != std::string::npos);
+  CHECK(result.out.find("- dev: 1/1 forward(s) running (daemon)") != std::string::npos);
+  CHECK(result.out.find("127.0.0.1:" + std::to_string(local_port)) != std::string::npos);
+
+  REQUIRE(kubeforward::run_cli({"kubeforward", "down", "--file", config_path.string()}) == 0);
+  cleanup.Dismiss();
+}
+
 TEST_CASE("up replacement fails when old process identity cannot be verified", "[cli]") {
   ScopedStateFile state_file;
   const auto kubectl_dir = WriteKubectlOnPath(
@@ -1010,6 +1326,97 @@ TEST_CASE("up restores the original session when replacement preflight fails aft
   cleanup.Dismiss();
 }
 
+TEST_CASE("up restores proxied forwards with kubectl binding their local ports", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath("fake-kubectl", "#!/bin/sh\ntrap 'exit 0' TERM INT\nsleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int original_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteSingleForwardConfig("replacement-proxied-restore", "dev", original_port);
+  ScopedCleanup cleanup([&]() { StopSessionPidsFromState(state_file.path()); });
+
+  {
+    ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+    ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+    REQUIRE(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"}) ==
+            0);
+  }
+
+  // Recorded as a foreground session would be: kubectl on an upstream port behind the proxy of a gone supervisor.
+  const int upstream_port = FindAvailableLoopbackPort();
+  std::string error;
+  REQUIRE(kubeforward::runtime::UpdateState(
+      state_file.path(),
+      [&](kubeforward::runtime::RuntimeState& state) {
+        auto& forward = state.sessions.at(0).forwards.at(0);
+        forward.upstream_port = upstream_port;
+        forward.argv.at(3) = std::to_string(upstream_port) + ":80";
+      },
+      error));
+
+  ScopedListeningSocket blocker("127.0.0.1", 0);
+  REQUIRE(blocker.ok());
+  WriteFile(config_path, SingleForwardConfigContents("dev", blocker.port()));
+  {
+    ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+    ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+    const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+    REQUIRE(result.exit_code == 2);
+    CHECK(result.err.find("previous session was restored") != std::string::npos);
+  }
+
+  const auto restored_state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(restored_state.ok());
+  REQUIRE(restored_state.state.sessions.size() == 1);
+  const auto& restored = restored_state.state.sessions.at(0).forwards.at(0);
+  CHECK(restored.upstream_port == 0);
+  CHECK(ContainsAdjacentArgs(restored.argv, "deployment/api", std::to_string(original_port) + ":80"));
+  CHECK(ContainsAdjacentArgs(restored.argv, "--address", "127.0.0.1"));
+  CHECK(IsPidAlive(restored.pid));
+
+  StopSessionPidsFromState(state_file.path());
+  cleanup.Dismiss();
+}
+
+TEST_CASE("up refuses to restore udp forwards without their relay", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath("fake-kubectl", "#!/bin/sh\ntrap 'exit 0' TERM INT\nsleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int original_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteSingleForwardConfig("replacement-udp-restore", "dev", original_port);
+  ScopedCleanup cleanup([&]() { StopSessionPidsFromState(state_file.path()); });
+
+  {
+    ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+    ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+    REQUIRE(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"}) ==
+            0);
+  }
+
+  // Recorded as a foreground udp forward would be: kubectl carries the relay's tcp tunnel on an upstream port.
+  const int upstream_port = FindAvailableLoopbackPort();
+  std::string error;
+  REQUIRE(kubeforward::runtime::UpdateState(
+      state_file.path(),
+      [&](kubeforward::runtime::RuntimeState& state) {
+        auto& forward = state.sessions.at(0).forwards.at(0);
+        forward.protocol = kubeforward::config::PortProtocol::kUdp;
+        forward.upstream_port = upstream_port;
+        forward.argv.at(3) = std::to_string(upstream_port) + ":80";
+      },
+      error));
+
+  ScopedListeningSocket blocker("127.0.0.1", 0);
+  REQUIRE(blocker.ok());
+  WriteFile(config_path, SingleForwardConfigContents("dev", blocker.port()));
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("rollback failed") != std::string::npos);
+  CHECK(result.err.find("forward 'api' relays udp") != std::string::npos);
+  cleanup.Dismiss();
+}
+
 TEST_CASE("up stops started forwards when state persistence fails", "[cli]") {
   const auto state_dir = TempPath("state-save-dir", "");
   std::filesystem::create_directories(state_dir);
@@ -1089,17 +1496,757 @@ TEST_CASE("up fails foreground sessions when one forward exits before the others
   CHECK(state.state.sessions.empty());
 }
 
-TEST_CASE("up refuses to replace sessions that cannot be rolled back safely", "[cli]") {
+TEST_CASE("up launches every forward before waiting on readiness", "[cli]") {
   ScopedStateFile state_file;
-  const auto kubectl_script = WriteExecutableScript("fake-kubectl-upgrade", "#!/bin/sh\ntrap 'exit 0' TERM INT\nsleep 30\n");
-  const auto config_path = WriteSingleForwardConfig("upgrade-session", "dev", FindAvailableLoopbackPort());
+  const auto marker_dir = TempPath("startup-markers", "");
+  std::filesystem::create_directories(marker_dir);
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-never-ready",
+      "#!/bin/sh\n"
+      "local_port=\"${3%%:*}\"\n"
+      "touch \"$KUBEFORWARD_MARKER_DIR/$local_port\"\n"
+      "trap 'exit 0' TERM INT\n"
+      "sleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int first_port = FindAvailableLoopbackPort();
+  int second_port = FindAvailableLoopbackPort();
+  while (second_port == first_port) {
+    second_port = FindAvailableLoopbackPort();
+  }
+  const auto config_path = WriteTwoForwardConfig("parallel-startup", "dev", first_port, second_port);
 
-  kubeforward::runtime::PosixProcessRunner runner;
-  kubeforward::runtime::StartProcessRequest request;
-  request.argv = {kubectl_script.string(), "port-forward", "deployment/api", "7000:80"};
-  request.cwd = std::filesystem::current_path();
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar marker_env("KUBEFORWARD_MARKER_DIR", marker_dir.string().c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "500");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
 
-  std::string error;
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("did not open") != std::string::npos);
+  CHECK(std::filesystem::exists(marker_dir / std::to_string(first_port)));
+  CHECK(std::filesystem::exists(marker_dir / std::to_string(second_port)));
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up startup parallelism limits forwards waiting on readiness", "[cli]") {
+  ScopedStateFile state_file;
+  const auto marker_dir = TempPath("startup-markers-limited", "");
+  std::filesystem::create_directories(marker_dir);
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-never-ready-limited",
+      "#!/bin/sh\n"
+      "local_port=\"${3%%:*}\"\n"
+      "touch \"$KUBEFORWARD_MARKER_DIR/$local_port\"\n"
+      "trap 'exit 0' TERM INT\n"
+      "sleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int first_port = FindAvailableLoopbackPort();
+  int second_port = FindAvailableLoopbackPort();
+  while (second_port == first_port) {
+    second_port = FindAvailableLoopbackPort();
+  }
+  const auto config_path = WriteTwoForwardConfig("parallel-startup-limited", "dev", first_port, second_port);
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar marker_env("KUBEFORWARD_MARKER_DIR", marker_dir.string().c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "500");
+  ScopedEnvVar parallelism("KUBEFORWARD_STARTUP_PARALLELISM", "1");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("did not open") != std::string::npos);
+  CHECK(std::filesystem::exists(marker_dir / std::to_string(first_port)));
+  CHECK_FALSE(std::filesystem::exists(marker_dir / std::to_string(second_port)));
+}
+
+TEST_CASE("up treats kubectl forwarding output as foreground readiness", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-forwarding-output",
+      "#!/bin/sh\n"
+      "local_port=\"${3%%:*}\"\n"
+      "echo \"Forwarding from 127.0.0.1:$local_port -> 80\"\n"
+      "sleep 1\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteSingleForwardConfig("foreground-forwarding-output", "dev", FindAvailableLoopbackPort());
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "500");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  CHECK(result.out.find("Forwarding from 127.0.0.1:") != std::string::npos);
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up fails foreground sessions as soon as kubectl loses the pod connection", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-lost-connection",
+      "#!/bin/sh\n"
+      "local_port=\"${3%%:*}\"\n"
+      "trap 'exit 0' TERM INT\n"
+      "echo \"Forwarding from 127.0.0.1:$local_port -> 80\"\n"
+      "sleep 1\n"
+      "echo 'error: lost connection to pod' >&2\n"
+      "sleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteSingleForwardConfig("foreground-lost-connection", "dev", FindAvailableLoopbackPort());
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "500");
+  const auto start = std::chrono::steady_clock::now();
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+  const auto elapsed_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("lost connection to pod") != std::string::npos);
+  CHECK(elapsed_ms < 10000);
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up replaces restartPolicy replace forwards that exit and records the restart", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-replace",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "local_port=\"${3%%:*}\"\n"
+      "runs=$(($(cat \"$dir/runs\" 2>/dev/null || echo 0) + 1))\n"
+      "echo \"$runs\" > \"$dir/runs\"\n"
+      "echo \"Forwarding from 127.0.0.1:$local_port -> 80\"\n"
+      "if [ \"$runs\" -eq 1 ]; then sleep 0.3; exit 1; fi\n"
+      "sleep 0.5\n"
+      "cp \"$KUBEFORWARD_STATE_FILE\" \"$dir/state-during-restart.yaml\"\n"
+      "cp \"$KUBEFORWARD_STATE_FILE.journal\" \"$dir/state-during-restart.yaml.journal\" 2>/dev/null\n"
+      "kill -KILL $$\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteConfigFile(
+      "foreground-replace",
+      SingleForwardConfigContents("dev", FindAvailableLoopbackPort()) + "        annotations:\n"
+                                                                          "          restartPolicy: replace\n");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  ScopedEnvVar backoff("KUBEFORWARD_RESTART_BACKOFF_MS", "50");
+  // The fake counts every invocation as a port-forward run, so keep pod lookups out of it.
+  ScopedEnvVar pod_cache("KUBEFORWARD_POD_CACHE_TTL_MS", "0");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  // The replacement was killed by a signal, which ends the session instead of restarting it again.
+  REQUIRE(result.exit_code == 2);
+  CHECK(result.err.find("exited with exit code 1; restarting in") != std::string::npos);
+  CHECK(result.out.find("restarted forward 'api' (restart 1)") != std::string::npos);
+
+  const auto during_restart = kubeforward::runtime::LoadState(kubectl_dir / "state-during-restart.yaml");
+  REQUIRE(during_restart.ok());
+  REQUIRE(during_restart.state.sessions.size() == 1);
+  REQUIRE(during_restart.state.sessions.at(0).forwards.size() == 1);
+  CHECK(during_restart.state.sessions.at(0).forwards.at(0).restart_count == 1);
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up stops waiting for a restarted forward when it is signalled", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-restart-signal",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "if [ -e \"$dir/started\" ]; then\n"
+      "  echo $$ > \"$dir/restarting\"\n"
+      "  trap 'exit 0' TERM INT\n"
+      "  while true; do sleep 0.1; done\n"
+      "fi\n"
+      "touch \"$dir/started\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "sleep 0.2\n"
+      "exit 1\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteConfigFile(
+      "foreground-restart-signal",
+      SingleForwardConfigContents("dev", FindAvailableLoopbackPort()) + "        annotations:\n"
+                                                                          "          restartPolicy: replace\n");
+  const auto up_log = TempPath("foreground-restart-signal-up", ".log");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  // The replacement never becomes ready, so only the signal can end its wait early.
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "30000");
+  ScopedEnvVar backoff("KUBEFORWARD_RESTART_BACKOFF_MS", "50");
+  ScopedEnvVar pod_cache("KUBEFORWARD_POD_CACHE_TTL_MS", "0");
+  const pid_t supervisor = ::fork();
+  REQUIRE(supervisor >= 0);
+  if (supervisor == 0) {
+    const int log_fd = ::open(up_log.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ::dup2(log_fd, STDOUT_FILENO);
+    ::dup2(log_fd, STDERR_FILENO);
+    ::_exit(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"}));
+  }
+  ScopedCleanup cleanup([&]() {
+    (void)::kill(supervisor, SIGKILL);
+    (void)::waitpid(supervisor, nullptr, 0);
+    StopSessionPidsFromState(state_file.path());
+  });
+
+  for (int waited_ms = 0; waited_ms < 10000 && !std::filesystem::exists(kubectl_dir / "restarting"); waited_ms += 20) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  REQUIRE(std::filesystem::exists(kubectl_dir / "restarting"));
+  (void)::kill(supervisor, SIGTERM);
+  int status = 0;
+  pid_t waited = 0;
+  for (int waited_ms = 0; waited_ms < 5000 && waited == 0; waited_ms += 20) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    waited = ::waitpid(supervisor, &status, WNOHANG);
+  }
+  REQUIRE(waited == supervisor);
+  cleanup.Dismiss();
+
+  INFO(ReadFile(up_log));
+  REQUIRE(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 143);
+  const int replacement = std::stoi(ReadFile(kubectl_dir / "restarting"));
+  CHECK(::kill(replacement, 0) != 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up notices a forward that exits while another one restarts", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-restart-other-exit",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "if [ \"$2\" = deployment/api-b ]; then\n"
+      "  echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "  sleep 0.5\n"
+      "  exit 3\n"
+      "fi\n"
+      "if [ -e \"$dir/started\" ]; then sleep 0.8; fi\n"
+      "touch \"$dir/started\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "sleep 0.2\n"
+      "exit 1\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  std::string contents = TwoForwardConfigContents("dev", FindAvailableLoopbackPort(), FindAvailableLoopbackPort());
+  const std::string first_ports = "            remote: 80\n";
+  contents.insert(contents.find(first_ports) + first_ports.size(), "        annotations:\n"
+                                                                   "          restartPolicy: replace\n");
+  const auto config_path = WriteConfigFile("foreground-restart-other-exit", contents);
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "5000");
+  ScopedEnvVar backoff("KUBEFORWARD_RESTART_BACKOFF_MS", "50");
+  ScopedEnvVar pod_cache("KUBEFORWARD_POD_CACHE_TTL_MS", "0");
+  const auto start = std::chrono::steady_clock::now();
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  // api-b exits while api-a's replacement is still starting; the session ends once that start is over.
+  CHECK(result.exit_code == 2);
+  CHECK(result.out.find("restarted forward 'api-a' (restart 1)") != std::string::npos);
+  CHECK(result.err.find("foreground forward 'api-b' exited with exit code 3 while other foreground forwards were "
+                        "still running") != std::string::npos);
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(4));
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up pins deployment targets to the pod they resolve to", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-pinning",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "if [ \"$1\" = get ]; then\n"
+      "  echo \"$2\" >> \"$dir/lookups\"\n"
+      "  case \"$2\" in\n"
+      "    deployment) printf '{\"app\":\"api\"}' ;;\n"
+      "    pods) printf 'api-7d9f-b Running True \\napi-7d9f-a Running True \\n' ;;\n"
+      "  esac\n"
+      "  exit 0\n"
+      "fi\n"
+      "echo \"$@\" > \"$dir/port-forward-args\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "sleep 0.5\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteSingleForwardConfig("foreground-pinning", "dev", FindAvailableLoopbackPort());
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto args = ReadFile(kubectl_dir / "port-forward-args");
+  CHECK(args.rfind("port-forward pod/api-7d9f-a ", 0) == 0);
+  CHECK(ReadFile(kubectl_dir / "lookups") == "deployment\npods\n");
+}
+
+TEST_CASE("up pins service targets with the target port of the pinned pod", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-service-pinning",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "if [ \"$1\" = get ]; then\n"
+      "  case \"$2\" in\n"
+      "    service) printf '80=http ' ;;\n"
+      "    endpoints) printf 'api-1|http=8080 \\n' ;;\n"
+      "  esac\n"
+      "  exit 0\n"
+      "fi\n"
+      "echo \"$@\" > \"$dir/port-forward-args\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 8080\"\n"
+      "sleep 0.5\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int local_port = FindAvailableLoopbackPort();
+  std::string contents = SingleForwardConfigContents("dev", local_port);
+  contents.replace(contents.find("kind: deployment"), std::string("kind: deployment").size(), "kind: service");
+  const auto config_path = WriteConfigFile("foreground-service-pinning", contents);
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  // kubectl forwards `pod/NAME` by pod port, so service port 80 becomes the pod's targetPort.
+  REQUIRE(result.exit_code == 0);
+  CHECK(ReadFile(kubectl_dir / "port-forward-args").rfind("port-forward pod/api-1 " + std::to_string(local_port) +
+                                                              ":8080 ",
+                                                          0) == 0);
+}
+
+TEST_CASE("up lets kubectl resolve targets whose pod lookup fails", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-pinning-fallback",
+      "#!/bin/sh\n"
+      "if [ \"$1\" = get ]; then echo 'Error from server (Forbidden): pods is forbidden' >&2; exit 1; fi\n"
+      "echo \"$@\" > \"$(dirname \"$0\")/port-forward-args\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "sleep 0.5\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteSingleForwardConfig("foreground-pinning-fallback", "dev", FindAvailableLoopbackPort());
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  CHECK(result.err.find("is not pinned to a pod, kubectl resolves deployment/api") != std::string::npos);
+  CHECK(ReadFile(kubectl_dir / "port-forward-args").rfind("port-forward deployment/api ", 0) == 0);
+}
+
+TEST_CASE("up opens one tunnel per service endpoint for load-balanced forwards", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-load-balance",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "if [ \"$1\" = get ]; then\n"
+      "  echo \"$2\" >> \"$dir/lookups\"\n"
+      "  case \"$2\" in\n"
+      "    service) printf '80= ' ;;\n"
+      "    endpoints) printf 'api-2 api-1 api-3|=8080 \\n' ;;\n"
+      "  esac\n"
+      "  exit 0\n"
+      "fi\n"
+      "echo \"$@\" >> \"$dir/port-forward-args\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "sleep 0.5\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  std::string contents = SingleForwardConfigContents("dev", FindAvailableLoopbackPort());
+  contents.replace(contents.find("kind: deployment"), std::string("kind: deployment").size(), "kind: service");
+  const auto config_path = WriteConfigFile("foreground-load-balance", contents + "        annotations:\n"
+                                                                                 "          loadBalance:\n"
+                                                                                 "            replicas: 2\n");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  // Both tunnels exit on their own: the first is ejected, the last one ends the session.
+  REQUIRE(result.exit_code == 0);
+  CHECK(ReadFile(kubectl_dir / "lookups") == "service\nendpoints\n");
+  const auto args = ReadFile(kubectl_dir / "port-forward-args");
+  // Each tunnel forwards to the service's target port on its pod.
+  CHECK(args.find("port-forward pod/api-1 ") != std::string::npos);
+  CHECK(args.find("port-forward pod/api-2 ") != std::string::npos);
+  CHECK(args.find(":80 ") == std::string::npos);
+  CHECK(args.find(":8080 ") != std::string::npos);
+  CHECK(args.find("api-3") == std::string::npos);
+  CHECK(result.err.find("forward 'api' ejected pod/api-") != std::string::npos);
+  CHECK(result.out.find("relayed 0 connection(s), 0 bytes sent, 0 bytes received, per pod 0/0") != std::string::npos);
+}
+
+TEST_CASE("up moves the tunnel of an ejected pod to another ready endpoint", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-load-balance-relocate",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "if [ \"$1\" = get ]; then\n"
+      "  case \"$2\" in\n"
+      "    service) printf '80= ' ;;\n"
+      "    endpoints) printf 'api-1 api-2 api-3|=8080 \\n' ;;\n"
+      "  esac\n"
+      "  exit 0\n"
+      "fi\n"
+      "echo \"$@\" >> \"$dir/port-forward-args\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 8080\"\n"
+      "if [ \"$2\" = pod/api-1 ]; then sleep 0.2; exit 1; fi\n"
+      "trap 'exit 0' TERM INT\n"
+      "while true; do sleep 0.1; done\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  std::string contents = SingleForwardConfigContents("dev", FindAvailableLoopbackPort());
+  contents.replace(contents.find("kind: deployment"), std::string("kind: deployment").size(), "kind: service");
+  const auto config_path = WriteConfigFile("foreground-load-balance-relocate",
+                                           contents + "        annotations:\n"
+                                                      "          loadBalance:\n"
+                                                      "            replicas: 2\n");
+  const auto up_log = TempPath("foreground-load-balance-relocate-up", ".log");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  ScopedEnvVar backoff("KUBEFORWARD_RESTART_BACKOFF_MS", "50");
+  const pid_t supervisor = ::fork();
+  REQUIRE(supervisor >= 0);
+  if (supervisor == 0) {
+    const int log_fd = ::open(up_log.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ::dup2(log_fd, STDOUT_FILENO);
+    ::dup2(log_fd, STDERR_FILENO);
+    ::_exit(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"}));
+  }
+  ScopedCleanup cleanup([&]() {
+    (void)::kill(supervisor, SIGKILL);
+    (void)::waitpid(supervisor, nullptr, 0);
+    StopSessionPidsFromState(state_file.path());
+  });
+
+  bool relocated = false;
+  for (int waited_ms = 0; waited_ms < 10000 && !relocated; waited_ms += 20) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto state = kubeforward::runtime::LoadState(state_file.path());
+    for (const auto& session : state.state.sessions) {
+      for (const auto& forward : session.forwards) {
+        relocated = relocated || ContainsAdjacentArgs(forward.argv, "port-forward", "pod/api-3");
+      }
+    }
+  }
+  CHECK(relocated);
+  (void)::kill(supervisor, SIGTERM);
+  int status = 0;
+  REQUIRE(::waitpid(supervisor, &status, 0) == supervisor);
+  cleanup.Dismiss();
+
+  CHECK(ReadFile(up_log).find("forward 'api' ejected pod/api-1") != std::string::npos);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up rejects load-balanced forwards in daemon mode", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedStateFile state_file;
+  std::string contents = SingleForwardConfigContents("dev", FindAvailableLoopbackPort());
+  contents.replace(contents.find("kind: deployment"), std::string("kind: deployment").size(), "kind: service");
+  const auto config_path = WriteConfigFile("load-balance-daemon", contents + "        annotations:\n"
+                                                                             "          loadBalance:\n"
+                                                                             "            replicas: 2\n");
+  const auto result =
+      RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+
+  CHECK(result.exit_code == 2);
+  CHECK(result.err.find("loadBalance needs a foreground session") != std::string::npos);
+}
+
+TEST_CASE("up runs exec credential plugins once for every kubectl of the session", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-shared-credentials",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "while [ $# -gt 0 ]; do\n"
+      "  if [ \"$1\" = --kubeconfig ]; then echo \"$2\" >> \"$dir/kubeconfigs\"; cat \"$2\" >> \"$dir/seen\"; fi\n"
+      "  shift\n"
+      "done\n"
+      "trap 'exit 0' TERM INT\n"
+      "sleep 30\n");
+  const auto plugin_path = WriteExecutableFile(
+      kubectl_dir / "cloud-auth",
+      "#!/bin/sh\n"
+      "echo run >> \"$(dirname \"$0\")/plugin-runs\"\n"
+      "printf '{\"apiVersion\":\"client.authentication.k8s.io/v1\",\"kind\":\"ExecCredential\","
+      "\"status\":{\"token\":\"shared-token\"}}'\n");
+  const auto kubeconfig_path = TempPath("shared-credentials-kubeconfig", ".yaml");
+  WriteFile(kubeconfig_path, "current-context: dev\n"
+                             "clusters: [{name: dev, cluster: {server: 'https://dev.example:6443'}}]\n"
+                             "users: [{name: dev, user: {exec: {apiVersion: client.authentication.k8s.io/v1, "
+                             "command: '" + plugin_path.string() + "'}}}]\n"
+                             "contexts: [{name: dev, context: {cluster: dev, user: dev}}]\n");
+  std::string contents = TwoForwardConfigContents("dev", FindAvailableLoopbackPort(), FindAvailableLoopbackPort());
+  contents.insert(contents.find("defaults:\n") + std::string("defaults:\n").size(),
+                  "  kubeconfig: " + kubeconfig_path.string() + "\n");
+  const auto config_path = WriteConfigFile("foreground-shared-credentials", contents);
+
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+  ScopedCleanup stop([&] { (void)RunAndCapture({"kubeforward", "down", "--file", config_path.string()}); });
+
+  REQUIRE(result.exit_code == 0);
+  CHECK(ReadFile(kubectl_dir / "plugin-runs") == "run\n");
+  std::istringstream kubeconfigs(ReadFile(kubectl_dir / "kubeconfigs"));
+  std::string first;
+  std::string second;
+  REQUIRE(std::getline(kubeconfigs, first));
+  REQUIRE(std::getline(kubeconfigs, second));
+  CHECK(first == second);
+  CHECK(first != kubeconfig_path.string());
+  CHECK(first.find("credentials-") != std::string::npos);
+  const auto seen = ReadFile(kubectl_dir / "seen");
+  CHECK(seen.find("token: shared-token") != std::string::npos);
+  CHECK(seen.find("exec") == std::string::npos);
+
+  // The credentials do not outlive the session.
+  REQUIRE(RunAndCapture({"kubeforward", "down", "--file", config_path.string(), "--env", "dev"}).exit_code == 0);
+  stop.Dismiss();
+  CHECK_FALSE(std::filesystem::exists(first));
+}
+
+TEST_CASE("down drains the connections of a foreground session before stopping it", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-drain",
+      "#!/bin/sh\n"
+      "echo \"${3%%:*}\" > \"$(dirname \"$0\")/upstream-port\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "trap 'exit 0' TERM INT\n"
+      "while true; do sleep 0.1; done\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int local_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteSingleForwardConfig("foreground-drain", "dev", local_port);
+  const auto up_log = TempPath("foreground-drain-up", ".log");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar proxy_mode("KUBEFORWARD_LOCAL_PROXY", "all");
+  ScopedEnvVar pod_cache("KUBEFORWARD_POD_CACHE_TTL_MS", "0");
+  ScopedEnvVar drain_timeout("KUBEFORWARD_DRAIN_TIMEOUT_MS", "5000");
+  // The supervising `up` has to be a process of its own for `down` to signal it.
+  const pid_t supervisor = ::fork();
+  REQUIRE(supervisor >= 0);
+  if (supervisor == 0) {
+    const int log_fd = ::open(up_log.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ::dup2(log_fd, STDOUT_FILENO);
+    ::dup2(log_fd, STDERR_FILENO);
+    ::_exit(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"}));
+  }
+  ScopedCleanup cleanup([&]() {
+    (void)::kill(supervisor, SIGKILL);
+    (void)::waitpid(supervisor, nullptr, 0);
+    StopSessionPidsFromState(state_file.path());
+  });
+
+  bool supervised = false;
+  for (int waited_ms = 0; waited_ms < 10000 && !supervised; waited_ms += 20) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto state = kubeforward::runtime::LoadState(state_file.path());
+    supervised = state.ok() && state.state.sessions.size() == 1 &&
+                 state.state.sessions.at(0).supervisor_pid == static_cast<int>(supervisor);
+  }
+  INFO(ReadFile(up_log));
+  REQUIRE(supervised);
+
+  // The test stands in for the pod behind the fake kubectl's upstream port.
+  ScopedListeningSocket upstream("127.0.0.1", std::stoi(ReadFile(kubectl_dir / "upstream-port")));
+  REQUIRE(upstream.ok());
+  const int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(local_port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  REQUIRE(::connect(client, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+  const int served = upstream.Accept(5000);
+  REQUIRE(served >= 0);
+
+  CliResult down;
+  std::thread down_command(
+      [&]() { down = RunAndCapture({"kubeforward", "down", "--file", config_path.string(), "--env", "dev"}); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  // Draining: the local port refuses newcomers while the open connection still reaches the pod.
+  CHECK_FALSE(CanConnectTcpPort(local_port));
+  REQUIRE(::write(served, "migrated", 8) == 8);
+  ::close(served);
+  char buffer[16] = {};
+  CHECK(::read(client, buffer, sizeof(buffer)) == 8);
+  CHECK(std::string(buffer) == "migrated");
+  ::close(client);
+
+  down_command.join();
+  CHECK(down.exit_code == 0);
+  CHECK(down.err.find("down: draining 1 foreground session(s) for up to 5000ms") != std::string::npos);
+  int status = 0;
+  REQUIRE(::waitpid(supervisor, &status, 0) == supervisor);
+  cleanup.Dismiss();
+  CHECK(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 143);
+  const auto up_output = ReadFile(up_log);
+  CHECK(up_output.find("up: draining 1 connection(s) for up to 5000ms") != std::string::npos);
+  CHECK(up_output.find("up: every connection finished") != std::string::npos);
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  CHECK(state.state.sessions.empty());
+}
+
+TEST_CASE("up replaces a foreground session once its supervisor released the local ports", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath("fake-kubectl-replace-supervised",
+                                              "#!/bin/sh\n"
+                                              "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+                                              "trap 'exit 0' TERM INT\n"
+                                              "while true; do sleep 0.1; done\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int local_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteSingleForwardConfig("foreground-replace", "dev", local_port);
+  const auto up_log = TempPath("foreground-replace-up", ".log");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar proxy_mode("KUBEFORWARD_LOCAL_PROXY", "all");
+  ScopedEnvVar pod_cache("KUBEFORWARD_POD_CACHE_TTL_MS", "0");
+  const pid_t supervisor = ::fork();
+  REQUIRE(supervisor >= 0);
+  if (supervisor == 0) {
+    const int log_fd = ::open(up_log.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ::dup2(log_fd, STDOUT_FILENO);
+    ::dup2(log_fd, STDERR_FILENO);
+    ::_exit(kubeforward::run_cli({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"}));
+  }
+  ScopedCleanup cleanup([&]() {
+    (void)::kill(supervisor, SIGKILL);
+    (void)::waitpid(supervisor, nullptr, 0);
+    StopSessionPidsFromState(state_file.path());
+  });
+
+  bool supervised = false;
+  for (int waited_ms = 0; waited_ms < 10000 && !supervised; waited_ms += 20) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto state = kubeforward::runtime::LoadState(state_file.path());
+    supervised = state.ok() && state.state.sessions.size() == 1 &&
+                 state.state.sessions.at(0).supervisor_pid == static_cast<int>(supervisor);
+  }
+  INFO(ReadFile(up_log));
+  REQUIRE(supervised);
+  REQUIRE(CanConnectTcpPort(local_port));
+
+  // No drain is configured; the supervisor is still stopped first, as only its exit frees the proxy's port.
+  ScopedEnvVar skip_readiness("KUBEFORWARD_SKIP_READINESS_CHECK", "1");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+  CHECK(result.exit_code == 0);
+  CHECK(result.err.find("preflight failed") == std::string::npos);
+  int status = 0;
+  REQUIRE(::waitpid(supervisor, &status, 0) == supervisor);
+  CHECK(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 143);
+
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  CHECK(state.state.sessions.at(0).daemon);
+  StopSessionPidsFromState(state_file.path());
+  cleanup.Dismiss();
+}
+
+TEST_CASE("up serves restartPolicy replace forwards through the local proxy", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-proxied",
+      "#!/bin/sh\n"
+      "dir=$(dirname \"$0\")\n"
+      "echo \"$@\" > \"$dir/argv\"\n"
+      "echo \"Forwarding from 127.0.0.1:${3%%:*} -> 80\"\n"
+      "sleep 0.3\n"
+      "cp \"$KUBEFORWARD_STATE_FILE\" \"$dir/state-while-running.yaml\"\n"
+      "cp \"$KUBEFORWARD_STATE_FILE.journal\" \"$dir/state-while-running.yaml.journal\" 2>/dev/null\n"
+      "kill -KILL $$\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const int local_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteConfigFile(
+      "foreground-proxied",
+      SingleForwardConfigContents("dev", local_port) + "        annotations:\n"
+                                                       "          restartPolicy: replace\n");
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+  REQUIRE(result.exit_code == 2);
+
+  const auto running = kubeforward::runtime::LoadState(kubectl_dir / "state-while-running.yaml");
+  REQUIRE(running.ok());
+  REQUIRE(running.state.sessions.size() == 1);
+  const auto& forward = running.state.sessions.at(0).forwards.at(0);
+  CHECK(forward.local_port == local_port);
+  REQUIRE(forward.upstream_port > 0);
+  CHECK(forward.upstream_port != local_port);
+
+  std::ifstream argv_file(kubectl_dir / "argv");
+  std::string argv;
+  std::getline(argv_file, argv);
+  CHECK(argv.find(std::to_string(forward.upstream_port) + ":80") != std::string::npos);
+  CHECK(argv.find("--address 127.0.0.1") != std::string::npos);
+  CHECK(argv.find(std::to_string(local_port) + ":80") == std::string::npos);
+}
+
+TEST_CASE("up detects daemon readiness from the forward log", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_dir = WriteKubectlOnPath(
+      "fake-kubectl-daemon-forwarding-output",
+      "#!/bin/sh\n"
+      "local_port=\"${3%%:*}\"\n"
+      "trap 'exit 0' TERM INT\n"
+      "echo \"Forwarding from 127.0.0.1:$local_port -> 80\"\n"
+      "sleep 30\n");
+  const auto kubectl_path = PrependPath(kubectl_dir);
+  const auto config_path = WriteSingleForwardConfig("daemon-forwarding-output", "dev", FindAvailableLoopbackPort());
+  ScopedCleanup cleanup([&]() { StopSessionPidsFromState(state_file.path()); });
+
+  ScopedEnvVar kubectl_bin("PATH", kubectl_path.c_str());
+  ScopedEnvVar timeout("KUBEFORWARD_STARTUP_TIMEOUT_MS", "2000");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+
+  StopSessionPidsFromState(state_file.path());
+  cleanup.Dismiss();
+}
+
+TEST_CASE("up refuses to replace sessions that cannot be rolled back safely", "[cli]") {
+  ScopedStateFile state_file;
+  const auto kubectl_script = WriteExecutableScript("fake-kubectl-upgrade", "#!/bin/sh\ntrap 'exit 0' TERM INT\nsleep 30\n");
+  const auto config_path = WriteSingleForwardConfig("upgrade-session", "dev", FindAvailableLoopbackPort());
+
+  kubeforward::runtime::PosixProcessRunner runner;
+  kubeforward::runtime::StartProcessRequest request;
+  request.argv = {kubectl_script.string(), "port-forward", "deployment/api", "7000:80"};
+  request.cwd = std::filesystem::current_path();
+
+  std::string error;
   const auto started = runner.Start(request, error);
   REQUIRE(started.has_value());
   REQUIRE(error.empty());
@@ -1238,3 +2385,34 @@ TEST_CASE("plan accepts json config through --file", "[cli]") {
   REQUIRE(result.exit_code == 0);
   CHECK(result.out.find("Environment: dev") != std::string::npos);
 }
+
+TEST_CASE("up tunnels udp ports through the udp relay on a tcp loopback port", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedStateFile state_file;
+  const int local_port = FindAvailableLoopbackPort();
+  const auto config_path = WriteConfigFile(
+      "udp-forward", SingleForwardConfigContents("dev", local_port) + "            protocol: udp\n");
+  const auto result = RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev"});
+
+  REQUIRE(result.exit_code == 0);
+  const auto state = kubeforward::runtime::LoadState(state_file.path());
+  REQUIRE(state.ok());
+  REQUIRE(state.state.sessions.size() == 1);
+  const auto& forward = state.state.sessions.at(0).forwards.at(0);
+  CHECK(forward.protocol == kubeforward::config::PortProtocol::kUdp);
+  CHECK(forward.local_port == local_port);
+  REQUIRE(forward.upstream_port > 0);
+  CHECK(ContainsAdjacentArgs(forward.argv, "deployment/api", std::to_string(forward.upstream_port) + ":80"));
+}
+
+TEST_CASE("up rejects udp ports in daemon mode", "[cli]") {
+  ScopedEnvVar noop_runner("KUBEFORWARD_USE_NOOP_RUNNER", "1");
+  ScopedStateFile state_file;
+  const auto config_path = WriteConfigFile(
+      "udp-forward-daemon", SingleForwardConfigContents("dev", FindAvailableLoopbackPort()) + "            protocol: udp\n");
+  const auto result =
+      RunAndCapture({"kubeforward", "up", "--file", config_path.string(), "--env", "dev", "--daemon"});
+
+  CHECK(result.exit_code == 2);
+  CHECK(result.err.find("udp ports need a foreground session") != std::string::npos);
+}
@@ -139,3 +139,61 @@ TEST_CASE("config accepts resource-level context", "[config]") {
   REQUIRE(dev.forwards.at(1).resource.context.has_value());
   CHECK(dev.forwards.at(1).resource.context.value() == "resource-cluster");
 }
+
+TEST_CASE("config parses warmPool annotations with a default refill rate", "[config]") {
+  const auto result = kubeforward::config::LoadConfigFromFile(Fixture("warm_pool.yaml"));
+  REQUIRE(result.ok());
+  REQUIRE(result.config);
+
+  const auto& dev = result.config->environments.at("dev");
+  REQUIRE(dev.forwards.at(0).warm_pool.has_value());
+  CHECK(dev.forwards.at(0).warm_pool->size == 4);
+  CHECK(dev.forwards.at(0).warm_pool->refill_per_second == 20);
+  REQUIRE(dev.forwards.at(1).warm_pool.has_value());
+  CHECK(dev.forwards.at(1).warm_pool->refill_per_second == 10);
+  CHECK(dev.forwards.at(0).annotations.count("warmPool") == 0);
+}
+
+TEST_CASE("config rejects invalid warmPool annotations", "[config]") {
+  const auto result = kubeforward::config::LoadConfigFromFile(Fixture("invalid_warm_pool.yaml"));
+  REQUIRE_FALSE(result.ok());
+
+  bool saw_size_error = false;
+  bool saw_unknown_key = false;
+  for (const auto& error : result.errors) {
+    saw_size_error = saw_size_error || (error.context == "environments.dev.forwards[0].annotations.warmPool.size" &&
+                                        error.message == "must be between 1 and 64");
+    saw_unknown_key = saw_unknown_key || error.message.find("unknown key 'burst'") != std::string::npos;
+  }
+  CHECK(saw_size_error);
+  CHECK(saw_unknown_key);
+}
+
+TEST_CASE("config parses loadBalance annotations with a default strategy", "[config]") {
+  const auto result = kubeforward::config::LoadConfigFromFile(Fixture("load_balance.yaml"));
+  REQUIRE(result.ok());
+  REQUIRE(result.config);
+
+  const auto& dev = result.config->environments.at("dev");
+  REQUIRE(dev.forwards.at(0).load_balance.has_value());
+  CHECK(dev.forwards.at(0).load_balance->replicas == 3);
+  CHECK(dev.forwards.at(0).load_balance->strategy == kubeforward::config::LoadBalanceStrategy::kLeastConnections);
+  REQUIRE(dev.forwards.at(1).load_balance.has_value());
+  CHECK(dev.forwards.at(1).load_balance->strategy == kubeforward::config::LoadBalanceStrategy::kRoundRobin);
+  CHECK(dev.forwards.at(0).annotations.count("loadBalance") == 0);
+}
+
+TEST_CASE("config rejects loadBalance on non-service targets and unknown strategies", "[config]") {
+  const auto result = kubeforward::config::LoadConfigFromFile(Fixture("invalid_load_balance.yaml"));
+  REQUIRE_FALSE(result.ok());
+
+  bool saw_kind_error = false;
+  bool saw_strategy_error = false;
+  for (const auto& error : result.errors) {
+    saw_kind_error = saw_kind_error || (error.context == "environments.dev.forwards[0].annotations.loadBalance" &&
+                                        error.message == "requires resource.kind service");
+    saw_strategy_error = saw_strategy_error || error.message.find("invalid strategy 'random'") != std::string::npos;
+  }
+  CHECK(saw_kind_error);
+  CHECK(saw_strategy_error);
+}
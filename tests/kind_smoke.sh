@@ -16,7 +16,7 @@ fi
 WORKDIR="${KUBEFORWARD_KIND_SMOKE_WORKDIR:-$(pwd)/out/kind-smoke}"
 CLUSTER_NAME="${KUBEFORWARD_KIND_SMOKE_CLUSTER_NAME:-kubeforward-smoke}"
 CONTEXT_NAME="kind-${CLUSTER_NAME}"
-STATE_FILE="${WORKDIR}/state.yaml"
+STATE_FILE="${WORKDIR}/state"
 CONFIG_FILE="${WORKDIR}/kubeforward.yaml"
 KIND_LOG_DIR="${WORKDIR}/kind-logs"
 LOCAL_PORT="${KUBEFORWARD_KIND_SMOKE_LOCAL_PORT:-18080}"
@@ -84,7 +84,7 @@ done
 
 "${BINARY_PATH}" down --file "${CONFIG_FILE}" --env dev --verbose
 
-if [[ -f "${STATE_FILE}" ]] && grep -q "id:" "${STATE_FILE}"; then
+if [[ -f "${STATE_FILE}" ]] && grep -aq "::dev::" "${STATE_FILE}"; then
   echo "runtime state still contains sessions after down" >&2
   exit 1
 fi
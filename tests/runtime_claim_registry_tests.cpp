@@ -0,0 +1,143 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "kubeforward/runtime/claim_registry.h"
+#include "kubeforward/runtime/state_store.h"
+
+namespace {
+
+std::filesystem::path TempRegistryDir(const std::string& name) {
+  const auto dir = std::filesystem::temp_directory_path() / "kubeforward-tests" /
+                   (name + "-" + std::to_string(::getpid()));
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+//! Points the temp directory, and with it the claim registry, at `dir` so tests never share the user's registry.
+class ScopedTempDirectory {
+ public:
+  explicit ScopedTempDirectory(const std::filesystem::path& dir) {
+    if (const char* value = std::getenv("TMPDIR")) {
+      previous_ = value;
+    }
+    ::setenv("TMPDIR", dir.c_str(), 1);
+  }
+  ScopedTempDirectory(const ScopedTempDirectory&) = delete;
+  ScopedTempDirectory& operator=(const ScopedTempDirectory&) = delete;
+  ~ScopedTempDirectory() {
+    if (previous_.has_value()) {
+      ::setenv("TMPDIR", previous_->c_str(), 1);
+    } else {
+      ::unsetenv("TMPDIR");
+    }
+  }
+
+ private:
+  std::optional<std::string> previous_;
+};
+
+kubeforward::runtime::RuntimeState StateClaiming(const std::string& config_path, int local_port) {
+  kubeforward::runtime::ManagedSession session;
+  session.id = config_path + "::dev";
+  session.config_path = config_path;
+  session.environment = "dev";
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+      .forward_name = "db", .local_port = local_port, .pid = static_cast<int>(::getpid())});
+  kubeforward::runtime::RuntimeState state;
+  state.sessions.push_back(session);
+  return state;
+}
+
+}  // namespace
+
+TEST_CASE("claim registry finds sockets claimed through other state files", "[runtime]") {
+  const auto dir = TempRegistryDir("claim-registry");
+  const ScopedTempDirectory temp_directory(dir);
+  const auto first_state = dir / "state-first.yaml";
+  const auto second_state = dir / "state-second.yaml";
+
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(first_state, StateClaiming("/tmp/first/kubeforward.yaml", 5432), error));
+  REQUIRE(kubeforward::runtime::SaveState(second_state, StateClaiming("/tmp/second/kubeforward.yaml", 6379), error));
+  const auto registry_path = kubeforward::runtime::ClaimRegistryPath();
+  CHECK(registry_path.parent_path() == dir / "kubeforward");
+  REQUIRE(std::filesystem::exists(registry_path));
+
+  const std::vector<kubeforward::runtime::PortClaimKey> keys = {{.local_port = 5432}};
+  const auto registered = kubeforward::runtime::LookupClaimRegistry(registry_path, keys);
+  REQUIRE(registered.ok());
+  REQUIRE(registered.state_paths.size() == 1);
+  CHECK(registered.state_paths.at(0).filename() == "state-first.yaml");
+
+  const auto claims = kubeforward::runtime::LookupRegisteredPortClaims(second_state, keys);
+  REQUIRE(claims.ok());
+  REQUIRE(claims.claims.size() == 1);
+  CHECK(claims.claims.at(0).session_id == "/tmp/first/kubeforward.yaml::dev");
+  CHECK(claims.claims.at(0).config_path == "/tmp/first/kubeforward.yaml");
+
+  REQUIRE(kubeforward::runtime::SaveState(first_state, kubeforward::runtime::RuntimeState{}, error));
+  CHECK(kubeforward::runtime::LookupClaimRegistry(registry_path, keys).state_paths.empty());
+  CHECK(kubeforward::runtime::LookupRegisteredPortClaims(second_state, keys).claims.empty());
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("claim registry skips unchanged claims and drops removed state files", "[runtime]") {
+  const auto dir = TempRegistryDir("claim-registry-prune");
+  const ScopedTempDirectory temp_directory(dir);
+  const auto first_state = dir / "state-first.yaml";
+  const auto second_state = dir / "state-second.yaml";
+
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(first_state, StateClaiming("/tmp/first/kubeforward.yaml", 5432), error));
+  const auto registry_path = kubeforward::runtime::ClaimRegistryPath();
+  struct stat before {};
+  REQUIRE(::stat(registry_path.c_str(), &before) == 0);
+  REQUIRE(kubeforward::runtime::UpdateState(
+      first_state, [](kubeforward::runtime::RuntimeState& state) { state.sessions.at(0).forwards.at(0).pid += 1; },
+      error));
+  struct stat after {};
+  REQUIRE(::stat(registry_path.c_str(), &after) == 0);
+  CHECK(after.st_ino == before.st_ino);
+
+  std::filesystem::remove(first_state);
+  REQUIRE(kubeforward::runtime::SaveState(second_state, StateClaiming("/tmp/second/kubeforward.yaml", 6379), error));
+  CHECK(kubeforward::runtime::LookupClaimRegistry(registry_path, {{.local_port = 5432}}).state_paths.empty());
+  const auto second = kubeforward::runtime::LookupClaimRegistry(registry_path, {{.local_port = 6379}});
+  REQUIRE(second.state_paths.size() == 1);
+  CHECK(second.state_paths.at(0).filename() == "state-second.yaml");
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("claim registry finds claims of state files in other directories", "[runtime]") {
+  const auto dir = TempRegistryDir("claim-registry-directories");
+  const ScopedTempDirectory temp_directory(dir);
+  const auto first_state = dir / "first" / "state.yaml";
+  const auto second_state = dir / "second" / "state.yaml";
+  std::filesystem::create_directories(first_state.parent_path());
+  std::filesystem::create_directories(second_state.parent_path());
+
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(first_state, StateClaiming("/tmp/first/kubeforward.yaml", 5432), error));
+  REQUIRE(kubeforward::runtime::SaveState(second_state, StateClaiming("/tmp/second/kubeforward.yaml", 6379), error));
+  CHECK_FALSE(std::filesystem::exists(first_state.parent_path() / ("claims-" + std::to_string(::getuid()) +
+                                                                   ".registry")));
+
+  const std::vector<kubeforward::runtime::PortClaimKey> keys = {{.local_port = 5432}};
+  const auto claims = kubeforward::runtime::LookupRegisteredPortClaims(second_state, keys);
+  REQUIRE(claims.ok());
+  REQUIRE(claims.claims.size() == 1);
+  CHECK(claims.claims.at(0).config_path == "/tmp/first/kubeforward.yaml");
+
+  std::filesystem::remove_all(dir);
+}
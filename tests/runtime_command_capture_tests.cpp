@@ -0,0 +1,34 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <string>
+
+#include "kubeforward/runtime/command_capture.h"
+
+namespace {
+
+constexpr std::chrono::milliseconds kCommandTimeout(5000);
+
+}  // namespace
+
+TEST_CASE("captured commands see the extra environment on top of the inherited one", "[runtime]") {
+  std::string output;
+  std::string error;
+  REQUIRE(kubeforward::runtime::RunCommandCapturingOutput(
+      {"sh", "-c", "printf '%s|%s|%s' \"$KF_CAPTURE_A\" \"$KF_CAPTURE_B\" \"${HOME:+home}\""},
+      {{"KF_CAPTURE_A", "one"}, {"KF_CAPTURE_B", "two words"}}, kCommandTimeout, output, error));
+  CHECK(output == "one|two words|home");
+}
+
+TEST_CASE("captured commands report stderr when they fail", "[runtime]") {
+  std::string output;
+  std::string error;
+  CHECK_FALSE(kubeforward::runtime::RunCommandCapturingOutput({"sh", "-c", "echo partial; echo broken >&2; exit 3"}, {},
+                                                              kCommandTimeout, output, error));
+  CHECK(output == "partial\n");
+  CHECK(error == "broken");
+
+  CHECK_FALSE(kubeforward::runtime::RunCommandCapturingOutput({"sh", "-c", "exit 4"}, {}, kCommandTimeout, output,
+                                                              error));
+  CHECK(error == "sh failed");
+}
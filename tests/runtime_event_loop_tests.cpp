@@ -0,0 +1,152 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "kubeforward/runtime/event_loop.h"
+
+namespace {
+
+using kubeforward::runtime::EventLoopBackend;
+
+constexpr EventLoopBackend kAllBackends[] = {EventLoopBackend::kPoll, EventLoopBackend::kEpoll,
+                                              EventLoopBackend::kIoUring};
+
+struct SocketPair {
+  SocketPair() { REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0); }
+  ~SocketPair() {
+    for (const int fd : fds) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  int fds[2] = {-1, -1};
+};
+
+unsigned EventsFor(const std::vector<kubeforward::runtime::ReadyEvent>& ready, int fd) {
+  unsigned events = 0;
+  for (const auto& event : ready) {
+    if (event.fd == fd) {
+      events |= event.events;
+    }
+  }
+  return events;
+}
+
+}  // namespace
+
+TEST_CASE("event loop backends parse and fall back without failing", "[runtime]") {
+  CHECK(kubeforward::runtime::ParseEventLoopBackend("io_uring") == EventLoopBackend::kIoUring);
+  CHECK(kubeforward::runtime::ParseEventLoopBackend("epoll") == EventLoopBackend::kEpoll);
+  CHECK(kubeforward::runtime::ParseEventLoopBackend("poll") == EventLoopBackend::kPoll);
+  CHECK_FALSE(kubeforward::runtime::ParseEventLoopBackend("kqueue").has_value());
+  for (const auto backend : kAllBackends) {
+    const auto loop = kubeforward::runtime::CreateEventLoop(backend);
+    REQUIRE(loop != nullptr);
+    CHECK(std::string(kubeforward::runtime::EventLoopBackendName(loop->backend())).size() > 0);
+  }
+  CHECK(kubeforward::runtime::CreateEventLoop(EventLoopBackend::kPoll)->backend() == EventLoopBackend::kPoll);
+}
+
+TEST_CASE("event loop reports level-triggered readiness until the data is consumed", "[runtime]") {
+  for (const auto backend : kAllBackends) {
+    const auto loop = kubeforward::runtime::CreateEventLoop(backend);
+    SocketPair pair;
+    std::string error;
+    std::vector<kubeforward::runtime::ReadyEvent> ready;
+
+    REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventReadable, error));
+    REQUIRE(loop->Wait(0, ready, error));
+    CHECK(EventsFor(ready, pair.fds[0]) == 0);
+
+    REQUIRE(::write(pair.fds[1], "x", 1) == 1);
+    for (int round = 0; round < 3; ++round) {
+      REQUIRE(loop->Wait(1000, ready, error));
+      CHECK((EventsFor(ready, pair.fds[0]) & kubeforward::runtime::kEventReadable) != 0);
+    }
+
+    char byte = 0;
+    REQUIRE(::read(pair.fds[0], &byte, 1) == 1);
+    REQUIRE(loop->Wait(0, ready, error));
+    CHECK(EventsFor(ready, pair.fds[0]) == 0);
+  }
+}
+
+TEST_CASE("event loop follows interest changes and stops reporting unwatched descriptors", "[runtime]") {
+  for (const auto backend : kAllBackends) {
+    const auto loop = kubeforward::runtime::CreateEventLoop(backend);
+    SocketPair pair;
+    std::string error;
+    std::vector<kubeforward::runtime::ReadyEvent> ready;
+
+    REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventReadable, error));
+    REQUIRE(loop->Wait(0, ready, error));
+    REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventWritable, error));
+    REQUIRE(loop->Wait(1000, ready, error));
+    CHECK(EventsFor(ready, pair.fds[0]) == kubeforward::runtime::kEventWritable);
+
+    // A hung-up peer must not be reported for a descriptor nobody waits on.
+    REQUIRE(loop->Watch(pair.fds[0], 0, error));
+    ::close(pair.fds[1]);
+    pair.fds[1] = -1;
+    REQUIRE(loop->Wait(50, ready, error));
+    CHECK(EventsFor(ready, pair.fds[0]) == 0);
+
+    REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventReadable, error));
+    REQUIRE(loop->Wait(1000, ready, error));
+    CHECK((EventsFor(ready, pair.fds[0]) & kubeforward::runtime::kEventReadable) != 0);
+  }
+}
+
+TEST_CASE("event loop waits out its timeout and releases forgotten sockets", "[runtime]") {
+  for (const auto backend : kAllBackends) {
+    const auto loop = kubeforward::runtime::CreateEventLoop(backend);
+    std::string error;
+    std::vector<kubeforward::runtime::ReadyEvent> ready;
+    SocketPair pair;
+    REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventReadable, error));
+
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(loop->Wait(100, ready, error));
+    CHECK(ready.empty());
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(90));
+
+    // Once forgotten and closed, the socket is really gone: the peer sees EOF even with io_uring.
+    loop->Forget(pair.fds[0]);
+    ::close(pair.fds[0]);
+    pair.fds[0] = -1;
+    char byte = 0;
+    CHECK(::read(pair.fds[1], &byte, 1) == 0);
+    REQUIRE(loop->Wait(0, ready, error));
+    CHECK(ready.empty());
+  }
+}
+
+TEST_CASE("event loop keeps every watch when more are queued than the ring holds", "[runtime]") {
+  for (const auto backend : kAllBackends) {
+    const auto loop = kubeforward::runtime::CreateEventLoop(backend);
+    std::string error;
+    std::vector<kubeforward::runtime::ReadyEvent> ready;
+    std::vector<SocketPair> pairs(600);
+    for (const auto& pair : pairs) {
+      REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventWritable, error));
+    }
+
+    // Every socket is writable at once, so the completions alone overflow the first rounds of the ring too.
+    for (int round = 0; round < 3; ++round) {
+      REQUIRE(loop->Wait(1000, ready, error));
+    }
+    for (const auto& pair : pairs) {
+      REQUIRE(loop->Watch(pair.fds[0], kubeforward::runtime::kEventReadable, error));
+    }
+    REQUIRE(::write(pairs.back().fds[1], "x", 1) == 1);
+    REQUIRE(loop->Wait(1000, ready, error));
+    CHECK((EventsFor(ready, pairs.back().fds[0]) & kubeforward::runtime::kEventReadable) != 0);
+    CHECK(EventsFor(ready, pairs.front().fds[0]) == 0);
+  }
+}
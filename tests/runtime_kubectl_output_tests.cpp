@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+#include "kubeforward/runtime/kubectl_output.h"
+
+namespace {
+
+using kubeforward::runtime::KubectlOutputEventKind;
+
+std::filesystem::path TempOutputPath(const std::string& name) {
+  const auto base = std::filesystem::temp_directory_path() / "kubeforward-kubectl-output-tests";
+  std::filesystem::create_directories(base);
+  return base / name;
+}
+
+}  // namespace
+
+TEST_CASE("kubectl output parser reports forwarding lines with their local port", "[runtime]") {
+  kubeforward::runtime::KubectlOutputParser parser;
+
+  const auto events = parser.Feed("Forwarding from 127.0.0.1:18080 -> 8080\nForwarding from [::1]:18080 -> 8080\n");
+  REQUIRE(events.size() == 2);
+  CHECK(events[0].kind == KubectlOutputEventKind::kForwarding);
+  CHECK(events[0].local_port == 18080);
+  CHECK(events[0].line == "Forwarding from 127.0.0.1:18080 -> 8080");
+  CHECK(events[1].local_port == 18080);
+}
+
+TEST_CASE("kubectl output parser buffers partial lines across chunks", "[runtime]") {
+  kubeforward::runtime::KubectlOutputParser parser;
+
+  CHECK(parser.Feed("Forwarding from 127.0.0.1:90").empty());
+  const auto events = parser.Feed("90 -> 80\r\nHandling connection for 9090\n");
+  REQUIRE(events.size() == 1);
+  CHECK(events[0].kind == KubectlOutputEventKind::kForwarding);
+  CHECK(events[0].local_port == 9090);
+}
+
+TEST_CASE("kubectl output parser classifies lost connections and errors", "[runtime]") {
+  kubeforward::runtime::KubectlOutputParser parser;
+
+  const auto events = parser.Feed(
+      "E0101 12:00:00.000000   42 portforward.go:413] error copying from remote stream to local connection\n"
+      "error: lost connection to pod\n"
+      "Unable to listen on port 8080: Listeners failed to create with the following errors\n"
+      "Error from server (NotFound): pods \"api\" not found\n");
+  REQUIRE(events.size() == 3);
+  CHECK(events[0].kind == KubectlOutputEventKind::kConnectionLost);
+  CHECK(events[1].kind == KubectlOutputEventKind::kError);
+  CHECK(events[2].kind == KubectlOutputEventKind::kError);
+}
+
+TEST_CASE("forward output monitor attributes pipe output to its pid", "[runtime]") {
+  int fds[2] = {-1, -1};
+  REQUIRE(::pipe(fds) == 0);
+  REQUIRE(::fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+
+  kubeforward::runtime::ForwardOutputMonitor monitor;
+  monitor.TrackPipes(4242, fds[0], -1);
+  CHECK(monitor.Wait(std::chrono::milliseconds(0)).empty());
+
+  const std::string line = "Forwarding from 127.0.0.1:7000 -> 7000\n";
+  REQUIRE(::write(fds[1], line.data(), line.size()) == static_cast<ssize_t>(line.size()));
+  const auto events = monitor.Wait(std::chrono::milliseconds(1000));
+  REQUIRE(events.size() == 1);
+  CHECK(events[0].pid == 4242);
+  CHECK(events[0].event.local_port == 7000);
+
+  ::close(fds[1]);
+  CHECK(monitor.Wait(std::chrono::milliseconds(100)).empty());
+}
+
+TEST_CASE("forward output monitor follows log files from the recorded offset", "[runtime]") {
+  const auto log_path = TempOutputPath("follow.log");
+  {
+    std::ofstream output(log_path, std::ios::trunc);
+    output << "Forwarding from 127.0.0.1:6000 -> 6000\n";
+  }
+
+  kubeforward::runtime::ForwardOutputMonitor monitor;
+  monitor.TrackLogFile(7, log_path, kubeforward::runtime::CurrentFileSize(log_path));
+  CHECK(monitor.Wait(std::chrono::milliseconds(0)).empty());
+
+  {
+    std::ofstream output(log_path, std::ios::app);
+    output << "Forwarding from 127.0.0.1:6001 -> 6001\n";
+  }
+  const auto events = monitor.Wait(std::chrono::milliseconds(0));
+  REQUIRE(events.size() == 1);
+  CHECK(events[0].pid == 7);
+  CHECK(events[0].event.local_port == 6001);
+}
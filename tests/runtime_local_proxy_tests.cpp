@@ -0,0 +1,550 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "kubeforward/runtime/local_proxy.h"
+
+namespace {
+
+int ListenOnLoopback(int port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  const int reuse = 1;
+  (void)::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int ConnectToLoopback(int port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  timeval timeout{.tv_sec = 5, .tv_usec = 0};
+  (void)::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+std::string ReadToEof(int fd) {
+  std::string data;
+  char buffer[4096];
+  ssize_t count = 0;
+  while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    data.append(buffer, static_cast<size_t>(count));
+  }
+  return data;
+}
+
+//! Accepts one connection on `listen_fd`, reads until the client half-closes and echoes everything back upper-cased.
+std::thread ServeOneUppercaseEcho(int listen_fd) {
+  return std::thread([listen_fd]() {
+    const int client = ::accept(listen_fd, nullptr, nullptr);
+    if (client < 0) {
+      return;
+    }
+    std::string data = ReadToEof(client);
+    for (auto& ch : data) {
+      ch = static_cast<char>(ch >= 'a' && ch <= 'z' ? ch - 'a' + 'A' : ch);
+    }
+    (void)::write(client, data.data(), data.size());
+    ::close(client);
+  });
+}
+
+}  // namespace
+
+TEST_CASE("local proxy relays both directions and propagates half-close", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  auto server = ServeOneUppercaseEcho(upstream_fd);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  const std::string payload(200000, 'k');
+  size_t written = 0;
+  while (written < payload.size()) {
+    const ssize_t count = ::write(client, payload.data() + written, payload.size() - written);
+    REQUIRE(count > 0);
+    written += static_cast<size_t>(count);
+  }
+  ::shutdown(client, SHUT_WR);
+
+  CHECK(ReadToEof(client) == std::string(payload.size(), 'K'));
+  ::close(client);
+  server.join();
+  ::close(upstream_fd);
+  proxy.Stop();
+
+  const auto stats = proxy.Stats();
+  REQUIRE(stats.size() == 1);
+  CHECK(stats.at(0).connections == 1);
+  CHECK(stats.at(0).bytes_to_upstream == payload.size());
+  CHECK(stats.at(0).bytes_to_client == payload.size());
+}
+
+TEST_CASE("local proxy holds new connections while the upstream restarts", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+
+  // Nothing listens upstream yet: the local port still accepts and the proxy keeps retrying.
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  REQUIRE(::write(client, "ping", 4) == 4);
+  ::shutdown(client, SHUT_WR);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  auto server = ServeOneUppercaseEcho(upstream_fd);
+
+  CHECK(ReadToEof(client) == "PING");
+  ::close(client);
+  server.join();
+  ::close(upstream_fd);
+}
+
+TEST_CASE("local proxy gives up on upstreams that stay down past the retry window", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+
+  kubeforward::runtime::LocalForwardProxy proxy(std::chrono::milliseconds(200));
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  const auto start = std::chrono::steady_clock::now();
+  CHECK(ReadToEof(client).empty());
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(3));
+  ::close(client);
+}
+
+TEST_CASE("local proxy releases every listener when one route cannot bind", "[runtime]") {
+  std::string error;
+  const int taken_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int free_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(taken_port > 0);
+  REQUIRE(free_port > 0);
+  const int taken_fd = ListenOnLoopback(taken_port);
+  REQUIRE(taken_fd >= 0);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  CHECK_FALSE(proxy.Start({{.local_port = free_port, .upstream_port = 1}, {.local_port = taken_port, .upstream_port = 1}},
+                          error));
+  CHECK(error.find(std::to_string(taken_port)) != std::string::npos);
+  CHECK_FALSE(proxy.running());
+
+  const int rebound = ListenOnLoopback(free_port);
+  CHECK(rebound >= 0);
+  ::close(rebound);
+  ::close(taken_fd);
+}
+
+#if defined(__linux__)
+TEST_CASE("loopback port reservation keeps the port for a listener that reuses the address", "[runtime]") {
+  std::string error;
+  auto reservation = kubeforward::runtime::LoopbackPortReservation::Create(error);
+  REQUIRE(reservation != nullptr);
+  const int port = reservation->port();
+
+  // Anyone else binding the port is refused while the child can listen on it, and again after a restart.
+  const int other = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  CHECK(::bind(other, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0);
+  ::close(other);
+  for (int start = 0; start < 2; ++start) {
+    const int listener = ListenOnLoopback(port);
+    CHECK(listener >= 0);
+    ::close(listener);
+  }
+
+  reservation.reset();
+  const int unreserved = ::socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(::bind(unreserved, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+  ::close(unreserved);
+}
+#endif
+
+TEST_CASE("local proxy relays concurrent connections with every event loop backend", "[runtime]") {
+  for (const auto backend : {kubeforward::runtime::EventLoopBackend::kPoll, kubeforward::runtime::EventLoopBackend::kEpoll,
+                             kubeforward::runtime::EventLoopBackend::kIoUring}) {
+    std::string error;
+    const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+    const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+    REQUIRE(upstream_port > 0);
+    REQUIRE(local_port > 0);
+    const int upstream_fd = ListenOnLoopback(upstream_port);
+    REQUIRE(upstream_fd >= 0);
+
+    kubeforward::runtime::LocalForwardProxy proxy(std::chrono::milliseconds(10000),
+                                                  kubeforward::runtime::StreamRelayMode::kAuto, backend);
+    REQUIRE(proxy.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}},
+                        error));
+
+    constexpr int kClients = 8;
+    std::vector<std::thread> servers;
+    std::vector<std::thread> clients;
+    std::vector<std::string> replies(kClients);
+    for (int i = 0; i < kClients; ++i) {
+      servers.push_back(ServeOneUppercaseEcho(upstream_fd));
+    }
+    for (int i = 0; i < kClients; ++i) {
+      clients.emplace_back([&, i]() {
+        const int client = ConnectToLoopback(local_port);
+        if (client < 0) {
+          return;
+        }
+        const std::string payload(50000 + i, static_cast<char>('a' + i));
+        size_t written = 0;
+        while (written < payload.size()) {
+          const ssize_t count = ::write(client, payload.data() + written, payload.size() - written);
+          if (count <= 0) {
+            break;
+          }
+          written += static_cast<size_t>(count);
+        }
+        ::shutdown(client, SHUT_WR);
+        replies[i] = ReadToEof(client);
+        ::close(client);
+      });
+    }
+    for (auto& client : clients) {
+      client.join();
+    }
+    for (auto& server : servers) {
+      server.join();
+    }
+    ::close(upstream_fd);
+    proxy.Stop();
+
+    for (int i = 0; i < kClients; ++i) {
+      CHECK(replies[i] == std::string(50000 + i, static_cast<char>('A' + i)));
+    }
+    CHECK(proxy.Stats().at(0).connections == kClients);
+  }
+}
+
+namespace {
+
+//! Upstream that counts accepted connections; the first `close_first` are closed at once, later ones get the
+//! upper-casing echo.
+struct CountingUpstream {
+  explicit CountingUpstream(int listen_fd, int close_first = 0) : listen_fd(listen_fd), close_first(close_first) {
+    thread = std::thread([this]() {
+      while (true) {
+        const int client = ::accept(this->listen_fd, nullptr, nullptr);
+        if (client < 0) {
+          return;
+        }
+        const int index = accepted.fetch_add(1);
+        if (index < this->close_first) {
+          ::close(client);
+          continue;
+        }
+        std::thread([client]() {
+          std::string data = ReadToEof(client);
+          for (auto& ch : data) {
+            ch = static_cast<char>(ch >= 'a' && ch <= 'z' ? ch - 'a' + 'A' : ch);
+          }
+          (void)::write(client, data.data(), data.size());
+          ::close(client);
+        }).detach();
+      }
+    });
+  }
+  ~CountingUpstream() {
+    ::shutdown(listen_fd, SHUT_RDWR);
+    thread.join();
+    ::close(listen_fd);
+  }
+
+  bool WaitForAccepted(int count) const {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (accepted.load() < count) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+  }
+
+  int listen_fd;
+  int close_first;
+  std::atomic<int> accepted{0};
+  std::thread thread;
+};
+
+std::string RoundTrip(int local_port, const std::string& payload) {
+  const int client = ConnectToLoopback(local_port);
+  if (client < 0) {
+    return {};
+  }
+  (void)::write(client, payload.data(), payload.size());
+  ::shutdown(client, SHUT_WR);
+  std::string reply = ReadToEof(client);
+  ::close(client);
+  return reply;
+}
+
+}  // namespace
+
+TEST_CASE("local proxy pairs new clients with warm upstream connections and refills the pool", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  CountingUpstream upstream(upstream_fd);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1",
+                        .local_port = local_port,
+                        .upstream_port = upstream_port,
+                        .warm_pool_size = 2,
+                        .warm_pool_refill_per_second = 100}},
+                      error));
+
+  // The pool fills before any client shows up.
+  REQUIRE(upstream.WaitForAccepted(2));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CHECK(upstream.accepted.load() == 2);
+
+  CHECK(RoundTrip(local_port, "warm") == "WARM");
+  CHECK(upstream.WaitForAccepted(3));
+  proxy.Stop();
+  const auto stats = proxy.Stats();
+  CHECK(stats.at(0).connections == 1);
+  CHECK(stats.at(0).warm_hits == 1);
+}
+
+TEST_CASE("local proxy replaces warm upstream connections the remote side closed", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  CountingUpstream upstream(upstream_fd, 3);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1",
+                        .local_port = local_port,
+                        .upstream_port = upstream_port,
+                        .warm_pool_size = 1,
+                        .warm_pool_refill_per_second = 100}},
+                      error));
+
+  // The first three warm connections are closed upstream and must be replaced rather than handed to a client.
+  REQUIRE(upstream.WaitForAccepted(4));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(RoundTrip(local_port, "fresh") == "FRESH");
+  proxy.Stop();
+  CHECK(proxy.Stats().at(0).warm_hits == 1);
+}
+
+TEST_CASE("local proxy spreads connections round-robin over balanced upstreams", "[runtime]") {
+  std::string error;
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(local_port > 0);
+  std::vector<int> upstream_ports;
+  std::vector<std::unique_ptr<CountingUpstream>> upstreams;
+  for (int i = 0; i < 3; ++i) {
+    upstream_ports.push_back(kubeforward::runtime::ReserveLoopbackPort(error));
+    const int listen_fd = ListenOnLoopback(upstream_ports.back());
+    REQUIRE(listen_fd >= 0);
+    upstreams.push_back(std::make_unique<CountingUpstream>(listen_fd));
+  }
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1",
+                        .local_port = local_port,
+                        .upstream_port = upstream_ports.at(0),
+                        .balanced_upstream_ports = {upstream_ports.at(1), upstream_ports.at(2)}}},
+                      error));
+  for (int i = 0; i < 6; ++i) {
+    CHECK(RoundTrip(local_port, "spread") == "SPREAD");
+  }
+  proxy.Stop();
+
+  for (const auto& upstream : upstreams) {
+    CHECK(upstream->accepted.load() == 2);
+  }
+  const auto stats = proxy.Stats();
+  CHECK(stats.at(0).upstream_connections == std::vector<uint64_t>{2, 2, 2});
+  CHECK(stats.at(0).ejections == 0);
+}
+
+TEST_CASE("local proxy sends new connections to the least busy balanced upstream", "[runtime]") {
+  std::string error;
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int first_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int second_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(local_port > 0);
+  const int first_fd = ListenOnLoopback(first_port);
+  const int second_fd = ListenOnLoopback(second_port);
+  REQUIRE(first_fd >= 0);
+  REQUIRE(second_fd >= 0);
+  CountingUpstream first(first_fd);
+  CountingUpstream second(second_fd);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1",
+                        .local_port = local_port,
+                        .upstream_port = first_port,
+                        .balanced_upstream_ports = {second_port},
+                        .balancing = kubeforward::runtime::UpstreamBalancing::kLeastConnections}},
+                      error));
+
+  // Keep one connection open on the first upstream; round-robin would hand it every other new connection.
+  const int held = ConnectToLoopback(local_port);
+  REQUIRE(held >= 0);
+  REQUIRE(::write(held, "held", 4) == 4);
+  REQUIRE(first.WaitForAccepted(1));
+  CHECK(RoundTrip(local_port, "one") == "ONE");
+  CHECK(RoundTrip(local_port, "two") == "TWO");
+  CHECK(first.accepted.load() == 1);
+  CHECK(second.accepted.load() == 2);
+
+  ::shutdown(held, SHUT_WR);
+  CHECK(ReadToEof(held) == "HELD");
+  ::close(held);
+  proxy.Stop();
+}
+
+TEST_CASE("local proxy ejects a refusing balanced upstream and moves the connection on", "[runtime]") {
+  std::string error;
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int down_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int up_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(local_port > 0);
+  const int up_fd = ListenOnLoopback(up_port);
+  REQUIRE(up_fd >= 0);
+  CountingUpstream upstream(up_fd);
+
+  // A short retry window proves the connections are not waiting for the refusing upstream to come back.
+  kubeforward::runtime::LocalForwardProxy proxy(std::chrono::milliseconds(50));
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1",
+                        .local_port = local_port,
+                        .upstream_port = down_port,
+                        .balanced_upstream_ports = {up_port}}},
+                      error));
+  for (int i = 0; i < 4; ++i) {
+    CHECK(RoundTrip(local_port, "moved") == "MOVED");
+  }
+  proxy.Stop();
+
+  const auto stats = proxy.Stats();
+  CHECK(stats.at(0).upstream_connections == std::vector<uint64_t>{0, 4});
+  CHECK(stats.at(0).ejections == 1);
+}
+
+TEST_CASE("local proxy drains relayed connections while refusing new ones", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  auto server = ServeOneUppercaseEcho(upstream_fd);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  REQUIRE(::write(client, "long", 4) == 4);
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (proxy.active_connections() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  REQUIRE(proxy.active_connections() == 1);
+
+  // The drain waits for the relayed connection while the local port stops accepting.
+  auto drained = std::async(std::launch::async, [&proxy]() { return proxy.Drain(std::chrono::seconds(5)); });
+  CHECK(drained.wait_for(std::chrono::milliseconds(200)) == std::future_status::timeout);
+  CHECK(ConnectToLoopback(local_port) < 0);
+
+  ::shutdown(client, SHUT_WR);
+  CHECK(ReadToEof(client) == "LONG");
+  CHECK(drained.get());
+  CHECK(proxy.active_connections() == 0);
+  ::close(client);
+  server.join();
+  ::close(upstream_fd);
+  proxy.Stop();
+}
+
+TEST_CASE("local proxy drain gives up at its deadline and leaves the rest to Stop", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  auto server = ServeOneUppercaseEcho(upstream_fd);
+
+  kubeforward::runtime::LocalForwardProxy proxy;
+  REQUIRE(proxy.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  REQUIRE(::write(client, "stuck", 5) == 5);
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (proxy.active_connections() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  CHECK_FALSE(proxy.Drain(std::chrono::milliseconds(200)));
+  CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(200));
+  CHECK(proxy.active_connections() == 1);
+  proxy.Stop();
+  CHECK(ReadToEof(client).empty());
+  ::close(client);
+  server.join();
+  ::close(upstream_fd);
+}
@@ -0,0 +1,246 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "kubeforward/runtime/local_proxy.h"
+#include "kubeforward/runtime/native_port_forward.h"
+
+namespace {
+
+int ListenOnLoopback(int port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  const int reuse = 1;
+  (void)::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int ConnectToLoopback(int port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  timeval timeout{.tv_sec = 5, .tv_usec = 0};
+  (void)::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+std::string ReadToEof(int fd) {
+  std::string data;
+  char buffer[4096];
+  ssize_t count = 0;
+  while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    data.append(buffer, static_cast<size_t>(count));
+  }
+  return data;
+}
+
+bool ReadExactly(int fd, std::string& out, size_t size) {
+  out.clear();
+  char buffer[4096];
+  while (out.size() < size) {
+    const ssize_t count = ::read(fd, buffer, std::min(sizeof(buffer), size - out.size()));
+    if (count <= 0) {
+      return false;
+    }
+    out.append(buffer, static_cast<size_t>(count));
+  }
+  return true;
+}
+
+void WriteAll(int fd, const std::string& data) { (void)::write(fd, data.data(), data.size()); }
+
+//! Unmasked server frame; `fin` false starts a fragmented message.
+std::string ServerFrame(unsigned char opcode, const std::string& payload, bool fin = true) {
+  std::string frame;
+  frame.push_back(static_cast<char>((fin ? 0x80 : 0x00) | opcode));
+  frame.push_back(static_cast<char>(payload.size()));
+  return frame + payload;
+}
+
+//! Reads one masked client frame (payload < 126 bytes) and returns its unmasked payload.
+bool ReadClientFrame(int fd, std::string& payload) {
+  std::string header;
+  if (!ReadExactly(fd, header, 2) || (header[1] & 0x80) == 0) {
+    return false;
+  }
+  const size_t length = static_cast<unsigned char>(header[1]) & 0x7F;
+  std::string mask;
+  if (length >= 126 || !ReadExactly(fd, mask, 4) || !ReadExactly(fd, payload, length)) {
+    return false;
+  }
+  for (size_t i = 0; i < payload.size(); ++i) {
+    payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+  }
+  return true;
+}
+
+std::string ReadRequestHead(int fd) {
+  std::string head;
+  char ch = 0;
+  while (head.find("\r\n\r\n") == std::string::npos && ::read(fd, &ch, 1) == 1) {
+    head.push_back(ch);
+  }
+  return head;
+}
+
+std::string HeaderValue(const std::string& head, const std::string& name) {
+  const auto start = head.find(name + ": ");
+  if (start == std::string::npos) {
+    return "";
+  }
+  const auto value_start = start + name.size() + 2;
+  return head.substr(value_start, head.find("\r\n", value_start) - value_start);
+}
+
+std::string PortPrefix(int port) {
+  return std::string{static_cast<char>(port & 0xFF), static_cast<char>((port >> 8) & 0xFF)};
+}
+
+}  // namespace
+
+TEST_CASE("native port-forward computes the RFC 6455 accept key", "[runtime]") {
+  CHECK(kubeforward::runtime::WebSocketAcceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST_CASE("native port-forward parses plain-http API server endpoints only", "[runtime]") {
+  kubeforward::runtime::ApiServerEndpoint endpoint;
+  std::string error;
+  REQUIRE(kubeforward::runtime::ParseApiServerEndpoint("http://127.0.0.1:8001/proxy/", endpoint, error));
+  CHECK(endpoint.host == "127.0.0.1");
+  CHECK(endpoint.port == 8001);
+  CHECK(endpoint.path_prefix == "/proxy");
+
+  REQUIRE(kubeforward::runtime::ParseApiServerEndpoint("http://localhost", endpoint, error));
+  CHECK(endpoint.port == 80);
+  CHECK(endpoint.path_prefix.empty());
+
+  CHECK_FALSE(kubeforward::runtime::ParseApiServerEndpoint("https://cluster:6443", endpoint, error));
+  CHECK(error.find("kubectl proxy") != std::string::npos);
+  CHECK_FALSE(kubeforward::runtime::ParseApiServerEndpoint("http://host:99999", endpoint, error));
+}
+
+TEST_CASE("native port-forward tunnels a connection over the v4 channel protocol", "[runtime]") {
+  std::string error;
+  const int api_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(api_port > 0);
+  REQUIRE(local_port > 0);
+  const int api_fd = ListenOnLoopback(api_port);
+  REQUIRE(api_fd >= 0);
+
+  std::string request_head;
+  std::string client_channel_payload;
+  std::thread api_server([&]() {
+    const int connection = ::accept(api_fd, nullptr, nullptr);
+    if (connection < 0) {
+      return;
+    }
+    request_head = ReadRequestHead(connection);
+    WriteAll(connection, "HTTP/1.1 101 Switching Protocols\r\n"
+                         "Upgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: " +
+                             kubeforward::runtime::WebSocketAcceptKey(HeaderValue(request_head, "Sec-WebSocket-Key")) +
+                             "\r\n"
+                             "Sec-WebSocket-Protocol: v4.channel.k8s.io\r\n\r\n");
+    WriteAll(connection, ServerFrame(0x2, std::string{'\0'} + PortPrefix(8080)));
+    WriteAll(connection, ServerFrame(0x2, std::string{'\1'} + PortPrefix(8080)));
+
+    std::string payload;
+    while (client_channel_payload.size() < 5 && ReadClientFrame(connection, payload)) {
+      if (!payload.empty() && payload[0] == '\0') {
+        client_channel_payload += payload.substr(1);
+      }
+    }
+    // Reply as a fragmented message so continuation frames are exercised too.
+    WriteAll(connection, ServerFrame(0x2, std::string{'\0'} + "HEL", /*fin=*/false));
+    WriteAll(connection, ServerFrame(0x0, "LO"));
+    WriteAll(connection, ServerFrame(0x8, ""));
+    ::close(connection);
+  });
+
+  kubeforward::runtime::NativePortForwarder forwarder;
+  REQUIRE(forwarder.Start({.api_server = "http://127.0.0.1:" + std::to_string(api_port) + "/proxy",
+                           .namespace_name = "team-a",
+                           .pod = "web-0",
+                           .ports = {{.local_port = local_port, .remote_port = 8080}}},
+                          error));
+
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  REQUIRE(::write(client, "hello", 5) == 5);
+  CHECK(ReadToEof(client) == "HELLO");
+  ::close(client);
+  api_server.join();
+  ::close(api_fd);
+  forwarder.Stop();
+
+  CHECK(request_head.rfind("GET /proxy/api/v1/namespaces/team-a/pods/web-0/portforward?ports=8080 HTTP/1.1\r\n", 0) ==
+        0);
+  CHECK(HeaderValue(request_head, "Sec-WebSocket-Protocol") == "v4.channel.k8s.io");
+  CHECK(client_channel_payload == "hello");
+  CHECK_FALSE(forwarder.lost());
+}
+
+TEST_CASE("native port-forward reports a lost pod when the upgrade is rejected", "[runtime]") {
+  std::string error;
+  const int api_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(api_port > 0);
+  REQUIRE(local_port > 0);
+  const int api_fd = ListenOnLoopback(api_port);
+  REQUIRE(api_fd >= 0);
+
+  std::thread api_server([&]() {
+    const int connection = ::accept(api_fd, nullptr, nullptr);
+    if (connection < 0) {
+      return;
+    }
+    (void)ReadRequestHead(connection);
+    WriteAll(connection, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    ::close(connection);
+  });
+
+  kubeforward::runtime::NativePortForwarder forwarder;
+  REQUIRE(forwarder.Start({.api_server = "http://127.0.0.1:" + std::to_string(api_port),
+                           .namespace_name = "team-a",
+                           .pod = "gone-0",
+                           .ports = {{.local_port = local_port, .remote_port = 8080}}},
+                          error));
+
+  const int client = ConnectToLoopback(local_port);
+  REQUIRE(client >= 0);
+  CHECK(ReadToEof(client).empty());
+  ::close(client);
+  api_server.join();
+  ::close(api_fd);
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (!forwarder.lost() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  CHECK(forwarder.lost());
+  CHECK(forwarder.lost_reason().find("404") != std::string::npos);
+  forwarder.Stop();
+}
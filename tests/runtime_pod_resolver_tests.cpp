@@ -0,0 +1,232 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "kubeforward/runtime/pod_resolver.h"
+
+namespace {
+
+constexpr std::chrono::milliseconds kLookupTimeout(5000);
+
+kubeforward::runtime::PodLookupKey DeploymentKey(const std::string& name) {
+  return kubeforward::runtime::PodLookupKey{
+      .kind = kubeforward::config::ResourceKind::kDeployment,
+      .name = name,
+      .namespace_name = "default",
+  };
+}
+
+//! Writes an executable stand-in for kubectl that answers `get` with canned output and logs its arguments.
+std::filesystem::path WriteFakeKubectl(const std::filesystem::path& dir) {
+  std::filesystem::create_directories(dir);
+  const auto path = dir / "kubectl";
+  std::ofstream script(path, std::ios::trunc);
+  script << "#!/bin/sh\n"
+         << "echo \"$@\" >> '" << (dir / "calls.log").string() << "'\n"
+         << "case \"$2\" in\n"
+         << "  deployment) printf '{\"app\":\"api\",\"tier\":\"web\"}' ;;\n"
+         << "  pods) printf 'api-b Running True \\napi-a Running False \\n"
+            "api-c Running True 2024-01-01T00:00:00Z\\napi-d Running True \\napi-0 Pending  \\n' ;;\n"
+         << "  service) printf '80=http 9090=metrics 443=tls ' ;;\n"
+         << "  endpoints) printf 'web-2 web-1|http=8080 \\nweb-2|metrics=9100 \\n|tls=8443 \\n' ;;\n"
+         << "  *) echo \"Error from server (NotFound): $2 \\\"$3\\\" not found\" >&2; exit 1 ;;\n"
+         << "esac\n";
+  script.close();
+  std::filesystem::permissions(path, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+  return path;
+}
+
+std::filesystem::path FakeKubectlDir(const std::string& stem) {
+  return std::filesystem::temp_directory_path() / "kubeforward-pod-resolver-tests" /
+         (stem + "-" + std::to_string(::getpid()));
+}
+
+//! Name of the pod a lookup resolved to; empty when it failed.
+std::string PodName(const std::optional<kubeforward::runtime::ResolvedPod>& pod) {
+  return pod.has_value() ? pod->name : "";
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream input(path);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+}  // namespace
+
+TEST_CASE("pod resolution cache reuses pins until they expire or are invalidated", "[runtime]") {
+  int calls = 0;
+  kubeforward::runtime::PodResolutionCache cache(
+      std::chrono::milliseconds(200), [&calls](const kubeforward::runtime::PodLookupKey& key, std::string&) {
+        return std::optional<kubeforward::runtime::ResolvedPod>({.name = key.name + "-pod-" + std::to_string(++calls)});
+      });
+
+  std::string error;
+  CHECK(PodName(cache.Resolve(DeploymentKey("api"), error)) == "api-pod-1");
+  CHECK(PodName(cache.Resolve(DeploymentKey("api"), error)) == "api-pod-1");
+  CHECK(PodName(cache.Resolve(DeploymentKey("web"), error)) == "web-pod-2");
+  CHECK(cache.lookups() == 2);
+
+  auto other_context = DeploymentKey("api");
+  other_context.context = "staging";
+  CHECK(PodName(cache.Resolve(other_context, error)) == "api-pod-3");
+
+  cache.Invalidate(DeploymentKey("api"));
+  CHECK(PodName(cache.Resolve(DeploymentKey("api"), error)) == "api-pod-4");
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  CHECK(PodName(cache.Resolve(DeploymentKey("api"), error)) == "api-pod-5");
+  CHECK(cache.lookups() == 5);
+}
+
+TEST_CASE("pod resolution cache does not remember failed lookups", "[runtime]") {
+  bool available = false;
+  kubeforward::runtime::PodResolutionCache cache(
+      std::chrono::milliseconds(60000),
+      [&available](const kubeforward::runtime::PodLookupKey&,
+                   std::string& error) -> std::optional<kubeforward::runtime::ResolvedPod> {
+        if (!available) {
+          error = "no pods";
+          return std::nullopt;
+        }
+        return kubeforward::runtime::ResolvedPod{.name = "api-0"};
+      });
+
+  std::string error;
+  CHECK_FALSE(cache.Resolve(DeploymentKey("api"), error).has_value());
+  CHECK(error == "no pods");
+  available = true;
+  CHECK(PodName(cache.Resolve(DeploymentKey("api"), error)) == "api-0");
+  CHECK(error.empty());
+  CHECK(cache.lookups() == 2);
+}
+
+TEST_CASE("label selector json parses flat string maps", "[runtime]") {
+  const auto labels =
+      kubeforward::runtime::ParseLabelSelectorJson(R"({"app":"api", "app.kubernetes.io/part-of":"shop"})");
+  REQUIRE(labels.has_value());
+  CHECK(labels->size() == 2);
+  CHECK(labels->at("app") == "api");
+  CHECK(labels->at("app.kubernetes.io/part-of") == "shop");
+
+  CHECK(kubeforward::runtime::ParseLabelSelectorJson("{}").value().empty());
+  CHECK_FALSE(kubeforward::runtime::ParseLabelSelectorJson("").has_value());
+  CHECK_FALSE(kubeforward::runtime::ParseLabelSelectorJson("map[app:api]").has_value());
+  CHECK_FALSE(kubeforward::runtime::ParseLabelSelectorJson(R"({"app":)").has_value());
+}
+
+TEST_CASE("kubectl pod lookup picks the first running and ready pod of a deployment", "[runtime]") {
+  const auto dir = FakeKubectlDir("deployment");
+  std::filesystem::remove_all(dir);
+  const auto kubectl = WriteFakeKubectl(dir);
+
+  auto key = DeploymentKey("api");
+  key.context = "dev";
+  std::string error;
+  const auto pod = kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), key, kLookupTimeout, error);
+  REQUIRE(pod.has_value());
+  CHECK(pod->name == "api-b");
+  CHECK(pod->target_ports.empty());
+  CHECK(error.empty());
+
+  const auto calls = ReadFile(dir / "calls.log");
+  CHECK(calls.find("get deployment api --namespace default --context dev") != std::string::npos);
+  CHECK(calls.find("get pods --selector app=api,tier=web --namespace default --context dev") != std::string::npos);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("kubectl pod lookup selects pods with the workload's match expressions", "[runtime]") {
+  const auto dir = FakeKubectlDir("match-expressions");
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const auto kubectl = dir / "kubectl";
+  std::ofstream(kubectl) << "#!/bin/sh\n"
+                         << "echo \"$@\" >> '" << (dir / "calls.log").string() << "'\n"
+                         << "case \"$2\" in\n"
+                         << "  statefulset) printf '{\"app\":\"db\"}\\ntier In primary replica\\n"
+                            "legacy DoesNotExist \\nzone Exists \\nrole NotIn backup\\n' ;;\n"
+                         << "  deployment) printf '\\ntier In web\\n' ;;\n"
+                         << "  pods) printf 'db-0 Running True \\n' ;;\n"
+                         << "esac\n";
+  std::filesystem::permissions(kubectl, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+
+  auto key = DeploymentKey("db");
+  key.kind = kubeforward::config::ResourceKind::kStatefulSet;
+  std::string error;
+  CHECK(PodName(kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), key, kLookupTimeout, error)) == "db-0");
+  CHECK(PodName(kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), DeploymentKey("api"), kLookupTimeout,
+                                                           error)) == "db-0");
+  const auto calls = ReadFile(dir / "calls.log");
+  CHECK(calls.find("get pods --selector app=db,tier in (primary,replica),!legacy,zone,role notin (backup) ") !=
+        std::string::npos);
+  CHECK(calls.find("get pods --selector tier in (web) ") != std::string::npos);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("kubectl pod lookup lists the ready endpoints of a service", "[runtime]") {
+  const auto dir = FakeKubectlDir("service");
+  std::filesystem::remove_all(dir);
+  const auto kubectl = WriteFakeKubectl(dir);
+
+  auto key = DeploymentKey("web");
+  key.kind = kubeforward::config::ResourceKind::kService;
+  std::string error;
+  CHECK(PodName(kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), key, kLookupTimeout, error)) == "web-1");
+
+  // Endpoint ports are matched to service ports by name; pods only get the ports of the subsets they are ready in.
+  const auto pods = kubeforward::runtime::LookupServicePodsWithKubectl(kubectl.string(), key, kLookupTimeout, error);
+  REQUIRE(pods.has_value());
+  CHECK(*pods == std::vector<kubeforward::runtime::ResolvedPod>{
+                     {.name = "web-1", .target_ports = {{80, 8080}}},
+                     {.name = "web-2", .target_ports = {{80, 8080}, {9090, 9100}}},
+                 });
+  const auto calls = ReadFile(dir / "calls.log");
+  CHECK(calls.find("get service web --namespace default") != std::string::npos);
+  CHECK(calls.find("get endpoints web --namespace default") != std::string::npos);
+
+  key.kind = kubeforward::config::ResourceKind::kPod;
+  CHECK(PodName(kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), key, kLookupTimeout, error)) == "web");
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("kubectl pod lookup reports kubectl errors", "[runtime]") {
+  const auto dir = FakeKubectlDir("missing");
+  std::filesystem::remove_all(dir);
+  const auto kubectl = WriteFakeKubectl(dir);
+
+  auto key = DeploymentKey("db");
+  key.kind = kubeforward::config::ResourceKind::kStatefulSet;
+  std::string error;
+  CHECK_FALSE(kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), key, kLookupTimeout, error).has_value());
+  CHECK(error == "failed to resolve statefulset/db: Error from server (NotFound): statefulset \"db\" not found");
+
+  const auto missing = (dir / "missing-kubectl").string();
+  CHECK_FALSE(kubeforward::runtime::LookupPodWithKubectl(missing, key, kLookupTimeout, error).has_value());
+  CHECK(error.find("failed to execute") != std::string::npos);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("kubectl pod lookup gives up on kubectl that does not answer in time", "[runtime]") {
+  const auto dir = FakeKubectlDir("hanging");
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const auto kubectl = dir / "kubectl";
+  std::ofstream(kubectl) << "#!/bin/sh\nsleep 30\n";
+  std::filesystem::permissions(kubectl, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+
+  std::string error;
+  const auto start = std::chrono::steady_clock::now();
+  CHECK_FALSE(kubeforward::runtime::LookupPodWithKubectl(kubectl.string(), DeploymentKey("api"),
+                                                         std::chrono::milliseconds(200), error)
+                  .has_value());
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+  CHECK(error.find("did not answer within 200ms") != std::string::npos);
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "kubeforward/runtime/port_probe.h"
+
+namespace {
+
+//! Binds a loopback TCP socket on an ephemeral port, optionally listening on it.
+class ScopedTcpSocket {
+ public:
+  ScopedTcpSocket(const std::string& bind_address, bool listen) {
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+      return;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    if (::inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1 ||
+        ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || (listen && ::listen(fd_, 1) != 0)) {
+      Close();
+      return;
+    }
+
+    socklen_t addr_len = sizeof(addr);
+    if (::getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len) != 0) {
+      Close();
+      return;
+    }
+    port_ = ntohs(addr.sin_port);
+  }
+
+  ~ScopedTcpSocket() { Close(); }
+
+  void Close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  bool ok() const { return fd_ >= 0; }
+  int port() const { return port_; }
+
+ private:
+  int fd_ = -1;
+  int port_ = 0;
+};
+
+}  // namespace
+
+TEST_CASE("tcp listener probe detects a listening socket", "[runtime]") {
+  ScopedTcpSocket listener("127.0.0.1", true);
+  REQUIRE(listener.ok());
+
+  const auto probe = kubeforward::runtime::ProbeTcpListener("127.0.0.1", listener.port());
+  if (probe == kubeforward::runtime::TcpListenerProbe::kUnavailable) {
+    SUCCEED("platform has no in-process listener probe");
+    return;
+  }
+  CHECK(probe == kubeforward::runtime::TcpListenerProbe::kListening);
+
+  const int port = listener.port();
+  listener.Close();
+  CHECK(kubeforward::runtime::ProbeTcpListener("127.0.0.1", port) ==
+        kubeforward::runtime::TcpListenerProbe::kNotListening);
+}
+
+TEST_CASE("tcp listener probe ignores bound sockets that are not listening", "[runtime]") {
+  ScopedTcpSocket bound("127.0.0.1", false);
+  REQUIRE(bound.ok());
+
+  const auto probe = kubeforward::runtime::ProbeTcpListener("127.0.0.1", bound.port());
+  CHECK(probe != kubeforward::runtime::TcpListenerProbe::kListening);
+}
+
+TEST_CASE("tcp listener probe matches wildcard listeners but not other addresses", "[runtime]") {
+  ScopedTcpSocket wildcard("0.0.0.0", true);
+  REQUIRE(wildcard.ok());
+  const auto wildcard_probe = kubeforward::runtime::ProbeTcpListener("127.0.0.1", wildcard.port());
+  if (wildcard_probe == kubeforward::runtime::TcpListenerProbe::kUnavailable) {
+    SUCCEED("platform has no in-process listener probe");
+    return;
+  }
+  CHECK(wildcard_probe == kubeforward::runtime::TcpListenerProbe::kListening);
+
+  ScopedTcpSocket loopback("127.0.0.1", true);
+  REQUIRE(loopback.ok());
+  CHECK(kubeforward::runtime::ProbeTcpListener("127.0.0.2", loopback.port()) ==
+        kubeforward::runtime::TcpListenerProbe::kNotListening);
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "kubeforward/runtime/process_identity.h"
+#include "kubeforward/runtime/process_runner.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+
+TEST_CASE("process fingerprint of a live process matches itself", "[runtime]") {
+  const int pid = static_cast<int>(::getpid());
+  const auto fingerprint = kubeforward::runtime::ReadProcessFingerprint(pid);
+  REQUIRE(fingerprint.has_value());
+  CHECK(fingerprint->start_time != 0);
+  CHECK(fingerprint->cmdline_hash != 0);
+  CHECK(kubeforward::runtime::CompareProcessFingerprint(pid, *fingerprint) ==
+        kubeforward::runtime::FingerprintMatch::kMatch);
+}
+
+TEST_CASE("process fingerprint rejects a different start time", "[runtime]") {
+  const int pid = static_cast<int>(::getpid());
+  auto fingerprint = kubeforward::runtime::ReadProcessFingerprint(pid);
+  REQUIRE(fingerprint.has_value());
+  fingerprint->start_time += 1;
+  CHECK(kubeforward::runtime::CompareProcessFingerprint(pid, *fingerprint) ==
+        kubeforward::runtime::FingerprintMatch::kMismatch);
+}
+
+TEST_CASE("process identity reads argv of a child without spawning ps", "[runtime]") {
+  kubeforward::runtime::PosixProcessRunner runner;
+  kubeforward::runtime::StartProcessRequest request;
+  request.argv = {"/bin/sh", "-c", "sleep 30", "kubectl", "port-forward"};
+  request.cwd = std::filesystem::current_path();
+
+  std::string error;
+  const auto started = runner.Start(request, error);
+  REQUIRE(started.has_value());
+
+  const auto argv = kubeforward::runtime::ReadProcessArgv(started->pid);
+  REQUIRE(argv.has_value());
+  CHECK(*argv == request.argv);
+
+  const auto fingerprint = kubeforward::runtime::ReadProcessFingerprint(started->pid);
+  REQUIRE(fingerprint.has_value());
+  CHECK(kubeforward::runtime::CompareProcessFingerprint(started->pid, *fingerprint) ==
+        kubeforward::runtime::FingerprintMatch::kMatch);
+
+  REQUIRE(runner.Stop(started->pid, error));
+  CHECK(kubeforward::runtime::CompareProcessFingerprint(started->pid, *fingerprint) ==
+        kubeforward::runtime::FingerprintMatch::kUnavailable);
+}
+
+TEST_CASE("process identity tells exited but unreaped children apart", "[runtime]") {
+  const pid_t child = ::fork();
+  REQUIRE(child >= 0);
+  if (child == 0) {
+    ::_exit(0);
+  }
+  CHECK_FALSE(kubeforward::runtime::IsZombieProcess(static_cast<int>(::getpid())));
+  bool zombie = false;
+  for (int attempt = 0; attempt < 200 && !zombie; ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    zombie = kubeforward::runtime::IsZombieProcess(static_cast<int>(child));
+  }
+  CHECK(zombie);
+  REQUIRE(::waitpid(child, nullptr, 0) == child);
+  CHECK_FALSE(kubeforward::runtime::IsZombieProcess(static_cast<int>(child)));
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <cerrno>
 #include <chrono>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <signal.h>
@@ -9,6 +10,7 @@
 #include <sys/wait.h>
 #include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include "kubeforward/runtime/process_runner.h"
 
@@ -113,6 +115,40 @@ TEST_CASE("posix process runner treats missing pid as already stopped", "[runtim
   REQUIRE(error.empty());
 }
 
+TEST_CASE("posix process runner stops a batch of stuck process groups within one grace period", "[runtime]") {
+  kubeforward::runtime::PosixProcessRunner runner;
+  kubeforward::runtime::StartProcessRequest request;
+  request.argv = {"/bin/sh", "-c", "trap '' TERM; sleep 30"};
+  request.cwd = std::filesystem::current_path();
+
+  std::vector<int> pids;
+  for (int i = 0; i < 3; ++i) {
+    std::string error;
+    const auto started = runner.Start(request, error);
+    REQUIRE(started.has_value());
+    pids.push_back(started->pid);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  pids.push_back(999999);
+  pids.push_back(0);
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto results = runner.StopAll(pids);
+  const auto elapsed_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  REQUIRE(results.size() == pids.size());
+  for (size_t i = 0; i < 3; ++i) {
+    CHECK(results[i].pid == pids[i]);
+    CHECK(results[i].stopped);
+    CHECK(results[i].error.empty());
+  }
+  CHECK(results[3].stopped);
+  CHECK_FALSE(results[4].stopped);
+  CHECK_FALSE(results[4].error.empty());
+  CHECK(elapsed_ms < 6000);
+}
+
 TEST_CASE("posix process runner writes daemon output to its log file", "[runtime]") {
   kubeforward::runtime::PosixProcessRunner runner;
   kubeforward::runtime::StartProcessRequest request;
@@ -158,6 +194,42 @@ TEST_CASE("posix process runner keeps foreground launches on inherited stdio", "
   CHECK((runner.Stop(started->pid, error) || CleanupProcessGroup(started->pid)));
 }
 
+TEST_CASE("posix process runner captures output on non-blocking pipes when requested", "[runtime]") {
+  kubeforward::runtime::PosixProcessRunner runner;
+  kubeforward::runtime::StartProcessRequest request;
+  request.argv = {"/bin/sh", "-c", "echo captured-stdout; echo captured-stderr >&2; sleep 30"};
+  request.cwd = std::filesystem::current_path();
+  request.capture_output = true;
+
+  std::string error;
+  const auto started = runner.Start(request, error);
+  REQUIRE(started.has_value());
+  REQUIRE(error.empty());
+  REQUIRE(started->stdout_fd >= 0);
+  REQUIRE(started->stderr_fd >= 0);
+  CHECK((::fcntl(started->stdout_fd, F_GETFL, 0) & O_NONBLOCK) != 0);
+
+  const auto read_until = [](int fd, const std::string& needle) {
+    std::string output;
+    char buffer[256];
+    for (int waited_ms = 0; waited_ms < 2000 && output.find(needle) == std::string::npos; waited_ms += 20) {
+      const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+      if (count > 0) {
+        output.append(buffer, static_cast<size_t>(count));
+        continue;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return output;
+  };
+  CHECK(read_until(started->stdout_fd, "captured-stdout").find("captured-stdout") != std::string::npos);
+  CHECK(read_until(started->stderr_fd, "captured-stderr").find("captured-stderr") != std::string::npos);
+
+  ::close(started->stdout_fd);
+  ::close(started->stderr_fd);
+  CHECK((runner.Stop(started->pid, error) || CleanupProcessGroup(started->pid)));
+}
+
 TEST_CASE("posix process runner stops reattached process groups before reporting success", "[runtime]") {
   int pid_pipe[2] = {-1, -1};
   REQUIRE(::pipe(pid_pipe) == 0);
@@ -193,3 +265,73 @@ TEST_CASE("posix process runner stops reattached process groups before reporting
   REQUIRE(error.empty());
   CHECK(::kill(reattached_pid, 0) != 0);
 }
+
+TEST_CASE("posix process runner reports exec failures the same way for fork and spawn launches", "[runtime]") {
+  using kubeforward::runtime::LaunchStrategy;
+  std::vector<LaunchStrategy> strategies = {LaunchStrategy::kFork};
+  if (kubeforward::runtime::PosixProcessRunner::SupportsSpawn()) {
+    strategies.push_back(LaunchStrategy::kSpawn);
+  }
+
+  for (const auto strategy : strategies) {
+    kubeforward::runtime::PosixProcessRunner runner(strategy);
+    kubeforward::runtime::StartProcessRequest request;
+    request.argv = {"kubeforward-missing-binary-for-tests"};
+    request.cwd = std::filesystem::current_path();
+    std::string error;
+
+    const auto started = runner.Start(request, error);
+    REQUIRE_FALSE(started.has_value());
+    CHECK(error.find("failed to exec 'kubeforward-missing-binary-for-tests'") != std::string::npos);
+  }
+}
+
+TEST_CASE("posix process runner spawn launches run in cwd, own process group and log file", "[runtime]") {
+  if (!kubeforward::runtime::PosixProcessRunner::SupportsSpawn()) {
+    return;
+  }
+
+  kubeforward::runtime::PosixProcessRunner runner(kubeforward::runtime::LaunchStrategy::kSpawn);
+  kubeforward::runtime::StartProcessRequest request;
+  const auto work_dir = TempRunnerPath("spawn-cwd");
+  std::filesystem::create_directories(work_dir);
+  const auto log_path = TempRunnerPath("spawn-daemon.log");
+  std::filesystem::remove(log_path);
+
+  request.argv = {"/bin/sh", "-c", "pwd; echo spawn-stderr >&2; sleep 30"};
+  request.cwd = work_dir;
+  request.daemon = true;
+  request.log_path = log_path;
+
+  std::string error;
+  const auto started = runner.Start(request, error);
+  REQUIRE(started.has_value());
+  REQUIRE(error.empty());
+  CHECK(::getpgid(started->pid) == started->pid);
+
+  std::string log;
+  for (int waited_ms = 0; waited_ms < 2000 && log.find("spawn-stderr") == std::string::npos; waited_ms += 20) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    log = ReadFile(log_path);
+  }
+  CHECK(log.find(std::filesystem::canonical(work_dir).string()) != std::string::npos);
+  CHECK(log.find("spawn-stderr") != std::string::npos);
+  CHECK((runner.Stop(started->pid, error) || CleanupProcessGroup(started->pid)));
+}
+
+TEST_CASE("posix process runner spawn launches fail cleanly on a missing cwd", "[runtime]") {
+  if (!kubeforward::runtime::PosixProcessRunner::SupportsSpawn()) {
+    return;
+  }
+
+  kubeforward::runtime::PosixProcessRunner runner(kubeforward::runtime::LaunchStrategy::kSpawn);
+  kubeforward::runtime::StartProcessRequest request;
+  request.argv = {"/bin/sh", "-c", "true"};
+  request.cwd = TempRunnerPath("spawn-missing-cwd") / "does-not-exist";
+  request.capture_output = true;
+  std::string error;
+
+  const auto started = runner.Start(request, error);
+  REQUIRE_FALSE(started.has_value());
+  CHECK(error.find("failed to exec '/bin/sh'") != std::string::npos);
+}
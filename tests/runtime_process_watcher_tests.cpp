@@ -0,0 +1,132 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "kubeforward/runtime/process_watcher.h"
+
+namespace {
+
+int SpawnSleepingChild(int sleep_ms) {
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    ::usleep(static_cast<useconds_t>(sleep_ms) * 1000);
+    _exit(0);
+  }
+  return static_cast<int>(pid);
+}
+
+long ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return static_cast<long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+}  // namespace
+
+TEST_CASE("process watcher wakes when a watched child exits", "[runtime]") {
+  kubeforward::runtime::ProcessWatcher watcher;
+  const int pid = SpawnSleepingChild(200);
+  REQUIRE(pid > 0);
+  watcher.WatchProcess(pid);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<int> exited;
+  while (std::find(exited.begin(), exited.end(), pid) == exited.end() && ElapsedMs(start) < 5000) {
+    exited = watcher.Wait(std::chrono::milliseconds(5000));
+  }
+
+  CHECK(std::find(exited.begin(), exited.end(), pid) != exited.end());
+  CHECK(ElapsedMs(start) < 5000);
+  int status = 0;
+  CHECK(::waitpid(pid, &status, 0) == pid);
+}
+
+TEST_CASE("process watcher returns when its wake descriptor is written", "[runtime]") {
+  kubeforward::runtime::ProcessWatcher watcher;
+  REQUIRE(watcher.wake_fd() >= 0);
+
+  const char byte = 0;
+  REQUIRE(::write(watcher.wake_fd(), &byte, 1) == 1);
+  const auto start = std::chrono::steady_clock::now();
+  CHECK(watcher.Wait(std::chrono::milliseconds(5000)).empty());
+  CHECK(ElapsedMs(start) < 1000);
+}
+
+TEST_CASE("process watcher wakes on readable descriptors", "[runtime]") {
+  int fds[2] = {-1, -1};
+  REQUIRE(::pipe(fds) == 0);
+
+  kubeforward::runtime::ProcessWatcher watcher;
+  watcher.SetDescriptors({fds[0]});
+  const char byte = 'x';
+  REQUIRE(::write(fds[1], &byte, 1) == 1);
+
+  const auto start = std::chrono::steady_clock::now();
+  (void)watcher.Wait(std::chrono::milliseconds(5000));
+  CHECK(ElapsedMs(start) < 1000);
+
+  watcher.SetDescriptors({});
+  const auto idle_start = std::chrono::steady_clock::now();
+  (void)watcher.Wait(std::chrono::milliseconds(50));
+  CHECK(ElapsedMs(idle_start) >= 40);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST_CASE("process watcher follows a descriptor number reused for another pipe", "[runtime]") {
+  int closed[2] = {-1, -1};
+  REQUIRE(::pipe(closed) == 0);
+  kubeforward::runtime::ProcessWatcher watcher;
+  watcher.SetDescriptors({closed[0]});
+  const int reused_fd = closed[0];
+  ::close(closed[0]);
+  ::close(closed[1]);
+
+  int fds[2] = {-1, -1};
+  REQUIRE(::pipe(fds) == 0);
+  if (fds[0] != reused_fd) {
+    REQUIRE(::dup2(fds[0], reused_fd) == reused_fd);
+    ::close(fds[0]);
+    fds[0] = reused_fd;
+  }
+  watcher.SetDescriptors({fds[0]});
+  const char byte = 'x';
+  REQUIRE(::write(fds[1], &byte, 1) == 1);
+
+  const auto start = std::chrono::steady_clock::now();
+  (void)watcher.Wait(std::chrono::milliseconds(5000));
+  CHECK(ElapsedMs(start) < 1000);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST_CASE("process watcher keeps watching a process whose pidfd reused a closed descriptor", "[runtime]") {
+  int closed[2] = {-1, -1};
+  REQUIRE(::pipe(closed) == 0);
+  kubeforward::runtime::ProcessWatcher watcher;
+  watcher.SetDescriptors({closed[0]});
+  ::close(closed[1]);
+  ::close(closed[0]);
+
+  // The pidfd takes the lowest free number, which is usually the pipe just closed.
+  const int pid = SpawnSleepingChild(200);
+  REQUIRE(pid > 0);
+  watcher.WatchProcess(pid);
+  watcher.SetDescriptors({});
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<int> exited;
+  while (std::find(exited.begin(), exited.end(), pid) == exited.end() && ElapsedMs(start) < 5000) {
+    exited = watcher.Wait(std::chrono::milliseconds(5000));
+  }
+
+  CHECK(std::find(exited.begin(), exited.end(), pid) != exited.end());
+  CHECK(ElapsedMs(start) < 5000);
+  int status = 0;
+  CHECK(::waitpid(pid, &status, 0) == pid);
+}
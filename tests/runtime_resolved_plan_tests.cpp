@@ -114,3 +114,30 @@ TEST_CASE("resolved plan applies environment context and resource overrides", "[
   REQUIRE(env.forwards.at(1).context.has_value());
   CHECK(env.forwards.at(1).context.value() == "resource-cluster");
 }
+
+TEST_CASE("resolved plan inherits the native engine settings from defaults", "[runtime]") {
+  const auto load_result = kubeforward::config::LoadConfigFromFile(Fixture("native_engine.yaml"));
+  REQUIRE(load_result.ok());
+  REQUIRE(load_result.config.has_value());
+
+  const auto plan_result = kubeforward::runtime::BuildResolvedPlan(*load_result.config, Fixture("native_engine.yaml"),
+                                                                   std::optional<std::string>{"dev"});
+  REQUIRE(plan_result.ok());
+  const auto& env = plan_result.plan->environments.at(0);
+  CHECK(env.settings.port_forward_engine == kubeforward::config::PortForwardEngine::kNative);
+  CHECK(env.settings.api_server == std::optional<std::string>{"http://127.0.0.1:8001"});
+}
+
+TEST_CASE("resolved plan rejects native engine environments it cannot serve", "[runtime]") {
+  const auto load_result = kubeforward::config::LoadConfigFromFile(Fixture("native_engine.yaml"));
+  REQUIRE(load_result.ok());
+  REQUIRE(load_result.config.has_value());
+
+  const auto plan_result = kubeforward::runtime::BuildResolvedPlan(*load_result.config, Fixture("native_engine.yaml"),
+                                                                   std::optional<std::string>{"broken"});
+  REQUIRE_FALSE(plan_result.ok());
+  REQUIRE(plan_result.errors.size() == 2);
+  CHECK(plan_result.errors.at(0).context == "environments.broken.apiServer");
+  CHECK(plan_result.errors.at(0).message.find("https") != std::string::npos);
+  CHECK(plan_result.errors.at(1).context == "environments.broken.forwards[0].resource.kind");
+}
@@ -0,0 +1,62 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+
+#include "kubeforward/runtime/restart_backoff.h"
+
+using std::chrono::milliseconds;
+
+TEST_CASE("restart backoff doubles up to the cap without jitter", "[runtime]") {
+  kubeforward::runtime::RestartBackoff backoff(kubeforward::runtime::RestartBackoffPolicy{
+      .initial_delay = milliseconds(100),
+      .max_delay = milliseconds(500),
+      .multiplier = 2.0,
+      .jitter = 0.0,
+  });
+
+  CHECK(backoff.NextDelay() == milliseconds(100));
+  CHECK(backoff.NextDelay() == milliseconds(200));
+  CHECK(backoff.NextDelay() == milliseconds(400));
+  CHECK(backoff.NextDelay() == milliseconds(500));
+  CHECK(backoff.NextDelay() == milliseconds(500));
+  CHECK(backoff.attempts() == 5);
+}
+
+TEST_CASE("restart backoff keeps jittered delays inside the configured window", "[runtime]") {
+  kubeforward::runtime::RestartBackoff backoff(
+      kubeforward::runtime::RestartBackoffPolicy{
+          .initial_delay = milliseconds(1000),
+          .max_delay = milliseconds(1000),
+          .jitter = 0.5,
+      },
+      42);
+
+  bool saw_variation = false;
+  milliseconds previous{-1};
+  for (int i = 0; i < 50; ++i) {
+    const auto delay = backoff.NextDelay();
+    CHECK(delay >= milliseconds(500));
+    CHECK(delay <= milliseconds(1000));
+    saw_variation = saw_variation || (previous.count() >= 0 && delay != previous);
+    previous = delay;
+  }
+  CHECK(saw_variation);
+}
+
+TEST_CASE("restart backoff resets after a stable run", "[runtime]") {
+  kubeforward::runtime::RestartBackoff backoff(kubeforward::runtime::RestartBackoffPolicy{
+      .initial_delay = milliseconds(100),
+      .max_delay = milliseconds(10000),
+      .jitter = 0.0,
+      .stable_after = milliseconds(1000),
+  });
+
+  (void)backoff.NextDelay();
+  (void)backoff.NextDelay();
+  backoff.RecordUptime(milliseconds(999));
+  CHECK(backoff.NextDelay() == milliseconds(400));
+
+  backoff.RecordUptime(milliseconds(1000));
+  CHECK(backoff.attempts() == 0);
+  CHECK(backoff.NextDelay() == milliseconds(100));
+}
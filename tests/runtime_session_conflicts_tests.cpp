@@ -5,6 +5,7 @@
 #include <unistd.h>
 
 #include "kubeforward/config/types.h"
+#include "kubeforward/runtime/process_identity.h"
 #include "kubeforward/runtime/resolved_plan.h"
 #include "kubeforward/runtime/session_conflicts.h"
 #include "kubeforward/runtime/state_store.h"
@@ -78,3 +79,50 @@ TEST_CASE("runtime conflict check rejects identical socket tuples from another s
   CHECK(error.find("127.0.0.1") != std::string::npos);
   CHECK(error.find("18080") != std::string::npos);
 }
+
+TEST_CASE("runtime conflict check covers additional ports of grouped processes", "[runtime]") {
+  auto state = MakeRunningState("127.0.0.1", kubeforward::config::PortProtocol::kTcp);
+  auto& process = state.sessions.at(0).forwards.at(0);
+  process.local_port = 18079;
+  process.additional_ports.push_back(kubeforward::runtime::ManagedPortMapping{.local_port = 18080, .remote_port = 80});
+  const auto target_env = MakeTargetEnvironment("right", "127.0.0.1", kubeforward::config::PortProtocol::kTcp);
+
+  std::string error;
+  CHECK_FALSE(kubeforward::runtime::CheckRuntimeSessionPortConflicts(state, "/tmp/kubeforward.yaml", target_env, error));
+  CHECK(error.find("18080") != std::string::npos);
+}
+
+TEST_CASE("runtime conflict check accepts claims looked up for the target sockets", "[runtime]") {
+  const auto state = MakeRunningState("127.0.0.1", kubeforward::config::PortProtocol::kTcp);
+  const auto target_env = MakeTargetEnvironment("right", "127.0.0.1", kubeforward::config::PortProtocol::kTcp);
+  const auto keys = kubeforward::runtime::PortClaimKeys(target_env);
+  REQUIRE(keys.size() == 1);
+  CHECK(keys.at(0).bind_address == "127.0.0.1");
+  CHECK(keys.at(0).local_port == 18080);
+
+  const auto claims = kubeforward::runtime::PortClaimsOf(state, keys);
+  REQUIRE(claims.size() == 1);
+  std::string error;
+  CHECK_FALSE(kubeforward::runtime::CheckPortClaimConflicts(claims, "/tmp/kubeforward.yaml", target_env, error));
+  CHECK(error.find("session-left") != std::string::npos);
+  CHECK(kubeforward::runtime::CheckPortClaimConflicts(claims, "/tmp/kubeforward.yaml",
+                                                      MakeTargetEnvironment("left", "127.0.0.1",
+                                                                            kubeforward::config::PortProtocol::kTcp),
+                                                      error));
+}
+
+TEST_CASE("runtime conflict check ignores claims whose pid now belongs to another process", "[runtime]") {
+  auto state = MakeRunningState("127.0.0.1", kubeforward::config::PortProtocol::kTcp);
+  auto& process = state.sessions.at(0).forwards.at(0);
+  const auto fingerprint = kubeforward::runtime::ReadProcessFingerprint(process.pid);
+  REQUIRE(fingerprint.has_value());
+  process.fingerprint = *fingerprint;
+  const auto target_env = MakeTargetEnvironment("right", "127.0.0.1", kubeforward::config::PortProtocol::kTcp);
+
+  std::string error;
+  CHECK_FALSE(kubeforward::runtime::CheckRuntimeSessionPortConflicts(state, "/tmp/kubeforward.yaml", target_env, error));
+
+  process.fingerprint.start_time += 1;
+  CHECK(kubeforward::runtime::CheckRuntimeSessionPortConflicts(state, "/tmp/kubeforward.yaml", target_env, error));
+  CHECK(error.empty());
+}
@@ -0,0 +1,286 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "kubeforward/runtime/shared_kubeconfig.h"
+
+namespace {
+
+std::filesystem::path TempDirectory(const std::string& stem) {
+  const auto path = std::filesystem::temp_directory_path() / "kubeforward-tests" / stem;
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& contents) {
+  std::ofstream out(path, std::ios::trunc);
+  out << contents;
+}
+
+std::string Rfc3339FromNow(std::chrono::seconds offset) {
+  const auto when = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() + offset);
+  std::tm utc{};
+  gmtime_r(&when, &utc);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+  return buffer;
+}
+
+std::string TokenCredential(const std::string& token, const std::string& expiry) {
+  return "{\"apiVersion\":\"client.authentication.k8s.io/v1\",\"kind\":\"ExecCredential\",\"status\":{\"token\":\"" +
+         token + "\"" + (expiry.empty() ? "" : ",\"expirationTimestamp\":\"" + expiry + "\"") + "}}";
+}
+
+constexpr const char* kTwoContextKubeconfig = R"(apiVersion: v1
+kind: Config
+current-context: dev
+clusters:
+  - name: dev-cluster
+    cluster:
+      server: https://dev.example:6443
+      certificate-authority: certs/ca.pem
+  - name: unused-cluster
+    cluster:
+      server: https://unused.example:6443
+users:
+  - name: cloud-user
+    user:
+      exec:
+        apiVersion: client.authentication.k8s.io/v1
+        command: cloud-auth
+        args: ["token", "--cluster", "dev"]
+        env:
+          - name: CLOUD_PROFILE
+            value: dev
+        provideClusterInfo: true
+  - name: static-user
+    user:
+      token: static-token
+contexts:
+  - name: dev
+    context:
+      cluster: dev-cluster
+      user: cloud-user
+      namespace: api
+  - name: dev-admin
+    context:
+      cluster: dev-cluster
+      user: cloud-user
+  - name: dev-static
+    context:
+      cluster: dev-cluster
+      user: static-user
+)";
+
+struct RecordingRunner {
+  std::vector<std::vector<std::string>> argvs;
+  std::vector<kubeforward::runtime::CommandEnvironment> environments;
+  std::string expiry;
+  bool fail = false;
+
+  kubeforward::runtime::ExecPluginRunner Runner() {
+    return [this](const std::vector<std::string>& argv, const kubeforward::runtime::CommandEnvironment& environment,
+                  std::string& output, std::string& error) {
+      argvs.push_back(argv);
+      environments.push_back(environment);
+      if (fail) {
+        error = "login required";
+        return false;
+      }
+      output = TokenCredential("token-" + std::to_string(argvs.size()), expiry);
+      return true;
+    };
+  }
+};
+
+}  // namespace
+
+TEST_CASE("exec credentials are parsed with their expiry", "[runtime]") {
+  std::string error;
+  const auto token = kubeforward::runtime::ParseExecCredential(
+      TokenCredential("abc", "2026-03-01T10:00:00Z"), error);
+  REQUIRE(token.has_value());
+  CHECK(token->token == "abc");
+  REQUIRE(token->expires_at.has_value());
+  CHECK(std::chrono::system_clock::to_time_t(*token->expires_at) == 1772359200);
+
+  const auto offset = kubeforward::runtime::ParseExecCredential(
+      TokenCredential("abc", "2026-03-01T12:30:00.250+02:30"), error);
+  REQUIRE(offset.has_value());
+  CHECK(std::chrono::system_clock::to_time_t(*offset->expires_at) == 1772359200);
+
+  const auto certificate = kubeforward::runtime::ParseExecCredential(
+      R"({"status":{"clientCertificateData":"CERT","clientKeyData":"KEY"}})", error);
+  REQUIRE(certificate.has_value());
+  CHECK(certificate->token.empty());
+  CHECK(certificate->client_certificate_data == "CERT");
+  CHECK(certificate->client_key_data == "KEY");
+  CHECK_FALSE(certificate->expires_at.has_value());
+
+  CHECK_FALSE(kubeforward::runtime::ParseExecCredential(R"({"kind":"ExecCredential"})", error).has_value());
+  CHECK(error == "ExecCredential has no status");
+  CHECK_FALSE(kubeforward::runtime::ParseExecCredential(R"({"status":{}})", error).has_value());
+  CHECK_FALSE(error.empty());
+}
+
+TEST_CASE("shared kubeconfig runs each exec plugin once for every context that uses it", "[runtime]") {
+  const auto directory = TempDirectory("shared-kubeconfig-contexts");
+  WriteFile(directory / "config", kTwoContextKubeconfig);
+  const auto output_path = directory / "private" / "session.kubeconfig";
+
+  RecordingRunner runner;
+  kubeforward::runtime::SharedKubeconfig shared((directory / "config").string(), {"", "dev-admin", "dev-static"},
+                                                output_path, runner.Runner());
+  std::string error;
+  const auto written = shared.Update(error);
+  REQUIRE(error.empty());
+  REQUIRE(written.has_value());
+  CHECK(*written == output_path);
+  CHECK(shared.plugin_runs() == 1);
+
+  REQUIRE(runner.argvs.size() == 1);
+  CHECK(runner.argvs.at(0) == std::vector<std::string>{"cloud-auth", "token", "--cluster", "dev"});
+  const auto& environment = runner.environments.at(0);
+  REQUIRE(environment.size() == 2);
+  CHECK(environment.at(0) == std::make_pair(std::string("CLOUD_PROFILE"), std::string("dev")));
+  CHECK(environment.at(1).first == "KUBERNETES_EXEC_INFO");
+  CHECK(environment.at(1).second.find("\"server\":\"https://dev.example:6443\"") != std::string::npos);
+  CHECK(environment.at(1).second.find("client.authentication.k8s.io/v1\"") != std::string::npos);
+
+  struct stat info {};
+  REQUIRE(::stat(output_path.c_str(), &info) == 0);
+  CHECK((info.st_mode & 0777) == 0600);
+  REQUIRE(::stat(output_path.parent_path().c_str(), &info) == 0);
+  CHECK((info.st_mode & 0777) == 0700);
+
+  const auto root = YAML::LoadFile(output_path.string());
+  CHECK(root["current-context"].as<std::string>() == "dev");
+  REQUIRE(root["clusters"].size() == 1);
+  CHECK(root["clusters"][0]["cluster"]["certificate-authority"].as<std::string>() ==
+        (directory / "certs" / "ca.pem").string());
+  REQUIRE(root["users"].size() == 2);
+  CHECK(root["users"][0]["name"].as<std::string>() == "cloud-user");
+  CHECK(root["users"][0]["user"]["token"].as<std::string>() == "token-1");
+  CHECK_FALSE(root["users"][0]["user"]["exec"]);
+  CHECK(root["users"][1]["user"]["token"].as<std::string>() == "static-token");
+  REQUIRE(root["contexts"].size() == 3);
+  CHECK(root["contexts"][0]["context"]["namespace"].as<std::string>() == "api");
+}
+
+TEST_CASE("shared kubeconfig reuses credentials until shortly before they expire", "[runtime]") {
+  const auto directory = TempDirectory("shared-kubeconfig-expiry");
+  WriteFile(directory / "config", kTwoContextKubeconfig);
+
+  RecordingRunner runner;
+  runner.expiry = Rfc3339FromNow(std::chrono::hours(1));
+  kubeforward::runtime::SharedKubeconfig shared((directory / "config").string(), {"dev"}, directory / "out" / "config",
+                                                runner.Runner());
+  std::string error;
+  REQUIRE(shared.Update(error).has_value());
+  REQUIRE(shared.Update(error).has_value());
+  CHECK(shared.plugin_runs() == 1);
+
+  RecordingRunner expiring;
+  expiring.expiry = Rfc3339FromNow(std::chrono::seconds(10));
+  kubeforward::runtime::SharedKubeconfig refreshed((directory / "config").string(), {"dev"},
+                                                   directory / "out" / "config", expiring.Runner());
+  REQUIRE(refreshed.Update(error).has_value());
+  REQUIRE(refreshed.Update(error).has_value());
+  CHECK(refreshed.plugin_runs() == 2);
+  const auto root = YAML::LoadFile((directory / "out" / "config").string());
+  CHECK(root["users"][0]["user"]["token"].as<std::string>() == "token-2");
+}
+
+TEST_CASE("shared kubeconfig is skipped when no context uses an exec plugin", "[runtime]") {
+  const auto directory = TempDirectory("shared-kubeconfig-static");
+  WriteFile(directory / "config", kTwoContextKubeconfig);
+
+  RecordingRunner runner;
+  kubeforward::runtime::SharedKubeconfig shared((directory / "config").string(), {"dev-static"},
+                                                directory / "out" / "config", runner.Runner());
+  std::string error = "stale";
+  CHECK_FALSE(shared.Update(error).has_value());
+  CHECK(error.empty());
+  CHECK(runner.argvs.empty());
+  CHECK_FALSE(std::filesystem::exists(directory / "out" / "config"));
+}
+
+TEST_CASE("shared kubeconfig reports plugin and context failures", "[runtime]") {
+  const auto directory = TempDirectory("shared-kubeconfig-errors");
+  WriteFile(directory / "config", kTwoContextKubeconfig);
+  std::string error;
+
+  RecordingRunner failing;
+  failing.fail = true;
+  kubeforward::runtime::SharedKubeconfig plugin_failure((directory / "config").string(), {"dev"},
+                                                        directory / "out" / "config", failing.Runner());
+  CHECK_FALSE(plugin_failure.Update(error).has_value());
+  CHECK(error == "exec plugin of user \"cloud-user\" failed: login required");
+
+  RecordingRunner runner;
+  kubeforward::runtime::SharedKubeconfig unknown((directory / "config").string(), {"prod"},
+                                                 directory / "out" / "config", runner.Runner());
+  CHECK_FALSE(unknown.Update(error).has_value());
+  CHECK(error == "context \"prod\" not found in kubeconfig");
+
+  WriteFile(directory / "interactive", R"(current-context: dev
+clusters: [{name: c, cluster: {server: https://c.example}}]
+users: [{name: u, user: {exec: {command: login, interactiveMode: Always}}}]
+contexts: [{name: dev, context: {cluster: c, user: u}}]
+)");
+  kubeforward::runtime::SharedKubeconfig interactive((directory / "interactive").string(), {""},
+                                                     directory / "out" / "config", runner.Runner());
+  CHECK_FALSE(interactive.Update(error).has_value());
+  CHECK(error == "exec plugin of user \"u\" failed: it needs an interactive terminal");
+  CHECK(runner.argvs.empty());
+
+  kubeforward::runtime::SharedKubeconfig missing((directory / "missing").string(), {""}, directory / "out" / "config",
+                                                 runner.Runner());
+  CHECK_FALSE(missing.Update(error).has_value());
+  CHECK_FALSE(error.empty());
+}
+
+TEST_CASE("shared kubeconfig merges KUBECONFIG files with the first definition winning", "[runtime]") {
+  const auto directory = TempDirectory("shared-kubeconfig-merge");
+  WriteFile(directory / "first", R"(current-context: dev
+contexts: [{name: dev, context: {cluster: c, user: u}}]
+users: [{name: u, user: {exec: {command: ./bin/auth}}}]
+)");
+  WriteFile(directory / "second", R"(current-context: other
+clusters: [{name: c, cluster: {server: https://c.example}}]
+users: [{name: u, user: {token: ignored}}]
+)");
+  const auto previous = std::getenv("KUBECONFIG");
+  const std::string saved = previous != nullptr ? previous : "";
+  const auto list = (directory / "first").string() + ":" + (directory / "absent").string() + ":" +
+                    (directory / "second").string();
+  ::setenv("KUBECONFIG", list.c_str(), 1);
+
+  RecordingRunner runner;
+  kubeforward::runtime::SharedKubeconfig shared(std::nullopt, {""}, directory / "out" / "config", runner.Runner());
+  std::string error;
+  const auto written = shared.Update(error);
+  if (previous != nullptr) {
+    ::setenv("KUBECONFIG", saved.c_str(), 1);
+  } else {
+    ::unsetenv("KUBECONFIG");
+  }
+  REQUIRE(written.has_value());
+  REQUIRE(runner.argvs.size() == 1);
+  CHECK(runner.argvs.at(0).at(0) == (directory / "bin" / "auth").string());
+  const auto root = YAML::LoadFile(written->string());
+  CHECK(root["current-context"].as<std::string>() == "dev");
+  CHECK(root["clusters"][0]["cluster"]["server"].as<std::string>() == "https://c.example");
+}
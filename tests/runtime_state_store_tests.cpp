@@ -1,7 +1,16 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <atomic>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
 
 #include "kubeforward/runtime/state_store.h"
 
@@ -13,6 +22,11 @@ std::filesystem::path TempStatePath() {
   return base / "state-store-test.yaml";
 }
 
+std::string ReadBytes(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
 class ScopedCurrentPath {
  public:
   explicit ScopedCurrentPath(const std::filesystem::path& path) : original_(std::filesystem::current_path()) {
@@ -68,6 +82,529 @@ TEST_CASE("state store round-trips sessions", "[runtime]") {
   CHECK(load.state.sessions.at(0).forwards.at(0).pid == 12001);
 }
 
+TEST_CASE("state store round-trips additional port mappings", "[runtime]") {
+  const auto path = TempStatePath();
+  std::filesystem::remove(path);
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "session-multi";
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+      .forward_name = "api",
+      .argv = {"kubectl", "port-forward", "deployment/api", "7000:80", "7001:81"},
+      .local_port = 7000,
+      .remote_port = 80,
+      .pid = 12002,
+      .additional_ports = {{.local_port = 7001, .remote_port = 81, .upstream_port = 41001}},
+      .upstream_port = 41000});
+  state.sessions.push_back(session);
+
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  const auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  REQUIRE(load.state.sessions.size() == 1);
+  const auto mappings = kubeforward::runtime::ManagedPortMappings(load.state.sessions.at(0).forwards.at(0));
+  REQUIRE(mappings.size() == 2);
+  CHECK(mappings.at(0).local_port == 7000);
+  CHECK(mappings.at(1).local_port == 7001);
+  CHECK(mappings.at(1).remote_port == 81);
+  CHECK(mappings.at(0).upstream_port == 41000);
+  CHECK(mappings.at(1).upstream_port == 41001);
+}
+
+TEST_CASE("state store updates one session in place and keeps the others", "[runtime]") {
+  const auto path = TempStatePath();
+  std::filesystem::remove(path);
+
+  kubeforward::runtime::RuntimeState state;
+  for (const auto* id : {"session-a", "session-b"}) {
+    kubeforward::runtime::ManagedSession session;
+    session.id = id;
+    session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+        .forward_name = "api", .argv = {"kubectl"}, .local_port = 7000, .pid = 12003});
+    state.sessions.push_back(session);
+  }
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  REQUIRE(kubeforward::runtime::UpdateState(
+      path,
+      [](kubeforward::runtime::RuntimeState& current) {
+        auto& forward = current.sessions.at(1).forwards.at(0);
+        forward.pid = 12004;
+        forward.restart_count = 2;
+      },
+      error));
+  REQUIRE(error.empty());
+
+  const auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  REQUIRE(load.state.sessions.size() == 2);
+  CHECK(load.state.sessions.at(0).forwards.at(0).pid == 12003);
+  CHECK(load.state.sessions.at(0).forwards.at(0).restart_count == 0);
+  CHECK(load.state.sessions.at(1).forwards.at(0).pid == 12004);
+  CHECK(load.state.sessions.at(1).forwards.at(0).restart_count == 2);
+}
+
+TEST_CASE("state store round-trips the supervisor and its drain request", "[runtime]") {
+  const auto path = TempStatePath();
+  std::filesystem::remove(path);
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession supervised;
+  supervised.id = "session-foreground";
+  supervised.supervisor_pid = 13001;
+  supervised.supervisor_fingerprint = {.start_time = 42, .exe_inode = 7, .cmdline_hash = 99};
+  supervised.drain_timeout_ms = 15000;
+  state.sessions.push_back(supervised);
+  kubeforward::runtime::ManagedSession daemon;
+  daemon.id = "session-daemon";
+  daemon.daemon = true;
+  state.sessions.push_back(daemon);
+
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  const auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  REQUIRE(load.state.sessions.size() == 2);
+  const auto& loaded = load.state.sessions.at(0);
+  CHECK(loaded.supervisor_pid == 13001);
+  CHECK(loaded.supervisor_fingerprint.start_time == 42);
+  CHECK(loaded.supervisor_fingerprint.exe_inode == 7);
+  CHECK(loaded.supervisor_fingerprint.cmdline_hash == 99);
+  CHECK(loaded.drain_timeout_ms == 15000);
+  CHECK(load.state.sessions.at(1).supervisor_pid == 0);
+  CHECK(load.state.sessions.at(1).supervisor_fingerprint.empty());
+  CHECK(load.state.sessions.at(1).drain_timeout_ms == 0);
+}
+
+TEST_CASE("state store reads single sessions without the rest of the state", "[runtime]") {
+  const auto path = TempStatePath();
+  std::filesystem::remove(path);
+
+  kubeforward::runtime::RuntimeState state;
+  for (const auto* environment : {"dev", "staging", "prod"}) {
+    for (const auto* config_path : {"/tmp/a/kubeforward.yaml", "/tmp/b/kubeforward.yaml"}) {
+      kubeforward::runtime::ManagedSession session;
+      session.id = std::string(config_path) + "::" + environment;
+      session.config_path = config_path;
+      session.environment = environment;
+      session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+          .forward_name = "api", .argv = {"kubectl", "port-forward"}, .local_port = 7000, .pid = 12005});
+      state.sessions.push_back(session);
+    }
+  }
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  const auto by_id = kubeforward::runtime::LoadSessions(path, {.id = "/tmp/b/kubeforward.yaml::staging"});
+  REQUIRE(by_id.ok());
+  REQUIRE(by_id.state.sessions.size() == 1);
+  CHECK(by_id.state.sessions.at(0).environment == "staging");
+  CHECK(by_id.state.sessions.at(0).forwards.at(0).argv.size() == 2);
+
+  const auto by_config = kubeforward::runtime::LoadSessions(path, {.config_path = "/tmp/a/kubeforward.yaml"});
+  REQUIRE(by_config.ok());
+  CHECK(by_config.state.sessions.size() == 3);
+
+  const auto by_scope =
+      kubeforward::runtime::LoadSessions(path, {.config_path = "/tmp/a/kubeforward.yaml", .environment = "prod"});
+  REQUIRE(by_scope.ok());
+  REQUIRE(by_scope.state.sessions.size() == 1);
+  CHECK(by_scope.state.sessions.at(0).id == "/tmp/a/kubeforward.yaml::prod");
+
+  CHECK(kubeforward::runtime::LoadSessions(path, {.id = "missing"}).state.sessions.empty());
+}
+
+TEST_CASE("state store migrates yaml state to the binary format on the next write", "[runtime]") {
+  const auto path = TempStatePath();
+  {
+    std::ofstream out(path, std::ios::trunc);
+    out << "sessions:\n"
+           "  - id: legacy\n"
+           "    configPath: /tmp/kubeforward.yaml\n"
+           "    environment: dev\n"
+           "    forwards:\n"
+           "      - name: api\n"
+           "        argv: [kubectl, port-forward, deployment/api, \"7000:80\"]\n"
+           "        localPort: 7000\n"
+           "        remotePort: 80\n"
+           "        protocol: udp\n"
+           "        pid: 12006\n";
+  }
+
+  const auto legacy = kubeforward::runtime::LoadSessions(path, {.environment = "dev"});
+  REQUIRE(legacy.ok());
+  REQUIRE(legacy.state.sessions.size() == 1);
+  CHECK(legacy.state.sessions.at(0).forwards.at(0).protocol == kubeforward::config::PortProtocol::kUdp);
+  const auto legacy_claims = kubeforward::runtime::LookupPortClaims(
+      path, {{.local_port = 7000, .protocol = kubeforward::config::PortProtocol::kUdp}});
+  REQUIRE(legacy_claims.ok());
+  REQUIRE(legacy_claims.claims.size() == 1);
+  CHECK(legacy_claims.claims.at(0).session_id == "legacy");
+
+  std::string error;
+  REQUIRE(kubeforward::runtime::UpdateState(
+      path, [](kubeforward::runtime::RuntimeState& current) { current.sessions.at(0).forwards.at(0).pid = 12007; },
+      error));
+  std::ifstream in(path, std::ios::binary);
+  std::string magic(8, '\0');
+  in.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+  CHECK(magic == std::string("KFSTATE\0", 8));
+
+  const auto migrated = kubeforward::runtime::LoadState(path);
+  REQUIRE(migrated.ok());
+  REQUIRE(migrated.state.sessions.size() == 1);
+  CHECK(migrated.state.sessions.at(0).id == "legacy");
+  CHECK(migrated.state.sessions.at(0).forwards.at(0).argv.at(3) == "7000:80");
+  CHECK(migrated.state.sessions.at(0).forwards.at(0).pid == 12007);
+  CHECK(migrated.state.sessions.at(0).forwards.at(0).protocol == kubeforward::config::PortProtocol::kUdp);
+}
+
+TEST_CASE("state store reports truncated binary state", "[runtime]") {
+  const auto path = TempStatePath();
+  std::filesystem::remove(path);
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "session-truncated";
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{.forward_name = "api", .pid = 12008});
+  state.sessions.push_back(session);
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+
+  const auto load = kubeforward::runtime::LoadState(path);
+  CHECK_FALSE(load.ok());
+  std::string update_error;
+  CHECK_FALSE(kubeforward::runtime::UpdateState(path, [](kubeforward::runtime::RuntimeState&) {}, update_error));
+}
+
+TEST_CASE("state store journals single forward updates instead of rewriting the snapshot", "[runtime]") {
+  const auto path = TempStatePath();
+  const auto journal_path = path.string() + ".journal";
+  std::filesystem::remove(path);
+  std::filesystem::remove(journal_path);
+
+  kubeforward::runtime::RuntimeState state;
+  for (const auto* id : {"session-a", "session-b"}) {
+    kubeforward::runtime::ManagedSession session;
+    session.id = id;
+    session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+        .forward_name = "api", .argv = {"kubectl"}, .local_port = 7000, .pid = 12010});
+    session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+        .forward_name = "db", .argv = {"kubectl"}, .local_port = 7001, .pid = 12011});
+    state.sessions.push_back(session);
+  }
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+  const auto snapshot = ReadBytes(path);
+  CHECK_FALSE(std::filesystem::exists(journal_path));
+
+  REQUIRE(kubeforward::runtime::UpdateState(
+      path, [](kubeforward::runtime::RuntimeState& current) { current.sessions.at(1).forwards.at(1).pid = 12012; },
+      error));
+  CHECK(ReadBytes(path) == snapshot);
+  REQUIRE(std::filesystem::exists(journal_path));
+  const auto journal_size = std::filesystem::file_size(journal_path);
+  CHECK(journal_size < snapshot.size());
+
+  auto next = kubeforward::runtime::LoadState(path).state;
+  next.sessions.erase(next.sessions.begin());
+  kubeforward::runtime::ManagedSession added;
+  added.id = "session-c";
+  added.environment = "staging";
+  next.sessions.push_back(added);
+  REQUIRE(kubeforward::runtime::SaveState(path, next, error));
+  CHECK(ReadBytes(path) == snapshot);
+  CHECK(std::filesystem::file_size(journal_path) > journal_size);
+
+  const auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  REQUIRE(load.state.sessions.size() == 2);
+  CHECK(load.state.sessions.at(0).id == "session-b");
+  CHECK(load.state.sessions.at(0).forwards.at(0).pid == 12010);
+  CHECK(load.state.sessions.at(0).forwards.at(1).pid == 12012);
+  CHECK(load.state.sessions.at(1).id == "session-c");
+
+  const auto by_environment = kubeforward::runtime::LoadSessions(path, {.environment = "staging"});
+  REQUIRE(by_environment.ok());
+  REQUIRE(by_environment.state.sessions.size() == 1);
+  CHECK(by_environment.state.sessions.at(0).id == "session-c");
+}
+
+TEST_CASE("state store ignores a torn journal tail and a journal of an older snapshot", "[runtime]") {
+  const auto path = TempStatePath();
+  const auto journal_path = path.string() + ".journal";
+  std::filesystem::remove(path);
+  std::filesystem::remove(journal_path);
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "session-journal";
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{.forward_name = "api", .pid = 12013});
+  state.sessions.push_back(session);
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+  REQUIRE(kubeforward::runtime::UpdateState(
+      path, [](kubeforward::runtime::RuntimeState& current) { current.sessions.at(0).forwards.at(0).pid = 12014; },
+      error));
+  const auto journal = ReadBytes(journal_path);
+  {
+    std::ofstream out(journal_path, std::ios::binary | std::ios::app);
+    out << std::string("\x40\x00\x00\x00partial", 11);
+  }
+
+  auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  CHECK(load.state.sessions.at(0).forwards.at(0).pid == 12014);
+  REQUIRE(kubeforward::runtime::UpdateState(
+      path, [](kubeforward::runtime::RuntimeState& current) { current.sessions.at(0).forwards.at(0).pid = 12015; },
+      error));
+  load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  CHECK(load.state.sessions.at(0).forwards.at(0).pid == 12015);
+
+  // Emptying the state writes a fresh snapshot; the old journal must not bring the session back.
+  REQUIRE(kubeforward::runtime::SaveState(path, kubeforward::runtime::RuntimeState{}, error));
+  CHECK_FALSE(std::filesystem::exists(journal_path));
+  {
+    std::ofstream out(journal_path, std::ios::binary | std::ios::trunc);
+    out << journal;
+  }
+  load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  CHECK(load.state.sessions.empty());
+}
+
+TEST_CASE("state store compacts the journal once it outgrows the snapshot", "[runtime]") {
+  const auto path = TempStatePath();
+  const auto journal_path = path.string() + ".journal";
+  std::filesystem::remove(path);
+  std::filesystem::remove(journal_path);
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "session-compaction";
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+      .forward_name = "api", .argv = {"kubectl", "port-forward", "deployment/api", "7000:80"}, .pid = 1});
+  state.sessions.push_back(session);
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  bool compacted = false;
+  for (int pid = 2; pid < 2000 && !compacted; ++pid) {
+    REQUIRE(kubeforward::runtime::UpdateState(
+        path, [pid](kubeforward::runtime::RuntimeState& current) { current.sessions.at(0).forwards.at(0).pid = pid; },
+        error));
+    compacted = pid > 2 && !std::filesystem::exists(journal_path);
+    const auto journal_size = compacted ? 0 : std::filesystem::file_size(journal_path);
+    CHECK(journal_size <= 64 * 1024);
+  }
+  CHECK(compacted);
+  const auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  CHECK(load.state.sessions.at(0).forwards.at(0).pid > 2);
+}
+
+TEST_CASE("state store answers port claims from its claim index and journal", "[runtime]") {
+  const auto path = TempStatePath();
+  std::filesystem::remove(path);
+  std::filesystem::remove(path.string() + ".journal");
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession first;
+  first.id = "session-a";
+  first.config_path = "/tmp/a/kubeforward.yaml";
+  first.environment = "dev";
+  first.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+      .forward_name = "api",
+      .local_port = 7000,
+      .pid = 12030,
+      .additional_ports = {{.local_port = 7002, .remote_port = 82}},
+  });
+  state.sessions.push_back(first);
+  kubeforward::runtime::ManagedSession second;
+  second.id = "session-b";
+  second.config_path = "/tmp/b/kubeforward.yaml";
+  second.environment = "dev";
+  second.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{
+      .forward_name = "dns",
+      .bind_address = "127.0.0.2",
+      .local_port = 7001,
+      .protocol = kubeforward::config::PortProtocol::kUdp,
+      .pid = 12031,
+  });
+  state.sessions.push_back(second);
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  const std::vector<kubeforward::runtime::PortClaimKey> keys = {
+      {.local_port = 7000},
+      {.local_port = 7002},
+      {.bind_address = "127.0.0.2", .local_port = 7001, .protocol = kubeforward::config::PortProtocol::kUdp},
+      {.local_port = 7001},
+      {.local_port = 9999},
+  };
+  const auto indexed = kubeforward::runtime::LookupPortClaims(path, keys);
+  REQUIRE(indexed.ok());
+  REQUIRE(indexed.claims.size() == 3);
+  CHECK(indexed.claims.at(0).session_id == "session-a");
+  CHECK(indexed.claims.at(0).key.local_port == 7000);
+  CHECK(indexed.claims.at(1).key.local_port == 7002);
+  CHECK(indexed.claims.at(2).session_id == "session-b");
+  CHECK(indexed.claims.at(2).forward_name == "dns");
+  CHECK(indexed.claims.at(2).pid == 12031);
+
+  REQUIRE(kubeforward::runtime::UpdateState(
+      path,
+      [](kubeforward::runtime::RuntimeState& current) {
+        current.sessions.at(1).forwards.at(0).pid = 12032;
+        current.sessions.erase(current.sessions.begin());
+        kubeforward::runtime::ManagedSession added;
+        added.id = "session-c";
+        added.forwards.push_back(
+            kubeforward::runtime::ManagedForwardProcess{.forward_name = "web", .local_port = 7000, .pid = 12033});
+        current.sessions.push_back(added);
+      },
+      error));
+  REQUIRE(std::filesystem::exists(path.string() + ".journal"));
+
+  const auto journaled = kubeforward::runtime::LookupPortClaims(path, keys);
+  REQUIRE(journaled.ok());
+  REQUIRE(journaled.claims.size() == 2);
+  const auto& dns = journaled.claims.at(0).session_id == "session-b" ? journaled.claims.at(0) : journaled.claims.at(1);
+  const auto& web = journaled.claims.at(0).session_id == "session-c" ? journaled.claims.at(0) : journaled.claims.at(1);
+  CHECK(dns.session_id == "session-b");
+  CHECK(dns.pid == 12032);
+  CHECK(web.session_id == "session-c");
+  CHECK(web.key.local_port == 7000);
+
+  const auto all = kubeforward::runtime::LoadState(path);
+  REQUIRE(all.ok());
+  CHECK(kubeforward::runtime::PortClaimsOf(all.state, keys).size() == 2);
+  CHECK(kubeforward::runtime::LookupPortClaims(path.parent_path() / "missing" / "state", keys).claims.empty());
+}
+
+TEST_CASE("state store reads without the lock while a writer holds it", "[runtime]") {
+  // Writes for a while, so it keeps off the file the other tests share.
+  const auto path = TempStatePath().parent_path() / ("state-lock-free-" + std::to_string(::getpid()) + ".yaml");
+  std::filesystem::remove(path);
+  std::filesystem::remove(path.string() + ".journal");
+
+  kubeforward::runtime::RuntimeState state;
+  for (const auto* id : {"session-a", "session-b"}) {
+    kubeforward::runtime::ManagedSession session;
+    session.id = id;
+    session.environment = "dev";
+    session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{.forward_name = "api", .pid = 13000});
+    state.sessions.push_back(session);
+  }
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  const int lock_fd = ::open((path.string() + ".lock").c_str(), O_RDWR);
+  REQUIRE(lock_fd >= 0);
+  REQUIRE(::flock(lock_fd, LOCK_EX) == 0);
+  const auto locked = kubeforward::runtime::LoadSessionsWithoutLock(path, {.id = "session-b"});
+  ::close(lock_fd);
+  REQUIRE(locked.ok());
+  REQUIRE(locked.state.sessions.size() == 1);
+  CHECK(locked.state.sessions.at(0).forwards.at(0).pid == 13000);
+
+  // Every update moves both pids forward together; a reader must never see one without the other or go back to an
+  // older state, whether the update was journaled or compacted into a new snapshot.
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    std::string write_error;
+    for (int pid = 13001; pid < 13400; ++pid) {
+      (void)kubeforward::runtime::UpdateState(
+          path,
+          [pid](kubeforward::runtime::RuntimeState& current) {
+            current.sessions.at(0).forwards.at(0).pid = pid;
+            current.sessions.at(1).forwards.at(0).pid = pid;
+            current.sessions.at(1).forwards.at(0).argv.assign(pid % 7, std::string(512, 'x'));
+          },
+          write_error);
+    }
+    done = true;
+  });
+  int reads = 0;
+  int last_pid = 13000;
+  bool consistent = true;
+  while (!done) {
+    const auto read = kubeforward::runtime::LoadSessionsWithoutLock(path, {});
+    // A reader that kept colliding with the writer gives up instead of waiting for it.
+    if (!read.ok() && read.errors == std::vector<std::string>{"state file is being written; try again"}) {
+      continue;
+    }
+    ++reads;
+    if (!read.ok() || read.state.sessions.size() != 2 ||
+        read.state.sessions.at(0).forwards.at(0).pid != read.state.sessions.at(1).forwards.at(0).pid ||
+        read.state.sessions.at(0).forwards.at(0).pid < last_pid) {
+      consistent = false;
+      break;
+    }
+    last_pid = read.state.sessions.at(0).forwards.at(0).pid;
+  }
+  writer.join();
+  CHECK(consistent);
+  CHECK(reads > 0);
+  CHECK(kubeforward::runtime::LoadSessionsWithoutLock(path, {}).state.sessions.at(1).forwards.at(0).pid == 13399);
+
+  for (const auto* suffix : {"", ".journal", ".lock", ".seq"}) {
+    std::filesystem::remove(path.string() + suffix);
+  }
+}
+
+TEST_CASE("state store reads without the lock never wait behind a writer", "[runtime]") {
+  const auto path = TempStatePath().parent_path() / ("state-lock-free-busy-" + std::to_string(::getpid()) + ".yaml");
+  std::filesystem::remove(path);
+  std::filesystem::remove(path.string() + ".journal");
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "session-a";
+  session.environment = "dev";
+  session.forwards.push_back(kubeforward::runtime::ManagedForwardProcess{.forward_name = "api", .pid = 14000});
+  state.sessions.push_back(session);
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(path, state, error));
+
+  // An odd sequence is a write in progress, as if its writer were still publishing (or had died doing so).
+  const int sequence_fd = ::open((path.string() + ".seq").c_str(), O_RDWR);
+  REQUIRE(sequence_fd >= 0);
+  std::uint64_t sequence = 0;
+  REQUIRE(::pread(sequence_fd, &sequence, sizeof(sequence), 0) == static_cast<ssize_t>(sizeof(sequence)));
+  sequence |= 1;
+  REQUIRE(::pwrite(sequence_fd, &sequence, sizeof(sequence), 0) == static_cast<ssize_t>(sizeof(sequence)));
+  ::close(sequence_fd);
+
+  const int lock_fd = ::open((path.string() + ".lock").c_str(), O_RDWR);
+  REQUIRE(lock_fd >= 0);
+  REQUIRE(::flock(lock_fd, LOCK_EX) == 0);
+  const auto start = std::chrono::steady_clock::now();
+  const auto busy = kubeforward::runtime::LoadSessionsWithoutLock(path, {});
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  ::close(lock_fd);
+  CHECK_FALSE(busy.ok());
+  CHECK(busy.state.sessions.empty());
+  CHECK(elapsed < std::chrono::milliseconds(100));
+
+  // Once no writer holds the lock, the reader takes it.
+  const auto settled = kubeforward::runtime::LoadSessionsWithoutLock(path, {});
+  REQUIRE(settled.ok());
+  REQUIRE(settled.state.sessions.size() == 1);
+  CHECK(settled.state.sessions.at(0).forwards.at(0).pid == 14000);
+
+  for (const auto* suffix : {"", ".journal", ".lock", ".seq"}) {
+    std::filesystem::remove(path.string() + suffix);
+  }
+}
+
 TEST_CASE("state store returns empty state for missing files", "[runtime]") {
   const auto path = TempStatePath();
   std::filesystem::remove(path);
@@ -86,6 +623,33 @@ TEST_CASE("default state path is deterministic for config path", "[runtime]") {
   CHECK(first != other);
 }
 
+TEST_CASE("default state path moves state files from the yaml name to the binary one", "[runtime]") {
+  const auto config_path = "/tmp/kubeforward-legacy-" + std::to_string(::getpid()) + ".yaml";
+  const auto path = kubeforward::runtime::DefaultStatePathForConfig(config_path);
+  CHECK(path.extension() == ".bin");
+  const auto legacy_path = path.parent_path() / (path.stem().string() + ".yaml");
+  std::filesystem::remove(path);
+
+  kubeforward::runtime::RuntimeState state;
+  kubeforward::runtime::ManagedSession session;
+  session.id = "legacy-name";
+  state.sessions.push_back(session);
+  std::string error;
+  REQUIRE(kubeforward::runtime::SaveState(legacy_path, state, error));
+
+  CHECK(kubeforward::runtime::DefaultStatePathForConfig(config_path) == path);
+  CHECK_FALSE(std::filesystem::exists(legacy_path));
+  const auto load = kubeforward::runtime::LoadState(path);
+  REQUIRE(load.ok());
+  REQUIRE(load.state.sessions.size() == 1);
+  CHECK(load.state.sessions.at(0).id == "legacy-name");
+
+  for (const auto* suffix : {"", ".lock", ".seq"}) {
+    std::filesystem::remove(path.string() + suffix);
+    std::filesystem::remove(legacy_path.string() + suffix);
+  }
+}
+
 TEST_CASE("default state path normalizes equivalent relative config paths", "[runtime]") {
   const auto base = std::filesystem::temp_directory_path() / "kubeforward-tests-state-path-normalize";
   std::filesystem::create_directories(base);
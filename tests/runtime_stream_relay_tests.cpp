@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "kubeforward/runtime/stream_relay.h"
+
+namespace {
+
+struct SocketPair {
+  SocketPair() { REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0); }
+  ~SocketPair() {
+    for (const int fd : fds) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  int fds[2] = {-1, -1};
+};
+
+void SetNonBlocking(int fd) { REQUIRE(::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == 0); }
+
+std::string ReadToEof(int fd) {
+  std::string data;
+  char buffer[4096];
+  ssize_t count = 0;
+  while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    data.append(buffer, static_cast<size_t>(count));
+  }
+  return data;
+}
+
+//! Pushes `payload` through a relay from one socket pair to another and returns what arrived at the far end.
+std::string RelayPayload(kubeforward::runtime::StreamRelay& relay, const std::string& payload) {
+  SocketPair source;
+  SocketPair destination;
+  SetNonBlocking(source.fds[1]);
+  SetNonBlocking(destination.fds[0]);
+
+  std::thread writer([&]() {
+    size_t written = 0;
+    while (written < payload.size()) {
+      const ssize_t count = ::write(source.fds[0], payload.data() + written, payload.size() - written);
+      if (count <= 0) {
+        break;
+      }
+      written += static_cast<size_t>(count);
+    }
+    ::shutdown(source.fds[0], SHUT_WR);
+  });
+  std::string received;
+  std::thread reader([&]() { received = ReadToEof(destination.fds[1]); });
+
+  while (!relay.shut()) {
+    pollfd fds[2] = {
+        {.fd = relay.wants_read() ? source.fds[1] : -1, .events = POLLIN, .revents = 0},
+        {.fd = relay.pending() ? destination.fds[0] : -1, .events = POLLOUT, .revents = 0},
+    };
+    REQUIRE(::poll(fds, 2, 5000) > 0);
+    REQUIRE(relay.Pump(source.fds[1], destination.fds[0]) == kubeforward::runtime::StreamRelay::Result::kOk);
+  }
+  writer.join();
+  reader.join();
+  return received;
+}
+
+std::string Pattern(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>('a' + i % 26);
+  }
+  return data;
+}
+
+}  // namespace
+
+TEST_CASE("stream relay splices a large payload and forwards the half-close", "[runtime]") {
+  kubeforward::runtime::RelayBufferPool pool;
+  kubeforward::runtime::StreamRelay relay(pool);
+  CHECK(relay.spliced() == kubeforward::runtime::StreamRelay::SupportsSplice());
+
+  const auto payload = Pattern(4 * 1024 * 1024 + 17);
+  CHECK(RelayPayload(relay, payload) == payload);
+  CHECK(relay.bytes_moved() == payload.size());
+  // Splicing never needs a user-space buffer.
+  CHECK(pool.idle() == (kubeforward::runtime::StreamRelay::SupportsSplice() ? 0u : 1u));
+}
+
+TEST_CASE("stream relay copy mode returns its buffer to the pool once drained", "[runtime]") {
+  kubeforward::runtime::RelayBufferPool pool;
+  kubeforward::runtime::StreamRelay relay(pool, kubeforward::runtime::StreamRelayMode::kCopy);
+  CHECK_FALSE(relay.spliced());
+
+  const auto payload = Pattern(1024 * 1024 + 3);
+  CHECK(RelayPayload(relay, payload) == payload);
+  CHECK(relay.bytes_moved() == payload.size());
+  CHECK(pool.idle() == 1);
+}
+
+TEST_CASE("stream relay stops reading while the destination applies backpressure", "[runtime]") {
+  for (const auto mode : {kubeforward::runtime::StreamRelayMode::kAuto, kubeforward::runtime::StreamRelayMode::kCopy}) {
+    kubeforward::runtime::RelayBufferPool pool;
+    kubeforward::runtime::StreamRelay relay(pool, mode);
+    SocketPair source;
+    SocketPair destination;
+    SetNonBlocking(source.fds[0]);
+    SetNonBlocking(source.fds[1]);
+    SetNonBlocking(destination.fds[0]);
+
+    // Nobody reads the destination, so only the socket buffers and the relay's window can absorb data.
+    const std::string chunk(64 * 1024, 'x');
+    for (int round = 0; round < 256 && relay.wants_read(); ++round) {
+      while (::write(source.fds[0], chunk.data(), chunk.size()) > 0) {
+      }
+      REQUIRE(relay.Pump(source.fds[1], destination.fds[0]) == kubeforward::runtime::StreamRelay::Result::kOk);
+    }
+    CHECK_FALSE(relay.wants_read());
+    CHECK(relay.pending());
+    CHECK_FALSE(relay.shut());
+  }
+}
@@ -0,0 +1,208 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "kubeforward/runtime/udp_relay.h"
+
+namespace {
+
+int ListenOnLoopback(int port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  const int reuse = 1;
+  (void)::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+//! A connected UDP client socket with a receive timeout.
+int UdpClient(int port) {
+  const int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  timeval timeout{.tv_sec = 5, .tv_usec = 0};
+  (void)::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+std::string ReceiveDatagram(int fd) {
+  char buffer[65536];
+  const ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+  return count > 0 ? std::string(buffer, static_cast<size_t>(count)) : std::string();
+}
+
+//! Stands in for the pod side of the tunnel: accepts `connections` tunnel connections and answers every frame with
+//! the upper-cased payload until the relay closes the connection. Returns how many connections it served.
+std::thread ServeFramedUppercaseEcho(int listen_fd, int connections, int& served) {
+  return std::thread([listen_fd, connections, &served]() {
+    for (int i = 0; i < connections; ++i) {
+      const int tunnel = ::accept(listen_fd, nullptr, nullptr);
+      if (tunnel < 0) {
+        return;
+      }
+      ++served;
+      std::thread([tunnel]() {
+        std::string stream;
+        std::vector<std::string> frames;
+        char buffer[4096];
+        ssize_t count = 0;
+        while ((count = ::read(tunnel, buffer, sizeof(buffer))) > 0) {
+          stream.append(buffer, static_cast<size_t>(count));
+          frames.clear();
+          kubeforward::runtime::ExtractDatagramFrames(stream, frames);
+          std::string reply;
+          for (auto& frame : frames) {
+            for (auto& ch : frame) {
+              ch = static_cast<char>(ch >= 'a' && ch <= 'z' ? ch - 'a' + 'A' : ch);
+            }
+            kubeforward::runtime::AppendDatagramFrame(reply, frame.data(), frame.size());
+          }
+          (void)::write(tunnel, reply.data(), reply.size());
+        }
+        ::close(tunnel);
+      }).detach();
+    }
+  });
+}
+
+}  // namespace
+
+TEST_CASE("datagram frames round-trip and wait for complete payloads", "[runtime]") {
+  std::string stream;
+  REQUIRE(kubeforward::runtime::AppendDatagramFrame(stream, "abc", 3));
+  REQUIRE(kubeforward::runtime::AppendDatagramFrame(stream, "", 0));
+  const std::string large(300, 'z');
+  REQUIRE(kubeforward::runtime::AppendDatagramFrame(stream, large.data(), large.size()));
+  CHECK(stream.substr(0, 2) == std::string("\0\3", 2));
+  CHECK_FALSE(kubeforward::runtime::AppendDatagramFrame(stream, large.data(), 70000));
+
+  // Feed the stream one byte short: the last frame must stay buffered.
+  std::string partial = stream.substr(0, stream.size() - 1);
+  std::vector<std::string> datagrams;
+  kubeforward::runtime::ExtractDatagramFrames(partial, datagrams);
+  REQUIRE(datagrams.size() == 2);
+  CHECK(datagrams.at(0) == "abc");
+  CHECK(datagrams.at(1).empty());
+  CHECK(partial.size() == 2 + large.size() - 1);
+
+  partial.push_back('z');
+  kubeforward::runtime::ExtractDatagramFrames(partial, datagrams);
+  REQUIRE(datagrams.size() == 3);
+  CHECK(datagrams.at(2) == large);
+  CHECK(partial.empty());
+}
+
+TEST_CASE("udp relay carries datagrams over one tunnel connection per client", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  int served = 0;
+  auto server = ServeFramedUppercaseEcho(upstream_fd, 2, served);
+
+  kubeforward::runtime::UdpForwardRelay relay;
+  REQUIRE(relay.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+
+  const int first = UdpClient(local_port);
+  const int second = UdpClient(local_port);
+  REQUIRE(first >= 0);
+  REQUIRE(second >= 0);
+  for (int i = 0; i < 20; ++i) {
+    const std::string query = "query-" + std::to_string(i);
+    REQUIRE(::send(first, query.data(), query.size(), 0) == static_cast<ssize_t>(query.size()));
+    CHECK(ReceiveDatagram(first) == "QUERY-" + std::to_string(i));
+  }
+  REQUIRE(::send(second, "ping", 4, 0) == 4);
+  CHECK(ReceiveDatagram(second) == "PING");
+
+  server.join();
+  ::close(first);
+  ::close(second);
+  ::close(upstream_fd);
+  relay.Stop();
+
+  CHECK(served == 2);
+  const auto stats = relay.Stats();
+  REQUIRE(stats.size() == 1);
+  CHECK(stats.at(0).connections == 2);
+  CHECK(stats.at(0).bytes_to_client == stats.at(0).bytes_to_upstream);
+}
+
+TEST_CASE("udp relay closes idle flows and opens a new tunnel for the next datagram", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  int served = 0;
+  auto server = ServeFramedUppercaseEcho(upstream_fd, 2, served);
+
+  kubeforward::runtime::UdpForwardRelay relay(std::chrono::milliseconds(100));
+  REQUIRE(relay.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+
+  const int client = UdpClient(local_port);
+  REQUIRE(client >= 0);
+  REQUIRE(::send(client, "one", 3, 0) == 3);
+  CHECK(ReceiveDatagram(client) == "ONE");
+  // The expiry sweep runs once a second.
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  REQUIRE(::send(client, "two", 3, 0) == 3);
+  CHECK(ReceiveDatagram(client) == "TWO");
+
+  server.join();
+  ::close(client);
+  ::close(upstream_fd);
+  relay.Stop();
+  CHECK(served == 2);
+  CHECK(relay.Stats().at(0).connections == 2);
+}
+
+TEST_CASE("udp relay drops datagrams while the tunnel is down", "[runtime]") {
+  std::string error;
+  const int upstream_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  const int local_port = kubeforward::runtime::ReserveLoopbackPort(error);
+  REQUIRE(upstream_port > 0);
+  REQUIRE(local_port > 0);
+
+  kubeforward::runtime::UdpForwardRelay relay;
+  REQUIRE(relay.Start({{.bind_address = "127.0.0.1", .local_port = local_port, .upstream_port = upstream_port}}, error));
+  const int client = UdpClient(local_port);
+  REQUIRE(client >= 0);
+  REQUIRE(::send(client, "lost", 4, 0) == 4);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  const int upstream_fd = ListenOnLoopback(upstream_port);
+  REQUIRE(upstream_fd >= 0);
+  int served = 0;
+  auto server = ServeFramedUppercaseEcho(upstream_fd, 1, served);
+  REQUIRE(::send(client, "found", 5, 0) == 5);
+  CHECK(ReceiveDatagram(client) == "FOUND");
+
+  server.join();
+  ::close(client);
+  ::close(upstream_fd);
+}